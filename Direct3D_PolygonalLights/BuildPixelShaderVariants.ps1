@@ -0,0 +1,52 @@
+# Builds PixelShader.hlsl once per LightMix but LIGHT_MIX_ALL (that one is
+# PixelShader.cso), with the mix's bits as LIGHT_* defines, into
+# PixelShaderVariants\PixelShader_<mix>.cso for Graphics::BindShaders. The
+# light types and their bits are read from the LightMix enum of Lights.h.
+#
+# Run by the PixelShaderVariants target after FxCompile. Only variants older
+# than PixelShader.hlsl or Lights.h are rebuilt, as many fxc at a time as
+# there are cores. With 7 light types an edit of the shader is 127 fxc /O3
+# runs of about what PixelShader.cso alone costs, divided by the core count.
+param(
+	[Parameter(Mandatory = $true)] [string] $Fxc,
+	[string] $OutDir = "PixelShaderVariants"
+)
+$ErrorActionPreference = "Stop"
+Set-Location $PSScriptRoot
+
+$types = @{}
+foreach ($match in [regex]::Matches((Get-Content Lights.h -Raw), 'LIGHT_MIX_(\w+)\s*=\s*1\s*<<\s*(\d+)')) {
+	$types[[int]$match.Groups[2].Value] = $match.Groups[1].Value
+}
+for ($bit = 0; $bit -lt $types.Count; $bit++) {
+	if (-not $types.ContainsKey($bit)) { throw "LightMix bits in Lights.h are not 0 to $($types.Count - 1)" }
+}
+$all = (1 -shl $types.Count) - 1
+
+New-Item -ItemType Directory -Force $OutDir | Out-Null
+$newest = (Get-Item PixelShader.hlsl, Lights.h | Sort-Object LastWriteTime | Select-Object -Last 1).LastWriteTime
+
+$builds = @()
+for ($mix = 0; $mix -lt $all; $mix++) {
+	$out = Join-Path $OutDir "PixelShader_$mix.cso"
+	if ((Test-Path $out) -and (Get-Item $out).LastWriteTime -ge $newest) { continue }
+
+	$defines = (0..($types.Count - 1) | ForEach-Object { "/D LIGHT_$($types[$_])=$(($mix -shr $_) -band 1)" }) -join " "
+	while (@($builds | Where-Object { -not $_.Process.HasExited }).Count -ge [Environment]::ProcessorCount) {
+		Start-Sleep -Milliseconds 20
+	}
+	$process = Start-Process $Fxc "/nologo /T ps_5_0 /E main /O3 $defines /Fo `"$out`" PixelShader.hlsl" -NoNewWindow -PassThru
+	$null = $process.Handle # keeps ExitCode readable after the process is gone
+	$builds += [pscustomobject]@{ Process = $process; Mix = $mix; Out = $out }
+}
+
+$failed = @()
+foreach ($build in $builds) {
+	$build.Process.WaitForExit()
+	if ($build.Process.ExitCode -ne 0) {
+		Remove-Item $build.Out -ErrorAction SilentlyContinue
+		$failed += $build.Mix
+	}
+}
+if ($failed.Count -gt 0) { throw "fxc failed for LightMix $($failed -join ', ')" }
+Write-Host "pixel shader variants: $($builds.Count) of $all rebuilt"
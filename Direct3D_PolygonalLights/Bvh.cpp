@@ -0,0 +1,307 @@
+#include "Bvh.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// Nodes are at most this deep; every split at least halves the biggest group.
+#define BVH_MAX_DEPTH 32
+
+// Empty slots lie outside every plane
+#define BVH_EMPTY 1e30f
+
+static float Axis(const Float3& v, int axis) {
+	return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+static Aabb Union(const Aabb& a, const Aabb& b) {
+	return {
+		{ std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z) },
+		{ std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z) }
+	};
+}
+
+static const Aabb EmptyAabb = { { BVH_EMPTY, BVH_EMPTY, BVH_EMPTY }, { -BVH_EMPTY, -BVH_EMPTY, -BVH_EMPTY } };
+
+Aabb TransformAabb(const Aabb& box, const Float4x4& transform) {
+	Float3 center = (box.min + box.max) * 0.5f;
+	Float3 extent = (box.max - box.min) * 0.5f;
+	Float3 c = XYZ(Transform({ center.x, center.y, center.z, 1 }, transform));
+	const float (*m)[4] = transform.m;
+	Float3 e = {
+		std::fabs(m[0][0]) * extent.x + std::fabs(m[1][0]) * extent.y + std::fabs(m[2][0]) * extent.z,
+		std::fabs(m[0][1]) * extent.x + std::fabs(m[1][1]) * extent.y + std::fabs(m[2][1]) * extent.z,
+		std::fabs(m[0][2]) * extent.x + std::fabs(m[1][2]) * extent.y + std::fabs(m[2][2]) * extent.z
+	};
+	return { c - e, c + e };
+}
+
+Frustum ExtractFrustum(const Float4x4& viewProjection) {
+	// clip = v * M, so clip.x is v against column 0 and so on
+	const float (*m)[4] = viewProjection.m;
+	Float4 column[4];
+	for (int j = 0; j < 4; j++)
+		column[j] = { m[0][j], m[1][j], m[2][j], m[3][j] };
+
+	Frustum frustum;
+	frustum.planes[0] = column[3] + column[0];
+	frustum.planes[1] = column[3] - column[0];
+	frustum.planes[2] = column[3] + column[1];
+	frustum.planes[3] = column[3] - column[1];
+	frustum.planes[4] = column[2];
+	frustum.planes[5] = column[3] - column[2];
+	for (Float4& plane : frustum.planes) {
+		float length = Length(XYZ(plane));
+		plane = plane * (1.0f / length);
+	}
+	return frustum;
+}
+
+bool IntersectsFrustum(const Frustum& frustum, const Aabb& box) {
+	for (const Float4& p : frustum.planes) {
+		Float3 corner = { p.x > 0 ? box.max.x : box.min.x, p.y > 0 ? box.max.y : box.min.y, p.z > 0 ? box.max.z : box.min.z };
+		if (corner.x * p.x + corner.y * p.y + corner.z * p.z + p.w < 0)
+			return false;
+	}
+	return true;
+}
+
+#pragma region Build
+
+void Bvh::Build(const Aabb* boxes, size_t count) {
+	Clear();
+	_order.resize(count);
+	std::iota(_order.begin(), _order.end(), 0u);
+	_centers.resize(count);
+	for (size_t i = 0; i < count; i++)
+		_centers[i] = (boxes[i].min + boxes[i].max) * 0.5f;
+
+	if (count > 0) {
+		_nodes.emplace_back();
+		BuildNode(0, 0, (uint32_t)count, boxes);
+	}
+	vector<Float3>().swap(_centers);
+}
+
+void Bvh::BuildNode(size_t node, uint32_t first, uint32_t count, const Aabb* boxes) {
+	uint32_t groupFirst[BVH_WIDTH] = { first };
+	uint32_t groupCount[BVH_WIDTH] = { count };
+	int groups = 1;
+	while (groups < BVH_WIDTH) {
+		int biggest = 0;
+		for (int i = 1; i < groups; i++)
+			if (groupCount[i] > groupCount[biggest])
+				biggest = i;
+		if (groupCount[biggest] < 2)
+			break;
+
+		uint32_t* begin = _order.data() + groupFirst[biggest];
+		uint32_t* end = begin + groupCount[biggest];
+		Float3 lo = _centers[*begin], hi = lo;
+		for (uint32_t* it = begin; it < end; it++) {
+			const Float3& c = _centers[*it];
+			lo = { std::min(lo.x, c.x), std::min(lo.y, c.y), std::min(lo.z, c.z) };
+			hi = { std::max(hi.x, c.x), std::max(hi.y, c.y), std::max(hi.z, c.z) };
+		}
+		Float3 size = hi - lo;
+		int axis = size.x >= size.y && size.x >= size.z ? 0 : size.y >= size.z ? 1 : 2;
+
+		uint32_t half = groupCount[biggest] / 2;
+		std::nth_element(begin, begin + half, end, [&](uint32_t a, uint32_t b) {
+			return Axis(_centers[a], axis) < Axis(_centers[b], axis);
+		});
+		groupFirst[groups] = groupFirst[biggest] + half;
+		groupCount[groups] = groupCount[biggest] - half;
+		groupCount[biggest] = half;
+		groups++;
+	}
+
+	for (int slot = 0; slot < BVH_WIDTH; slot++)
+		SetChild(_nodes[node], slot, EmptyAabb, -1, 0, 0);
+
+	for (int slot = 0; slot < groups; slot++) {
+		Aabb box = EmptyAabb;
+		for (uint32_t i = groupFirst[slot]; i < groupFirst[slot] + groupCount[slot]; i++)
+			box = Union(box, boxes[_order[i]]);
+
+		int32_t child = -1;
+		if (groupCount[slot] > 1) {
+			child = (int32_t)_nodes.size();
+			_nodes.emplace_back();
+			BuildNode(child, groupFirst[slot], groupCount[slot], boxes);
+		}
+		SetChild(_nodes[node], slot, box, child, groupFirst[slot], groupCount[slot]);
+	}
+}
+
+void Bvh::Refit(const Aabb* boxes) {
+	if (!_nodes.empty())
+		RefitNode(0, boxes);
+}
+
+Aabb Bvh::RefitNode(size_t node, const Aabb* boxes) {
+	Aabb bounds = EmptyAabb;
+	for (int slot = 0; slot < BVH_WIDTH; slot++) {
+		Node& n = _nodes[node];
+		if (n.count[slot] == 0)
+			continue;
+		Aabb box = n.child[slot] < 0 ? boxes[_order[n.first[slot]]] : RefitNode(n.child[slot], boxes);
+		SetChild(_nodes[node], slot, box, n.child[slot], n.first[slot], n.count[slot]);
+		bounds = Union(bounds, box);
+	}
+	return bounds;
+}
+
+void Bvh::SetChild(Node& node, int slot, const Aabb& box, int32_t child, uint32_t first, uint32_t count) {
+	node.minX[slot] = box.min.x;
+	node.minY[slot] = box.min.y;
+	node.minZ[slot] = box.min.z;
+	node.maxX[slot] = box.max.x;
+	node.maxY[slot] = box.max.y;
+	node.maxZ[slot] = box.max.z;
+	node.child[slot] = child;
+	node.first[slot] = first;
+	node.count[slot] = count;
+}
+
+void Bvh::Clear() {
+	_nodes.clear();
+	_order.clear();
+}
+
+#pragma endregion
+
+#pragma region Cull
+
+int Bvh::MaxLanes() {
+#if SIMD_WIDTH >= 8
+	return 8;
+#elif defined(SIMD_SSE2)
+	return 4;
+#else
+	return 1;
+#endif
+}
+
+void Bvh::Cull(const Frustum& frustum, vector<uint32_t>& visible, int lanes, BvhCullStats* stats) const {
+	if (lanes <= 0 || lanes > MaxLanes())
+		lanes = MaxLanes();
+#if SIMD_WIDTH >= 8
+	if (lanes >= 8)
+		return CullLanes<8>(frustum, visible, stats);
+#endif
+#if defined(SIMD_SSE2)
+	if (lanes >= 4)
+		return CullLanes<4>(frustum, visible, stats);
+#endif
+	CullLanes<1>(frustum, visible, stats);
+}
+
+// Per plane only the box corner farthest along the normal can be inside, and
+// only the nearest one can be outside; which corner that is depends on the
+// plane alone, so the lanes just load min or max arrays.
+template<int W>
+void Bvh::CullLanes(const Frustum& frustum, vector<uint32_t>& visible, BvhCullStats* stats) const {
+	typedef SimdF<W> F;
+	typedef typename F::Mask Mask;
+	if (_nodes.empty())
+		return;
+
+	const F zero(0.0f);
+	int32_t stack[BVH_MAX_DEPTH * BVH_WIDTH];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node& node = _nodes[stack[--top]];
+		if (stats)
+			stats->nodes++;
+
+		for (int group = 0; group < BVH_WIDTH; group += W) {
+			Mask outside = Less(zero, zero);
+			Mask inside = Less(zero, F(1.0f));
+			for (const Float4& p : frustum.planes) {
+				F farX = F::Load((p.x > 0 ? node.maxX : node.minX) + group);
+				F farY = F::Load((p.y > 0 ? node.maxY : node.minY) + group);
+				F farZ = F::Load((p.z > 0 ? node.maxZ : node.minZ) + group);
+				F nearX = F::Load((p.x > 0 ? node.minX : node.maxX) + group);
+				F nearY = F::Load((p.y > 0 ? node.minY : node.maxY) + group);
+				F nearZ = F::Load((p.z > 0 ? node.minZ : node.maxZ) + group);
+				F far = farX * F(p.x) + farY * F(p.y) + farZ * F(p.z) + F(p.w);
+				F near = nearX * F(p.x) + nearY * F(p.y) + nearZ * F(p.z) + F(p.w);
+				outside = F::Or(outside, Less(far, zero));
+				inside = F::AndNot(Less(near, zero), inside);
+			}
+
+			int outsideBits = F::Bits(outside), insideBits = F::Bits(inside);
+			for (int lane = 0; lane < W; lane++) {
+				int slot = group + lane;
+				if (node.count[slot] == 0 || (outsideBits >> lane & 1))
+					continue;
+				if (node.child[slot] >= 0 && !(insideBits >> lane & 1)) {
+					stack[top++] = node.child[slot];
+					continue;
+				}
+				if (stats && node.child[slot] >= 0)
+					stats->inside++;
+				visible.insert(visible.end(), _order.begin() + node.first[slot], _order.begin() + node.first[slot] + node.count[slot]);
+			}
+		}
+	}
+}
+
+#pragma endregion
+
+#pragma region Query
+
+void Bvh::Query(const Aabb& box, vector<uint32_t>& hits, int lanes) const {
+	if (lanes <= 0 || lanes > MaxLanes())
+		lanes = MaxLanes();
+#if SIMD_WIDTH >= 8
+	if (lanes >= 8)
+		return QueryLanes<8>(box, hits);
+#endif
+#if defined(SIMD_SSE2)
+	if (lanes >= 4)
+		return QueryLanes<4>(box, hits);
+#endif
+	QueryLanes<1>(box, hits);
+}
+
+// Two boxes are apart when one ends before the other starts on any axis;
+// empty slots end before everything starts.
+template<int W>
+void Bvh::QueryLanes(const Aabb& box, vector<uint32_t>& hits) const {
+	typedef SimdF<W> F;
+	typedef typename F::Mask Mask;
+	if (_nodes.empty())
+		return;
+
+	const F minX(box.min.x), minY(box.min.y), minZ(box.min.z);
+	const F maxX(box.max.x), maxY(box.max.y), maxZ(box.max.z);
+	int32_t stack[BVH_MAX_DEPTH * BVH_WIDTH];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node& node = _nodes[stack[--top]];
+		for (int group = 0; group < BVH_WIDTH; group += W) {
+			Mask apart = F::Or(
+				F::Or(Less(F::Load(node.maxX + group), minX), Less(maxX, F::Load(node.minX + group))),
+				F::Or(Less(F::Load(node.maxY + group), minY), Less(maxY, F::Load(node.minY + group))));
+			apart = F::Or(apart,
+				F::Or(Less(F::Load(node.maxZ + group), minZ), Less(maxZ, F::Load(node.minZ + group))));
+
+			int apartBits = F::Bits(apart);
+			for (int lane = 0; lane < W; lane++) {
+				int slot = group + lane;
+				if (node.count[slot] == 0 || (apartBits >> lane & 1))
+					continue;
+				if (node.child[slot] >= 0)
+					stack[top++] = node.child[slot];
+				else
+					hits.push_back(_order[node.first[slot]]);
+			}
+		}
+	}
+}
+
+#pragma endregion
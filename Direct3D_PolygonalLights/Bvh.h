@@ -0,0 +1,86 @@
+#pragma once
+
+#include "CpuMath.h"
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+// Children per node, tested together in SIMD lanes
+#define BVH_WIDTH 8
+
+struct Aabb {
+	Float3 min;
+	Float3 max;
+};
+
+// Box around a box after a row-vector transform
+Aabb TransformAabb(const Aabb& box, const Float4x4& transform);
+
+// Inward facing planes, dot(plane.xyz, p) + plane.w >= 0 inside: left,
+// right, bottom, top, near, far of a D3D (0 <= z <= w) clip space.
+struct Frustum {
+	Float4 planes[6];
+};
+
+Frustum ExtractFrustum(const Float4x4& viewProjection);
+
+// Not outside any single plane; conservative near the frustum's edges, the
+// same test the BVH applies to every box.
+bool IntersectsFrustum(const Frustum& frustum, const Aabb& box);
+
+struct BvhCullStats {
+	size_t nodes = 0;        // nodes whose children were tested
+	size_t inside = 0;       // subtrees taken whole, untested below
+};
+
+// Wide bounding volume hierarchy over object boxes for frustum culling. Every
+// node holds the boxes of its BVH_WIDTH children in SoA arrays, so one step
+// tests all of them against a plane at once. A child fully inside the
+// frustum adds its whole range of objects without going further down.
+class Bvh {
+public:
+	// Top-down: every node splits its objects into up to BVH_WIDTH groups by
+	// repeated median splits of the biggest group along its widest axis.
+	void Build(const Aabb* boxes, size_t count);
+	// Same objects moved: recomputes the node boxes, keeps the tree.
+	void Refit(const Aabb* boxes);
+	void Clear();
+
+	// Appends the indices of the boxes that intersect the frustum, in tree
+	// order. lanes is the SIMD width to test with, 1, 4 or 8; 0 takes the
+	// widest the build has.
+	void Cull(const Frustum& frustum, vector<uint32_t>& visible, int lanes = 0, BvhCullStats* stats = nullptr) const;
+	// Appends the indices of the boxes that overlap box, in tree order.
+	void Query(const Aabb& box, vector<uint32_t>& hits, int lanes = 0) const;
+
+	size_t GetObjectCount() const { return _order.size(); }
+	size_t GetNodeCount() const { return _nodes.size(); }
+	static int MaxLanes();
+
+private:
+	struct Node {
+		float minX[BVH_WIDTH];
+		float minY[BVH_WIDTH];
+		float minZ[BVH_WIDTH];
+		float maxX[BVH_WIDTH];
+		float maxY[BVH_WIDTH];
+		float maxZ[BVH_WIDTH];
+		int32_t child[BVH_WIDTH];  // node index, -1 for a single object
+		uint32_t first[BVH_WIDTH]; // objects below the child are _order[first..first + count)
+		uint32_t count[BVH_WIDTH]; // 0 for an empty slot
+	};
+
+	vector<Node> _nodes;
+	vector<uint32_t> _order;
+	vector<Float3> _centers; // build only
+
+	void BuildNode(size_t node, uint32_t first, uint32_t count, const Aabb* boxes);
+	Aabb RefitNode(size_t node, const Aabb* boxes);
+	void SetChild(Node& node, int slot, const Aabb& box, int32_t child, uint32_t first, uint32_t count);
+
+	template<int W>
+	void CullLanes(const Frustum& frustum, vector<uint32_t>& visible, BvhCullStats* stats) const;
+	template<int W>
+	void QueryLanes(const Aabb& box, vector<uint32_t>& hits) const;
+};
@@ -0,0 +1,29 @@
+#include "Camera.h"
+#include <cstring>
+
+bool Keyboard::keys[KEYBOARD_KEYS];
+
+void Keyboard::SetKeys(const bool state[KEYBOARD_KEYS]) {
+	memcpy(keys, state, sizeof(keys));
+}
+
+void Camera::Update() {
+	Float3 cameraMove = { 0, 0, 0 };
+	if (Keyboard::IsPressed('W')) cameraMove.z += 0.1f;
+	if (Keyboard::IsPressed('A')) cameraMove.x -= 0.1f;
+	if (Keyboard::IsPressed('S')) cameraMove.z -= 0.1f;
+	if (Keyboard::IsPressed('D')) cameraMove.x += 0.1f;
+	if (Keyboard::IsPressed('F')) cameraMove.y -= 0.1f;
+	if (Keyboard::IsPressed('R')) cameraMove.y += 0.1f;
+	if (Keyboard::IsPressed('I')) Rotation.x -= 0.01f;
+	if (Keyboard::IsPressed('K')) Rotation.x += 0.01f;
+	if (Keyboard::IsPressed('J')) Rotation.y -= 0.01f;
+	if (Keyboard::IsPressed('L')) Rotation.y += 0.01f;
+
+	// the move goes through its own translation as a point, so a step is
+	// twice cameraMove, as it always was
+	Float4x4 translation = Float4x4::Translation(cameraMove.x, cameraMove.y, cameraMove.z);
+	Float4x4 rotation = Float4x4::RotationRollPitchYaw(Rotation.x, Rotation.y, Rotation.z);
+	Float4 movement = Transform({ cameraMove.x, cameraMove.y, cameraMove.z, 1 }, translation * rotation);
+	Position += XYZ(movement);
+}
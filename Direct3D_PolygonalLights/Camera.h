@@ -0,0 +1,28 @@
+#pragma once
+
+#include "CpuMath.h"
+
+#define KEYBOARD_KEYS 256
+
+// Key state by virtual-key code, written by the window callback or an
+// InputReplay and read by Camera::Update.
+class Keyboard {
+private:
+	static bool keys[KEYBOARD_KEYS];
+public:
+	static void PressKey(unsigned char key) { keys[key] = true; }
+	static void ReleaseKey(unsigned char key) { keys[key] = false; }
+	static bool IsPressed(unsigned char key) { return keys[key]; }
+	static const bool* GetKeys() { return keys; }
+	static void SetKeys(const bool state[KEYBOARD_KEYS]);
+};
+
+// Fly camera driven by WASD/RF to move and IJKL to turn, one step per
+// Update. Kept free of DirectXMath so Headless replays move it exactly as
+// the app does.
+struct Camera {
+	Float3 Position = { -4, 1, -4 };
+	Float3 Rotation = { 0, 0, 0 };
+
+	void Update();
+};
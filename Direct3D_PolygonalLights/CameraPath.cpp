@@ -0,0 +1,88 @@
+#include "CameraPath.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+void CameraPath::AddKey(const PathKey& key) {
+	if (!_keys.empty() && key.time < _keys.back().time)
+		return;
+	_keys.push_back(key);
+}
+
+bool CameraPath::Load(const char* path) {
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	_keys.clear();
+	char line[512];
+	bool ok = true;
+	while (ok && fgets(line, sizeof(line), file)) {
+		if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0')
+			continue;
+		PathKey key;
+		ok = sscanf(line, "%f %f %f %f %f %f %f %f %f", &key.time,
+			&key.position.x, &key.position.y, &key.position.z,
+			&key.rotation.x, &key.rotation.y, &key.rotation.z,
+			&key.lightRotation[0], &key.lightRotation[1]) == 9
+			&& (_keys.empty() || key.time >= _keys.back().time);
+		_keys.push_back(key);
+	}
+	fclose(file);
+	if (!ok)
+		_keys.clear();
+	return ok && !_keys.empty();
+}
+
+bool CameraPath::Save(const char* path) const {
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return false;
+
+	fprintf(file, "# time px py pz pitch yaw roll lightZ lightW\n");
+	for (const PathKey& key : _keys)
+		fprintf(file, "%.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g\n", key.time,
+			key.position.x, key.position.y, key.position.z,
+			key.rotation.x, key.rotation.y, key.rotation.z,
+			key.lightRotation[0], key.lightRotation[1]);
+	return fclose(file) == 0;
+}
+
+PathKey CameraPath::Sample(float time) const {
+	if (_keys.empty())
+		return { time, { -4, 1, -4 }, { 0, 0, 0 }, { 0, 0 } };
+	if (time <= _keys.front().time)
+		return _keys.front();
+	if (time >= _keys.back().time)
+		return _keys.back();
+
+	auto next = std::upper_bound(_keys.begin(), _keys.end(), time, [](float t, const PathKey& key) { return t < key.time; });
+	const PathKey& a = *(next - 1);
+	const PathKey& b = *next;
+	float s = b.time > a.time ? (time - a.time) / (b.time - a.time) : 0.0f;
+	auto lerp = [s](float x, float y) { return x + (y - x) * s; };
+	return {
+		time,
+		{ lerp(a.position.x, b.position.x), lerp(a.position.y, b.position.y), lerp(a.position.z, b.position.z) },
+		{ lerp(a.rotation.x, b.rotation.x), lerp(a.rotation.y, b.rotation.y), lerp(a.rotation.z, b.rotation.z) },
+		{ lerp(a.lightRotation[0], b.lightRotation[0]), lerp(a.lightRotation[1], b.lightRotation[1]) }
+	};
+}
+
+// Yaw is kept unwrapped, so interpolating between keys never turns the
+// long way round.
+CameraPath CameraPath::Orbit(float duration) {
+	const Float3 center = { 0, 0.5f, 4 };
+	const int keys = 64;
+	CameraPath path;
+	for (int i = 0; i <= keys; i++) {
+		float t = (float)i / keys;
+		float angle = t * 6.2831853f;
+		Float3 position = { center.x - 8 * std::sin(angle), 1.5f + std::sin(2 * angle), center.z - 8 * std::cos(angle) };
+		Float3 d = { center.x - position.x, center.y - position.y, center.z - position.z };
+		float pitch = std::atan2(-d.y, std::sqrt(d.x * d.x + d.z * d.z));
+		path.AddKey({ t * duration, position, { pitch, angle, 0 }, { t, 0.5f } });
+	}
+	return path;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "CpuMath.h"
+#include <vector>
+
+using std::vector;
+
+// Where the camera and the first rect light are at a point in time
+struct PathKey {
+	float time;          // seconds
+	Float3 position;
+	Float3 rotation;     // pitch, yaw, roll as Camera keeps them
+	float lightRotation[2]; // Params.z, Params.w of rect light 0, in turns
+};
+
+// A camera and light path replayed at a fixed timestep, so every run sees
+// the same frames. Keys are sorted by time and linearly interpolated, the
+// ends held. On disk it is text, one key per line:
+//   time px py pz pitch yaw roll lightZ lightW
+// with # starting a comment line.
+class CameraPath {
+public:
+	// A key at or after the last key's time
+	void AddKey(const PathKey& key);
+	void Clear() { _keys.clear(); }
+	bool Load(const char* path);
+	bool Save(const char* path) const;
+
+	PathKey Sample(float time) const;
+	float GetDuration() const { return _keys.empty() ? 0.0f : _keys.back().time; }
+	size_t GetKeyCount() const { return _keys.size(); }
+	const vector<PathKey>& GetKeys() const { return _keys; }
+
+	// The scripted default: one orbit around the wWinMain cube at a varying
+	// height, while the rect light turns once
+	static CameraPath Orbit(float duration = 10.0f);
+
+private:
+	vector<PathKey> _keys;
+};
@@ -0,0 +1,309 @@
+#include "ClusterGrid.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#pragma region LightRanges
+
+static float MaxColor(const Float4& color) {
+	return std::max({ color.x, color.y, color.z, 0.0f });
+}
+
+// the window is zero from the light's radius on, and at most 1 inside it
+static float WindowedRange(float cutoffRange, const Float4& range) {
+	return range.x > 0.0f ? std::min(cutoffRange, range.x) : cutoffRange;
+}
+
+// diffuse 5 * I / d^2 on the albedo plus specular I / d^2, both tinted by the light color
+float PointLightRange(const PointLight& light) {
+	float c = MaxColor(light.Color);
+	return WindowedRange(std::sqrt((5.0f + c) * c * std::max(light.Color.w, 0.0f) / LIGHT_CUTOFF), light.Range);
+}
+
+// same falloff as the point light without the 5x diffuse; the cone is ignored
+float SpotLightRange(const SpotLight& light) {
+	float c = MaxColor(light.Color);
+	return WindowedRange(std::sqrt((1.0f + c) * c * std::max(light.Color.w, 0.0f) / LIGHT_CUTOFF), light.Range);
+}
+
+// A small quad integrates to about 2 * area / d^2 under the cosine lobe. The
+// specular lobe at roughness 0.25 is assumed to be at most 4x as peaked.
+float RectLightRange(const RectLight& light) {
+	float halfWidth = std::fabs(light.Params.x);
+	float halfHeight = std::fabs(light.Params.y);
+	float area = 4.0f * halfWidth * halfHeight;
+	float c = MaxColor(light.Color);
+	float energy = 2.0f * area * (1.5f + 0.2f * 4.0f * c) * c * std::max(light.Color.w, 0.0f) / (2.0f * PI);
+	return std::sqrt(halfWidth * halfWidth + halfHeight * halfHeight) + std::sqrt(energy / LIGHT_CUTOFF);
+}
+
+// A sphere looks like a disk of its radius from anywhere
+float DiskLightRange(const DiskLight& light) {
+	float radius = std::fabs(light.Direction.w);
+	float area = PI * radius * radius;
+	float c = MaxColor(light.Color);
+	float energy = 2.0f * area * (1.5f + 0.2f * 4.0f * c) * c * std::max(light.Color.w, 0.0f) / (2.0f * PI);
+	return radius + std::sqrt(energy / LIGHT_CUTOFF);
+}
+
+float SphereLightRange(const SphereLight& light) {
+	return DiskLightRange({ light.Position, { 0, 0, 1, light.Position.w }, light.Color, {} });
+}
+
+void BoundPolygonLight(PolygonLight& light, const Float4* vertices) {
+	int count = (int)light.Vertices[0];
+	Float3 center = { 0, 0, 0 };
+	for (int i = 0; i < count; i++)
+		center += XYZ(vertices[i]);
+	center = center * (1.0f / count);
+
+	float area = 0.0f;
+	float extent = 0.0f;
+	for (int i = 0; i < count; i++) {
+		Float3 a = XYZ(vertices[i]) - center;
+		Float3 b = XYZ(vertices[(i + 1) % count]) - center;
+		area += 0.5f * Length(Cross(a, b));
+		extent = std::max(extent, Length(a));
+	}
+	float c = MaxColor(light.Color);
+	float energy = 2.0f * area * (1.5f + 0.2f * 4.0f * c) * c * std::max(light.Color.w, 0.0f) / (2.0f * PI);
+	light.Bounds = { center.x, center.y, center.z, extent + std::sqrt(energy / LIGHT_CUTOFF) };
+}
+
+// ambientStr defaults of CalcPointLight/CalcSpotLight (scaled by intensity) and CalcRectLight (not scaled)
+Float3 SumLightAmbient(const PointLight* pointLights, size_t pointCount,
+	const SpotLight* spotLights, size_t spotCount,
+	const RectLight* rectLights, size_t rectCount)
+{
+	Float3 ambient = { 0, 0, 0 };
+	for (size_t i = 0; i < pointCount; i++)
+		ambient += XYZ(pointLights[i].Color) * (0.01f * pointLights[i].Color.w);
+	for (size_t i = 0; i < spotCount; i++)
+		ambient += XYZ(spotLights[i].Color) * (0.01f * spotLights[i].Color.w);
+	for (size_t i = 0; i < rectCount; i++)
+		ambient += XYZ(rectLights[i].Color) * 0.05f;
+	return ambient;
+}
+
+#pragma endregion
+
+#pragma region Grid
+
+// Slopes x/z of the two lines through the origin tangent to a circle at
+// (c, z) with radius r. False when the origin is inside the circle's shadow.
+static bool TangentSlopes(float c, float z, float r, float& lo, float& hi) {
+	float d = z * z - r * r;
+	if (z <= r || d <= 0.0f)
+		return false;
+
+	float s = r * std::sqrt(c * c + d);
+	lo = (c * z - s) / d;
+	hi = (c * z + s) / d;
+	return true;
+}
+
+int ClusterGrid::GetSlice(float viewZ) const {
+	float s = std::floor(std::log(std::max(viewZ, 1e-6f)) * _sliceScale + _sliceBias);
+	return (int)std::min(std::max(s, 0.0f), (float)(_desc.slices - 1));
+}
+
+void ClusterGrid::GetClusterBounds(size_t cluster, Float3& boundsMin, Float3& boundsMax) const {
+	boundsMin = _boxes[cluster].min;
+	boundsMax = _boxes[cluster].max;
+}
+
+void ClusterGrid::SetDesc(const ClusterGridDesc& desc) {
+	if (memcmp(&desc, &_desc, sizeof(desc)) == 0 && !_boxes.empty())
+		return;
+
+	_desc = desc;
+	_tilesX = (desc.width + desc.tileSize - 1) / desc.tileSize;
+	_tilesY = (desc.height + desc.tileSize - 1) / desc.tileSize;
+	float logRange = std::log(desc.farZ / desc.nearZ);
+	_sliceScale = desc.slices / logRange;
+	_sliceBias = -desc.slices * std::log(desc.nearZ) / logRange;
+
+	_boxes.resize((size_t)_tilesX * _tilesY * desc.slices);
+	for (int s = 0; s < desc.slices; s++) {
+		float zNear = desc.nearZ * std::pow(desc.farZ / desc.nearZ, (float)s / desc.slices);
+		float zFar = desc.nearZ * std::pow(desc.farZ / desc.nearZ, (float)(s + 1) / desc.slices);
+		for (int y = 0; y < _tilesY; y++) {
+			// screen y grows downwards, view y upwards
+			float top = (1.0f - 2.0f * y * desc.tileSize / desc.height) * desc.tanHalfFovY;
+			float bottom = (1.0f - 2.0f * (y + 1) * desc.tileSize / desc.height) * desc.tanHalfFovY;
+			for (int x = 0; x < _tilesX; x++) {
+				float left = (2.0f * x * desc.tileSize / desc.width - 1.0f) * desc.tanHalfFovX;
+				float right = (2.0f * (x + 1) * desc.tileSize / desc.width - 1.0f) * desc.tanHalfFovX;
+
+				ClusterBox& box = _boxes[GetClusterIndex(x, y, s)];
+				box.min = { std::min(left * zNear, left * zFar), std::min(bottom * zNear, bottom * zFar), zNear };
+				box.max = { std::max(right * zNear, right * zFar), std::max(top * zNear, top * zFar), zFar };
+			}
+		}
+	}
+}
+
+void ClusterGrid::BoundLight(LightBounds& bounds, Float3 center, float radius) const {
+	bounds.center = center;
+	bounds.radius = radius;
+	bounds.s0 = 1;
+	bounds.s1 = 0;
+
+	if (center.z + radius < _desc.nearZ || center.z - radius > _desc.farZ)
+		return;
+
+	// tile ranges from the tangent planes, in pixels first so offscreen lights drop out
+	float tileSpanX = (float)(_tilesX * _desc.tileSize);
+	float tileSpanY = (float)(_tilesY * _desc.tileSize);
+	float x0 = 0.0f, x1 = tileSpanX - 1.0f;
+	float y0 = 0.0f, y1 = tileSpanY - 1.0f;
+	float lo, hi;
+	if (TangentSlopes(center.x, center.z, radius, lo, hi)) {
+		x0 = (lo / _desc.tanHalfFovX * 0.5f + 0.5f) * _desc.width;
+		x1 = (hi / _desc.tanHalfFovX * 0.5f + 0.5f) * _desc.width;
+	}
+	if (TangentSlopes(center.y, center.z, radius, lo, hi)) {
+		y0 = (0.5f - hi / _desc.tanHalfFovY * 0.5f) * _desc.height;
+		y1 = (0.5f - lo / _desc.tanHalfFovY * 0.5f) * _desc.height;
+	}
+	if (x1 < 0.0f || y1 < 0.0f || x0 >= tileSpanX || y0 >= tileSpanY)
+		return;
+
+	bounds.x0 = (int)std::max(x0, 0.0f) / _desc.tileSize;
+	bounds.x1 = (int)std::min(x1, tileSpanX - 1.0f) / _desc.tileSize;
+	bounds.y0 = (int)std::max(y0, 0.0f) / _desc.tileSize;
+	bounds.y1 = (int)std::min(y1, tileSpanY - 1.0f) / _desc.tileSize;
+	bounds.s0 = GetSlice(std::max(center.z - radius, _desc.nearZ));
+	bounds.s1 = GetSlice(std::min(center.z + radius, _desc.farZ));
+}
+
+void ClusterGrid::Build(const ClusterGridDesc& desc, const Float4x4& worldToView,
+	const PointLight* pointLights, size_t pointCount,
+	const SpotLight* spotLights, size_t spotCount,
+	const RectLight* rectLights, size_t rectCount,
+	ThreadPool& pool)
+{
+	SetDesc(desc);
+
+	// View-space bounds, one light id space: points, then spots, then rects
+	//========================================
+	size_t lightCount = pointCount + spotCount + rectCount;
+	_bounds.resize(lightCount);
+	pool.ParallelFor((lightCount + 255) / 256, [&](size_t block) {
+		size_t last = std::min(lightCount, (block + 1) * 256);
+		for (size_t i = block * 256; i < last; i++) {
+			Float4 position;
+			float radius;
+			if (i < pointCount) {
+				position = pointLights[i].Position;
+				radius = PointLightRange(pointLights[i]);
+			}
+			else if (i < pointCount + spotCount) {
+				position = spotLights[i - pointCount].Position;
+				radius = SpotLightRange(spotLights[i - pointCount]);
+			}
+			else {
+				position = rectLights[i - pointCount - spotCount].Position;
+				radius = RectLightRange(rectLights[i - pointCount - spotCount]);
+			}
+			Float4 view = Transform({ position.x, position.y, position.z, 1.0f }, worldToView);
+			BoundLight(_bounds[i], XYZ(view), radius);
+		}
+	});
+
+	// Bin by depth slice, keeping id order
+	//========================================
+	_sliceLights.resize(desc.slices);
+	for (vector<uint32_t>& slice : _sliceLights)
+		slice.clear();
+	for (size_t i = 0; i < lightCount; i++)
+		for (int s = _bounds[i].s0; s <= _bounds[i].s1; s++)
+			_sliceLights[s].push_back((uint32_t)i);
+
+	// Fill every row of clusters, then pack the rows
+	//========================================
+	size_t rows = (size_t)desc.slices * _tilesY;
+	_rowIndices.resize(rows);
+	_clusters.resize(_boxes.size());
+	pool.ParallelFor(rows, [&](size_t row) {
+		FillRow(row, pointCount, spotCount);
+	});
+
+	size_t total = 0;
+	for (size_t row = 0; row < rows; row++) {
+		ClusterRange* first = &_clusters[row * _tilesX];
+		for (int x = 0; x < _tilesX; x++)
+			first[x].offset += (uint32_t)total;
+		total += _rowIndices[row].size();
+	}
+
+	_lightIndices.resize(total);
+	pool.ParallelFor(rows, [&](size_t row) {
+		const vector<uint32_t>& indices = _rowIndices[row];
+		if (!indices.empty())
+			memcpy(&_lightIndices[_clusters[row * _tilesX].offset], indices.data(), indices.size() * sizeof(uint32_t));
+	});
+}
+
+// row = slice * tilesY + y, which is also the first cluster of the row / tilesX.
+// Hits are collected light by light and then counting-sorted by tile, which
+// keeps every cluster's list in id order (points, spots, rects).
+void ClusterGrid::FillRow(size_t row, size_t pointCount, size_t spotCount) {
+	struct Hit {
+		uint32_t x;
+		uint32_t id;
+	};
+	thread_local vector<Hit> hits;
+	thread_local vector<uint32_t> cursor;
+	int slice = (int)(row / _tilesY);
+	int y = (int)(row % _tilesY);
+	ClusterRange* clusters = &_clusters[GetClusterIndex(0, y, slice)];
+	const ClusterBox* boxes = &_boxes[GetClusterIndex(0, y, slice)];
+
+	hits.clear();
+	cursor.assign(_tilesX, 0);
+	for (uint32_t id : _sliceLights[slice]) {
+		const LightBounds& b = _bounds[id];
+		if (y < b.y0 || y > b.y1)
+			continue;
+
+		for (int x = b.x0; x <= b.x1; x++) {
+			const ClusterBox& box = boxes[x];
+			float dx = std::max({ box.min.x - b.center.x, 0.0f, b.center.x - box.max.x });
+			float dy = std::max({ box.min.y - b.center.y, 0.0f, b.center.y - box.max.y });
+			float dz = std::max({ box.min.z - b.center.z, 0.0f, b.center.z - box.max.z });
+			if (dx * dx + dy * dy + dz * dz > b.radius * b.radius)
+				continue;
+
+			hits.push_back({ (uint32_t)x, id });
+			cursor[x]++;
+		}
+	}
+
+	uint32_t offset = 0;
+	for (int x = 0; x < _tilesX; x++) {
+		clusters[x] = { offset, 0, 0, 0 };
+		offset += cursor[x];
+		cursor[x] = clusters[x].offset;
+	}
+
+	vector<uint32_t>& out = _rowIndices[row];
+	out.resize(hits.size());
+	for (const Hit& hit : hits) {
+		ClusterRange& cluster = clusters[hit.x];
+		uint32_t index = hit.id;
+		if (hit.id < pointCount)
+			cluster.pointCount++;
+		else if (hit.id < pointCount + spotCount) {
+			cluster.spotCount++;
+			index -= (uint32_t)pointCount;
+		}
+		else {
+			cluster.rectCount++;
+			index -= (uint32_t)(pointCount + spotCount);
+		}
+		out[cursor[hit.x]++] = index;
+	}
+}
+
+#pragma endregion
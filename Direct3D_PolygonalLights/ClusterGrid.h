@@ -0,0 +1,110 @@
+#pragma once
+
+#include "CpuMath.h"
+#include "Lights.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+#define CLUSTER_TILE_SIZE 64
+#define CLUSTER_SLICES 24
+
+// Lights are culled where their contribution (without the ambient term,
+// which the renderers sum separately) drops below this, or past the radius
+// of a windowed point or spot light. Rect lights are two-sided, so their
+// range is a sphere around the quad that grows with intensity and area.
+#define LIGHT_CUTOFF (1.0f / 256.0f)
+
+float PointLightRange(const PointLight& light);
+float SpotLightRange(const SpotLight& light);
+float RectLightRange(const RectLight& light);
+// Sets Bounds of a polygon light from its vertices, like RectLightRange.
+void BoundPolygonLight(PolygonLight& light, const Float4* vertices);
+float DiskLightRange(const DiskLight& light);
+float SphereLightRange(const SphereLight& light);
+
+// The per-light ambient terms of the shading functions do not fall off with
+// distance, so clustered shading drops them per light and adds this sum once.
+Float3 SumLightAmbient(const PointLight* pointLights, size_t pointCount,
+	const SpotLight* spotLights, size_t spotCount,
+	const RectLight* rectLights, size_t rectCount);
+
+struct ClusterGridDesc {
+	int width;          // viewport in pixels
+	int height;
+	int tileSize;       // cluster footprint in pixels
+	int slices;         // exponential depth slices between nearZ and farZ
+	float nearZ;
+	float farZ;
+	float tanHalfFovX;  // 1 / projection[0][0]
+	float tanHalfFovY;  // 1 / projection[1][1]
+};
+
+// Matches the uint4 the pixel shader reads per cluster: the lights of a
+// cluster are GetLightIndices()[offset..] as points, then spots, then rects,
+// each an index into its own light array.
+struct ClusterRange {
+	uint32_t offset;
+	uint32_t pointCount;
+	uint32_t spotCount;
+	uint32_t rectCount;
+};
+
+// Froxel light grid built on the CPU every frame. Lights are bounded by a
+// view-space sphere, binned to the slices they overlap, and then every row
+// of clusters is filled in parallel with a sphere/AABB test.
+class ClusterGrid {
+public:
+	void Build(const ClusterGridDesc& desc, const Float4x4& worldToView,
+		const PointLight* pointLights, size_t pointCount,
+		const SpotLight* spotLights, size_t spotCount,
+		const RectLight* rectLights, size_t rectCount,
+		ThreadPool& pool);
+
+	const ClusterGridDesc& GetDesc() const { return _desc; }
+	int GetTilesX() const { return _tilesX; }
+	int GetTilesY() const { return _tilesY; }
+	size_t GetClusterCount() const { return _clusters.size(); }
+	const vector<ClusterRange>& GetClusters() const { return _clusters; }
+	const vector<uint32_t>& GetLightIndices() const { return _lightIndices; }
+
+	// slice = floor(log(viewZ) * scale + bias), as in the pixel shader
+	float GetSliceScale() const { return _sliceScale; }
+	float GetSliceBias() const { return _sliceBias; }
+	int GetSlice(float viewZ) const;
+	size_t GetClusterIndex(int x, int y, int slice) const { return ((size_t)slice * _tilesY + y) * _tilesX + x; }
+
+	// view-space bounds of a cluster, for validation
+	void GetClusterBounds(size_t cluster, Float3& boundsMin, Float3& boundsMax) const;
+
+private:
+	struct LightBounds {
+		Float3 center; // view space
+		float radius;
+		int x0, x1, y0, y1, s0, s1; // empty when s0 > s1
+	};
+
+	struct ClusterBox {
+		Float3 min;
+		Float3 max;
+	};
+
+	ClusterGridDesc _desc = {};
+	int _tilesX = 0;
+	int _tilesY = 0;
+	float _sliceScale = 0.0f;
+	float _sliceBias = 0.0f;
+
+	vector<ClusterBox> _boxes;
+	vector<LightBounds> _bounds;
+	vector<vector<uint32_t>> _sliceLights;
+	vector<vector<uint32_t>> _rowIndices;
+	vector<ClusterRange> _clusters;
+	vector<uint32_t> _lightIndices;
+
+	void SetDesc(const ClusterGridDesc& desc);
+	void BoundLight(LightBounds& bounds, Float3 center, float radius) const;
+	void FillRow(size_t row, size_t pointCount, size_t spotCount);
+};
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cmath>
+
+// Small HLSL-like vector math for the CPU side. Kept free of DirectXMath and
+// Windows headers so the CPU reference code builds on any platform.
+
+static const float PI = 3.14159265f;
+
+struct Float3 {
+	float x;
+	float y;
+	float z;
+};
+
+struct Float4 {
+	float x;
+	float y;
+	float z;
+	float w;
+};
+
+inline Float3 operator+(Float3 a, Float3 b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline Float3 operator-(Float3 a, Float3 b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline Float3 operator*(Float3 a, Float3 b) { return { a.x * b.x, a.y * b.y, a.z * b.z }; }
+inline Float3 operator*(Float3 a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+inline Float3 operator*(float s, Float3 a) { return { a.x * s, a.y * s, a.z * s }; }
+inline Float3 operator/(Float3 a, float s) { return { a.x / s, a.y / s, a.z / s }; }
+inline Float3 operator-(Float3 a) { return { -a.x, -a.y, -a.z }; }
+inline Float3& operator+=(Float3& a, Float3 b) { a = a + b; return a; }
+inline Float3& operator*=(Float3& a, float s) { a = a * s; return a; }
+
+inline float Dot(Float3 a, Float3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline float Length(Float3 a) { return std::sqrt(Dot(a, a)); }
+inline Float3 Normalize(Float3 a) { return a / Length(a); }
+inline float Saturate(float v) { return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v); }
+
+inline Float3 Cross(Float3 a, Float3 b) {
+	return {
+		a.y * b.z - a.z * b.y,
+		a.z * b.x - a.x * b.z,
+		a.x * b.y - a.y * b.x
+	};
+}
+
+inline Float3 XYZ(Float4 v) { return { v.x, v.y, v.z }; }
+
+struct Float2 {
+	float x;
+	float y;
+};
+
+inline Float4 operator+(Float4 a, Float4 b) { return { a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w }; }
+inline Float4 operator-(Float4 a, Float4 b) { return { a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w }; }
+inline Float4 operator*(Float4 a, float s) { return { a.x * s, a.y * s, a.z * s, a.w * s }; }
+
+// Row-major 4x4 matrix used with row vectors (v * M), the same convention as
+// DirectXMath, so the helpers below produce the matrices Graphics builds.
+struct Float4x4 {
+	float m[4][4];
+
+	static Float4x4 Identity();
+	static Float4x4 Translation(float x, float y, float z);
+	static Float4x4 Scaling(float x, float y, float z);
+	static Float4x4 RotationX(float angle);
+	static Float4x4 RotationY(float angle);
+	static Float4x4 RotationZ(float angle);
+	static Float4x4 RotationRollPitchYaw(float pitch, float yaw, float roll);
+	static Float4x4 PerspectiveLH(float viewWidth, float viewHeight, float nearZ, float farZ);
+	static Float4x4 LookToLH(Float3 eye, Float3 direction, Float3 up);
+};
+
+inline Float4x4 Float4x4::Identity() {
+	return { { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } } };
+}
+
+inline Float4x4 Float4x4::Translation(float x, float y, float z) {
+	return { { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { x, y, z, 1 } } };
+}
+
+inline Float4x4 Float4x4::Scaling(float x, float y, float z) {
+	return { { { x, 0, 0, 0 }, { 0, y, 0, 0 }, { 0, 0, z, 0 }, { 0, 0, 0, 1 } } };
+}
+
+inline Float4x4 Float4x4::RotationX(float angle) {
+	float s = std::sin(angle), c = std::cos(angle);
+	return { { { 1, 0, 0, 0 }, { 0, c, s, 0 }, { 0, -s, c, 0 }, { 0, 0, 0, 1 } } };
+}
+
+inline Float4x4 Float4x4::RotationY(float angle) {
+	float s = std::sin(angle), c = std::cos(angle);
+	return { { { c, 0, -s, 0 }, { 0, 1, 0, 0 }, { s, 0, c, 0 }, { 0, 0, 0, 1 } } };
+}
+
+inline Float4x4 Float4x4::RotationZ(float angle) {
+	float s = std::sin(angle), c = std::cos(angle);
+	return { { { c, s, 0, 0 }, { -s, c, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } } };
+}
+
+inline Float4x4 operator*(const Float4x4& a, const Float4x4& b) {
+	Float4x4 r;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+	return r;
+}
+
+// roll around z, then pitch around x, then yaw around y
+inline Float4x4 Float4x4::RotationRollPitchYaw(float pitch, float yaw, float roll) {
+	return RotationZ(roll) * RotationX(pitch) * RotationY(yaw);
+}
+
+inline Float4x4 Float4x4::PerspectiveLH(float viewWidth, float viewHeight, float nearZ, float farZ) {
+	float range = farZ / (farZ - nearZ);
+	return { {
+		{ 2 * nearZ / viewWidth, 0, 0, 0 },
+		{ 0, 2 * nearZ / viewHeight, 0, 0 },
+		{ 0, 0, range, 1 },
+		{ 0, 0, -range * nearZ, 0 }
+	} };
+}
+
+inline Float4x4 Float4x4::LookToLH(Float3 eye, Float3 direction, Float3 up) {
+	Float3 zAxis = Normalize(direction);
+	Float3 xAxis = Normalize(Cross(up, zAxis));
+	Float3 yAxis = Cross(zAxis, xAxis);
+	return { {
+		{ xAxis.x, yAxis.x, zAxis.x, 0 },
+		{ xAxis.y, yAxis.y, zAxis.y, 0 },
+		{ xAxis.z, yAxis.z, zAxis.z, 0 },
+		{ -Dot(xAxis, eye), -Dot(yAxis, eye), -Dot(zAxis, eye), 1 }
+	} };
+}
+
+inline Float4x4 Transpose(const Float4x4& a) {
+	Float4x4 r;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			r.m[i][j] = a.m[j][i];
+	return r;
+}
+
+// General inverse by cofactors; returns the identity for singular matrices.
+inline Float4x4 Inverse(const Float4x4& a) {
+	const float* m = &a.m[0][0];
+	float inv[16];
+	inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+	inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+	float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+	if (det == 0.0f)
+		return Float4x4::Identity();
+
+	Float4x4 r;
+	for (int i = 0; i < 16; i++)
+		(&r.m[0][0])[i] = inv[i] / det;
+	return r;
+}
+
+inline Float4 Transform(Float4 v, const Float4x4& a) {
+	return {
+		v.x * a.m[0][0] + v.y * a.m[1][0] + v.z * a.m[2][0] + v.w * a.m[3][0],
+		v.x * a.m[0][1] + v.y * a.m[1][1] + v.z * a.m[2][1] + v.w * a.m[3][1],
+		v.x * a.m[0][2] + v.y * a.m[1][2] + v.z * a.m[2][2] + v.w * a.m[3][2],
+		v.x * a.m[0][3] + v.y * a.m[1][3] + v.z * a.m[2][3] + v.w * a.m[3][3]
+	};
+}
@@ -0,0 +1,130 @@
+#include "D3D11RenderDevice.h"
+#include "Vertex.h"
+#include <cstring>
+
+D3D11RenderDevice::D3D11RenderDevice(ID3D11Device* device, ID3D11DeviceContext* context)
+	: _pDevice(device), _pContext(context)
+{
+	D3D11_BUFFER_DESC bd = {};
+	bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bd.Usage = D3D11_USAGE_DYNAMIC;
+	bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bd.MiscFlags = 0u;
+	bd.ByteWidth = sizeof(DrawConstantBuffer);
+	bd.StructureByteStride = 0u;
+
+	if (FAILED(_pDevice->CreateBuffer(&bd, nullptr, &_pDrawConstantBuffer)))
+		throw deviceException("Draw constant buffer fucked up");
+	_pContext->VSSetConstantBuffers(1u, 1u, _pDrawConstantBuffer.GetAddressOf());
+}
+
+void D3D11RenderDevice::SetVertexFormat(BufferKind kind, ID3D11InputLayout* layout, ID3D11VertexShader* shader) {
+	if (kind == BufferKind::Index || kind == BufferKind::Index32)
+		throw deviceException("Index buffers have no vertex format");
+
+	int format = kind == BufferKind::PackedVertex ? 1 : 0;
+	_layouts[format] = layout;
+	_vertexShaders[format] = shader;
+	// bound by the next draw that uses it
+	if (_boundVertexKind == kind)
+		_boundVertexBuffer = 0;
+}
+
+BufferHandle D3D11RenderDevice::CreateBuffer(BufferKind kind, size_t bytes, const void* data, bool dynamic) {
+	D3D11_BUFFER_DESC bd = {};
+	bd.BindFlags = kind == BufferKind::Index || kind == BufferKind::Index32 ? D3D11_BIND_INDEX_BUFFER : D3D11_BIND_VERTEX_BUFFER;
+	bd.Usage = dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_IMMUTABLE;
+	bd.CPUAccessFlags = dynamic ? D3D11_CPU_ACCESS_WRITE : 0u;
+	bd.MiscFlags = 0u;
+	bd.ByteWidth = (UINT)bytes;
+	bd.StructureByteStride = 0u;
+
+	D3D11_SUBRESOURCE_DATA sd = {};
+	sd.pSysMem = data;
+
+	ComPtr<ID3D11Buffer> pBuffer;
+	if (FAILED(_pDevice->CreateBuffer(&bd, data ? &sd : nullptr, &pBuffer)))
+		throw deviceException("Buffer creation fucked up");
+
+	_stats.bufferAllocations++;
+	_stats.bytesAllocated += bytes;
+
+	if (!_free.empty()) {
+		BufferHandle handle = _free.back();
+		_free.pop_back();
+		_buffers[handle - 1] = pBuffer;
+		_kinds[handle - 1] = kind;
+		return handle;
+	}
+	_buffers.push_back(pBuffer);
+	_kinds.push_back(kind);
+	return (BufferHandle)_buffers.size();
+}
+
+void D3D11RenderDevice::ReleaseBuffer(BufferHandle buffer) {
+	if (buffer == 0 || buffer > _buffers.size() || !_buffers[buffer - 1])
+		return;
+
+	_buffers[buffer - 1].Reset();
+	_free.push_back(buffer);
+	if (_boundVertexBuffer == buffer)
+		_boundVertexBuffer = 0;
+	if (_boundIndexBuffer == buffer)
+		_boundIndexBuffer = 0;
+}
+
+void D3D11RenderDevice::WriteBuffer(BufferHandle buffer, size_t offset, const void* data, size_t bytes, bool discard) {
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	if (FAILED(_pContext->Map(Get(buffer), 0, discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mappedResource)))
+		throw deviceException("Buffer map fucked up");
+
+	memcpy((unsigned char*)mappedResource.pData + offset, data, bytes);
+	_pContext->Unmap(Get(buffer), 0);
+
+	_stats.bufferWrites++;
+	_stats.bytesWritten += bytes;
+}
+
+void D3D11RenderDevice::DrawIndexed(BufferHandle vertexBuffer, BufferHandle indexBuffer, unsigned int indexCount, unsigned int firstIndex, int baseVertex, unsigned int objectBase, unsigned int instanceCount) {
+	if (vertexBuffer != _boundVertexBuffer) {
+		ID3D11Buffer* pVertexBuffer = Get(vertexBuffer);
+		BufferKind kind = _kinds[vertexBuffer - 1];
+		const UINT stride = kind == BufferKind::PackedVertex ? sizeof(PackedVertex) : sizeof(Vertex);
+		const UINT offset = 0u;
+		_pContext->IASetVertexBuffers(0u, 1u, &pVertexBuffer, &stride, &offset);
+
+		int format = kind == BufferKind::PackedVertex ? 1 : 0;
+		if ((kind != _boundVertexKind || _boundVertexBuffer == 0) && _layouts[format]) {
+			_pContext->IASetInputLayout(_layouts[format].Get());
+			_pContext->VSSetShader(_vertexShaders[format].Get(), nullptr, 0u);
+		}
+		_boundVertexBuffer = vertexBuffer;
+		_boundVertexKind = kind;
+	}
+
+	if (indexBuffer != _boundIndexBuffer) {
+		ID3D11Buffer* pIndexBuffer = Get(indexBuffer);
+		DXGI_FORMAT format = _kinds[indexBuffer - 1] == BufferKind::Index32 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+		_pContext->IASetIndexBuffer(pIndexBuffer, format, 0u);
+		_boundIndexBuffer = indexBuffer;
+	}
+
+	if (objectBase != _boundObjectBase) {
+		D3D11_MAPPED_SUBRESOURCE mappedResource;
+		_pContext->Map(_pDrawConstantBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+		DrawConstantBuffer constants = { objectBase, { 0, 0, 0 } };
+		memcpy(mappedResource.pData, &constants, sizeof(constants));
+		_pContext->Unmap(_pDrawConstantBuffer.Get(), 0);
+		_boundObjectBase = objectBase;
+	}
+
+	_pContext->DrawIndexedInstanced(indexCount, instanceCount, firstIndex, baseVertex, 0u);
+	_stats.draws++;
+	_stats.instances += instanceCount;
+}
+
+ID3D11Buffer* D3D11RenderDevice::Get(BufferHandle buffer) const {
+	if (buffer == 0 || buffer > _buffers.size() || !_buffers[buffer - 1])
+		throw deviceException("Invalid buffer handle");
+	return _buffers[buffer - 1].Get();
+}
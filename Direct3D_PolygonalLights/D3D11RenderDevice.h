@@ -0,0 +1,58 @@
+#pragma once
+
+#include "RenderDevice.h"
+#include <d3d11_1.h>
+#include <wrl.h>
+#include <exception>
+#include <vector>
+
+using Microsoft::WRL::ComPtr;
+using std::exception;
+using std::vector;
+
+// RenderDevice on top of the D3D11 immediate context. Owns the per-draw
+// constant buffer (vertex shader slot b1) that carries objectBase, and
+// switches input layout and vertex shader with the vertex buffer's kind.
+class D3D11RenderDevice : public RenderDevice {
+public:
+	D3D11RenderDevice(ID3D11Device* device, ID3D11DeviceContext* context);
+
+	// Pipeline state vertex buffers of this kind are drawn with
+	void SetVertexFormat(BufferKind kind, ID3D11InputLayout* layout, ID3D11VertexShader* shader);
+
+	BufferHandle CreateBuffer(BufferKind kind, size_t bytes, const void* data, bool dynamic) override;
+	void ReleaseBuffer(BufferHandle buffer) override;
+	void WriteBuffer(BufferHandle buffer, size_t offset, const void* data, size_t bytes, bool discard) override;
+	void DrawIndexed(BufferHandle vertexBuffer, BufferHandle indexBuffer, unsigned int indexCount, unsigned int firstIndex, int baseVertex, unsigned int objectBase, unsigned int instanceCount = 1) override;
+
+private:
+	struct DrawConstantBuffer {
+		unsigned int objectBase;
+		unsigned int padding[3];
+	};
+
+	ID3D11Device* _pDevice;
+	ID3D11DeviceContext* _pContext;
+	ComPtr<ID3D11Buffer> _pDrawConstantBuffer;
+	ComPtr<ID3D11InputLayout> _layouts[2];
+	ComPtr<ID3D11VertexShader> _vertexShaders[2];
+	vector<ComPtr<ID3D11Buffer>> _buffers;
+	vector<BufferKind> _kinds;
+	vector<BufferHandle> _free;
+
+	// last bound state, to skip redundant IA and constant buffer updates
+	BufferHandle _boundVertexBuffer = 0;
+	BufferKind _boundVertexKind = BufferKind::Vertex;
+	BufferHandle _boundIndexBuffer = 0;
+	unsigned int _boundObjectBase = ~0u;
+
+	ID3D11Buffer* Get(BufferHandle buffer) const;
+
+	class deviceException : public exception {
+	private:
+		const char* _message;
+	public:
+		deviceException(const char* message) : _message(message) {}
+		const char* what() const throw () { return _message; }
+	};
+};
@@ -0,0 +1,257 @@
+#include "DDSFile.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#define DDS_MAGIC 0x20534444 // "DDS "
+#define DDS_FOURCC_DX10 0x30315844 // "DX10"
+#define DDS_HEADER_SIZE 124
+#define DDS_DX10_HEADER_SIZE 20
+
+// header flags for the files this writes
+#define DDSD_CAPS_HEIGHT_WIDTH_PIXELFORMAT 0x1007
+#define DDSD_PITCH 0x8
+#define DDSD_LINEARSIZE 0x80000
+#define DDSD_MIPMAPCOUNT 0x20000
+#define DDPF_FOURCC 0x4
+#define DDSCAPS_TEXTURE 0x1000
+#define DDSCAPS_COMPLEX_MIPMAP 0x400008
+#define DDS_DIMENSION_TEXTURE2D 3
+
+// DXGI_FORMAT values, spelled out to avoid pulling in dxgiformat.h
+#define FORMAT_R32G32B32A32_FLOAT 2
+#define FORMAT_R32G32_FLOAT 16
+#define FORMAT_R32_FLOAT 41
+
+// legacy D3DFORMAT FourCCs
+#define D3DFMT_A32B32G32R32F 116
+#define D3DFMT_G32R32F 115
+#define D3DFMT_R32F 114
+#define D3DFMT_A16B16G16R16F 113
+#define D3DFMT_G16R16F 112
+#define D3DFMT_R16F 111
+#define D3DFMT_A16B16G16R16 36
+
+#define FOURCC(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+static uint32_t ReadU32(const uint8_t* data, size_t offset) {
+	uint32_t v;
+	memcpy(&v, data + offset, sizeof(v));
+	return v;
+}
+
+static void WriteU32(vector<char>& data, size_t offset, uint32_t v) {
+	memcpy(data.data() + offset, &v, sizeof(v));
+}
+
+bool ParseDDS(const uint8_t* data, size_t size, DDSInfo& info) {
+	if (!data || size < 4 + DDS_HEADER_SIZE)
+		return false;
+	if (ReadU32(data, 0) != DDS_MAGIC || ReadU32(data, 4) != DDS_HEADER_SIZE)
+		return false;
+
+	info.height = ReadU32(data, 12);
+	info.width = ReadU32(data, 16);
+	info.depth = std::max(ReadU32(data, 24), 1u);
+	info.mipCount = std::max(ReadU32(data, 28), 1u);
+	info.arraySize = 1;
+	info.pixelFlags = ReadU32(data, 80);
+	info.fourCC = ReadU32(data, 84);
+	info.rgbBitCount = ReadU32(data, 88);
+	info.dxgiFormat = 0;
+
+	size_t offset = 4 + DDS_HEADER_SIZE;
+	if (info.fourCC == DDS_FOURCC_DX10) {
+		if (size < offset + DDS_DX10_HEADER_SIZE)
+			return false;
+
+		info.dxgiFormat = ReadU32(data, offset);
+		info.arraySize = std::max(ReadU32(data, offset + 12), 1u);
+		offset += DDS_DX10_HEADER_SIZE;
+	}
+
+	info.bits = data + offset;
+	info.bitSize = size - offset;
+	return true;
+}
+
+// Bytes per 4x4 block of the block compressed formats, 0 for the others.
+static size_t BlockBytes(const DDSInfo& info) {
+	if (info.fourCC == DDS_FOURCC_DX10) {
+		uint32_t f = info.dxgiFormat;
+		if ((f >= 70 && f <= 72) || (f >= 79 && f <= 81))
+			return 8; // BC1, BC4
+		if ((f >= 73 && f <= 78) || (f >= 82 && f <= 84) || (f >= 94 && f <= 99))
+			return 16; // BC2, BC3, BC5, BC6H, BC7
+		return 0;
+	}
+
+	switch (info.fourCC) {
+	case FOURCC('D', 'X', 'T', '1'): case FOURCC('A', 'T', 'I', '1'): case FOURCC('B', 'C', '4', 'U'): case FOURCC('B', 'C', '4', 'S'):
+		return 8;
+	case FOURCC('D', 'X', 'T', '2'): case FOURCC('D', 'X', 'T', '3'): case FOURCC('D', 'X', 'T', '4'): case FOURCC('D', 'X', 'T', '5'):
+	case FOURCC('A', 'T', 'I', '2'): case FOURCC('B', 'C', '5', 'U'): case FOURCC('B', 'C', '5', 'S'):
+		return 16;
+	}
+	return 0;
+}
+
+// Bits per pixel of the plain formats, 0 when unknown.
+static size_t PixelBits(const DDSInfo& info) {
+	if (info.fourCC == DDS_FOURCC_DX10) {
+		uint32_t f = info.dxgiFormat;
+		if (f >= 1 && f <= 4) return 128;  // R32G32B32A32
+		if (f >= 5 && f <= 8) return 96;   // R32G32B32
+		if (f >= 9 && f <= 22) return 64;  // R16G16B16A16, R32G32, R32G8X24
+		if (f >= 23 && f <= 47) return 32; // R10G10B10A2 .. R24G8
+		if (f >= 48 && f <= 59) return 16; // R8G8, R16
+		if (f >= 60 && f <= 65) return 8;  // R8, A8
+		if (f == 85 || f == 86) return 16; // B5G6R5, B5G5R5A1
+		if (f >= 87 && f <= 93) return 32; // B8G8R8A8, B8G8R8X8
+		return 0;
+	}
+
+	if (!(info.pixelFlags & DDPF_FOURCC))
+		return info.rgbBitCount;
+
+	switch (info.fourCC) {
+	case D3DFMT_A32B32G32R32F: return 128;
+	case D3DFMT_G32R32F: case D3DFMT_A16B16G16R16F: case D3DFMT_A16B16G16R16: return 64;
+	case D3DFMT_R32F: case D3DFMT_G16R16F: return 32;
+	case D3DFMT_R16F: return 16;
+	}
+	return 0;
+}
+
+bool GetDDSMipLayout(const DDSInfo& info, vector<DDSMip>& mips) {
+	size_t blockBytes = BlockBytes(info);
+	size_t pixelBits = blockBytes ? 0 : PixelBits(info);
+	if (!blockBytes && !pixelBits)
+		return false;
+
+	mips.resize(info.mipCount);
+	size_t offset = 0;
+	uint32_t w = info.width, h = info.height, d = info.depth;
+	for (DDSMip& mip : mips) {
+		mip.width = w;
+		mip.height = h;
+		mip.depth = d;
+		mip.offset = offset;
+		if (blockBytes) {
+			mip.rowPitch = std::max<size_t>(1, (w + 3) / 4) * blockBytes;
+			mip.slicePitch = mip.rowPitch * std::max<size_t>(1, (h + 3) / 4);
+		}
+		else {
+			mip.rowPitch = (w * pixelBits + 7) / 8;
+			mip.slicePitch = mip.rowPitch * h;
+		}
+		mip.bytes = mip.slicePitch * d;
+		offset += mip.bytes;
+
+		w = std::max(w >> 1, 1u);
+		h = std::max(h >> 1, 1u);
+		d = std::max(d >> 1, 1u);
+	}
+
+	return offset * info.arraySize <= info.bitSize;
+}
+
+bool ReadFloatDDS(const char* path, int& width, int& height, vector<Float4>& texels) {
+	MappedFile file;
+	DDSInfo info;
+	if (!file.Open(path) || !ParseDDS(file.GetData(), file.GetSize(), info))
+		return false;
+
+	int channels = 0;
+	if (info.fourCC == DDS_FOURCC_DX10) {
+		switch (info.dxgiFormat) {
+		case FORMAT_R32G32B32A32_FLOAT: channels = 4; break;
+		case FORMAT_R32G32_FLOAT: channels = 2; break;
+		case FORMAT_R32_FLOAT: channels = 1; break;
+		}
+	}
+	else {
+		switch (info.fourCC) {
+		case D3DFMT_A32B32G32R32F: channels = 4; break;
+		case D3DFMT_G32R32F: channels = 2; break;
+		case D3DFMT_R32F: channels = 1; break;
+		}
+	}
+
+	width = (int)info.width;
+	height = (int)info.height;
+	if (channels == 0 || width <= 0 || height <= 0)
+		return false;
+
+	size_t texelCount = (size_t)width * height;
+	if (info.bitSize < texelCount * channels * sizeof(float))
+		return false;
+
+	texels.resize(texelCount);
+	for (size_t i = 0; i < texelCount; i++) {
+		float c[4] = { 0, 0, 0, 1 };
+		memcpy(c, info.bits + i * channels * sizeof(float), channels * sizeof(float));
+		texels[i] = { c[0], c[1], c[2], c[3] };
+	}
+
+	return true;
+}
+
+bool GetDDSMipLayout(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t dxgiFormat, vector<DDSMip>& mips) {
+	DDSInfo info = { width, height, 1, std::max(mipCount, 1u), 1, DDPF_FOURCC, DDS_FOURCC_DX10, 0, dxgiFormat, nullptr, ~(size_t)0 };
+	return width && height && GetDDSMipLayout(info, mips);
+}
+
+bool WriteDDS(const char* path, uint32_t width, uint32_t height, uint32_t mipCount, uint32_t dxgiFormat, const void* bits, size_t bytes) {
+	vector<DDSMip> mips;
+	if (!GetDDSMipLayout(width, height, mipCount, dxgiFormat, mips) || mips.back().offset + mips.back().bytes != bytes)
+		return false;
+
+	DDSInfo info = { width, height, 1, (uint32_t)mips.size(), 1, DDPF_FOURCC, DDS_FOURCC_DX10, 0, dxgiFormat, nullptr, bytes };
+	bool compressed = BlockBytes(info) != 0;
+	size_t offset = 4 + DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE;
+	vector<char> data(offset);
+	WriteU32(data, 0, DDS_MAGIC);
+	WriteU32(data, 4, DDS_HEADER_SIZE);
+	WriteU32(data, 8, DDSD_CAPS_HEIGHT_WIDTH_PIXELFORMAT | (compressed ? DDSD_LINEARSIZE : DDSD_PITCH) | (info.mipCount > 1 ? DDSD_MIPMAPCOUNT : 0));
+	WriteU32(data, 12, height);
+	WriteU32(data, 16, width);
+	WriteU32(data, 20, (uint32_t)(compressed ? mips[0].bytes : mips[0].rowPitch));
+	WriteU32(data, 24, 1); // depth
+	WriteU32(data, 28, info.mipCount);
+	WriteU32(data, 76, 32); // pixel format size
+	WriteU32(data, 80, DDPF_FOURCC);
+	WriteU32(data, 84, DDS_FOURCC_DX10);
+	WriteU32(data, 108, DDSCAPS_TEXTURE | (info.mipCount > 1 ? DDSCAPS_COMPLEX_MIPMAP : 0));
+
+	size_t dx10 = 4 + DDS_HEADER_SIZE;
+	WriteU32(data, dx10, dxgiFormat);
+	WriteU32(data, dx10 + 4, DDS_DIMENSION_TEXTURE2D);
+	WriteU32(data, dx10 + 12, 1); // array size
+
+	std::ofstream file(path, std::ios::binary);
+	return file && file.write(data.data(), data.size()) && file.write((const char*)bits, bytes) ? true : false;
+}
+
+bool WriteFloatDDS(const char* path, int width, int height, int channels, const vector<Float4>& texels) {
+	uint32_t format;
+	switch (channels) {
+	case 4: format = FORMAT_R32G32B32A32_FLOAT; break;
+	case 2: format = FORMAT_R32G32_FLOAT; break;
+	case 1: format = FORMAT_R32_FLOAT; break;
+	default: return false;
+	}
+
+	size_t texelCount = (size_t)width * height;
+	if (width <= 0 || height <= 0 || texels.size() != texelCount)
+		return false;
+
+	vector<float> bits(texelCount * channels);
+	for (size_t i = 0; i < texelCount; i++) {
+		const float c[4] = { texels[i].x, texels[i].y, texels[i].z, texels[i].w };
+		memcpy(&bits[i * channels], c, channels * sizeof(float));
+	}
+
+	return WriteDDS(path, (uint32_t)width, (uint32_t)height, 1, format, bits.data(), bits.size() * sizeof(float));
+}
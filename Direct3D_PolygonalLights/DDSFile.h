@@ -0,0 +1,58 @@
+#pragma once
+
+#include "CpuMath.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+// Header fields of a DDS file parsed in place; bits points into the
+// caller's buffer (usually a MappedFile), nothing is copied.
+struct DDSInfo {
+	uint32_t width;
+	uint32_t height;
+	uint32_t depth;
+	uint32_t mipCount;
+	uint32_t arraySize;
+	uint32_t pixelFlags;
+	uint32_t fourCC;
+	uint32_t rgbBitCount;
+	uint32_t dxgiFormat; // 0 without a DX10 header
+	const uint8_t* bits;
+	size_t bitSize;
+};
+
+// One level of the mip chain of the first array slice, offset from bits.
+struct DDSMip {
+	uint32_t width;
+	uint32_t height;
+	uint32_t depth;
+	size_t offset;
+	size_t rowPitch;
+	size_t slicePitch;
+	size_t bytes; // slicePitch * depth
+};
+
+bool ParseDDS(const uint8_t* data, size_t size, DDSInfo& info);
+
+// Mip chain layout for the block compressed (BC1-BC7, DXTn) and plain
+// formats, the same walk FillInitData does. False for formats it does not
+// know and for files too short for their chain.
+bool GetDDSMipLayout(const DDSInfo& info, vector<DDSMip>& mips);
+
+// Layout of a 2D texture WriteDDS would write.
+bool GetDDSMipLayout(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t dxgiFormat, vector<DDSMip>& mips);
+
+// Minimal, platform independent access to uncompressed float DDS files
+// (R32G32B32A32, R32G32 and R32 via the DX10 header or legacy FourCC).
+// Missing channels are expanded the same way the sampler does: (0, 0, 0, 1).
+// Only the top mip of the first array slice is read.
+bool ReadFloatDDS(const char* path, int& width, int& height, vector<Float4>& texels);
+
+// Writes a 2D texture with a DX10 header; bits holds the whole mip chain.
+bool WriteDDS(const char* path, uint32_t width, uint32_t height, uint32_t mipCount, uint32_t dxgiFormat, const void* bits, size_t bytes);
+
+// Writes the first channels (1, 2 or 4) of every texel as a single-mip
+// R32[G32[B32A32]]_FLOAT texture with a DX10 header.
+bool WriteFloatDDS(const char* path, int width, int height, int channels, const vector<Float4>& texels);
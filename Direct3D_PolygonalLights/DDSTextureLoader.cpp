@@ -23,6 +23,7 @@
 #include <memory>
 
 #include "DDSTextureLoader.h"
+#include "MappedFile.h"
 
 #if !defined(NO_D3D11_DEBUG_NAME) && ( defined(_DEBUG) || defined(PROFILE) )
 #pragma comment(lib,"dxguid.lib")
@@ -121,12 +122,6 @@ struct DDS_HEADER_DXT10
 namespace
 {
 
-    struct handle_closer { void operator()(HANDLE h) { if (h) CloseHandle(h); } };
-
-    typedef std::unique_ptr<void, handle_closer> ScopedHandle;
-
-    inline HANDLE safe_handle(HANDLE h) { return (h == INVALID_HANDLE_VALUE) ? 0 : h; }
-
     template<UINT TNameLength>
     inline void SetDebugObjectName(_In_ ID3D11DeviceChild* resource, _In_ const char(&name)[TNameLength])
     {
@@ -140,11 +135,14 @@ namespace
 
 };
 
+//--------------------------------------------------------------------------------------
+// Maps the file and parses the header in place: header and bitData point
+// into the mapped pages, which stay valid for as long as ddsFile is open.
 //--------------------------------------------------------------------------------------
 static HRESULT LoadTextureDataFromFile(_In_z_ const wchar_t* fileName,
-    std::unique_ptr<uint8_t[]>& ddsData,
-    DDS_HEADER** header,
-    uint8_t** bitData,
+    MappedFile& ddsFile,
+    const DDS_HEADER** header,
+    const uint8_t** bitData,
     size_t* bitSize
 )
 {
@@ -153,86 +151,29 @@ static HRESULT LoadTextureDataFromFile(_In_z_ const wchar_t* fileName,
         return E_POINTER;
     }
 
-    // open the file
-#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
-    ScopedHandle hFile(safe_handle(CreateFile2(fileName,
-        GENERIC_READ,
-        FILE_SHARE_READ,
-        OPEN_EXISTING,
-        nullptr)));
-#else
-    ScopedHandle hFile(safe_handle(CreateFileW(fileName,
-        GENERIC_READ,
-        FILE_SHARE_READ,
-        nullptr,
-        OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL,
-        nullptr)));
-#endif
-
-    if (!hFile)
-    {
-        return HRESULT_FROM_WIN32(GetLastError());
-    }
-
-    // Get the file size
-    LARGE_INTEGER FileSize = { 0 };
-
-#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
-    FILE_STANDARD_INFO fileInfo;
-    if (!GetFileInformationByHandleEx(hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo)))
+    if (!ddsFile.Open(fileName))
     {
-        return HRESULT_FROM_WIN32(GetLastError());
+        DWORD error = GetLastError();
+        return error ? HRESULT_FROM_WIN32(error) : E_FAIL;
     }
-    FileSize = fileInfo.EndOfFile;
-#else
-    GetFileSizeEx(hFile.get(), &FileSize);
-#endif
 
-    // File is too big for 32-bit allocation, so reject read
-    if (FileSize.HighPart > 0)
-    {
-        return E_FAIL;
-    }
+    const uint8_t* ddsData = ddsFile.GetData();
+    size_t fileSize = ddsFile.GetSize();
 
     // Need at least enough data to fill the header and magic number to be a valid DDS
-    if (FileSize.LowPart < (sizeof(DDS_HEADER) + sizeof(uint32_t)))
-    {
-        return E_FAIL;
-    }
-
-    // create enough space for the file data
-    ddsData.reset(new (std::nothrow) uint8_t[FileSize.LowPart]);
-    if (!ddsData)
-    {
-        return E_OUTOFMEMORY;
-    }
-
-    // read the data in
-    DWORD BytesRead = 0;
-    if (!ReadFile(hFile.get(),
-        ddsData.get(),
-        FileSize.LowPart,
-        &BytesRead,
-        nullptr
-    ))
-    {
-        return HRESULT_FROM_WIN32(GetLastError());
-    }
-
-    if (BytesRead < FileSize.LowPart)
+    if (fileSize < (sizeof(DDS_HEADER) + sizeof(uint32_t)))
     {
         return E_FAIL;
     }
 
     // DDS files always start with the same magic number ("DDS ")
-    uint32_t dwMagicNumber = *(const uint32_t*)(ddsData.get());
+    uint32_t dwMagicNumber = *(const uint32_t*)(ddsData);
     if (dwMagicNumber != DDS_MAGIC)
     {
         return E_FAIL;
     }
 
-    auto hdr = reinterpret_cast<DDS_HEADER*>(ddsData.get() + sizeof(uint32_t));
+    auto hdr = reinterpret_cast<const DDS_HEADER*>(ddsData + sizeof(uint32_t));
 
     // Verify header to validate DDS file
     if (hdr->size != sizeof(DDS_HEADER) ||
@@ -247,7 +188,7 @@ static HRESULT LoadTextureDataFromFile(_In_z_ const wchar_t* fileName,
         (MAKEFOURCC('D', 'X', '1', '0') == hdr->ddspf.fourCC))
     {
         // Must be long enough for both headers and magic value
-        if (FileSize.LowPart < (sizeof(DDS_HEADER) + sizeof(uint32_t) + sizeof(DDS_HEADER_DXT10)))
+        if (fileSize < (sizeof(DDS_HEADER) + sizeof(uint32_t) + sizeof(DDS_HEADER_DXT10)))
         {
             return E_FAIL;
         }
@@ -259,8 +200,8 @@ static HRESULT LoadTextureDataFromFile(_In_z_ const wchar_t* fileName,
     *header = hdr;
     ptrdiff_t offset = sizeof(uint32_t) + sizeof(DDS_HEADER)
         + (bDXT10Header ? sizeof(DDS_HEADER_DXT10) : 0);
-    *bitData = ddsData.get() + offset;
-    *bitSize = FileSize.LowPart - offset;
+    *bitData = ddsData + offset;
+    *bitSize = fileSize - offset;
 
     return S_OK;
 }
@@ -1753,13 +1694,15 @@ HRESULT DirectX::CreateDDSTextureFromFileEx(ID3D11Device* d3dDevice,
         return E_INVALIDARG;
     }
 
-    DDS_HEADER* header = nullptr;
-    uint8_t* bitData = nullptr;
+    const DDS_HEADER* header = nullptr;
+    const uint8_t* bitData = nullptr;
     size_t bitSize = 0;
 
-    std::unique_ptr<uint8_t[]> ddsData;
+    // the subresources FillInitData builds point into the mapping, so it
+    // stays open until the texture is created
+    MappedFile ddsFile;
     HRESULT hr = LoadTextureDataFromFile(fileName,
-        ddsData,
+        ddsFile,
         &header,
         &bitData,
         &bitSize
@@ -1825,4 +1768,73 @@ HRESULT DirectX::CreateDDSTextureFromFileEx(ID3D11Device* d3dDevice,
     }
 
     return hr;
-}
\ No newline at end of file
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+size_t DirectX::GetTextureMemorySize(ID3D11Resource* texture)
+{
+    if (!texture)
+        return 0;
+
+    D3D11_RESOURCE_DIMENSION resDim = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+    texture->GetType(&resDim);
+
+    size_t width = 0, height = 1, depth = 1, mipLevels = 1, arraySize = 1;
+    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+    switch (resDim)
+    {
+    case D3D11_RESOURCE_DIMENSION_TEXTURE1D:
+        {
+            D3D11_TEXTURE1D_DESC desc;
+            static_cast<ID3D11Texture1D*>(texture)->GetDesc(&desc);
+            width = desc.Width;
+            mipLevels = desc.MipLevels;
+            arraySize = desc.ArraySize;
+            format = desc.Format;
+        }
+        break;
+
+    case D3D11_RESOURCE_DIMENSION_TEXTURE2D:
+        {
+            D3D11_TEXTURE2D_DESC desc;
+            static_cast<ID3D11Texture2D*>(texture)->GetDesc(&desc);
+            width = desc.Width;
+            height = desc.Height;
+            mipLevels = desc.MipLevels;
+            arraySize = desc.ArraySize;
+            format = desc.Format;
+        }
+        break;
+
+    case D3D11_RESOURCE_DIMENSION_TEXTURE3D:
+        {
+            D3D11_TEXTURE3D_DESC desc;
+            static_cast<ID3D11Texture3D*>(texture)->GetDesc(&desc);
+            width = desc.Width;
+            height = desc.Height;
+            depth = desc.Depth;
+            mipLevels = desc.MipLevels;
+            format = desc.Format;
+        }
+        break;
+
+    default:
+        return 0;
+    }
+
+    size_t total = 0;
+    for (size_t level = 0; level < mipLevels; level++)
+    {
+        size_t numBytes = 0;
+        GetSurfaceInfo(width, height, format, &numBytes, nullptr, nullptr);
+        total += numBytes * depth;
+
+        width = std::max<size_t>(width / 2, 1);
+        height = std::max<size_t>(height / 2, 1);
+        depth = std::max<size_t>(depth / 2, 1);
+    }
+
+    return total * arraySize;
+}
@@ -157,4 +157,8 @@ namespace DirectX
         _Outptr_opt_ ID3D11ShaderResourceView** textureView,
         _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
     );
+
+    // Bytes of every subresource of a texture, summed with the same
+    // GetSurfaceInfo the loaders use to lay out the initial data
+    size_t GetTextureMemorySize(_In_ ID3D11Resource* texture);
 }
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "FrameGraph.h"
+#include "Profiler.h"
+
+FrameGraph::Node FrameGraph::Add(const char* name, std::function<void()> body, std::initializer_list<Node> dependencies) {
+	Node node = (Node)_entries.size();
+	_entries.emplace_back();
+	Entry& entry = _entries.back();
+	entry.name = name;
+	entry.body = std::move(body);
+	for (Node dependency : dependencies) {
+		_entries[dependency].dependents.push_back(node);
+		entry.dependencies++;
+	}
+	_timings.push_back({ name, 0.0, 0.0, -1 });
+	return node;
+}
+
+void FrameGraph::Clear() {
+	_entries.clear();
+	_timings.clear();
+}
+
+void FrameGraph::Run(ThreadPool& pool) {
+	_pool = &pool;
+	_start = Clock::now();
+
+	// jobs submitted from inside a job count up before their parent counts
+	// down, so done only reaches zero after the last one
+	JobCounter done;
+	for (size_t i = 0; i < _entries.size(); i++) {
+		Entry& entry = _entries[i];
+		entry.remaining = entry.dependencies;
+		entry.job = { &FrameGraph::RunEntry, this, i, &done };
+	}
+	for (Entry& entry : _entries)
+		if (entry.dependencies == 0)
+			pool.Submit(entry.job);
+	pool.Wait(done);
+
+	_runTime = std::chrono::duration<double, std::milli>(Clock::now() - _start).count();
+}
+
+void FrameGraph::RunEntry(const Job& job) {
+	FrameGraph& graph = *(FrameGraph*)job.context;
+	Entry& entry = graph._entries[job.index];
+
+	Clock::time_point start = Clock::now();
+	{
+		PROFILE_ZONE(entry.name);
+		entry.body();
+	}
+	Clock::time_point end = Clock::now();
+	graph._timings[job.index] = {
+		entry.name,
+		std::chrono::duration<double, std::milli>(start - graph._start).count(),
+		std::chrono::duration<double, std::milli>(end - start).count(),
+		graph._pool->GetWorkerIndex()
+	};
+
+	for (Node dependent : entry.dependents) {
+		Entry& next = graph._entries[dependent];
+		if (next.remaining.fetch_sub(1) == 1)
+			graph._pool->Submit(next.job);
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "ThreadPool.h"
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+using std::vector;
+
+// A job's last run, in ms from the start of FrameGraph::Run
+struct JobTiming {
+	const char* name;
+	double start;
+	double duration;
+	int worker; // ThreadPool::GetWorkerIndex of the thread that ran it
+};
+
+// The CPU jobs of a frame and what each waits for, built once and run every
+// frame. Run submits the jobs without dependencies; a job that finishes
+// counts down the jobs after it and submits those that reach zero, so
+// independent jobs run side by side. Jobs may ParallelFor on the same pool.
+class FrameGraph {
+public:
+	typedef int Node;
+
+	// Dependencies are nodes added before.
+	Node Add(const char* name, std::function<void()> body, std::initializer_list<Node> dependencies = {});
+	void Clear();
+	// Returns when every job has run.
+	void Run(ThreadPool& pool);
+
+	size_t GetJobCount() const { return _entries.size(); }
+	// in the order the jobs were added
+	const vector<JobTiming>& GetTimings() const { return _timings; }
+	// ms of the last Run, all jobs
+	double GetRunTime() const { return _runTime; }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Entry {
+		const char* name;
+		std::function<void()> body;
+		vector<Node> dependents;
+		int dependencies = 0;
+		std::atomic<int> remaining{ 0 };
+		Job job;
+	};
+
+	std::deque<Entry> _entries; // stay in place, the jobs point at them
+	vector<JobTiming> _timings;
+	ThreadPool* _pool = nullptr;
+	Clock::time_point _start;
+	double _runTime = 0.0;
+
+	static void RunEntry(const Job& job);
+};
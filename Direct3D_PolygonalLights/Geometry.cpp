@@ -0,0 +1,134 @@
+#include "Geometry.h"
+
+void AppendTriangle(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer) {
+
+	unsigned int offset = (unsigned int)vBuffer.size();
+
+	vBuffer.push_back({ 0.0f,0.5f, 0.0f , 1.0f, 0.0f, 0.0f });
+	vBuffer.push_back({ 0.5f,-0.5f, 0.0f ,0.0f, 1.0f, 0.0f });
+	vBuffer.push_back({ -0.5f,-0.5f, 0.0f ,0.0f, 0.0f, 1.0f });
+
+	iBuffer.push_back(offset + 0u);
+	iBuffer.push_back(offset + 1u);
+	iBuffer.push_back(offset + 2u);
+}
+
+void AppendCubeShared(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer) {
+	unsigned int offset = (unsigned int)vBuffer.size();
+
+	vBuffer.push_back({ -1.0f, -1.0f, -1.0f, 1.0f, 0.0f, 0.0f });
+	vBuffer.push_back({ 1.0f,-1.0f, -1.0f,	0.0f, 1.0f, 0.0f });
+	vBuffer.push_back({ -1.0f,1.0f, -1.0f,  0.0f, 0.0f, 1.0f });
+	vBuffer.push_back({ 1.0f,1.0f, -1.0f,	1.0f, 1.0f, 0.0f });
+	vBuffer.push_back({ -1.0f,-1.0f, 1.0f,	1.0f, 0.0f, 1.0f });
+	vBuffer.push_back({ 1.0f,-1.0f, 1.0f,  0.0f, 1.0f, 1.0f });
+	vBuffer.push_back({ -1.0f,1.0f, 1.0f,	0.0f, 0.0f, 0.0f });
+	vBuffer.push_back({ 1.0f,1.0f, 1.0f,	1.0f, 1.0f, 1.0f });
+
+	const unsigned short indices[] = {
+		0,2,1, 2,3,1,
+		1,3,5, 3,7,5,
+		2,6,3, 3,6,7,
+		4,5,7, 4,7,6,
+		0,4,2, 2,4,6,
+		0,1,4, 1,5,4
+	};
+
+	for (unsigned short index : indices)
+		iBuffer.push_back(offset + index);
+}
+
+void AppendCube(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, unsigned int objectIndex) {
+	unsigned int offset = (unsigned int)vBuffer.size();
+
+	// BACK - green
+	vBuffer.push_back({ -1.0f,-1.0f, 1.0f,	0.0f, 1.0f, 0.0f, 0,0, 0.0f, 0.0f, 1.0f, objectIndex });
+	vBuffer.push_back({ 1.0f,-1.0f, 1.0f,  0.0f, 1.0f, 0.0f,  0,0, 0.0f, 0.0f, 1.0f, objectIndex });
+	vBuffer.push_back({ -1.0f,1.0f, 1.0f,	0.0f, 1.0f, 0.0f, 0,0, 0.0f, 0.0f, 1.0f , objectIndex });
+	vBuffer.push_back({ 1.0f,1.0f, 1.0f,	0.0f, 1.0f, 0.0f, 0,0, 0.0f, 0.0f, 1.0f , objectIndex });
+
+	// LEFT - magenta
+	vBuffer.push_back({ -1.0f, -1.0f, -1.0f, 1.0f, 0.0f, 1.0f, 0,0,   -1.0f, 0.0f, 0.0f , objectIndex });
+	vBuffer.push_back({ -1.0f,1.0f, -1.0f,  1.0f, 0.0f, 1.0f,  0,0,  -1.0f, 0.0f, 0.0f , objectIndex });
+	vBuffer.push_back({ -1.0f,-1.0f, 1.0f,	1.0f, 0.0f, 1.0f,  0,0,  -1.0f, 0.0f, 0.0f , objectIndex });
+	vBuffer.push_back({ -1.0f,1.0f, 1.0f,	1.0f, 0.0f, 1.0f,  0,0,  -1.0f, 0.0f, 0.0f , objectIndex });
+
+	// RIGHT - cyan
+	vBuffer.push_back({ 1.0f,-1.0f, -1.0f,	0.0f, 1.0f, 1.0f, 0,0,  1.0f, 0.0f, 0.0f , objectIndex });
+	vBuffer.push_back({ 1.0f,1.0f, -1.0f,	0.0f, 1.0f, 1.0f, 0,0,  1.0f, 0.0f, 0.0f , objectIndex });
+	vBuffer.push_back({ 1.0f,-1.0f, 1.0f,  0.0f, 1.0f, 1.0f,  0,0, 1.0f, 0.0f, 0.0f , objectIndex });
+	vBuffer.push_back({ 1.0f,1.0f, 1.0f,	0.0f, 1.0f, 1.0f, 0,0,  1.0f, 0.0f, 0.0f , objectIndex });
+
+	// TOP - blue
+	vBuffer.push_back({ -1.0f,1.0f, -1.0f,  0.0f, 0.0f, 1.0f, 0,0,  0.0f, 1.0f, 0.0f , objectIndex });
+	vBuffer.push_back({ 1.0f,1.0f, -1.0f,	0.0f, 0.0f, 1.0f, 0,0,  0.0f, 1.0f, 0.0f , objectIndex });
+	vBuffer.push_back({ -1.0f,1.0f, 1.0f,	0.0f, 0.0f, 1.0f, 0,0,  0.0f, 1.0f, 0.0f , objectIndex });
+	vBuffer.push_back({ 1.0f,1.0f, 1.0f,	0.0f, 0.0f, 1.0f, 0,0,  0.0f, 1.0f, 0.0f , objectIndex });
+
+	// BOTTOM - yellow
+	vBuffer.push_back({ -1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 0.0f,0,0,   0.0f, -1.0f, 0.0f , objectIndex });
+	vBuffer.push_back({ 1.0f,-1.0f, -1.0f,	1.0f, 1.0f, 0.0f, 0,0,  0.0f, -1.0f, 0.0f , objectIndex });
+	vBuffer.push_back({ -1.0f,-1.0f, 1.0f,	1.0f, 1.0f, 0.0f, 0,0,  0.0f, -1.0f, 0.0f , objectIndex });
+	vBuffer.push_back({ 1.0f,-1.0f, 1.0f,  1.0f, 1.0f, 0.0f,  0,0, 0.0f, -1.0f, 0.0f , objectIndex });
+
+	// FRONT - red
+	vBuffer.push_back({ -1.0f, -1.0f, -1.0f, 1.0f, 0.0f, 0.0f,0,0,  0.0f, 0.0f, -1.0f , objectIndex });
+	vBuffer.push_back({ 1.0f,-1.0f, -1.0f,	1.0f, 0.0f, 0.0f, 0,0, 0.0f, 0.0f, -1.0f , objectIndex });
+	vBuffer.push_back({ -1.0f,1.0f, -1.0f,  1.0f, 0.0f, 0.0f, 0,0, 0.0f, 0.0f, -1.0f , objectIndex });
+	vBuffer.push_back({ 1.0f,1.0f, -1.0f,	1.0f, 0.0f, 0.0f, 0,0, 0.0f, 0.0f, -1.0f , objectIndex });
+
+
+	const unsigned short indices[] = {
+		0,1,2,    2,1,3,
+		4,6,5,	  6,7,5,
+		8,9,10,   10,9,11,
+		12,14,13, 14,15,13,
+		16,17,18, 18,17,19,
+		20,22,21, 22,23,21
+	};
+
+	for (unsigned short index : indices)
+		iBuffer.push_back(offset + index);
+}
+
+void AppendFloor(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, unsigned int objectIndex) {
+	unsigned int offset = (unsigned int)vBuffer.size();
+
+	vBuffer.push_back({ -100.0f, -1.0f, -100.0f,	0.5f, 0.5f, 0.5f, 0,0, 0.0f, 1.0f, 0.0f, objectIndex });
+	vBuffer.push_back({ 100.0f,  -1.0f, -100.0f,	0.5f, 0.5f, 0.5f, 0,0, 0.0f, 1.0f, 0.0f, objectIndex });
+	vBuffer.push_back({ 100.0f,  -1.0f, 100.0f,		0.5f, 0.5f, 0.5f, 0,0, 0.0f, 1.0f, 0.0f, objectIndex });
+	vBuffer.push_back({ -100.0f, -1.0f, 100.0f,		0.5f, 0.5f, 0.5f, 0,0, 0.0f, 1.0f, 0.0f, objectIndex });
+
+
+	const unsigned short indices[] = {
+		0,2,1,    0,3,2,
+	};
+
+	for (unsigned short index : indices)
+		iBuffer.push_back(offset + index);
+}
+
+void AppendQuadLight(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, const RectLight& light, unsigned int objectIndex) {
+	unsigned int offset = (unsigned int)vBuffer.size();
+
+	vBuffer.push_back({ -1.0f, -1.0f, .0f,	light.Color.x, light.Color.y, light.Color.z, 0,0, .0f, .0f, -1.0f, objectIndex });
+	vBuffer.push_back({ 1.0f, -1.0f, .0f,	light.Color.x, light.Color.y, light.Color.z, 1,0, .0f, .0f, -1.0f, objectIndex });
+	vBuffer.push_back({ 1.0f,  1.0f, .0f,	light.Color.x, light.Color.y, light.Color.z, 1,1, .0f, .0f, -1.0f, objectIndex });
+	vBuffer.push_back({ -1.0f,  1.0f, .0f,	light.Color.x, light.Color.y, light.Color.z, 0,1, .0f, .0f, -1.0f, objectIndex });
+
+	const unsigned short indices[] = {
+		0,2,1,    0,3,2,
+		0,1,2,    0,2,3
+	};
+
+	for (unsigned short index : indices)
+		iBuffer.push_back(offset + index);
+}
+
+Float4x4 QuadLightTransform(const RectLight& light) {
+	return
+		Float4x4::Scaling(light.Params.x, light.Params.y, 0)
+		* Float4x4::RotationY(light.Params.z * 2 * 3.14f)
+		* Float4x4::RotationZ(light.Params.w * 2 * 3.14f)
+		* Float4x4::Translation(light.Position.x, light.Position.y, light.Position.z);
+}
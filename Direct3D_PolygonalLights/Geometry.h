@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Lights.h"
+#include "Vertex.h"
+#include <vector>
+
+using std::vector;
+
+// Object-space geometry of the built-in shapes, shared by every renderer.
+// Vertices are tagged with objectIndex; the caller supplies the transform.
+
+void AppendTriangle(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer);
+void AppendCubeShared(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer);
+void AppendCube(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, unsigned int objectIndex);
+void AppendFloor(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, unsigned int objectIndex);
+void AppendQuadLight(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, const RectLight& light, unsigned int objectIndex);
+
+// Model-to-world transform of the proxy quad drawn for a rect light
+Float4x4 QuadLightTransform(const RectLight& light);
@@ -1,4 +1,20 @@
 #include "Graphics.h"
+#include "DDSFile.h"
+#include "MappedFile.h"
+
+static Float4x4 ToFloat4x4(dx::XMMATRIX matrix) {
+	dx::XMFLOAT4X4 stored;
+	dx::XMStoreFloat4x4(&stored, matrix);
+	Float4x4 result;
+	memcpy(result.m, stored.m, sizeof(result.m));
+	return result;
+}
+
+static dx::XMMATRIX ToXMMatrix(const Float4x4& matrix) {
+	dx::XMFLOAT4X4 stored;
+	memcpy(stored.m, matrix.m, sizeof(stored.m));
+	return dx::XMLoadFloat4x4(&stored);
+}
 
 #pragma region PublicMethods
 
@@ -8,280 +24,194 @@ Graphics::Graphics(HWND hWnd, FLOAT width, FLOAT height)
 	CreateDeviceAndSwapChain(hWnd);
 	CreateRenderTargetView();
 	ComPtr<ID3DBlob> vertexShader;
-	BindShaders(vertexShader);
-	CreateLayoutAndTopology(vertexShader);
+	ComPtr<ID3DBlob> packedVertexShader;
+	BindShaders(vertexShader, packedVertexShader);
+	CreateLayoutAndTopology(vertexShader, packedVertexShader);
 	SetViewPort();
+
+	_device = std::make_unique<D3D11RenderDevice>(_pDevice.Get(), _pContext.Get());
+	_device->SetVertexFormat(BufferKind::Vertex, _pInputLayout.Get(), _pVertexShader.Get());
+	_device->SetVertexFormat(BufferKind::PackedVertex, _pPackedInputLayout.Get(), _pPackedVertexShader.Get());
+	_meshes = std::make_unique<MeshCache>(*_device);
+
+	// the proxy quad only needs its shape, the pixel shader takes the light color
+	vector<Vertex> vBuffer;
+	vector<unsigned int> iBuffer;
+	AppendQuadLight(vBuffer, iBuffer, { { 0, 0, 0, 1 }, { 1, 1, 0, 0 }, { 1, 1, 1, 1 } }, 0u);
+	_quadLightMesh = _meshes->Register(vBuffer, iBuffer);
+
+	BuildFrameGraph();
 }
 
 void Graphics::Clear(const FLOAT colorRGBA[4]) {
+	PROFILE_ZONE("Clear");
 	_pContext->ClearRenderTargetView(_pRTView.Get(), colorRGBA);
 	_pContext->ClearDepthStencilView(_pDepthStencilView.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0u);
 }
 
 void Graphics::SwapBuffers() {
-	_pSwapChain->Present(1u, 0u);
-	_objectIndex = 0;
+	{
+		PROFILE_ZONE("Present");
+		_pSwapChain->Present(_vsync ? 1u : 0u, 0u);
+	}
+	_instances.Clear();
+	_objectSpheres.clear();
+	_textures->NextFrame();
 }
 
-void Graphics::DrawTriangles(vector<Vertex>& vBuffer, vector<unsigned short>& iBuffer, dx::XMFLOAT3 cameraPos, dx::XMFLOAT3 cameraRotation) {
+void Graphics::DrawTriangles(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, dx::XMFLOAT3 cameraPos, dx::XMFLOAT3 cameraRotation) {
+	PROFILE_ZONE("DrawTriangles");
+	_meshes->DrawDynamic(vBuffer, iBuffer);
+	Draw(cameraPos, cameraRotation);
+}
 
-	for (int i = 0; i < _psConstantBuffer.lightCounts.w; i++) {
-		RectLight* l = GetRectLight(i);
-		FillQuadLight(vBuffer, iBuffer, *GetRectLight(i));
-	}
+MeshHandle Graphics::RegisterMesh(const vector<Vertex>& vBuffer, const vector<unsigned int>& iBuffer) {
+	return _meshes->Register(vBuffer, iBuffer);
+}
 
+MeshHandle Graphics::RegisterMesh(const vector<PackedVertex>& vBuffer, const vector<unsigned int>& iBuffer) {
+	return _meshes->Register(vBuffer, iBuffer);
+}
 
-	// Bind Vertex Buffer
-	//========================================
-	{
-		ComPtr<ID3D11Buffer> pVertexBuffer;
+MeshHandle Graphics::RegisterMesh(const ImportedMesh& mesh) {
+	return _meshes->Register(mesh.GetVertices(), mesh.GetVertexCount(), mesh.GetIndices(), mesh.GetIndexCount());
+}
 
-		D3D11_BUFFER_DESC bd = {};
-		bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-		bd.Usage = D3D11_USAGE_DEFAULT;
-		bd.CPUAccessFlags = 0u;
-		bd.MiscFlags = 0u;
-		bd.ByteWidth = sizeof(Vertex) * vBuffer.size();
-		bd.StructureByteStride = sizeof(Vertex);
+void Graphics::ReleaseMesh(MeshHandle mesh) {
+	_meshes->Release(mesh);
+}
 
-		D3D11_SUBRESOURCE_DATA sd = {};
-		sd.pSysMem = vBuffer.data();
+void Graphics::DrawMesh(MeshHandle mesh, dx::XMMATRIX transform) {
+	_meshes->Draw(mesh, (unsigned int)_instances.GetCount());
+	SetObjectTransform(transform);
+	_objectSpheres.resize(_instances.GetCount() - 1, UnboundedSphere());
+	_objectSpheres.push_back(TransformSphere(_meshes->GetBoundingSphere(mesh), ToFloat4x4(transform)));
+}
+
+void Graphics::DrawMeshInstanced(MeshHandle mesh, const dx::XMMATRIX* transforms, size_t count) {
+	_instanceStaging.resize(count);
+	for (size_t i = 0; i < count; i++)
+		_instanceStaging[i] = ToFloat4x4(transforms[i]);
+	unsigned int first = _instances.Append(_instanceStaging.data(), count, &_pool);
+	_meshes->Draw(mesh, first, (unsigned int)count);
+
+	Float4 bounds = _meshes->GetBoundingSphere(mesh);
+	_objectSpheres.resize(first, UnboundedSphere());
+	for (size_t i = 0; i < count; i++)
+		_objectSpheres.push_back(TransformSphere(bounds, _instanceStaging[i]));
+}
+
+bool Graphics::BindTexture(UINT slot, const std::string& path, uint32_t flags) {
+	if (slot >= TEXTURE_SLOTS)
+		throw graphicsException("Texture slot out of range");
 
-		_pDevice->CreateBuffer(&bd, &sd, &pVertexBuffer);
-		const UINT stride = sizeof(Vertex);
-		const UINT offset = 0u;
-		_pContext->IASetVertexBuffers(0u, 1u, pVertexBuffer.GetAddressOf(), &stride, &offset);
+	LoadedTexture* texture = _textures->Acquire(path, flags);
+	ID3D11ShaderResourceView* view = texture ? texture->view.Get() : nullptr;
+	if (view != _boundTextures[slot]) {
+		_pContext->PSSetShaderResources(slot, 1u, &view);
+		_boundTextures[slot] = view;
 	}
+	return texture != nullptr;
+}
 
-	// Bind Index Buffer
-	//========================================
-	{
-		ComPtr<ID3D11Buffer> pIndexBuffer;
+void Graphics::Draw(dx::XMFLOAT3 cameraPos, dx::XMFLOAT3 cameraRotation) {
+	PROFILE_ZONE("Draw");
 
-		D3D11_BUFFER_DESC bd = {};
-		bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		bd.Usage = D3D11_USAGE_DEFAULT;
-		bd.CPUAccessFlags = 0u;
-		bd.MiscFlags = 0u;
-		bd.ByteWidth = sizeof(unsigned short) * iBuffer.size();
-		bd.StructureByteStride = sizeof(unsigned short);
+	// swap in the mips the streamer finished since the last frame
+	_textureStreamer->Update([this](unsigned int, LoadedTexture& texture) {
+		_filteredTexture = std::move(texture);
+		_pContext->PSSetShaderResources(2u, 1u, _filteredTexture.view.GetAddressOf());
+	});
+	BindTexture(0u, "./ltc_mat.dds", TEXTURE_SRGB);
+	BindTexture(1u, "./ltc_amp.dds", TEXTURE_SRGB);
 
-		D3D11_SUBRESOURCE_DATA sd = {};
-		sd.pSysMem = iBuffer.data();
+	_uploads = {};
+	size_t deviceBytes = _device->GetStats().bytesWritten;
+
+	// CPU side of the frame on the pool, see BuildFrameGraph
+	_frame.cameraPos = cameraPos;
+	_frame.cameraRotation = cameraRotation;
+	{
+		PROFILE_ZONE("frame graph");
+		_frameGraph.Run(_pool);
+	}
 
-		_pDevice->CreateBuffer(&bd, &sd, &pIndexBuffer);
-		_pContext->IASetIndexBuffer(pIndexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0u);
+	// every light keeps its proxy slot, but only runs of visible ones are drawn
+	for (size_t i = 0, run; i < _visibleProxies.size(); i += run) {
+		for (run = 1; i + run < _visibleProxies.size() && _visibleProxies[i + run] == _visibleProxies[i] + run; run++);
+		_meshes->Draw(_quadLightMesh, _frame.firstProxy + _visibleProxies[i], (unsigned int)run);
 	}
 
-	// Update VS Constant Buffer
+	// Update Constant Buffers
 	//========================================
 	{
-		//vsConstantBuffer.modelToWorld = dx::XMMatrixTranspose(dx::XMMatrixTranslation(0, 0, 4));
-		//vsConstantBuffer.normalTransform = dx::XMMatrixTranspose(dx::XMMatrixInverse(nullptr, vsConstantBuffer.modelToWorld[]));
-		_vsConstantBuffer.projection = dx::XMMatrixTranspose(dx::XMMatrixPerspectiveLH(1.0f, _height / _width, 0.5f, 500.0f));
-		dx::XMFLOAT3 forward(0, 0, 1);
-		dx::XMFLOAT3 pos(0, 0, 0);
-		dx::XMMATRIX translation;
-
-		dx::XMVECTOR cameraDir = dx::XMVector3Transform(
-			dx::XMLoadFloat3(&forward),
-			dx::XMMatrixRotationRollPitchYaw(cameraRotation.x, cameraRotation.y, cameraRotation.z)
-		);
-		_vsConstantBuffer.worldToView = dx::XMMatrixTranspose(dx::XMMatrixLookToLH(
-			dx::XMLoadFloat3(&cameraPos),
-			dx::XMVector3Normalize(cameraDir),
-			{ 0, 1, 0 }
-		));
-		_vsConstantBuffer.objects = _objectIndex;
-
-
-		// Update the constant buffer.
-		D3D11_MAPPED_SUBRESOURCE mappedResource;
-		_pContext->Map(
-			_pVSConstantBuffer.Get(),
-			0,
-			D3D11_MAP_WRITE_DISCARD,
-			0,
-			&mappedResource
-		);
-		memcpy(mappedResource.pData, &_vsConstantBuffer,
-			sizeof(_vsConstantBuffer));
-		_pContext->Unmap(_pVSConstantBuffer.Get(), 0);
+		PROFILE_ZONE("upload constants");
+		UploadConstants(_pVSConstantBuffer.Get(), &_vsConstantBuffer, sizeof(_vsConstantBuffer), _vsUploaded);
+		UploadConstants(_pPSConstantBuffer.Get(), &_psConstantBuffer, sizeof(_psConstantBuffer), _psUploaded);
 	}
-
-	// Update PS Constant Buffer
 	{
-		_psConstantBuffer.viewPos = dx::XMFLOAT4{ cameraPos.x, cameraPos.y, cameraPos.z, 1 };
-
-		// Update the constant buffer.
-		D3D11_MAPPED_SUBRESOURCE mappedResource;
-		_pContext->Map(
-			_pPSConstantBuffer.Get(),
-			0,
-			D3D11_MAP_WRITE_DISCARD,
-			0,
-			&mappedResource
-		);
-
-		memcpy(mappedResource.pData, &_psConstantBuffer,
-			sizeof(_psConstantBuffer));
-		_pContext->Unmap(_pPSConstantBuffer.Get(), 0);
+		PROFILE_ZONE("upload instances");
+		UploadStructured(_instanceBuffer, _instances.GetData(), _instances.GetCount(), sizeof(ObjectTransform), 0u, true);
 	}
-
-	_pContext->DrawIndexed(iBuffer.size(), 0u, 0u);
+	{
+		PROFILE_ZONE("upload lights");
+		UploadLights();
+	}
+	BindPixelShader(_lightPermutations ? _lights.GetLightMix() : LIGHT_MIX_ALL);
+	{
+		PROFILE_ZONE("mesh flush");
+		_meshes->Flush();
+	}
+	_uploads.bytes += _device->GetStats().bytesWritten - deviceBytes;
 }
 
-void Graphics::FillTriangle(vector<Vertex>& vBuffer, vector<unsigned short>& iBuffer) {
-
-	unsigned short offset = vBuffer.size();
-
-	vBuffer.push_back({ 0.0f,0.5f, 0.0f , 1.0f, 0.0f, 0.0f });
-	vBuffer.push_back({ 0.5f,-0.5f, 0.0f ,0.0f, 1.0f, 0.0f });
-	vBuffer.push_back({ -0.5f,-0.5f, 0.0f ,0.0f, 0.0f, 1.0f });
-
-	iBuffer.push_back(offset + 0u);
-	iBuffer.push_back(offset + 1u);
-	iBuffer.push_back(offset + 2u);
+void Graphics::SetCullBounds(const Aabb* bounds, size_t count) {
+	_objectBvh.Build(bounds, count);
 }
 
-void Graphics::FillCubeShared(vector<Vertex>& vBuffer, vector<unsigned short>& iBuffer) {
-	unsigned short offset = vBuffer.size();
-
-	vBuffer.push_back({ -1.0f, -1.0f, -1.0f, 1.0f, 0.0f, 0.0f });
-	vBuffer.push_back({ 1.0f,-1.0f, -1.0f,	0.0f, 1.0f, 0.0f });
-	vBuffer.push_back({ -1.0f,1.0f, -1.0f,  0.0f, 0.0f, 1.0f });
-	vBuffer.push_back({ 1.0f,1.0f, -1.0f,	1.0f, 1.0f, 0.0f });
-	vBuffer.push_back({ -1.0f,-1.0f, 1.0f,	1.0f, 0.0f, 1.0f });
-	vBuffer.push_back({ 1.0f,-1.0f, 1.0f,  0.0f, 1.0f, 1.0f });
-	vBuffer.push_back({ -1.0f,1.0f, 1.0f,	0.0f, 0.0f, 0.0f });
-	vBuffer.push_back({ 1.0f,1.0f, 1.0f,	1.0f, 1.0f, 1.0f });
-
-	const unsigned short indices[] = {
-		0,2,1, 2,3,1,
-		1,3,5, 3,7,5,
-		2,6,3, 3,6,7,
-		4,5,7, 4,7,6,
-		0,4,2, 2,4,6,
-		0,1,4, 1,5,4
-	};
-
-	for (unsigned short index : indices)
-		iBuffer.push_back(offset + index);
-}
-
-void Graphics::FillCube(vector<Vertex>& vBuffer, vector<unsigned short>& iBuffer, dx::XMMATRIX transform) {
-	unsigned short offset = vBuffer.size();
-
-	float red[3] = { 1.0f, 0.0f, 0.0f };
-
-	// BACK - green
-	vBuffer.push_back({ -1.0f,-1.0f, 1.0f,	0.0f, 1.0f, 0.0f, 0,0, 0.0f, 0.0f, 1.0f, _objectIndex });
-	vBuffer.push_back({ 1.0f,-1.0f, 1.0f,  0.0f, 1.0f, 0.0f,  0,0, 0.0f, 0.0f, 1.0f, _objectIndex });
-	vBuffer.push_back({ -1.0f,1.0f, 1.0f,	0.0f, 1.0f, 0.0f, 0,0, 0.0f, 0.0f, 1.0f , _objectIndex });
-	vBuffer.push_back({ 1.0f,1.0f, 1.0f,	0.0f, 1.0f, 0.0f, 0,0, 0.0f, 0.0f, 1.0f , _objectIndex });
-
-	// LEFT - magenta
-	vBuffer.push_back({ -1.0f, -1.0f, -1.0f, 1.0f, 0.0f, 1.0f, 0,0,   -1.0f, 0.0f, 0.0f , _objectIndex });
-	vBuffer.push_back({ -1.0f,1.0f, -1.0f,  1.0f, 0.0f, 1.0f,  0,0,  -1.0f, 0.0f, 0.0f , _objectIndex });
-	vBuffer.push_back({ -1.0f,-1.0f, 1.0f,	1.0f, 0.0f, 1.0f,  0,0,  -1.0f, 0.0f, 0.0f , _objectIndex });
-	vBuffer.push_back({ -1.0f,1.0f, 1.0f,	1.0f, 0.0f, 1.0f,  0,0,  -1.0f, 0.0f, 0.0f , _objectIndex });
-
-	// RIGHT - cyan
-	vBuffer.push_back({ 1.0f,-1.0f, -1.0f,	0.0f, 1.0f, 1.0f, 0,0,  1.0f, 0.0f, 0.0f , _objectIndex });
-	vBuffer.push_back({ 1.0f,1.0f, -1.0f,	0.0f, 1.0f, 1.0f, 0,0,  1.0f, 0.0f, 0.0f , _objectIndex });
-	vBuffer.push_back({ 1.0f,-1.0f, 1.0f,  0.0f, 1.0f, 1.0f,  0,0, 1.0f, 0.0f, 0.0f , _objectIndex });
-	vBuffer.push_back({ 1.0f,1.0f, 1.0f,	0.0f, 1.0f, 1.0f, 0,0,  1.0f, 0.0f, 0.0f , _objectIndex });
-
-	// TOP - blue
-	vBuffer.push_back({ -1.0f,1.0f, -1.0f,  0.0f, 0.0f, 1.0f, 0,0,  0.0f, 1.0f, 0.0f , _objectIndex });
-	vBuffer.push_back({ 1.0f,1.0f, -1.0f,	0.0f, 0.0f, 1.0f, 0,0,  0.0f, 1.0f, 0.0f , _objectIndex });
-	vBuffer.push_back({ -1.0f,1.0f, 1.0f,	0.0f, 0.0f, 1.0f, 0,0,  0.0f, 1.0f, 0.0f , _objectIndex });
-	vBuffer.push_back({ 1.0f,1.0f, 1.0f,	0.0f, 0.0f, 1.0f, 0,0,  0.0f, 1.0f, 0.0f , _objectIndex });
-
-	// BOTTOM - yellow
-	vBuffer.push_back({ -1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 0.0f,0,0,   0.0f, -1.0f, 0.0f , _objectIndex });
-	vBuffer.push_back({ 1.0f,-1.0f, -1.0f,	1.0f, 1.0f, 0.0f, 0,0,  0.0f, -1.0f, 0.0f , _objectIndex });
-	vBuffer.push_back({ -1.0f,-1.0f, 1.0f,	1.0f, 1.0f, 0.0f, 0,0,  0.0f, -1.0f, 0.0f , _objectIndex });
-	vBuffer.push_back({ 1.0f,-1.0f, 1.0f,  1.0f, 1.0f, 0.0f,  0,0, 0.0f, -1.0f, 0.0f , _objectIndex });
-
-	// FRONT - red
-	vBuffer.push_back({ -1.0f, -1.0f, -1.0f, 1.0f, 0.0f, 0.0f,0,0,  0.0f, 0.0f, -1.0f , _objectIndex });
-	vBuffer.push_back({ 1.0f,-1.0f, -1.0f,	1.0f, 0.0f, 0.0f, 0,0, 0.0f, 0.0f, -1.0f , _objectIndex });
-	vBuffer.push_back({ -1.0f,1.0f, -1.0f,  1.0f, 0.0f, 0.0f, 0,0, 0.0f, 0.0f, -1.0f , _objectIndex });
-	vBuffer.push_back({ 1.0f,1.0f, -1.0f,	1.0f, 0.0f, 0.0f, 0,0, 0.0f, 0.0f, -1.0f , _objectIndex });
-
-
-	const unsigned short indices[] = {
-		0,1,2,    2,1,3,
-		4,6,5,	  6,7,5,
-		8,9,10,   10,9,11,
-		12,14,13, 14,15,13,
-		16,17,18, 18,17,19,
-		20,22,21, 22,23,21
-	};
-
-	for (unsigned short index : indices)
-		iBuffer.push_back(offset + index);
-
-	_vsConstantBuffer.modelToWorld[_objectIndex] = dx::XMMatrixTranspose(transform);
-	_vsConstantBuffer.normalTransform[_objectIndex] = dx::XMMatrixTranspose(dx::XMMatrixInverse(nullptr, _vsConstantBuffer.modelToWorld[_objectIndex]));
-	_objectIndex++;
+void Graphics::UpdateCullBounds(const Aabb* bounds) {
+	_objectBvh.Refit(bounds);
 }
 
-void Graphics::FillFloor(vector<Vertex>& vBuffer, vector<unsigned short>& iBuffer, dx::XMMATRIX transform) {
-	unsigned short offset = vBuffer.size();
-
-	vBuffer.push_back({ -100.0f, -1.0f, -100.0f,	0.5f, 0.5f, 0.5f, 0,0, 0.0f, 1.0f, 0.0f, _objectIndex });
-	vBuffer.push_back({ 100.0f,  -1.0f, -100.0f,	0.5f, 0.5f, 0.5f, 0,0, 0.0f, 1.0f, 0.0f, _objectIndex });
-	vBuffer.push_back({ 100.0f,  -1.0f, 100.0f,		0.5f, 0.5f, 0.5f, 0,0, 0.0f, 1.0f, 0.0f, _objectIndex });
-	vBuffer.push_back({ -100.0f, -1.0f, 100.0f,		0.5f, 0.5f, 0.5f, 0,0, 0.0f, 1.0f, 0.0f, _objectIndex });
-
-
-	const unsigned short indices[] = {
-		0,2,1,    0,3,2,
-	};
-
-	for (unsigned short index : indices)
-		iBuffer.push_back(offset + index);
-
-	_vsConstantBuffer.modelToWorld[_objectIndex] = dx::XMMatrixTranspose(transform);
-	_vsConstantBuffer.normalTransform[_objectIndex] = dx::XMMatrixTranspose(dx::XMMatrixInverse(nullptr, _vsConstantBuffer.modelToWorld[_objectIndex]));
-	_objectIndex++;
+const vector<uint32_t>& Graphics::CullObjects(dx::XMFLOAT3 cameraPos, dx::XMFLOAT3 cameraRotation) {
+	dx::XMMATRIX worldToView, projection;
+	dx::XMVECTOR cameraDir;
+	GetCamera(cameraPos, cameraRotation, worldToView, projection, cameraDir);
+	_visibleObjects.clear();
+	_objectBvh.Cull(ExtractFrustum(ToFloat4x4(worldToView * projection)), _visibleObjects);
+	return _visibleObjects;
 }
 
-void Graphics::FillQuadLight(vector<Vertex>& vBuffer, vector<unsigned short>& iBuffer, RectLight light) {
-	unsigned short offset = vBuffer.size();
-
-	vBuffer.push_back({ -1.0f, -1.0f, .0f,	light.Color.x, light.Color.y, light.Color.z, 0,0, .0f, .0f, -1.0f, _objectIndex });
-	vBuffer.push_back({ 1.0f, -1.0f, .0f,	light.Color.x, light.Color.y, light.Color.z, 1,0, .0f, .0f, -1.0f, _objectIndex });
-	vBuffer.push_back({ 1.0f,  1.0f, .0f,	light.Color.x, light.Color.y, light.Color.z, 1,1, .0f, .0f, -1.0f, _objectIndex });
-	vBuffer.push_back({ -1.0f,  1.0f, .0f,	light.Color.x, light.Color.y, light.Color.z, 0,1, .0f, .0f, -1.0f, _objectIndex });
-
-	const unsigned short indices[] = {
-		0,2,1,    0,3,2,
-		0,1,2,    0,2,3
-	};
+void Graphics::FillTriangle(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer) {
+	PROFILE_ZONE("FillTriangle");
+	AppendTriangle(vBuffer, iBuffer);
+}
 
-	for (unsigned short index : indices)
-		iBuffer.push_back(offset + index);
+void Graphics::FillCubeShared(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer) {
+	PROFILE_ZONE("FillCubeShared");
+	AppendCubeShared(vBuffer, iBuffer);
+}
 
-	dx::XMMATRIX transform =
-		dx::XMMatrixScaling(light.Params.x, light.Params.y, 0)
-		* dx::XMMatrixRotationY(light.Params.z * 2 * 3.14)
-		* dx::XMMatrixRotationZ(light.Params.w * 2 * 3.14)
-		* dx::XMMatrixTranslation(light.Position.x, light.Position.y, light.Position.z);
+void Graphics::FillCube(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, dx::XMMATRIX transform) {
+	PROFILE_ZONE("FillCube");
+	AppendCube(vBuffer, iBuffer, (unsigned int)_instances.GetCount());
+	SetObjectTransform(transform);
+}
 
-	_vsConstantBuffer.modelToWorld[_objectIndex] = dx::XMMatrixTranspose(transform);
-	_vsConstantBuffer.normalTransform[_objectIndex] = dx::XMMatrixTranspose(dx::XMMatrixInverse(nullptr, _vsConstantBuffer.modelToWorld[_objectIndex]));
-	_objectIndex++;
+void Graphics::FillFloor(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, dx::XMMATRIX transform) {
+	PROFILE_ZONE("FillFloor");
+	AppendFloor(vBuffer, iBuffer, (unsigned int)_instances.GetCount());
+	SetObjectTransform(transform);
 }
 
-void Graphics::AddPointLight(dx::XMFLOAT3 position, dx::XMFLOAT3 color, float intensity) {
-	if (_psConstantBuffer.lightCounts.x >= LIGHT_BUFFER_SIZE)
-		return;
+void Graphics::FillQuadLight(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, RectLight light) {
+	PROFILE_ZONE("FillQuadLight");
+	AppendQuadLight(vBuffer, iBuffer, light, (unsigned int)_instances.GetCount());
+	SetObjectTransform(ToXMMatrix(QuadLightTransform(light)));
+}
 
-	int index = _psConstantBuffer.lightCounts.x++;
-	PointLight& light = _psConstantBuffer.pointLights[index];
+void Graphics::AddPointLight(dx::XMFLOAT3 position, dx::XMFLOAT3 color, float intensity, float radius) {
+	PointLight& light = _lights.AddPointLight();
 	light.Position = {
 		position.x,
 		position.y,
@@ -294,14 +224,11 @@ void Graphics::AddPointLight(dx::XMFLOAT3 position, dx::XMFLOAT3 color, float in
 		color.z,
 		intensity
 	};
+	light.Range = { radius, 0, 0, 0 };
 }
 
-void Graphics::AddSpotLight(dx::XMFLOAT3 position, dx::XMFLOAT3 color, dx::XMFLOAT3 direction, float intensity, float innerCone, float outerCone) {
-	if (_psConstantBuffer.lightCounts.y >= LIGHT_BUFFER_SIZE)
-		return;
-
-	int index = _psConstantBuffer.lightCounts.y++;
-	SpotLight& light = _psConstantBuffer.spotLights[index];
+void Graphics::AddSpotLight(dx::XMFLOAT3 position, dx::XMFLOAT3 color, dx::XMFLOAT3 direction, float intensity, float innerCone, float outerCone, float radius) {
+	SpotLight& light = _lights.AddSpotLight();
 
 	light.Position = {
 		position.x,
@@ -323,6 +250,8 @@ void Graphics::AddSpotLight(dx::XMFLOAT3 position, dx::XMFLOAT3 color, dx::XMFLO
 		0, 0
 	};
 
+	light.Range = { radius, 0, 0, 0 };
+
 	light.Direction = {
 		direction.x,
 		direction.y,
@@ -332,12 +261,11 @@ void Graphics::AddSpotLight(dx::XMFLOAT3 position, dx::XMFLOAT3 color, dx::XMFLO
 }
 
 void Graphics::AddDirLight(dx::XMFLOAT3 color, dx::XMFLOAT3 direction, float intensity) {
-	if (_psConstantBuffer.lightCounts.z >= LIGHT_BUFFER_SIZE)
+	DirLight* added = _lights.AddDirLight();
+	if (!added)
 		return;
 
-	int index = _psConstantBuffer.lightCounts.z++;
-	DirLight& light = _psConstantBuffer.dirLights[index];
-
+	DirLight& light = *added;
 	light.Color = {
 		color.x,
 		color.y,
@@ -354,11 +282,7 @@ void Graphics::AddDirLight(dx::XMFLOAT3 color, dx::XMFLOAT3 direction, float int
 }
 
 void Graphics::AddRectLight(dx::XMFLOAT3 position, dx::XMFLOAT3 color, float intensity, float width, float height, float rotationX, float rotationY) {
-	if (_psConstantBuffer.lightCounts.w >= LIGHT_BUFFER_SIZE)
-		return;
-
-	int index = _psConstantBuffer.lightCounts.w++;
-	RectLight& light = _psConstantBuffer.rectLights[index];
+	RectLight& light = _lights.AddRectLight();
 
 	light.Color = {
 		color.x,
@@ -382,37 +306,295 @@ void Graphics::AddRectLight(dx::XMFLOAT3 position, dx::XMFLOAT3 color, float int
 	};
 }
 
-PointLight* Graphics::GetPointLight(int index) {
-	if (index >= _psConstantBuffer.lightCounts.x)
-		return nullptr;
+bool Graphics::AddPolygonLight(const dx::XMFLOAT3* vertices, int count, dx::XMFLOAT3 color, float intensity) {
+	PolygonLight* light = _lights.AddPolygonLight((const Float3*)vertices, count);
+	if (!light)
+		return false;
 
-	return &_psConstantBuffer.pointLights[index];
+	light->Color = {
+		color.x,
+		color.y,
+		color.z,
+		intensity
+	};
+	return true;
 }
 
-SpotLight* Graphics::GetSpotLight(int index) {
-	if (index >= _psConstantBuffer.lightCounts.y)
-		return nullptr;
+void Graphics::AddDiskLight(dx::XMFLOAT3 position, dx::XMFLOAT3 normal, float radius, dx::XMFLOAT3 color, float intensity) {
+	DiskLight& light = _lights.AddDiskLight();
+
+	light.Position = {
+		position.x,
+		position.y,
+		position.z,
+		1
+	};
+
+	light.Direction = {
+		normal.x,
+		normal.y,
+		normal.z,
+		radius
+	};
 
-	return &_psConstantBuffer.spotLights[index];
+	light.Color = {
+		color.x,
+		color.y,
+		color.z,
+		intensity
+	};
 }
 
-DirLight* Graphics::GetDirLight(int index) {
-	if (index >= _psConstantBuffer.lightCounts.z)
-		return nullptr;
+void Graphics::AddSphereLight(dx::XMFLOAT3 position, float radius, dx::XMFLOAT3 color, float intensity) {
+	SphereLight& light = _lights.AddSphereLight();
+
+	light.Position = {
+		position.x,
+		position.y,
+		position.z,
+		radius
+	};
+
+	light.Color = {
+		color.x,
+		color.y,
+		color.z,
+		intensity
+	};
+}
 
-	return &_psConstantBuffer.dirLights[index];
+// The light is uploaded again with the next Draw, written to or not
+PointLight* Graphics::GetPointLight(int index) {
+	return _lights.EditPointLight(index);
+}
+
+SpotLight* Graphics::GetSpotLight(int index) {
+	return _lights.EditSpotLight(index);
+}
+
+DirLight* Graphics::GetDirLight(int index) {
+	return _lights.EditDirLight(index);
 }
 
 RectLight* Graphics::GetRectLight(int index) {
-	if (index >= _psConstantBuffer.lightCounts.w)
-		return nullptr;
+	return _lights.EditRectLight(index);
+}
+
+PolygonLight* Graphics::GetPolygonLight(int index) {
+	return _lights.EditPolygonLight(index);
+}
+
+DiskLight* Graphics::GetDiskLight(int index) {
+	return _lights.EditDiskLight(index);
+}
 
-	return &_psConstantBuffer.rectLights[index];
+SphereLight* Graphics::GetSphereLight(int index) {
+	return _lights.EditSphereLight(index);
+}
+
+bool Graphics::MovePolygonLight(int index, const dx::XMFLOAT3* vertices) {
+	Float4* target = _lights.EditPolygonVertices(index);
+	if (!target)
+		return false;
+
+	for (uint32_t i = 0; i < _lights.GetPolygonLights()[index].Vertices[0]; i++)
+		target[i] = { vertices[i].x, vertices[i].y, vertices[i].z, 1 };
+	return true;
 }
 
 #pragma endregion
 
 #pragma region PrivateMethods
+void Graphics::GetCamera(dx::XMFLOAT3 cameraPos, dx::XMFLOAT3 cameraRotation, dx::XMMATRIX& worldToView, dx::XMMATRIX& projection, dx::XMVECTOR& cameraDir) const {
+	projection = dx::XMMatrixPerspectiveLH(1.0f, _height / _width, 0.5f, 500.0f);
+	dx::XMFLOAT3 forward(0, 0, 1);
+	cameraDir = dx::XMVector3Normalize(dx::XMVector3Transform(
+		dx::XMLoadFloat3(&forward),
+		dx::XMMatrixRotationRollPitchYaw(cameraRotation.x, cameraRotation.y, cameraRotation.z)
+	));
+	worldToView = dx::XMMatrixLookToLH(dx::XMLoadFloat3(&cameraPos), cameraDir, { 0, 1, 0 });
+}
+
+void Graphics::SetObjectTransform(dx::XMMATRIX transform) {
+	Float4x4 matrix = ToFloat4x4(transform);
+	_instances.Append(&matrix, 1);
+}
+
+// The CPU work of Draw, run on the pool every frame. The D3D context is not
+// free-threaded, so the jobs only fill CPU-side state; Draw maps and uploads
+// it on its own thread afterwards.
+void Graphics::BuildFrameGraph() {
+	FrameGraph::Node camera = _frameGraph.Add("camera", [this] {
+		GetCamera(_frame.cameraPos, _frame.cameraRotation, _frame.worldToView, _frame.projection, _frame.cameraDir);
+	});
+
+	// light proxies go last, the pixel shader finds them by objects - index
+	FrameGraph::Node proxies = _frameGraph.Add("proxy instances", [this] {
+		const vector<RectLight>& rects = _lights.GetRectLights();
+		const Aabb quadBox = { { -1, -1, 0 }, { 1, 1, 0 } };
+		_instanceStaging.resize(rects.size());
+		_proxyBounds.resize(rects.size());
+		for (size_t i = 0; i < rects.size(); i++) {
+			_instanceStaging[i] = QuadLightTransform(rects[i]);
+			_proxyBounds[i] = TransformAabb(quadBox, _instanceStaging[i]);
+		}
+		_frame.firstProxy = _instances.Append(_instanceStaging.data(), rects.size(), &_pool);
+	});
+
+	_frameGraph.Add("proxy culling", [this] {
+		_proxyBvh.Build(_proxyBounds.data(), _proxyBounds.size());
+		_visibleProxies.clear();
+		_proxyBvh.Cull(ExtractFrustum(ToFloat4x4(_frame.worldToView * _frame.projection)), _visibleProxies);
+		std::sort(_visibleProxies.begin(), _visibleProxies.end());
+	}, { camera, proxies });
+
+	_frameGraph.Add("light constants", [this] {
+		_lights.UpdateConstants();
+	});
+
+	_frameGraph.Add("cluster grid", [this] {
+		dx::XMFLOAT4X4 proj;
+		dx::XMStoreFloat4x4(&proj, _frame.projection);
+		ClusterGridDesc desc = {
+			(int)_width, (int)_height, CLUSTER_TILE_SIZE, CLUSTER_SLICES, 0.5f, 500.0f,
+			1.0f / proj._11, 1.0f / proj._22
+		};
+		_clusterGrid.Build(desc, ToFloat4x4(_frame.worldToView),
+			_lights.GetPointLights().data(), _lights.GetPointLights().size(),
+			_lights.GetSpotLights().data(), _lights.GetSpotLights().size(),
+			_lights.GetRectLights().data(), _lights.GetRectLights().size(),
+			_pool);
+		_psConstantBuffer.clusterGrid = { _clusterGrid.GetTilesX(), _clusterGrid.GetTilesY(), desc.slices, desc.tileSize };
+		_psConstantBuffer.clusterDepth = { _clusterGrid.GetSliceScale(), _clusterGrid.GetSliceBias(), 0, 0 };
+	}, { camera });
+
+	// objects without a bounding sphere, drawn by the Fill functions or as
+	// light proxies, get no list
+	_frameGraph.Add("object lights", [this] {
+		_objectSpheres.resize(_instances.GetCount(), UnboundedSphere());
+		_objectLights.Build(_objectSpheres.data(), _objectSpheres.size(),
+			_lights.GetPointLights().data(), _lights.GetPointLights().size(),
+			_lights.GetSpotLights().data(), _lights.GetSpotLights().size(),
+			_lights.GetRectLights().data(), _lights.GetRectLights().size(),
+			_pool);
+	}, { proxies });
+
+	_frameGraph.Add("constant buffers", [this] {
+		_vsConstantBuffer.projection = dx::XMMatrixTranspose(_frame.projection);
+		_vsConstantBuffer.worldToView = dx::XMMatrixTranspose(_frame.worldToView);
+		_vsConstantBuffer.objects = (unsigned int)_instances.GetCount();
+		_psConstantBuffer.rectProxies.x = (UINT)_lights.GetRectLights().size();
+		_psConstantBuffer.rectProxies.y = (UINT)_instances.GetCount();
+		_psConstantBuffer.viewPos = dx::XMFLOAT4{ _frame.cameraPos.x, _frame.cameraPos.y, _frame.cameraPos.z, 1 };
+		dx::XMStoreFloat4(&_psConstantBuffer.viewForward, _frame.cameraDir);
+	}, { camera, proxies });
+}
+
+// Uploads the lights that changed (t3-t5, t10-t13, b1), and this frame's clusters,
+// index lists (t6-t7) and object lists (t8-t9).
+void Graphics::UploadLights() {
+	_uploads.lightBytes = _lights.Flush([this](const LightUpload& upload) {
+		UploadLight(upload);
+	});
+	_uploads.bytes += _uploads.lightBytes;
+	UploadStructured(_clusterBuffer, _clusterGrid.GetClusters().data(), _clusterGrid.GetClusterCount(), sizeof(ClusterRange), 6u);
+	UploadStructured(_clusterLightBuffer, _clusterGrid.GetLightIndices().data(), _clusterGrid.GetLightIndices().size(), sizeof(uint32_t), 7u);
+	UploadStructured(_objectLightBuffer, _objectLights.GetRanges().data(), _objectLights.GetObjectCount(), sizeof(ClusterRange), 8u);
+	UploadStructured(_objectLightIndexBuffer, _objectLights.GetLightIndices().data(), _objectLights.GetLightIndices().size(), sizeof(uint32_t), 9u);
+}
+
+// Light buffers are DEFAULT usage, so a few changed lights are copied in
+// with a box instead of rewriting the whole buffer.
+void Graphics::UploadLight(const LightUpload& upload) {
+	if (upload.target == LightTarget::Constants) {
+		D3D11_MAPPED_SUBRESOURCE mappedResource;
+		_pContext->Map(_pLightConstantBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+		memcpy(mappedResource.pData, upload.data, upload.bytes);
+		_pContext->Unmap(_pLightConstantBuffer.Get(), 0);
+		_uploads.writes++;
+		return;
+	}
+
+	StructuredBuffer* target = nullptr;
+	UINT slot = 0u;
+	switch (upload.target) {
+	case LightTarget::PointLights: target = &_pointLightBuffer; slot = 3u; break;
+	case LightTarget::SpotLights: target = &_spotLightBuffer; slot = 4u; break;
+	case LightTarget::RectLights: target = &_rectLightBuffer; slot = 5u; break;
+	case LightTarget::PolygonLights: target = &_polygonLightBuffer; slot = 10u; break;
+	case LightTarget::PolygonVertices: target = &_polygonVertexBuffer; slot = 11u; break;
+	case LightTarget::DiskLights: target = &_diskLightBuffer; slot = 12u; break;
+	case LightTarget::SphereLights: target = &_sphereLightBuffer; slot = 13u; break;
+	default: return;
+	}
+	if (upload.resize)
+		CreateStructured(*target, upload.capacity, upload.stride, slot, false, false);
+	if (upload.bytes == 0)
+		return;
+
+	D3D11_BOX box = { (UINT)upload.offset, 0u, 0u, (UINT)(upload.offset + upload.bytes), 1u, 1u };
+	_pContext->UpdateSubresource(target->buffer.Get(), 0u, &box, upload.data, 0u, 0u);
+	_uploads.writes++;
+}
+
+void Graphics::UploadStructured(StructuredBuffer& target, const void* data, size_t count, size_t stride, UINT slot, bool vertexShader) {
+	if (count > target.capacity || !target.buffer) {
+		size_t capacity = 64;
+		while (capacity < count)
+			capacity *= 2;
+		CreateStructured(target, capacity, stride, slot, vertexShader, true);
+	}
+
+	if (count == 0)
+		return;
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	_pContext->Map(target.buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	memcpy(mappedResource.pData, data, count * stride);
+	_pContext->Unmap(target.buffer.Get(), 0);
+	_uploads.bytes += count * stride;
+	_uploads.writes++;
+}
+
+void Graphics::CreateStructured(StructuredBuffer& target, size_t capacity, size_t stride, UINT slot, bool vertexShader, bool dynamic) {
+	D3D11_BUFFER_DESC bd = {};
+	bd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	bd.Usage = dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
+	bd.CPUAccessFlags = dynamic ? D3D11_CPU_ACCESS_WRITE : 0u;
+	bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	bd.ByteWidth = (UINT)(capacity * stride);
+	bd.StructureByteStride = (UINT)stride;
+	target.buffer.Reset();
+	target.view.Reset();
+	CHECKED(_pDevice->CreateBuffer(&bd, nullptr, &target.buffer), "Structured buffer fucked up");
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0u;
+	srvDesc.Buffer.NumElements = (UINT)capacity;
+	CHECKED(_pDevice->CreateShaderResourceView(target.buffer.Get(), &srvDesc, &target.view), "Structured buffer view fucked up");
+	target.capacity = capacity;
+	if (vertexShader)
+		_pContext->VSSetShaderResources(slot, 1u, target.view.GetAddressOf());
+	else
+		_pContext->PSSetShaderResources(slot, 1u, target.view.GetAddressOf());
+}
+
+// Constant buffers are small, but most frames do not change most of them
+void Graphics::UploadConstants(ID3D11Buffer* buffer, const void* data, size_t bytes, vector<unsigned char>& uploaded) {
+	if (uploaded.size() == bytes && memcmp(uploaded.data(), data, bytes) == 0)
+		return;
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	_pContext->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	memcpy(mappedResource.pData, data, bytes);
+	_pContext->Unmap(buffer, 0);
+	uploaded.assign((const unsigned char*)data, (const unsigned char*)data + bytes);
+	_uploads.bytes += bytes;
+	_uploads.writes++;
+}
+
 void Graphics::CreateDeviceAndSwapChain(HWND hWnd) {
 	DXGI_SWAP_CHAIN_DESC sd = { 0 };
 	sd.BufferDesc.Width = 0;
@@ -494,13 +676,49 @@ void Graphics::CreateRenderTargetView() {
 	_pContext->OMSetRenderTargets(1u, _pRTView.GetAddressOf(), _pDepthStencilView.Get());
 }
 
-void Graphics::BindShaders(ComPtr<ID3DBlob>& blobBuffer) {
+// Called on the render thread for cache loads and the first streamed step,
+// on the streamer's thread after that; only the device is touched, never
+// the context. size is the largest dimension of the top mip loaded.
+bool Graphics::LoadTexture(const std::string& path, uint32_t flags, size_t maxSize, LoadedTexture& texture, size_t& size, bool& complete) {
+	MappedFile file;
+	DDSInfo info;
+	if (!file.Open(path.c_str()) || !ParseDDS(file.GetData(), file.GetSize(), info))
+		return false;
+	file.Close();
+
+	std::wstring widePath(path.begin(), path.end());
+	if (FAILED(DirectX::CreateDDSTextureFromFile(_pDevice.Get(), widePath.c_str(), (flags & TEXTURE_SRGB) != 0, &texture.texture, &texture.view, maxSize)))
+		return false;
+
+	// the mips FillInitData skips; it ignores maxsize without a mip chain
+	size_t fullSize = std::max({ info.width, info.height, info.depth });
+	size = fullSize;
+	for (uint32_t mip = 1; maxSize && mip < info.mipCount && size > maxSize; mip++)
+		size = std::max<size_t>(size / 2, 1);
+	complete = size == fullSize;
+	return true;
+}
+
+void Graphics::BindShaders(ComPtr<ID3DBlob>& blobBuffer, ComPtr<ID3DBlob>& packedBlobBuffer) {
 	// pixel shader
 	{
-		ComPtr<ID3D11PixelShader> pPixelShader;
+		ComPtr<ID3D11PixelShader>& pPixelShader = _pixelShaders[LIGHT_MIX_ALL];
 		CHECKED(D3DReadFileToBlob(L"PixelShader.cso", &blobBuffer), "Reading PShader fucked up");
 		CHECKED(_pDevice->CreatePixelShader(blobBuffer->GetBufferPointer(), blobBuffer->GetBufferSize(), nullptr, &pPixelShader), "PShader creation fucked up");
 		_pContext->PSSetShader(pPixelShader.Get(), nullptr, 0u);
+		_pixelShaderMix = LIGHT_MIX_ALL;
+
+		// every other LightMix, built with the project (BuildPixelShaderVariants.ps1),
+		// so no mix that shows up later stalls a frame; a missing one is drawn
+		// with the generic shader
+		for (uint32_t mix = 0; mix < LIGHT_MIX_ALL; mix++) {
+			wchar_t path[64];
+			swprintf_s(path, L"PixelShaderVariants/PixelShader_%u.cso", mix);
+			ComPtr<ID3DBlob> variant;
+			if (FAILED(D3DReadFileToBlob(path, &variant))
+				|| FAILED(_pDevice->CreatePixelShader(variant->GetBufferPointer(), variant->GetBufferSize(), nullptr, &_pixelShaders[mix])))
+				_pixelShaders[mix] = pPixelShader;
+		}
 
 		D3D11_BUFFER_DESC bd = {};
 		bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
@@ -516,14 +734,31 @@ void Graphics::BindShaders(ComPtr<ID3DBlob>& blobBuffer) {
 		HRESULT hr = _pDevice->CreateBuffer(&bd, &sd, &_pPSConstantBuffer);
 		_pContext->PSSetConstantBuffers(0u, 1u, _pPSConstantBuffer.GetAddressOf());
 
-		hr = DirectX::CreateDDSTextureFromFile(_pDevice.Get(), L"./ltc_mat.dds", true, &_pLTCMatTexture, &_pLTCMatTextureView);
-		_pContext->PSSetShaderResources(0, 1, _pLTCMatTextureView.GetAddressOf());
-
-		hr = DirectX::CreateDDSTextureFromFile(_pDevice.Get(), L"./ltc_amp.dds", true, &_pLTCAmpTexture, &_pLTCAmpTextureView);
-		_pContext->PSSetShaderResources(1, 1, _pLTCAmpTextureView.GetAddressOf());
-
-		hr = DirectX::CreateDDSTextureFromFile(_pDevice.Get(), L"./dataFiltered.dds", true, &_pLTCAmpTexture, &_pLTCAmpTextureView);
-		_pContext->PSSetShaderResources(2, 1, _pLTCAmpTextureView.GetAddressOf());
+		// lights, written by LightStore::Flush when they change
+		bd.ByteWidth = sizeof(LightConstants);
+		sd.pSysMem = &_lights.GetConstants();
+		CHECKED(_pDevice->CreateBuffer(&bd, &sd, &_pLightConstantBuffer), "Light constant buffer fucked up");
+		_pContext->PSSetConstantBuffers(1u, 1u, _pLightConstantBuffer.GetAddressOf());
+
+		_textures = std::make_unique<TextureCache<LoadedTexture>>(
+			[this](const std::string& path, uint32_t flags, size_t maxSize, LoadedTexture& texture, size_t& bytes, size_t& size) {
+				bool complete;
+				if (!LoadTexture(path, flags, maxSize, texture, size, complete))
+					return false;
+				bytes = DirectX::GetTextureMemorySize(texture.texture.Get());
+				return true;
+			}, TEXTURE_BUDGET);
+		BindTexture(0u, "./ltc_mat.dds", TEXTURE_SRGB);
+		BindTexture(1u, "./ltc_amp.dds", TEXTURE_SRGB);
+
+		// the smallest mips are up for the first frame, the rest stream in
+		_textureStreamer = std::make_unique<MipStreamer<LoadedTexture>>(
+			[this](const std::string& path, size_t maxSize, LoadedTexture& texture, bool& complete) {
+				size_t size;
+				return LoadTexture(path, TEXTURE_SRGB, maxSize, texture, size, complete);
+			});
+		if (_textureStreamer->Load("./dataFiltered.dds", _filteredTexture))
+			_pContext->PSSetShaderResources(2, 1, _filteredTexture.view.GetAddressOf());
 
 
 		D3D11_SAMPLER_DESC samplerDesc = {};
@@ -538,10 +773,13 @@ void Graphics::BindShaders(ComPtr<ID3DBlob>& blobBuffer) {
 
 	// vertex shader
 	{
-		ComPtr<ID3D11VertexShader> pVertexShader;
 		CHECKED(D3DReadFileToBlob(L"VertexShader.cso", &blobBuffer), "Reading VSHader fucked up");
-		CHECKED(_pDevice->CreateVertexShader(blobBuffer->GetBufferPointer(), blobBuffer->GetBufferSize(), nullptr, &pVertexShader), "VShader creation fucked up");
-		_pContext->VSSetShader(pVertexShader.Get(), nullptr, 0u);
+		CHECKED(_pDevice->CreateVertexShader(blobBuffer->GetBufferPointer(), blobBuffer->GetBufferSize(), nullptr, &_pVertexShader), "VShader creation fucked up");
+		_pContext->VSSetShader(_pVertexShader.Get(), nullptr, 0u);
+
+		// retained meshes in PackedVertex, the device switches to it per draw
+		CHECKED(D3DReadFileToBlob(L"VertexShaderPacked.cso", &packedBlobBuffer), "Reading packed VSHader fucked up");
+		CHECKED(_pDevice->CreateVertexShader(packedBlobBuffer->GetBufferPointer(), packedBlobBuffer->GetBufferSize(), nullptr, &_pPackedVertexShader), "Packed VShader creation fucked up");
 
 		D3D11_BUFFER_DESC bd = {};
 		bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
@@ -559,9 +797,18 @@ void Graphics::BindShaders(ComPtr<ID3DBlob>& blobBuffer) {
 	}
 }
 
-void Graphics::CreateLayoutAndTopology(ComPtr<ID3DBlob> blobBuffer) {
+// The pixel shader without the loops of the light types mix has none of,
+// all of them created up front by BindShaders (the generic one if missing).
+void Graphics::BindPixelShader(uint32_t mix) {
+	if (mix == _pixelShaderMix)
+		return;
+
+	_pContext->PSSetShader(_pixelShaders[mix].Get(), nullptr, 0u);
+	_pixelShaderMix = mix;
+}
+
+void Graphics::CreateLayoutAndTopology(ComPtr<ID3DBlob> blobBuffer, ComPtr<ID3DBlob> packedBlobBuffer) {
 	// input (vertex) layout (2d position only)
-	ComPtr<ID3D11InputLayout> pInputLayout;
 	const D3D11_INPUT_ELEMENT_DESC ied[] =
 	{
 		{ "Position",0,DXGI_FORMAT_R32G32B32_FLOAT,0,0,D3D11_INPUT_PER_VERTEX_DATA,0 },
@@ -575,11 +822,27 @@ void Graphics::CreateLayoutAndTopology(ComPtr<ID3DBlob> blobBuffer) {
 		ied, (UINT)(sizeof(ied) / sizeof(ied[0])),
 		blobBuffer->GetBufferPointer(),
 		blobBuffer->GetBufferSize(),
-		&pInputLayout
+		&_pInputLayout
 	), "Create Input Layout fucked up");
 
+	// PackedVertex: the input assembler expands the normal, uv and color
+	const D3D11_INPUT_ELEMENT_DESC packedIed[] =
+	{
+		{ "Position",0,DXGI_FORMAT_R32G32B32_FLOAT,0,0,D3D11_INPUT_PER_VERTEX_DATA,0 },
+		{ "Normal",0,DXGI_FORMAT_R16G16_SNORM,0,12u,D3D11_INPUT_PER_VERTEX_DATA,0 },
+		{ "Texture",0,DXGI_FORMAT_R16G16_FLOAT,0,16u,D3D11_INPUT_PER_VERTEX_DATA,0 },
+		{ "Color",0,DXGI_FORMAT_R8G8B8A8_UNORM,0,20u,D3D11_INPUT_PER_VERTEX_DATA,0 }
+	};
+
+	CHECKED(_pDevice->CreateInputLayout(
+		packedIed, (UINT)(sizeof(packedIed) / sizeof(packedIed[0])),
+		packedBlobBuffer->GetBufferPointer(),
+		packedBlobBuffer->GetBufferSize(),
+		&_pPackedInputLayout
+	), "Create packed Input Layout fucked up");
+
 	// bind vertex layout
-	_pContext->IASetInputLayout(pInputLayout.Get());
+	_pContext->IASetInputLayout(_pInputLayout.Get());
 	// Set primitive topology to triangle list (groups of 3 vertices)
 	_pContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 }
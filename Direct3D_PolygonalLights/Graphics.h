@@ -10,9 +10,28 @@
 #include <Windows.h>
 #include <vector>
 #include "DDSTextureLoader.h"
+#include "Lights.h"
+#include "LightStore.h"
+#include "Vertex.h"
+#include "VertexPacking.h"
+#include "Geometry.h"
+#include "D3D11RenderDevice.h"
+#include "ClusterGrid.h"
+#include "Bvh.h"
+#include "FrameGraph.h"
+#include "ObjectLights.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include "MeshCache.h"
+#include "MeshImport.h"
+#include "InstanceBuffer.h"
+#include "MipStreamer.h"
+#include "TextureCache.h"
+#include <memory>
 #include <fstream>
 #include <limits>
 #include <cmath>
+#include <algorithm>
 
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "D3DCompiler.lib")
@@ -20,70 +39,59 @@
 #define CHECKED(expr, message) if(FAILED(expr)) throw graphicsException(message);
 
 
-#define LIGHT_BUFFER_SIZE 10
-#define MAX_OBJECTS 100
+#define TEXTURE_BUDGET (256u << 20)
+#define TEXTURE_SLOTS 8
+
+// texture cache load flags
+#define TEXTURE_SRGB 0x1
 
 namespace dx = DirectX;
 using Microsoft::WRL::ComPtr;
 using std::exception;
 using std::vector;
 
-
-struct Vertex {
-	float x;
-	float y;
-	float z;
-
-	float r;
-	float g;
-	float b;
-
-	float u;
-	float v;
-
-	float nx;
-	float ny;
-	float nz;
-
-	unsigned int index;
-};
-
-struct PointLight {
-	dx::XMFLOAT4 Position;
-	dx::XMFLOAT4 Color;
-};
-
-struct DirLight {
-	dx::XMFLOAT4 Direction;
-	dx::XMFLOAT4 Color;
+// GPU buffer writes of one Draw: constant and structured buffers, lights,
+// and whatever the mesh and texture device wrote
+struct UploadStats {
+	size_t bytes = 0;
+	size_t writes = 0;
+	size_t lightBytes = 0; // part of bytes, see LightStore::Flush
 };
 
-struct SpotLight {
-	dx::XMFLOAT4 Position;
-	dx::XMFLOAT4 Direction;
-	dx::XMFLOAT4 Color;
-	dx::XMFLOAT4 Cone;
-};
-
-struct RectLight {
-	dx::XMFLOAT4 Position;
-	dx::XMFLOAT4 Params; // Width, Height, RotY, RotZ
-	dx::XMFLOAT4 Color;
-};
 
 class Graphics {
 public:
 	Graphics(HWND hWnd, FLOAT width, FLOAT height);
 	void Clear(const FLOAT colorRGBA[4]);
 	void SwapBuffers();
-	void DrawTriangles(vector<Vertex>& vBuffer, vector<unsigned short>& iBuffer, dx::XMFLOAT3 cameraPos, dx::XMFLOAT3 cameraRotation);
-	void FillTriangle(vector<Vertex>& vBuffer, vector<unsigned short>& iBuffer);
-	void FillCubeShared(vector<Vertex>& vBuffer, vector<unsigned short>& iBuffer);
-	void FillCube(vector<Vertex>& vBuffer, vector<unsigned short>& iBuffer, dx::XMMATRIX transform);
-	void FillFloor(vector<Vertex>& vBuffer, vector<unsigned short>& iBuffer, dx::XMMATRIX transform);
-	void FillQuadLight(vector<Vertex>& vBuffer, vector<unsigned short>& iBuffer, RectLight light);
-	void AddPointLight(dx::XMFLOAT3 position, dx::XMFLOAT3 color, float intensity = 1.0f);
-	void AddSpotLight(dx::XMFLOAT3 position, dx::XMFLOAT3 color, dx::XMFLOAT3 direction, float intensity = 10.0f, float innerCone = 0.7f, float outerCone = .75f);
+	// Off, SwapBuffers presents at once, for replays that run as fast as they can
+	void SetVSync(bool enabled) { _vsync = enabled; }
+	// false draws every frame with the generic pixel shader, LIGHT_MIX_ALL
+	void SetLightPermutations(bool enabled) { _lightPermutations = enabled; }
+	// Far rect lights shaded from their disk, zeros for exact; see RectLightLod
+	void SetRectLightLod(const RectLightLod& lod) { _psConstantBuffer.rectLod = { lod.diffuseSolidAngle, lod.specularSolidAngle, 0, 0 }; }
+	void DrawTriangles(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, dx::XMFLOAT3 cameraPos, dx::XMFLOAT3 cameraRotation);
+	MeshHandle RegisterMesh(const vector<Vertex>& vBuffer, const vector<unsigned int>& iBuffer);
+	MeshHandle RegisterMesh(const vector<PackedVertex>& vBuffer, const vector<unsigned int>& iBuffer);
+	MeshHandle RegisterMesh(const ImportedMesh& mesh);
+	void ReleaseMesh(MeshHandle mesh);
+	void DrawMesh(MeshHandle mesh, dx::XMMATRIX transform);
+	void DrawMeshInstanced(MeshHandle mesh, const dx::XMMATRIX* transforms, size_t count);
+	void Draw(dx::XMFLOAT3 cameraPos, dx::XMFLOAT3 cameraRotation);
+	// Frustum culling of the caller's objects by world-space box, in the order
+	// given: SetCullBounds builds the BVH, UpdateCullBounds refits it to moved
+	// boxes, CullObjects returns the indices the camera of Draw can see.
+	void SetCullBounds(const Aabb* bounds, size_t count);
+	void UpdateCullBounds(const Aabb* bounds);
+	const vector<uint32_t>& CullObjects(dx::XMFLOAT3 cameraPos, dx::XMFLOAT3 cameraRotation);
+	void FillTriangle(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer);
+	void FillCubeShared(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer);
+	void FillCube(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, dx::XMMATRIX transform);
+	void FillFloor(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, dx::XMMATRIX transform);
+	void FillQuadLight(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, RectLight light);
+	// radius > 0 windows the falloff down to zero there, see DistanceWindow
+	void AddPointLight(dx::XMFLOAT3 position, dx::XMFLOAT3 color, float intensity = 1.0f, float radius = 0.0f);
+	void AddSpotLight(dx::XMFLOAT3 position, dx::XMFLOAT3 color, dx::XMFLOAT3 direction, float intensity = 10.0f, float innerCone = 0.7f, float outerCone = .75f, float radius = 0.0f);
 	void AddDirLight(dx::XMFLOAT3 color, dx::XMFLOAT3 direction, float intensity = 1.0f);
 	void AddRectLight(dx::XMFLOAT3 position, dx::XMFLOAT3 color, float intensity = 1.0f, float width = 1.0f, float height = 1.0f, float rotationX = .0f, float rotationY = .0f);
 
@@ -91,23 +99,80 @@ public:
 	SpotLight* GetSpotLight(int index);
 	DirLight* GetDirLight(int index);
 	RectLight* GetRectLight(int index);
+	// Without marking anything for upload, unlike GetRectLight
+	const vector<RectLight>& GetRectLights() const { return _lights.GetRectLights(); }
+
+	// Convex, planar polygon lights of 3 to POLYGON_LIGHT_MAX_VERTICES vertices,
+	// false outside that. They are not clustered: every pixel loops over them
+	// and skips those whose Bounds it is outside of.
+	bool AddPolygonLight(const dx::XMFLOAT3* vertices, int count, dx::XMFLOAT3 color, float intensity = 1.0f);
+	PolygonLight* GetPolygonLight(int index);
+	// vertices holds as many as the light was added with
+	bool MovePolygonLight(int index, const dx::XMFLOAT3* vertices);
+
+	// Two-sided disks and spheres, not clustered either: every pixel skips
+	// those whose Range it is outside of.
+	void AddDiskLight(dx::XMFLOAT3 position, dx::XMFLOAT3 normal, float radius, dx::XMFLOAT3 color, float intensity = 1.0f);
+	void AddSphereLight(dx::XMFLOAT3 position, float radius, dx::XMFLOAT3 color, float intensity = 1.0f);
+	DiskLight* GetDiskLight(int index);
+	SphereLight* GetSphereLight(int index);
+
+	// Binds a pixel shader texture through the cache; false when it does not load
+	bool BindTexture(UINT slot, const std::string& path, uint32_t flags = 0);
+	void SetTextureBudget(size_t bytes) { _textures->SetBudget(bytes); }
+
+	const DeviceStats& GetDeviceStats() const { return _device->GetStats(); }
+	const TextureCacheStats& GetTextureCacheStats() const { return _textures->GetStats(); }
+
+	// What the last Draw wrote to GPU buffers
+	const UploadStats& GetUploadStats() const { return _uploads; }
+
+	// Per-job timings of the last Draw's frame graph
+	const vector<JobTiming>& GetFrameTimings() const { return _frameGraph.GetTimings(); }
+	double GetFrameCpuTime() const { return _frameGraph.GetRunTime(); }
+	// For the caller's own jobs between frames; Draw runs its graph on it too.
+	ThreadPool& GetThreadPool() { return _pool; }
 
 private:
+	// object transforms live in a structured buffer (t0), see InstanceBuffer
 	struct VSConstantBuffer {
-		dx::XMMATRIX modelToWorld[MAX_OBJECTS];
 		dx::XMMATRIX worldToView;
 		dx::XMMATRIX projection;
-		dx::XMMATRIX normalTransform[MAX_OBJECTS];
 		unsigned int objects;
 	};
 
+	// per frame; the lights have their own buffer (b1), see LightStore
 	struct PSConstantBuffer {
 		dx::XMFLOAT4 viewPos = { 0, 0, 0, 1 };
-		dx::XMINT4 lightCounts = { 0, 0, 0, 0 }; // point, spot, dir, rect
-		PointLight pointLights[LIGHT_BUFFER_SIZE] = {};
-		SpotLight spotLights[LIGHT_BUFFER_SIZE] = {};
-		DirLight dirLights[LIGHT_BUFFER_SIZE] = {};
-		RectLight rectLights[LIGHT_BUFFER_SIZE] = {};
+		dx::XMFLOAT4 viewForward = { 0, 0, 1, 0 };
+		dx::XMINT4 clusterGrid = { 0, 0, 0, 0 }; // tiles x, tiles y, slices, tile size
+		dx::XMFLOAT4 clusterDepth = { 0, 0, 0, 0 }; // slice scale, slice bias
+		dx::XMUINT4 rectProxies = { 0, 0, 0, 0 }; // rect light proxies, objects
+		dx::XMFLOAT4 rectLod = { 0, 0, 0, 0 }; // diffuse and specular solid angle
+	};
+
+	// Dynamic structured buffer bound to a pixel shader slot, grown on demand
+	struct StructuredBuffer {
+		ComPtr<ID3D11Buffer> buffer;
+		ComPtr<ID3D11ShaderResourceView> view;
+		size_t capacity = 0;
+	};
+
+	// What the frame graph's jobs share within one Draw
+	struct FrameState {
+		dx::XMMATRIX worldToView;
+		dx::XMMATRIX projection;
+		dx::XMVECTOR cameraDir;
+		dx::XMFLOAT3 cameraPos;
+		dx::XMFLOAT3 cameraRotation;
+		unsigned int firstProxy;
+	};
+
+	// A DDS as created by DDSTextureLoader, owned by the texture cache or the
+	// streamer; streamed steps are created on the streamer's I/O thread
+	struct LoadedTexture {
+		ComPtr<ID3D11Resource> texture;
+		ComPtr<ID3D11ShaderResourceView> view;
 	};
 
 	ComPtr<ID3D11Device> _pDevice;
@@ -116,25 +181,76 @@ private:
 	ComPtr<ID3D11RenderTargetView> _pRTView;
 	ComPtr<ID3D11Buffer> _pVSConstantBuffer;
 	ComPtr<ID3D11Buffer> _pPSConstantBuffer;
-	ComPtr<ID3D11Resource> _pLTCMatTexture;
-	ComPtr<ID3D11ShaderResourceView> _pLTCMatTextureView;
-	ComPtr<ID3D11Resource> _pLTCAmpTexture;
-	ComPtr<ID3D11ShaderResourceView> _pLTCAmpTextureView;
+	ComPtr<ID3D11Buffer> _pLightConstantBuffer;
 	ComPtr<ID3D11SamplerState> _pSampler;
 	ComPtr<ID3D11DepthStencilView> _pDepthStencilView;
+	ComPtr<ID3D11VertexShader> _pVertexShader;
+	ComPtr<ID3D11PixelShader> _pixelShaders[LIGHT_MIX_ALL + 1]; // per LightMix, all created with the device, the generic one where a variant is missing
+	uint32_t _pixelShaderMix = LIGHT_MIX_ALL;
+	bool _lightPermutations = true;
+	ComPtr<ID3D11VertexShader> _pPackedVertexShader;
+	ComPtr<ID3D11InputLayout> _pInputLayout;
+	ComPtr<ID3D11InputLayout> _pPackedInputLayout;
+	std::unique_ptr<D3D11RenderDevice> _device;
+	std::unique_ptr<MeshCache> _meshes;
+	std::unique_ptr<TextureCache<LoadedTexture>> _textures;
+	ID3D11ShaderResourceView* _boundTextures[TEXTURE_SLOTS] = {};
+	std::unique_ptr<MipStreamer<LoadedTexture>> _textureStreamer;
+	LoadedTexture _filteredTexture;
+	MeshHandle _quadLightMesh;
 	
+	LightStore _lights;
+	ThreadPool _pool;
+	bool _vsync = true;
+	ClusterGrid _clusterGrid;
+	StructuredBuffer _pointLightBuffer;
+	StructuredBuffer _spotLightBuffer;
+	StructuredBuffer _rectLightBuffer;
+	StructuredBuffer _polygonLightBuffer;
+	StructuredBuffer _polygonVertexBuffer;
+	StructuredBuffer _diskLightBuffer;
+	StructuredBuffer _sphereLightBuffer;
+	StructuredBuffer _clusterBuffer;
+	StructuredBuffer _clusterLightBuffer;
+	ObjectLightLists _objectLights;
+	vector<Float4> _objectSpheres; // per object of _instances
+	StructuredBuffer _objectLightBuffer;
+	StructuredBuffer _objectLightIndexBuffer;
+
 	PSConstantBuffer _psConstantBuffer;
 	VSConstantBuffer _vsConstantBuffer;
+	vector<unsigned char> _psUploaded; // as last written, to skip unchanged frames
+	vector<unsigned char> _vsUploaded;
+	UploadStats _uploads;
 	FLOAT _width;
 	FLOAT _height;
-	size_t _objectIndex;
+	InstanceBuffer _instances;
+	StructuredBuffer _instanceBuffer;
+	vector<Float4x4> _instanceStaging;
+	Bvh _objectBvh;
+	Bvh _proxyBvh;
+	vector<Aabb> _proxyBounds;
+	vector<uint32_t> _visibleObjects;
+	vector<uint32_t> _visibleProxies;
+	FrameState _frame = {};
+	FrameGraph _frameGraph;
 
 
 	void CreateDeviceAndSwapChain(HWND hWnd);
 	void CreateRenderTargetView();
-	void BindShaders(ComPtr<ID3DBlob>& blobBuffer);
-	void CreateLayoutAndTopology(ComPtr<ID3DBlob> blobBuffer);
+	void BindShaders(ComPtr<ID3DBlob>& blobBuffer, ComPtr<ID3DBlob>& packedBlobBuffer);
+	void BindPixelShader(uint32_t mix);
+	bool LoadTexture(const std::string& path, uint32_t flags, size_t maxSize, LoadedTexture& texture, size_t& size, bool& complete);
+	void CreateLayoutAndTopology(ComPtr<ID3DBlob> blobBuffer, ComPtr<ID3DBlob> packedBlobBuffer);
 	void SetViewPort();
+	void GetCamera(dx::XMFLOAT3 cameraPos, dx::XMFLOAT3 cameraRotation, dx::XMMATRIX& worldToView, dx::XMMATRIX& projection, dx::XMVECTOR& cameraDir) const;
+	void SetObjectTransform(dx::XMMATRIX transform);
+	void BuildFrameGraph();
+	void UploadLights();
+	void UploadStructured(StructuredBuffer& target, const void* data, size_t count, size_t stride, UINT slot, bool vertexShader = false);
+	void CreateStructured(StructuredBuffer& target, size_t capacity, size_t stride, UINT slot, bool vertexShader, bool dynamic);
+	void UploadLight(const LightUpload& upload);
+	void UploadConstants(ID3D11Buffer* buffer, const void* data, size_t bytes, vector<unsigned char>& uploaded);
 
 	class graphicsException : public exception {
 	private:
@@ -0,0 +1,174 @@
+#include "InputLog.h"
+#include <cstdio>
+#include <cstring>
+
+#define INPUT_LOG_MAGIC 0x474f4c49u // "ILOG"
+#define INPUT_LOG_VERSION 1u
+
+struct InputLogHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t frames;
+	uint32_t bytes;
+};
+
+static void WriteVarint(vector<uint8_t>& data, uint32_t value) {
+	while (value >= 0x80) {
+		data.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	data.push_back((uint8_t)value);
+}
+
+#pragma region Recording
+
+void InputLog::Clear() {
+	_data.clear();
+	_frames = 0;
+	memset(_keys, 0, sizeof(_keys));
+	_params.clear();
+}
+
+void InputLog::RecordFrame(const bool keys[KEYBOARD_KEYS], const RectLight* lights, size_t lightCount) {
+	uint8_t toggled[KEYBOARD_KEYS];
+	uint32_t toggleCount = 0;
+	for (int key = 0; key < KEYBOARD_KEYS; key++) {
+		if (keys[key] != _keys[key]) {
+			toggled[toggleCount++] = (uint8_t)key;
+			_keys[key] = keys[key];
+		}
+	}
+	WriteVarint(_data, toggleCount);
+	_data.insert(_data.end(), toggled, toggled + toggleCount);
+
+	// lights added since the last frame are compared against zeros
+	if (_params.size() < lightCount)
+		_params.resize(lightCount, { 0, 0, 0, 0 });
+	size_t countAt = _data.size();
+	uint32_t changed = 0;
+	_data.push_back(0); // patched below, while it fits one byte
+	for (size_t i = 0; i < lightCount; i++) {
+		const float* now = &lights[i].Params.x;
+		float* before = &_params[i].x;
+		uint8_t mask = 0;
+		for (int c = 0; c < 4; c++)
+			if (memcmp(&now[c], &before[c], sizeof(float)) != 0)
+				mask |= 1 << c;
+		if (!mask)
+			continue;
+
+		WriteVarint(_data, (uint32_t)i);
+		_data.push_back(mask);
+		for (int c = 0; c < 4; c++) {
+			if (mask & (1 << c)) {
+				const uint8_t* bytes = (const uint8_t*)&now[c];
+				_data.insert(_data.end(), bytes, bytes + sizeof(float));
+				before[c] = now[c];
+			}
+		}
+		changed++;
+	}
+	if (changed < 0x80)
+		_data[countAt] = (uint8_t)changed;
+	else {
+		vector<uint8_t> count;
+		WriteVarint(count, changed);
+		_data.erase(_data.begin() + countAt);
+		_data.insert(_data.begin() + countAt, count.begin(), count.end());
+	}
+	_frames++;
+}
+
+bool InputLog::Save(const char* path) const {
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return false;
+
+	InputLogHeader header = { INPUT_LOG_MAGIC, INPUT_LOG_VERSION, (uint32_t)_frames, (uint32_t)_data.size() };
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+		&& (_data.empty() || fwrite(_data.data(), _data.size(), 1, file) == 1);
+	return fclose(file) == 0 && ok;
+}
+
+// The recording state is not restored: a loaded log is for replaying.
+bool InputLog::Load(const char* path) {
+	Clear();
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	InputLogHeader header;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1
+		&& header.magic == INPUT_LOG_MAGIC && header.version == INPUT_LOG_VERSION;
+	if (ok) {
+		_data.resize(header.bytes);
+		ok = header.bytes == 0 || fread(_data.data(), header.bytes, 1, file) == 1;
+		_frames = header.frames;
+	}
+	fclose(file);
+	if (!ok)
+		Clear();
+	return ok;
+}
+
+#pragma endregion
+
+#pragma region Replay
+
+bool InputReplay::NextFrame(bool keys[KEYBOARD_KEYS], const std::function<void(int index, Float4 params)>& setParams) {
+	if (_frame >= _log.GetFrameCount())
+		return false;
+
+	uint32_t toggles = ReadVarint();
+	for (uint32_t i = 0; i < toggles; i++) {
+		uint8_t key = ReadByte();
+		_keys[key] = !_keys[key];
+	}
+	memcpy(keys, _keys, sizeof(_keys));
+
+	uint32_t changed = ReadVarint();
+	for (uint32_t i = 0; i < changed; i++) {
+		uint32_t index = ReadVarint();
+		uint8_t mask = ReadByte();
+		if (_params.size() <= index)
+			_params.resize(index + 1, { 0, 0, 0, 0 });
+		float* params = &_params[index].x;
+		for (int c = 0; c < 4; c++) {
+			if (mask & (1 << c)) {
+				uint8_t bytes[sizeof(float)];
+				for (uint8_t& b : bytes)
+					b = ReadByte();
+				memcpy(&params[c], bytes, sizeof(float));
+			}
+		}
+		setParams((int)index, _params[index]);
+	}
+	_frame++;
+	return true;
+}
+
+void InputReplay::Rewind() {
+	_offset = 0;
+	_frame = 0;
+	memset(_keys, 0, sizeof(_keys));
+	_params.clear();
+}
+
+uint8_t InputReplay::ReadByte() {
+	if (_offset >= _log.GetData().size())
+		throw inputLogException("Input log ends inside a frame");
+	return _log.GetData()[_offset++];
+}
+
+uint32_t InputReplay::ReadVarint() {
+	uint32_t value = 0;
+	for (int shift = 0; shift < 35; shift += 7) {
+		uint8_t b = ReadByte();
+		value |= (uint32_t)(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return value;
+	}
+	throw inputLogException("Input log varint too long");
+}
+
+#pragma endregion
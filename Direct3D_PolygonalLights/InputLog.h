@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Camera.h"
+#include "Lights.h"
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <vector>
+
+using std::exception;
+using std::vector;
+
+// A session's input, frame by frame: the Keyboard state Camera::Update read
+// and the Params of every rect light after the frame's update. Both are
+// delta coded against the frame before, so a frame in which nothing changed
+// is two bytes:
+//   varint n, n key codes that toggled
+//   varint m, m times: varint light index, component mask, changed floats
+// Floats are stored bit for bit, so a replay reproduces the session exactly.
+class InputLog {
+public:
+	void Clear();
+	void RecordFrame(const bool keys[KEYBOARD_KEYS], const RectLight* lights, size_t lightCount);
+	bool Save(const char* path) const;
+	// False for other files and other versions
+	bool Load(const char* path);
+
+	size_t GetFrameCount() const { return _frames; }
+	size_t GetByteCount() const { return _data.size(); }
+	const vector<uint8_t>& GetData() const { return _data; }
+
+private:
+	vector<uint8_t> _data;
+	size_t _frames = 0;
+	bool _keys[KEYBOARD_KEYS] = {};
+	vector<Float4> _params;
+};
+
+// Plays an InputLog from its first frame, as fast as it is called
+class InputReplay {
+public:
+	InputReplay(const InputLog& log) : _log(log) {}
+
+	// Sets keys to the next frame's Keyboard state and calls setParams for
+	// every rect light whose Params changed in it. False after the last frame.
+	bool NextFrame(bool keys[KEYBOARD_KEYS], const std::function<void(int index, Float4 params)>& setParams);
+	void Rewind();
+	size_t GetFrame() const { return _frame; }
+
+private:
+	const InputLog& _log;
+	size_t _offset = 0;
+	size_t _frame = 0;
+	bool _keys[KEYBOARD_KEYS] = {};
+	vector<Float4> _params;
+
+	uint32_t ReadVarint();
+	uint8_t ReadByte();
+
+	class inputLogException : public exception {
+	private:
+		const char* _message;
+	public:
+		inputLogException(const char* message) : _message(message) {}
+		const char* what() const throw () { return _message; }
+	};
+};
@@ -0,0 +1,28 @@
+#include "InstanceBuffer.h"
+#include <algorithm>
+
+// objects per ParallelFor item, and the smallest batch worth spreading
+#define INSTANCE_BLOCK 256
+
+static void ConvertTransforms(const Float4x4* transforms, ObjectTransform* out, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		out[i].modelToWorld = Transpose(transforms[i]);
+		out[i].normalTransform = Inverse(transforms[i]);
+	}
+}
+
+unsigned int InstanceBuffer::Append(const Float4x4* transforms, size_t count, ThreadPool* pool) {
+	size_t first = _objects.size();
+	_objects.resize(first + count);
+	ObjectTransform* out = &_objects[first];
+
+	if (!pool || count < 2 * INSTANCE_BLOCK)
+		ConvertTransforms(transforms, out, count);
+	else {
+		pool->ParallelFor((count + INSTANCE_BLOCK - 1) / INSTANCE_BLOCK, [&](size_t block) {
+			size_t begin = block * INSTANCE_BLOCK;
+			ConvertTransforms(transforms + begin, out + begin, std::min(count - begin, (size_t)INSTANCE_BLOCK));
+		});
+	}
+	return (unsigned int)first;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "CpuMath.h"
+#include "ThreadPool.h"
+#include <vector>
+
+using std::vector;
+
+// One element of the vertex shader's object structured buffer (t0), laid out
+// for HLSL's column-major matrices: modelToWorld is stored transposed and
+// normalTransform as the plain inverse, so the shader reads the inverse
+// transpose it multiplies normals with.
+struct ObjectTransform {
+	Float4x4 modelToWorld;
+	Float4x4 normalTransform;
+};
+
+// Per-frame object transforms. Single draws and instanced draws both append
+// here; the vertex shader finds an object as vertex index + draw base +
+// SV_InstanceID, so a mesh drawn N times is one draw over N elements.
+class InstanceBuffer {
+public:
+	// Appends count row-vector transforms and returns the index of the first.
+	// Large batches are converted in parallel when a pool is given.
+	unsigned int Append(const Float4x4* transforms, size_t count, ThreadPool* pool = nullptr);
+	void Clear() { _objects.clear(); }
+
+	size_t GetCount() const { return _objects.size(); }
+	const ObjectTransform* GetData() const { return _objects.data(); }
+	size_t GetBytes() const { return _objects.size() * sizeof(ObjectTransform); }
+
+private:
+	vector<ObjectTransform> _objects;
+};
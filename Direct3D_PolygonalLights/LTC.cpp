@@ -0,0 +1,1065 @@
+#include "LTC.h"
+#include "DDSFile.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#pragma region ShadingPoints
+
+void ShadingPoints::Resize(size_t count) {
+	for (vector<float>* v : { &px, &py, &pz, &nx, &ny, &nz, &vx, &vy, &vz, &r, &g, &b, &outR, &outG, &outB })
+		v->resize(count, 0.0f);
+}
+
+void ShadingPoints::Set(size_t i, Float3 position, Float3 normal, Float3 viewDir, Float3 color) {
+	px[i] = position.x; py[i] = position.y; pz[i] = position.z;
+	nx[i] = normal.x; ny[i] = normal.y; nz[i] = normal.z;
+	vx[i] = viewDir.x; vy[i] = viewDir.y; vz[i] = viewDir.z;
+	r[i] = color.x; g[i] = color.y; b[i] = color.z;
+}
+
+void ShadingPoints::ClearResults() {
+	std::fill(outR.begin(), outR.end(), 0.0f);
+	std::fill(outG.begin(), outG.end(), 0.0f);
+	std::fill(outB.begin(), outB.end(), 0.0f);
+}
+
+#pragma endregion
+
+#pragma region ShaderPort
+
+// Straight ports of the helpers in PixelShader.hlsl. Keep them in sync.
+
+static Float3 rotation_y(Float3 v, float a) {
+	Float3 r;
+	r.x = v.x * std::cos(a) + v.z * std::sin(a);
+	r.y = v.y;
+	r.z = -v.x * std::sin(a) + v.z * std::cos(a);
+	return r;
+}
+
+static Float3 rotation_z(Float3 v, float a) {
+	Float3 r;
+	r.x = v.x * std::cos(a) - v.y * std::sin(a);
+	r.y = v.x * std::sin(a) + v.y * std::cos(a);
+	r.z = v.z;
+	return r;
+}
+
+static Float3 rotation_yz(Float3 v, float ay, float az) {
+	return rotation_z(rotation_y(v, ay), az);
+}
+
+// HLSL mul(v, M) for a row vector
+static Float3 Mul(Float3 v, const float m[3][3]) {
+	return {
+		v.x * m[0][0] + v.y * m[1][0] + v.z * m[2][0],
+		v.x * m[0][1] + v.y * m[1][1] + v.z * m[2][1],
+		v.x * m[0][2] + v.y * m[1][2] + v.z * m[2][2]
+	};
+}
+
+static float IntegrateEdge(Float3 v1, Float3 v2) {
+	float cosTheta = Dot(v1, v2);
+	float theta = std::acos(cosTheta);
+	float res = Cross(v1, v2).z * ((theta > 0.001f) ? theta / std::sin(theta) : 1.0f);
+
+	return res;
+}
+
+static void ClipQuadToHorizon(Float3 L[5], int& n) {
+	// detect clipping config
+	int config = 0;
+	if (L[0].z > 0.0f) config += 1;
+	if (L[1].z > 0.0f) config += 2;
+	if (L[2].z > 0.0f) config += 4;
+	if (L[3].z > 0.0f) config += 8;
+
+	// clip
+	n = 0;
+
+	if (config == 0)
+	{
+		// clip all
+	}
+	else if (config == 1) // V1 clip V2 V3 V4
+	{
+		n = 3;
+		L[1] = -L[1].z * L[0] + L[0].z * L[1];
+		L[2] = -L[3].z * L[0] + L[0].z * L[3];
+	}
+	else if (config == 2) // V2 clip V1 V3 V4
+	{
+		n = 3;
+		L[0] = -L[0].z * L[1] + L[1].z * L[0];
+		L[2] = -L[2].z * L[1] + L[1].z * L[2];
+	}
+	else if (config == 3) // V1 V2 clip V3 V4
+	{
+		n = 4;
+		L[2] = -L[2].z * L[1] + L[1].z * L[2];
+		L[3] = -L[3].z * L[0] + L[0].z * L[3];
+	}
+	else if (config == 4) // V3 clip V1 V2 V4
+	{
+		n = 3;
+		L[0] = -L[3].z * L[2] + L[2].z * L[3];
+		L[1] = -L[1].z * L[2] + L[2].z * L[1];
+	}
+	else if (config == 5) // V1 V3 clip V2 V4) impossible
+	{
+		n = 0;
+	}
+	else if (config == 6) // V2 V3 clip V1 V4
+	{
+		n = 4;
+		L[0] = -L[0].z * L[1] + L[1].z * L[0];
+		L[3] = -L[3].z * L[2] + L[2].z * L[3];
+	}
+	else if (config == 7) // V1 V2 V3 clip V4
+	{
+		n = 5;
+		L[4] = -L[3].z * L[0] + L[0].z * L[3];
+		L[3] = -L[3].z * L[2] + L[2].z * L[3];
+	}
+	else if (config == 8) // V4 clip V1 V2 V3
+	{
+		n = 3;
+		L[0] = -L[0].z * L[3] + L[3].z * L[0];
+		L[1] = -L[2].z * L[3] + L[3].z * L[2];
+		L[2] = L[3];
+	}
+	else if (config == 9) // V1 V4 clip V2 V3
+	{
+		n = 4;
+		L[1] = -L[1].z * L[0] + L[0].z * L[1];
+		L[2] = -L[2].z * L[3] + L[3].z * L[2];
+	}
+	else if (config == 10) // V2 V4 clip V1 V3) impossible
+	{
+		n = 0;
+	}
+	else if (config == 11) // V1 V2 V4 clip V3
+	{
+		n = 5;
+		L[4] = L[3];
+		L[3] = -L[2].z * L[3] + L[3].z * L[2];
+		L[2] = -L[2].z * L[1] + L[1].z * L[2];
+	}
+	else if (config == 12) // V3 V4 clip V1 V2
+	{
+		n = 4;
+		L[1] = -L[1].z * L[2] + L[2].z * L[1];
+		L[0] = -L[0].z * L[3] + L[3].z * L[0];
+	}
+	else if (config == 13) // V1 V3 V4 clip V2
+	{
+		n = 5;
+		L[4] = L[3];
+		L[3] = L[2];
+		L[2] = -L[1].z * L[2] + L[2].z * L[1];
+		L[1] = -L[1].z * L[0] + L[0].z * L[1];
+	}
+	else if (config == 14) // V2 V3 V4 clip V1
+	{
+		n = 5;
+		L[4] = -L[0].z * L[3] + L[3].z * L[0];
+		L[0] = -L[0].z * L[1] + L[1].z * L[0];
+	}
+	else if (config == 15) // V1 V2 V3 V4
+	{
+		n = 4;
+	}
+
+	if (n == 3)
+		L[3] = L[0];
+	if (n == 4)
+		L[4] = L[0];
+}
+
+// Sutherland-Hodgman against the horizon plane z = 0 for any convex polygon:
+// every vertex above it is kept, and every edge that crosses it adds the
+// crossing point, scaled like the ones ClipQuadToHorizon makes. Returns the
+// vertex count of out, at most count + 1; 0 or 3 and up.
+static int ClipPolygonToHorizon(const Float3* L, int count, Float3* out) {
+	int n = 0;
+	for (int i = 0; i < count; i++) {
+		const Float3& a = L[i];
+		const Float3& b = L[(i + 1) % count];
+		bool aUp = a.z > 0.0f;
+		if (aUp)
+			out[n++] = a;
+		if (aUp != (b.z > 0.0f))
+			out[n++] = std::fabs(a.z) * b + std::fabs(b.z) * a;
+	}
+	return n >= 3 ? n : 0;
+}
+
+// Blinn's cubic solver, as in Heitz and Hill's disk light code: the roots of
+// c.x + c.y t + c.z t^2 + c.w t^3, the smallest one in y.
+static Float3 SolveCubic(Float4 c) {
+	c.x /= c.w;
+	c.y /= c.w;
+	c.z /= c.w;
+	c.y /= 3.0f;
+	c.z /= 3.0f;
+
+	float A = c.w;
+	float B = c.z;
+	float C = c.y;
+	float D = c.x;
+
+	// Hessian and discriminant
+	Float3 delta = { -c.z * c.z + c.y, -c.y * c.z + c.x, c.z * c.x - c.y * c.y };
+	// double roots, as for a circle straight ahead, can round below zero
+	float discriminant = std::max(4.0f * delta.x * delta.z - delta.y * delta.y, 0.0f);
+
+	// largest root
+	float xlNum, xlDen;
+	{
+		float Ca = delta.x;
+		float Da = -2.0f * B * delta.x + delta.y;
+		float theta = std::atan2(std::sqrt(discriminant), -Da) / 3.0f;
+		float scale = 2.0f * std::sqrt(std::max(-Ca, 0.0f));
+		float cosTheta = std::cos(theta);
+		float sinTheta = std::sin(theta);
+		float x1 = scale * cosTheta;
+		float x3 = scale * (-0.5f * cosTheta - 0.8660254f * sinTheta); // cos(theta + 2 pi / 3)
+		float xl = (x1 + x3 > 2.0f * B) ? x1 : x3;
+		xlNum = xl - B;
+		xlDen = A;
+	}
+
+	// smallest root
+	float xsNum, xsDen;
+	{
+		float Cd = delta.z;
+		float Dd = -D * delta.y + 2.0f * C * delta.z;
+		float theta = std::atan2(D * std::sqrt(discriminant), -Dd) / 3.0f;
+		float scale = 2.0f * std::sqrt(std::max(-Cd, 0.0f));
+		float cosTheta = std::cos(theta);
+		float sinTheta = std::sin(theta);
+		float x1 = scale * cosTheta;
+		float x3 = scale * (-0.5f * cosTheta - 0.8660254f * sinTheta); // cos(theta + 2 pi / 3)
+		float xs = (x1 + x3 < 2.0f * C) ? x1 : x3;
+		xsNum = -D;
+		xsDen = xs + C;
+	}
+
+	// middle root from the other two
+	float E = xlDen * xsDen;
+	float F = -xlNum * xsDen - xlDen * xsNum;
+	float G = xlNum * xsNum;
+	Float3 root = { xsNum / xsDen, (C * F - B * G) / (-B * F + C * E), xlNum / xlDen };
+
+	if (root.x < root.y && root.x < root.z)
+		std::swap(root.x, root.y);
+	else if (root.z < root.x && root.z < root.y)
+		std::swap(root.y, root.z);
+	return root;
+}
+
+// Cosine-weighted integral over the part of a sphere cap above the horizon,
+// over pi: the cap subtends sin^2 of its half angle = formFactor, and its
+// center is at cosTheta from the normal (Snyder's closed form).
+static float SphereIntegral(float cosTheta, float formFactor) {
+	formFactor = std::min(formFactor, 0.9999f);
+	if (cosTheta * cosTheta > formFactor)
+		return std::max(formFactor * cosTheta, 0.0f);
+
+	float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+	float x = std::sqrt(1.0f / formFactor - 1.0f);
+	float y = std::min(std::max(-x * cosTheta / sinTheta, -1.0f), 1.0f);
+	float sinThetaSqrtY = sinTheta * std::sqrt(1.0f - y * y);
+	float integral = (cosTheta * std::acos(y) - x * sinThetaSqrtY) * formFactor + std::atan(sinThetaSqrtY / x);
+	return std::max(integral / PI, 0.0f);
+}
+
+void RectLightPoints(const RectLight& light, Float3 points[4]) {
+	Float3 lightPos = XYZ(light.Position);
+	float halfWidth = light.Params.x;
+	float halfHeight = light.Params.y;
+	float rotateY = light.Params.z * 2 * PI;
+	float rotateZ = light.Params.w * 2 * PI;
+
+	Float3 dirX = rotation_yz({ 1, 0, 0 }, rotateY, rotateZ);
+	Float3 dirY = rotation_yz({ 0, 1, 0 }, rotateY, rotateZ);
+
+	Float3 ex = halfWidth * dirX;
+	Float3 ey = halfHeight * dirY;
+
+	points[0] = lightPos - ex - ey;
+	points[1] = lightPos + ex - ey;
+	points[2] = lightPos + ex + ey;
+	points[3] = lightPos - ex + ey;
+}
+
+Float3 LTC::LTCEvaluate(Float3 fragPos, Float3 viewDir, Float3 normal, const Float3 points[4], const float Minv[3][3]) const {
+	Float3 T1, T2;
+	T1 = Normalize(viewDir - normal * Dot(viewDir, normal));
+	T2 = Cross(normal, T1);
+
+	// mul(transpose(M), Minv) with M = (T1, T2, normal) as rows
+	const Float3 M[3] = { T1, T2, normal };
+	float MinvT[3][3];
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			MinvT[i][j] =
+				(&M[0].x)[i] * Minv[0][j] +
+				(&M[1].x)[i] * Minv[1][j] +
+				(&M[2].x)[i] * Minv[2][j];
+		}
+	}
+
+	Float3 L[5];
+	L[0] = Mul(points[0] - fragPos, MinvT);
+	L[1] = Mul(points[1] - fragPos, MinvT);
+	L[2] = Mul(points[2] - fragPos, MinvT);
+	L[3] = Mul(points[3] - fragPos, MinvT);
+	L[4] = { 0, 0, 0 };
+
+	int n = 0;
+	ClipQuadToHorizon(L, n);
+
+	if (n == 0)
+		return { 0, 0, 0 };
+
+	// project onto sphere
+	L[0] = Normalize(L[0]);
+	L[1] = Normalize(L[1]);
+	L[2] = Normalize(L[2]);
+	L[3] = Normalize(L[3]);
+	L[4] = Normalize(L[4]);
+
+	float sum = 0;
+	sum += IntegrateEdge(L[0], L[1]);
+	sum += IntegrateEdge(L[1], L[2]);
+	sum += IntegrateEdge(L[2], L[3]);
+	if (n >= 4)
+		sum += IntegrateEdge(L[3], L[4]);
+	if (n == 5)
+		sum += IntegrateEdge(L[4], L[0]);
+
+	sum = std::fabs(sum);
+	return { sum, sum, sum };
+}
+
+Float3 LTC::LTCEvaluatePolygon(Float3 fragPos, Float3 viewDir, Float3 normal, const Float3* points, int count, const float Minv[3][3]) const {
+	Float3 T1, T2;
+	T1 = Normalize(viewDir - normal * Dot(viewDir, normal));
+	T2 = Cross(normal, T1);
+
+	const Float3 M[3] = { T1, T2, normal };
+	float MinvT[3][3];
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			MinvT[i][j] =
+				(&M[0].x)[i] * Minv[0][j] +
+				(&M[1].x)[i] * Minv[1][j] +
+				(&M[2].x)[i] * Minv[2][j];
+		}
+	}
+
+	Float3 L[POLYGON_LIGHT_MAX_VERTICES];
+	for (int i = 0; i < count; i++)
+		L[i] = Mul(points[i] - fragPos, MinvT);
+
+	Float3 clipped[POLYGON_LIGHT_MAX_VERTICES + 1];
+	int n = ClipPolygonToHorizon(L, count, clipped);
+	if (n == 0)
+		return { 0, 0, 0 };
+
+	// project onto sphere
+	for (int i = 0; i < n; i++)
+		clipped[i] = Normalize(clipped[i]);
+
+	float sum = 0;
+	for (int i = 0; i < n; i++)
+		sum += IntegrateEdge(clipped[i], clipped[(i + 1) % n]);
+
+	sum = std::fabs(sum);
+	return { sum, sum, sum };
+}
+
+// The ellipse center + cos(t) axisX + sin(t) axisY under Minv is still an
+// ellipse. It is replaced by the sphere cap with the same vector form factor,
+// whose horizon-clipped integral has a closed form. Same scale as LTCEvaluate.
+Float3 LTC::LTCEvaluateDisk(Float3 fragPos, Float3 viewDir, Float3 normal, Float3 center, Float3 axisX, Float3 axisY, const float Minv[3][3]) const {
+	Float3 T1, T2;
+	T1 = Normalize(viewDir - normal * Dot(viewDir, normal));
+	T2 = Cross(normal, T1);
+
+	const Float3 M[3] = { T1, T2, normal };
+	float MinvT[3][3];
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			MinvT[i][j] =
+				(&M[0].x)[i] * Minv[0][j] +
+				(&M[1].x)[i] * Minv[1][j] +
+				(&M[2].x)[i] * Minv[2][j];
+		}
+	}
+
+	Float3 C = Mul(center - fragPos, MinvT);
+	Float3 V1 = Mul(axisX, MinvT);
+	Float3 V2 = Mul(axisY, MinvT);
+
+	// principal axes of the ellipse
+	float a, b;
+	float d11 = Dot(V1, V1);
+	float d22 = Dot(V2, V2);
+	float d12 = Dot(V1, V2);
+	if (std::fabs(d12) / std::sqrt(d11 * d22) > 0.0001f) {
+		float tr = d11 + d22;
+		float det = std::sqrt(std::max(-d12 * d12 + d11 * d22, 0.0f));
+		float u = 0.5f * std::sqrt(std::max(tr - 2.0f * det, 0.0f));
+		float v = 0.5f * std::sqrt(tr + 2.0f * det);
+		float eMax = (u + v) * (u + v);
+		float eMin = (u - v) * (u - v);
+
+		Float3 V1_, V2_;
+		if (d11 > d22) {
+			V1_ = d12 * V1 + (eMax - d11) * V2;
+			V2_ = d12 * V1 + (eMin - d11) * V2;
+		}
+		else {
+			V1_ = d12 * V2 + (eMax - d22) * V1;
+			V2_ = d12 * V2 + (eMin - d22) * V1;
+		}
+		a = 1.0f / eMax;
+		b = 1.0f / eMin;
+		V1 = Normalize(V1_);
+		V2 = Normalize(V2_);
+	}
+	else {
+		a = 1.0f / d11;
+		b = 1.0f / d22;
+		V1 *= std::sqrt(a);
+		V2 *= std::sqrt(b);
+	}
+
+	Float3 V3 = Cross(V1, V2);
+	if (Dot(C, V3) < 0.0f)
+		V3 = -V3;
+
+	// edge-on through the shading point
+	float L = Dot(V3, C);
+	if (L < 1e-6f)
+		return { 0, 0, 0 };
+	float x0 = Dot(V1, C) / L;
+	float y0 = Dot(V2, C) / L;
+
+	a *= L * L;
+	b *= L * L;
+
+	float c0 = a * b;
+	float c1 = a * b * (1.0f + x0 * x0 + y0 * y0) - a - b;
+	float c2 = 1.0f - a * (1.0f + x0 * x0) - b * (1.0f + y0 * y0);
+	Float3 roots = SolveCubic({ c0, c1, c2, 1.0f });
+	float e1 = roots.x;
+	float e2 = roots.y;
+	float e3 = roots.z;
+
+	Float3 avgDir = Normalize(V1 * (a * x0 / (a - e2)) + V2 * (b * y0 / (b - e2)) + V3);
+
+	float L1 = std::sqrt(-e2 / e3);
+	float L2 = std::sqrt(-e2 / e1);
+	float formFactor = L1 * L2 / std::sqrt((1.0f + L1 * L1) * (1.0f + L2 * L2));
+
+	float sum = 2.0f * PI * SphereIntegral(avgDir.z, formFactor);
+	return { sum, sum, sum };
+}
+
+Float3 LTC::CalcRectLight(const RectLight& light, Float3 normal, Float3 fragPos, Float3 fragColor, Float3 viewDir, float roughness, float ambientStr) const {
+	Float3 lightColor = XYZ(light.Color);
+	float lightIntensity = light.Color.w;
+
+	Float3 points[4];
+	RectLightPoints(light, points);
+
+	const float identity[3][3] = {
+		{ 1, 0, 0 },
+		{ 0, 1, 0 },
+		{ 0, 0, 1 }
+	};
+	Float3 diffuse = LTCEvaluate(fragPos, viewDir, normal, points, identity);
+	diffuse *= 1.5f;
+
+	// MAKE MATRIX SAMPLE
+	float lutScale = (_lutSize - 1.0f) / _lutSize;
+	float lutBias = 0.5f / _lutSize;
+	float theta = std::acos(Dot(normal, viewDir));
+	float u = roughness * lutScale + lutBias;
+	float v = theta / (0.5f * PI) * lutScale + lutBias;
+
+	Float4 t = SampleMat(u, v);
+	const float Minv[3][3] = {
+		{ 1, 0, t.y },
+		{ 0, t.z, 0 },
+		{ t.w, 0, t.x }
+	};
+	Float3 specular = LTCEvaluate(fragPos, viewDir, normal, points, Minv);
+	specular *= SampleAmp(u, v).w * 0.2f;
+
+	Float3 ambient = { ambientStr, ambientStr, ambientStr };
+
+	Float3 col = (specular * lightColor + diffuse * fragColor) * lightColor;
+	col *= lightIntensity;
+	col = col / (2.0f * PI);
+	col += ambient * fragColor * lightColor;
+	return col;
+}
+
+// Same LUT lookup and shading as CalcRectLight, over the light's own vertices
+Float3 LTC::CalcPolygonLight(const PolygonLight& light, const Float4* vertices, Float3 normal, Float3 fragPos, Float3 fragColor, Float3 viewDir, float roughness, float ambientStr) const {
+	Float3 lightColor = XYZ(light.Color);
+	float lightIntensity = light.Color.w;
+
+	int count = std::min((int)light.Vertices[0], POLYGON_LIGHT_MAX_VERTICES);
+	if (count < 3)
+		return { 0, 0, 0 };
+	Float3 points[POLYGON_LIGHT_MAX_VERTICES];
+	for (int i = 0; i < count; i++)
+		points[i] = XYZ(vertices[light.Vertices[1] + i]);
+
+	const float identity[3][3] = {
+		{ 1, 0, 0 },
+		{ 0, 1, 0 },
+		{ 0, 0, 1 }
+	};
+	Float3 diffuse = LTCEvaluatePolygon(fragPos, viewDir, normal, points, count, identity);
+	diffuse *= 1.5f;
+
+	float lutScale = (_lutSize - 1.0f) / _lutSize;
+	float lutBias = 0.5f / _lutSize;
+	float theta = std::acos(Dot(normal, viewDir));
+	float u = roughness * lutScale + lutBias;
+	float v = theta / (0.5f * PI) * lutScale + lutBias;
+
+	Float4 t = SampleMat(u, v);
+	const float Minv[3][3] = {
+		{ 1, 0, t.y },
+		{ 0, t.z, 0 },
+		{ t.w, 0, t.x }
+	};
+	Float3 specular = LTCEvaluatePolygon(fragPos, viewDir, normal, points, count, Minv);
+	specular *= SampleAmp(u, v).w * 0.2f;
+
+	Float3 ambient = { ambientStr, ambientStr, ambientStr };
+
+	Float3 col = (specular * lightColor + diffuse * fragColor) * lightColor;
+	col *= lightIntensity;
+	col = col / (2.0f * PI);
+	col += ambient * fragColor * lightColor;
+	return col;
+}
+
+// CalcRectLight's shading around LTCEvaluateDisk, for the diffuse term the
+// caller worked out
+Float3 LTC::CalcEllipseLight(Float3 center, Float3 axisX, Float3 axisY, Float4 color, float diffuse, Float3 normal, Float3 fragPos, Float3 fragColor, Float3 viewDir, float roughness, float ambientStr) const {
+	Float3 lightColor = XYZ(color);
+	float lightIntensity = color.w;
+
+	float lutScale = (_lutSize - 1.0f) / _lutSize;
+	float lutBias = 0.5f / _lutSize;
+	float theta = std::acos(Dot(normal, viewDir));
+	float u = roughness * lutScale + lutBias;
+	float v = theta / (0.5f * PI) * lutScale + lutBias;
+
+	Float4 t = SampleMat(u, v);
+	const float Minv[3][3] = {
+		{ 1, 0, t.y },
+		{ 0, t.z, 0 },
+		{ t.w, 0, t.x }
+	};
+	Float3 specular = LTCEvaluateDisk(fragPos, viewDir, normal, center, axisX, axisY, Minv);
+	specular *= SampleAmp(u, v).w * 0.2f;
+
+	Float3 ambient = { ambientStr, ambientStr, ambientStr };
+
+	Float3 col = (specular * lightColor + diffuse * fragColor) * lightColor;
+	col *= lightIntensity;
+	col = col / (2.0f * PI);
+	col += ambient * fragColor * lightColor;
+	return col;
+}
+
+// Any two axes in the disk's plane, radius long
+static void DiskAxes(Float3 normal, float radius, Float3& axisX, Float3& axisY) {
+	Float3 up = std::fabs(normal.y) < 0.999f ? Float3{ 0, 1, 0 } : Float3{ 1, 0, 0 };
+	axisX = Normalize(Cross(up, normal));
+	axisY = Cross(normal, axisX) * radius;
+	axisX *= radius;
+}
+
+Float3 LTC::CalcDiskLight(const DiskLight& light, Float3 normal, Float3 fragPos, Float3 fragColor, Float3 viewDir, float roughness, float ambientStr) const {
+	Float3 axisX, axisY;
+	DiskAxes(Normalize(XYZ(light.Direction)), light.Direction.w, axisX, axisY);
+
+	const float identity[3][3] = {
+		{ 1, 0, 0 },
+		{ 0, 1, 0 },
+		{ 0, 0, 1 }
+	};
+	float diffuse = LTCEvaluateDisk(fragPos, viewDir, normal, XYZ(light.Position), axisX, axisY, identity).x * 1.5f;
+	return CalcEllipseLight(XYZ(light.Position), axisX, axisY, light.Color, diffuse, normal, fragPos, fragColor, viewDir, roughness, ambientStr);
+}
+
+// From outside, a sphere covers the same directions as the disk its
+// silhouette circle bounds: closer by r^2 / d, smaller by sqrt(1 - r^2 / d^2).
+Float3 LTC::CalcSphereLight(const SphereLight& light, Float3 normal, Float3 fragPos, Float3 fragColor, Float3 viewDir, float roughness, float ambientStr) const {
+	Float3 toLight = XYZ(light.Position) - fragPos;
+	float distance = Length(toLight);
+	float radius = light.Position.w;
+	if (distance <= radius)
+		return { 0, 0, 0 };
+
+	Float3 direction = toLight / distance;
+	float ratio = radius / distance;
+
+	// the diffuse term needs no ellipse: it is the cap's integral itself
+	float diffuse = 2.0f * PI * SphereIntegral(Dot(normal, direction), ratio * ratio) * 1.5f;
+
+	Float3 center = XYZ(light.Position) - direction * (radius * ratio);
+	Float3 axisX, axisY;
+	DiskAxes(direction, radius * std::sqrt(1.0f - ratio * ratio), axisX, axisY);
+	return CalcEllipseLight(center, axisX, axisY, light.Color, diffuse, normal, fragPos, fragColor, viewDir, roughness, ambientStr);
+}
+
+#pragma endregion
+
+#pragma region Batch
+
+// Horizon clipping without the 16-case switch: each edge keeps its part above
+// the horizon, and the exit/entry crossing points close the polygon along it.
+// For a convex quad this sums exactly the edges ClipQuadToHorizon produces.
+template<int W>
+static SimdF<W> IntegrateEdgeSimd(const SimdF3<W>& a, const SimdF3<W>& b) {
+	typedef SimdF<W> F;
+	F cosTheta = Dot(a, b);
+	F theta = Acos(cosTheta);
+	F sinTheta = Sqrt(Max(F(1.0f) - cosTheta * cosTheta, F(0.0f)));
+	F factor = Select(Greater(theta, F(0.001f)), theta / sinTheta, F(1.0f));
+	return (a.x * b.y - a.y * b.x) * factor;
+}
+
+template<int W>
+static SimdF<W> IntegrateClippedQuad(const SimdF3<W> L[4]) {
+	typedef SimdF<W> F;
+	typedef SimdF3<W> F3;
+	typedef typename F::Mask Mask;
+
+	F sum(0.0f);
+	F3 exitPoint = { F(0.0f), F(0.0f), F(0.0f) };
+	F3 entryPoint = exitPoint;
+	Mask crossed = Greater(F(0.0f), F(0.0f));
+
+	for (int e = 0; e < 4; e++) {
+		const F3& a = L[e];
+		const F3& b = L[(e + 1) % 4];
+		Mask aUp = Greater(a.z, F(0.0f));
+		Mask bUp = Greater(b.z, F(0.0f));
+
+		// point where the edge crosses the horizon, same scaling as the shader
+		F3 p = b * Abs(a.z) + a * Abs(b.z);
+		F3 start = Select<W>(aUp, a, p);
+		F3 end = Select<W>(bUp, b, p);
+
+		F edge = IntegrateEdgeSimd<W>(Normalize(start), Normalize(end));
+		sum = sum + Select(F::Or(aUp, bUp), edge, F(0.0f));
+
+		Mask exits = F::AndNot(bUp, aUp);
+		Mask enters = F::AndNot(aUp, bUp);
+		exitPoint = Select<W>(exits, p, exitPoint);
+		entryPoint = Select<W>(enters, p, entryPoint);
+		crossed = F::Or(crossed, exits);
+	}
+
+	if (F::Any(crossed)) {
+		F edge = IntegrateEdgeSimd<W>(Normalize(exitPoint), Normalize(entryPoint));
+		sum = sum + Select(crossed, edge, F(0.0f));
+	}
+
+	return Abs(sum);
+}
+
+// atan(a) - a for a >= 0, A&S 4.4.49 without its first term: taking a from
+// atan(a) cancels to nothing in float for the small a of small caps
+template<int W>
+static SimdF<W> AtanMinusX(SimdF<W> a) {
+	typedef SimdF<W> F;
+	typename F::Mask inverted = Greater(a, F(1.0f));
+	F t = Select(inverted, F(1.0f) / Max(a, F(1.0f)), a);
+	F t2 = t * t;
+	F q = F(0.0028662257f);
+	q = q * t2 + F(-0.0161657367f);
+	q = q * t2 + F(0.0429096138f);
+	q = q * t2 + F(-0.0752896400f);
+	q = q * t2 + F(0.1065626393f);
+	q = q * t2 + F(-0.1420889944f);
+	q = q * t2 + F(0.1999355085f);
+	q = q * t2 + F(-0.3333314528f);
+	F series = t * t2 * q;
+	// atan(a) = pi / 2 - atan(1 / a) past 1
+	return Select(inverted, F(0.5f * PI) - t - series - a, series);
+}
+
+// SphereIntegral, with the cap cut by the horizon only where some lane needs
+// it. x sinThetaSqrtY formFactor = a - a formFactor for a = sinThetaSqrtY / x,
+// which leaves atan(a) - a of the two large terms that cancel.
+template<int W>
+static SimdF<W> SphereIntegralSimd(SimdF<W> cosTheta, SimdF<W> formFactor) {
+	typedef SimdF<W> F;
+	formFactor = Min(formFactor, F(0.9999f));
+	F above = Max(formFactor * cosTheta, F(0.0f));
+	typename F::Mask cut = Greater(formFactor, cosTheta * cosTheta);
+	if (!F::Any(cut))
+		return above;
+
+	F sinTheta = Sqrt(Max(F(1.0f) - cosTheta * cosTheta, F(0.0f)));
+	F x = Sqrt(F(1.0f) / formFactor - F(1.0f));
+	F y = Min(Max(-x * cosTheta / sinTheta, F(-1.0f)), F(1.0f));
+	F sinThetaSqrtY = sinTheta * Sqrt(Max(F(1.0f) - y * y, F(0.0f)));
+	F a = sinThetaSqrtY / x;
+	F integral = (cosTheta * Acos(y) + a) * formFactor + AtanMinusX(a);
+	return Select(cut, Max(integral * F(1.0f / PI), F(0.0f)), above);
+}
+
+// The small-light limit of IntegrateClippedQuad: the disk facing the shading
+// point with the solid angle |A.c| / |c|^3 a patch of area vector A at c
+// covers, integrated like CalcSphereLight's cap. Above the horizon it is the
+// patch's form factor, c.z |A.c| / (pi |c|^4), times 2 pi.
+template<int W>
+static SimdF<W> IntegrateDiskQuad(const SimdF3<W>& c, const SimdF3<W>& area) {
+	typedef SimdF<W> F;
+	F inverseLength = F(1.0f) / Sqrt(Dot(c, c));
+	F solidAngle = Abs(Dot(area, c)) * inverseLength * inverseLength * inverseLength;
+	return F(2.0f * PI) * SphereIntegralSimd<W>(c.z * inverseLength, solidAngle * F(1.0f / PI));
+}
+
+// Shading points' tangent frames and LTC matrices, and the unscaled lobes of
+// one rect light in them, integrated or from its disk
+template<int W>
+struct RectLightFrame {
+	typedef SimdF<W> F;
+	typedef SimdF3<W> F3;
+
+	F3 P, N, T1, T2;
+	F mA, mB, mC, mD;
+	F stretch; // most a solid angle grows by in LTC space
+
+	F3 ToFrame(const F3& d) const { return { Dot(d, T1), Dot(d, T2), Dot(d, N) }; }
+	F3 ToLtc(const F3& l) const { return { l.x + l.z * mD, l.y * mC, l.x * mB + l.z * mA }; }
+
+	// Directions map to Mw / |Mw|, whose Jacobian |det M| / |Mw|^3 peaks at
+	// the smallest singular value. M is diag(mC) on y, a 2x2 block on xz.
+	void SetMatrix(F a, F b, F c, F d) {
+		mA = a; mB = b; mC = c; mD = d;
+		F det = mA - mD * mB;
+		F sum = F(1.0f) + mD * mD + mB * mB + mA * mA;
+		F largest = (sum + Sqrt(Max(sum * sum - F(4.0f) * det * det, F(0.0f)))) * F(0.5f);
+		F smallest = Sqrt(Min(det * det / largest, mC * mC));
+		stretch = Abs(mC * det) / (smallest * smallest * smallest);
+	}
+
+	void Lobes(const Float3 corners[4], bool diskDiffuse, bool diskSpecular, F& diffuse, F& specular) const {
+		if (!diskDiffuse || !diskSpecular) {
+			F3 L[4], Ls[4];
+			for (int k = 0; k < 4; k++) {
+				const Float3& c = corners[k];
+				L[k] = ToFrame({ F(c.x) - P.x, F(c.y) - P.y, F(c.z) - P.z });
+				Ls[k] = ToLtc(L[k]);
+			}
+			if (!diskDiffuse)
+				diffuse = IntegrateClippedQuad<W>(L);
+			if (!diskSpecular)
+				specular = IntegrateClippedQuad<W>(Ls);
+		}
+		if (diskDiffuse || diskSpecular) {
+			Float3 center = (corners[0] + corners[2]) * 0.5f;
+			Float3 ex = (corners[1] - corners[0]) * 0.5f;
+			Float3 ey = (corners[3] - corners[0]) * 0.5f;
+			F3 c = ToFrame({ F(center.x) - P.x, F(center.y) - P.y, F(center.z) - P.z });
+			if (diskDiffuse) {
+				Float3 area = Cross(ex, ey) * 4.0f;
+				diffuse = IntegrateDiskQuad<W>(c, ToFrame({ F(area.x), F(area.y), F(area.z) }));
+			}
+			if (diskSpecular) {
+				F3 sx = ToLtc(ToFrame({ F(ex.x), F(ex.y), F(ex.z) }));
+				F3 sy = ToLtc(ToFrame({ F(ey.x), F(ey.y), F(ey.z) }));
+				specular = IntegrateDiskQuad<W>(ToLtc(c), Cross(sx, sy) * F(4.0f));
+			}
+		}
+	}
+};
+
+template<int W>
+void LTC::CalcRectLightBlock(const RectLight* lights, const Float3* corners, int count, ShadingPoints& sp, size_t first, float roughness, float ambientStr, RectLightLodStats* stats) const {
+	typedef SimdF<W> F;
+	typedef SimdF3<W> F3;
+
+	RectLightFrame<W> frame;
+	frame.P = { F::Load(&sp.px[first]), F::Load(&sp.py[first]), F::Load(&sp.pz[first]) };
+	frame.N = { F::Load(&sp.nx[first]), F::Load(&sp.ny[first]), F::Load(&sp.nz[first]) };
+	F3 V = { F::Load(&sp.vx[first]), F::Load(&sp.vy[first]), F::Load(&sp.vz[first]) };
+	F3 fragColor = { F::Load(&sp.r[first]), F::Load(&sp.g[first]), F::Load(&sp.b[first]) };
+
+	frame.T1 = Normalize(V - frame.N * Dot(V, frame.N));
+	frame.T2 = Cross(frame.N, frame.T1);
+
+	// The LUT lookup depends on the shading point only, so it is shared by all lights.
+	float lutScale = (_lutSize - 1.0f) / _lutSize;
+	float lutBias = 0.5f / _lutSize;
+	float u = roughness * lutScale + lutBias;
+	F v = Acos(Dot(frame.N, V)) * F(lutScale / (0.5f * PI)) + F(lutBias);
+
+	alignas(64) float lanes[W];
+	alignas(64) float ta[W], tb[W], tc[W], td[W], amp[W];
+	v.Store(lanes);
+	for (int i = 0; i < W; i++) {
+		Float4 t = SampleMat(u, lanes[i]);
+		ta[i] = t.x; tb[i] = t.y; tc[i] = t.z; td[i] = t.w;
+		amp[i] = SampleAmp(u, lanes[i]).w * 0.2f;
+	}
+	frame.SetMatrix(F::Load(ta), F::Load(tb), F::Load(tc), F::Load(td));
+	F specScale = F::Load(amp);
+
+	bool lod = _rectLod.diffuseSolidAngle > 0.0f || _rectLod.specularSolidAngle > 0.0f;
+	const int allLanes = (1 << W) - 1;
+
+	F3 result = { F(0.0f), F(0.0f), F(0.0f) };
+	for (int l = 0; l < count; l++) {
+		const Float3* quad = &corners[l * 4];
+
+		// every lane has to be under a lobe's solid angle for the block to take the disk
+		bool diskDiffuse = false, diskSpecular = false;
+		if (lod) {
+			Float3 center = (quad[0] + quad[2]) * 0.5f;
+			F3 d = { F(center.x) - frame.P.x, F(center.y) - frame.P.y, F(center.z) - frame.P.z };
+			F distance2 = Dot(d, d);
+			F area(Length(Cross(quad[1] - quad[0], quad[3] - quad[0])));
+			diskDiffuse = F::Bits(Less(area, distance2 * F(_rectLod.diffuseSolidAngle))) == allLanes;
+			diskSpecular = F::Bits(Less(area * frame.stretch, distance2 * F(_rectLod.specularSolidAngle))) == allLanes;
+		}
+		if (stats)
+			(diskDiffuse ? (diskSpecular ? stats->far : stats->diffuse) : (diskSpecular ? stats->specular : stats->full)) += W;
+
+		F diffuse, specular;
+		frame.Lobes(quad, diskDiffuse, diskSpecular, diffuse, specular);
+		diffuse = diffuse * F(1.5f);
+		specular = specular * specScale;
+
+		const RectLight& light = lights[l];
+		F3 lightColor = { F(light.Color.x), F(light.Color.y), F(light.Color.z) };
+		F scale(light.Color.w / (2.0f * PI));
+
+		F3 col = {
+			(specular * lightColor.x + diffuse * fragColor.x) * lightColor.x,
+			(specular * lightColor.y + diffuse * fragColor.y) * lightColor.y,
+			(specular * lightColor.z + diffuse * fragColor.z) * lightColor.z
+		};
+		col = col * scale;
+		col.x = col.x + F(ambientStr) * fragColor.x * lightColor.x;
+		col.y = col.y + F(ambientStr) * fragColor.y * lightColor.y;
+		col.z = col.z + F(ambientStr) * fragColor.z * lightColor.z;
+		result = result + col;
+	}
+
+	(F::Load(&sp.outR[first]) + result.x).Store(&sp.outR[first]);
+	(F::Load(&sp.outG[first]) + result.y).Store(&sp.outG[first]);
+	(F::Load(&sp.outB[first]) + result.z).Store(&sp.outB[first]);
+}
+
+void LTC::CalcRectLights(const RectLight* lights, int count, ShadingPoints& points, float roughness, float ambientStr, RectLightLodStats* stats) const {
+	vector<Float3> corners(count * 4);
+	for (int l = 0; l < count; l++)
+		RectLightPoints(lights[l], &corners[l * 4]);
+
+	size_t size = points.Size();
+	size_t i = 0;
+	for (; i + SIMD_WIDTH <= size; i += SIMD_WIDTH)
+		CalcRectLightBlock<SIMD_WIDTH>(lights, corners.data(), count, points, i, roughness, ambientStr, stats);
+	for (; i < size; i++)
+		CalcRectLightBlock<1>(lights, corners.data(), count, points, i, roughness, ambientStr, stats);
+}
+
+// IntegrateClippedQuad in double precision, for lights too small for float:
+// the polygon above the horizon, then the edge integrals over the sphere.
+static double IntegrateQuadReference(const Float3 quad[4]) {
+	double in[4][3], out[8][3];
+	for (int k = 0; k < 4; k++) {
+		in[k][0] = quad[k].x; in[k][1] = quad[k].y; in[k][2] = quad[k].z;
+	}
+	int n = 0;
+	for (int k = 0; k < 4; k++) {
+		const double* a = in[k];
+		const double* b = in[(k + 1) % 4];
+		if (a[2] > 0.0) {
+			out[n][0] = a[0]; out[n][1] = a[1]; out[n][2] = a[2];
+			n++;
+		}
+		if ((a[2] > 0.0) != (b[2] > 0.0)) {
+			double t = a[2] / (a[2] - b[2]);
+			for (int c = 0; c < 3; c++)
+				out[n][c] = a[c] + (b[c] - a[c]) * t;
+			out[n][2] = 0.0;
+			n++;
+		}
+	}
+	for (int k = 0; k < n; k++) {
+		double length = std::sqrt(out[k][0] * out[k][0] + out[k][1] * out[k][1] + out[k][2] * out[k][2]);
+		for (int c = 0; c < 3; c++)
+			out[k][c] /= length;
+	}
+
+	double sum = 0.0;
+	for (int k = 0; k < n; k++) {
+		const double* a = out[k];
+		const double* b = out[(k + 1) % n];
+		double cosTheta = std::min(std::max(a[0] * b[0] + a[1] * b[1] + a[2] * b[2], -1.0), 1.0);
+		double theta = std::acos(cosTheta);
+		double factor = theta > 1e-9 ? theta / std::sin(theta) : 1.0;
+		sum += (a[0] * b[1] - a[1] * b[0]) * factor;
+	}
+	return std::fabs(sum);
+}
+
+// Samples lights of random size and turn at log-uniform solid angles from a
+// point of random view and roughness. Lights cut by the horizon are the worst
+// case of the disk, so every direction around the point is drawn.
+RectLightLod LTC::FitRectLightLod(float maxError, int samples, vector<RectLightLodError>* errors) const {
+	const int binsPerOctave = 4, octaves = 16;
+	vector<RectLightLodError> bins(binsPerOctave * octaves);
+	for (size_t b = 0; b < bins.size(); b++)
+		bins[b] = { std::exp2(-(float)octaves + (b + 1.0f) / binsPerOctave), 0.0f, 0.0f };
+	auto binOf = [&](float solidAngle) {
+		return std::min((int)bins.size() - 1, std::max(0, (int)std::floor((std::log2(solidAngle) + octaves) * binsPerOctave)));
+	};
+
+	uint32_t random = 0x9E3779B9u;
+	auto unit = [&random]() {
+		random = random * 1664525u + 1013904223u;
+		return (random >> 8) * (1.0f / 16777216.0f);
+	};
+
+	float lutScale = (_lutSize - 1.0f) / _lutSize;
+	float lutBias = 0.5f / _lutSize;
+	for (int s = 0; s < samples; s++) {
+		float u = unit() * lutScale + lutBias;
+		float v = unit() * lutScale + lutBias;
+		Float4 t = SampleMat(u, v);
+
+		RectLightFrame<1> frame;
+		frame.P = { 0.0f, 0.0f, 0.0f };
+		frame.N = { 0.0f, 0.0f, 1.0f };
+		frame.T1 = { 1.0f, 0.0f, 0.0f };
+		frame.T2 = { 0.0f, 1.0f, 0.0f };
+		frame.SetMatrix(t.x, t.y, t.z, t.w);
+
+		// a light of random shape and turn around a random direction
+		RectLight light = { { 0, 0, 0, 1 }, { 0.05f + unit(), 0.05f + unit(), unit(), unit() }, { 1, 1, 1, 1 } };
+		float z = 2.0f * unit() - 1.0f, phi = 2.0f * PI * unit();
+		float r = std::sqrt(std::max(1.0f - z * z, 0.0f));
+		float area = 4.0f * light.Params.x * light.Params.y;
+		float solidAngle = std::exp2(-octaves * unit());
+		float distance = std::sqrt(area / solidAngle);
+		if (distance * distance < 1.1f * (light.Params.x * light.Params.x + light.Params.y * light.Params.y))
+			continue;
+		light.Position = { r * std::cos(phi) * distance, r * std::sin(phi) * distance, z * distance, 1 };
+
+		Float3 corners[4], L[4], Ls[4];
+		RectLightPoints(light, corners);
+		for (int k = 0; k < 4; k++) {
+			L[k] = corners[k];
+			Ls[k] = { L[k].x + L[k].z * t.w, L[k].y * t.z, L[k].x * t.y + L[k].z * t.x };
+		}
+		double diffuse = IntegrateQuadReference(L), specular = IntegrateQuadReference(Ls);
+		SimdF<1> diskDiffuse, diskSpecular;
+		frame.Lobes(corners, true, true, diskDiffuse, diskSpecular);
+
+		// a lobe of solid angle w is at most 2 w, head-on
+		float specularAngle = solidAngle * frame.stretch.v;
+		RectLightLodError& d = bins[binOf(solidAngle)];
+		RectLightLodError& sp = bins[binOf(specularAngle)];
+		d.diffuse = std::max(d.diffuse, (float)(std::fabs(diskDiffuse.v - diffuse) / (2.0 * solidAngle)));
+		sp.specular = std::max(sp.specular, (float)(std::fabs(diskSpecular.v - specular) / (2.0 * specularAngle)));
+	}
+
+	// worst up to each solid angle, the largest within the bound is the threshold
+	RectLightLod lod = {};
+	for (size_t b = 0; b < bins.size(); b++) {
+		if (b > 0) {
+			bins[b].diffuse = std::max(bins[b].diffuse, bins[b - 1].diffuse);
+			bins[b].specular = std::max(bins[b].specular, bins[b - 1].specular);
+		}
+		if (bins[b].diffuse <= maxError)
+			lod.diffuseSolidAngle = bins[b].solidAngle;
+		if (bins[b].specular <= maxError)
+			lod.specularSolidAngle = bins[b].solidAngle;
+	}
+	if (errors)
+		*errors = bins;
+	return lod;
+}
+
+int LTC::BatchWidth() {
+	return SIMD_WIDTH;
+}
+
+#pragma endregion
+
+#pragma region Tables
+
+LTC::LTC(const char* matPath, const char* ampPath) {
+	int matWidth, matHeight, ampWidth, ampHeight;
+	if (!ReadFloatDDS(matPath, matWidth, matHeight, _mat))
+		throw ltcException("Reading LTC matrix table fucked up");
+	if (!ReadFloatDDS(ampPath, ampWidth, ampHeight, _amp))
+		throw ltcException("Reading LTC amplitude table fucked up");
+	if (matWidth != matHeight || ampWidth != matWidth || ampHeight != matHeight)
+		throw ltcException("LTC tables must be square and of the same size");
+
+	_lutSize = matWidth;
+}
+
+LTC::LTC(int lutSize, vector<Float4> mat, vector<Float4> amp)
+	: _lutSize(lutSize), _mat(std::move(mat)), _amp(std::move(amp))
+{
+	if (_mat.size() != (size_t)lutSize * lutSize || _amp.size() != _mat.size())
+		throw ltcException("LTC table size mismatch");
+}
+
+// Bilinear filtering with clamp addressing, like ltcSampler
+Float4 LTC::Sample(const vector<Float4>& table, float u, float v) const {
+	float x = u * _lutSize - 0.5f;
+	float y = v * _lutSize - 0.5f;
+	float fx = std::floor(x);
+	float fy = std::floor(y);
+	float tx = x - fx;
+	float ty = y - fy;
+
+	auto clampIndex = [this](int i) { return i < 0 ? 0 : (i >= _lutSize ? _lutSize - 1 : i); };
+	int x0 = clampIndex((int)fx), x1 = clampIndex((int)fx + 1);
+	int y0 = clampIndex((int)fy), y1 = clampIndex((int)fy + 1);
+
+	const Float4& a = table[y0 * _lutSize + x0];
+	const Float4& b = table[y0 * _lutSize + x1];
+	const Float4& c = table[y1 * _lutSize + x0];
+	const Float4& d = table[y1 * _lutSize + x1];
+
+	auto lerp2 = [tx, ty](float a, float b, float c, float d) {
+		float top = a + (b - a) * tx;
+		float bottom = c + (d - c) * tx;
+		return top + (bottom - top) * ty;
+	};
+
+	return {
+		lerp2(a.x, b.x, c.x, d.x),
+		lerp2(a.y, b.y, c.y, d.y),
+		lerp2(a.z, b.z, c.z, d.z),
+		lerp2(a.w, b.w, c.w, d.w)
+	};
+}
+
+#pragma endregion
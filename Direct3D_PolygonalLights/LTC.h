@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Lights.h"
+#include <exception>
+#include <vector>
+
+using std::exception;
+using std::vector;
+
+#define LTC_LUT_SIZE 64
+
+// Shading points in SoA layout, the batch counterpart of the PSIn fields the
+// pixel shader reads. Results are accumulated into outR/outG/outB.
+struct ShadingPoints {
+	vector<float> px, py, pz;
+	vector<float> nx, ny, nz;
+	vector<float> vx, vy, vz;
+	vector<float> r, g, b;
+	vector<float> outR, outG, outB;
+
+	void Resize(size_t count);
+	void Set(size_t i, Float3 position, Float3 normal, Float3 viewDir, Float3 color);
+	void ClearResults();
+	Float3 GetResult(size_t i) const { return { outR[i], outG[i], outB[i] }; }
+	size_t Size() const { return px.size(); }
+};
+
+// Light x point evaluations of CalcRectLights by RectLightLod level
+struct RectLightLodStats {
+	size_t full = 0;     // both lobes integrated
+	size_t diffuse = 0;  // the diffuse lobe from the disk
+	size_t specular = 0; // the specular lobe from the disk
+	size_t far = 0;      // both lobes from the disk
+};
+
+// Worst error of FitRectLightLod's samples up to a solid angle, relative to
+// the lobe of a light of that solid angle seen head-on
+struct RectLightLodError {
+	float solidAngle;
+	float diffuse;
+	float specular;
+};
+
+// World-space corners of the quad a rect light emits from, in the order
+// LTCEvaluate integrates them
+void RectLightPoints(const RectLight& light, Float3 points[4]);
+
+// CPU version of the rect light LTC shading in PixelShader.hlsl.
+// CalcRectLight is a line-by-line port of the shader and serves as the
+// reference; CalcRectLights evaluates SIMD_WIDTH points per step.
+// CalcPolygonLight is the reference for polygon lights, whose vertices it
+// reads from the shared vertex array; CalcDiskLight and CalcSphereLight for
+// the round lights.
+//
+// CalcRectLights shades rect lights at the levels of SetRectLightLod, every
+// light exactly unless it is called. The levels are decided per light and
+// SIMD_WIDTH points, by the worst of them.
+class LTC {
+public:
+	LTC(const char* matPath, const char* ampPath);
+	LTC(int lutSize, vector<Float4> mat, vector<Float4> amp);
+
+	Float3 CalcRectLight(const RectLight& light, Float3 normal, Float3 fragPos, Float3 fragColor, Float3 viewDir, float roughness = 0.25f, float ambientStr = 0.05f) const;
+	void CalcRectLights(const RectLight* lights, int count, ShadingPoints& points, float roughness = 0.25f, float ambientStr = 0.05f, RectLightLodStats* stats = nullptr) const;
+	Float3 CalcPolygonLight(const PolygonLight& light, const Float4* vertices, Float3 normal, Float3 fragPos, Float3 fragColor, Float3 viewDir, float roughness = 0.25f, float ambientStr = 0.0f) const;
+	Float3 CalcDiskLight(const DiskLight& light, Float3 normal, Float3 fragPos, Float3 fragColor, Float3 viewDir, float roughness = 0.25f, float ambientStr = 0.0f) const;
+	Float3 CalcSphereLight(const SphereLight& light, Float3 normal, Float3 fragPos, Float3 fragColor, Float3 viewDir, float roughness = 0.25f, float ambientStr = 0.0f) const;
+
+	void SetRectLightLod(const RectLightLod& lod) { _rectLod = lod; }
+	const RectLightLod& GetRectLightLod() const { return _rectLod; }
+	// Thresholds whose disk lobes err by at most maxError, measured over
+	// random lights, views, roughness and distances. errors gets the worst
+	// error per solid angle.
+	RectLightLod FitRectLightLod(float maxError, int samples = 1 << 18, vector<RectLightLodError>* errors = nullptr) const;
+
+	Float4 SampleMat(float u, float v) const { return Sample(_mat, u, v); }
+	Float4 SampleAmp(float u, float v) const { return Sample(_amp, u, v); }
+	int GetLutSize() const { return _lutSize; }
+
+	static int BatchWidth();
+
+private:
+	int _lutSize;
+	vector<Float4> _mat;
+	vector<Float4> _amp;
+	RectLightLod _rectLod = {};
+
+	Float4 Sample(const vector<Float4>& table, float u, float v) const;
+	Float3 LTCEvaluate(Float3 fragPos, Float3 viewDir, Float3 normal, const Float3 points[4], const float Minv[3][3]) const;
+	Float3 LTCEvaluatePolygon(Float3 fragPos, Float3 viewDir, Float3 normal, const Float3* points, int count, const float Minv[3][3]) const;
+	Float3 LTCEvaluateDisk(Float3 fragPos, Float3 viewDir, Float3 normal, Float3 center, Float3 axisX, Float3 axisY, const float Minv[3][3]) const;
+	Float3 CalcEllipseLight(Float3 center, Float3 axisX, Float3 axisY, Float4 color, float diffuse, Float3 normal, Float3 fragPos, Float3 fragColor, Float3 viewDir, float roughness, float ambientStr) const;
+
+	template<int W>
+	void CalcRectLightBlock(const RectLight* lights, const Float3* corners, int count, ShadingPoints& sp, size_t first, float roughness, float ambientStr, RectLightLodStats* stats) const;
+
+	class ltcException : public exception {
+	private:
+		const char* _message;
+	public:
+		ltcException(const char* message) : _message(message) {}
+		const char* what() const throw () { return _message; }
+	};
+};
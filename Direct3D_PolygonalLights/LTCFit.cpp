@@ -0,0 +1,417 @@
+#include "LTCFit.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// The fit runs in double, float loses the lobes at LTC_MIN_ALPHA.
+struct Dir {
+	double x;
+	double y;
+	double z;
+};
+
+static const double PI_D = 3.14159265358979323846;
+
+static Dir operator+(Dir a, Dir b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+static Dir operator*(Dir a, double s) { return { a.x * s, a.y * s, a.z * s }; }
+static double Dot(Dir a, Dir b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static Dir Normalize(Dir a) { return a * (1.0 / std::sqrt(Dot(a, a))); }
+
+#pragma region GGX
+
+// Smith masking, Heitz 2014
+static double Lambda(double alpha, double cosTheta) {
+	if (cosTheta >= 1.0)
+		return 0.0;
+
+	double tanTheta = std::sqrt(1.0 - cosTheta * cosTheta) / cosTheta;
+	double a = 1.0 / (alpha * tanTheta);
+	return 0.5 * (-1.0 + std::sqrt(1.0 + 1.0 / (a * a)));
+}
+
+// GGX times the cosine of L, and the pdf of SampleGGX for L
+static double EvalGGX(Dir V, Dir L, double alpha, double& pdf) {
+	pdf = 0.0;
+	if (V.z <= 0.0)
+		return 0.0;
+
+	Dir H = Normalize(V + L);
+	if (H.z <= 0.0)
+		return 0.0;
+
+	double slopeX = H.x / H.z;
+	double slopeY = H.y / H.z;
+	double alpha2 = alpha * alpha;
+	double D = 1.0 / (1.0 + (slopeX * slopeX + slopeY * slopeY) / alpha2);
+	D = D * D / (PI_D * alpha2 * H.z * H.z * H.z * H.z);
+	pdf = std::fabs(D * H.z / (4.0 * Dot(V, H)));
+
+	if (L.z <= 0.0)
+		return 0.0;
+
+	double G2 = 1.0 / (1.0 + Lambda(alpha, V.z) + Lambda(alpha, L.z));
+	return D * G2 / (4.0 * V.z);
+}
+
+// reflects V about a normal sampled from D(h) cos(h)
+static Dir SampleGGX(Dir V, double alpha, double u1, double u2) {
+	double phi = 2.0 * PI_D * u1;
+	double r = alpha * std::sqrt(u2 / (1.0 - u2));
+	Dir N = Normalize(Dir{ r * std::cos(phi), r * std::sin(phi), 1.0 });
+	return N * (2.0 * Dot(N, V)) + V * -1.0;
+}
+
+#pragma endregion
+
+#pragma region Lobe
+
+// The stored (m22, m02, m11, m20) as the matrix that maps a light direction
+// in the (T1, T2, N) frame into the cosine lobe: LTCEvaluate multiplies row
+// vectors by Minv, which is this matrix applied to column vectors.
+struct Lobe {
+	double A[3][3];
+	double M[3][3]; // inverse of A, the LTC itself
+	double det;
+
+	bool Set(const double p[4]) {
+		double x = p[0], y = p[1], z = p[2], w = p[3];
+		double d = x - w * y;
+		det = z * d;
+		if (z <= 0.0 || d <= 0.0)
+			return false;
+
+		const double a[3][3] = { { 1, 0, w }, { 0, z, 0 }, { y, 0, x } };
+		const double m[3][3] = { { x / d, 0, -w / d }, { 0, 1 / z, 0 }, { -y / d, 0, 1 / d } };
+		std::copy(&a[0][0], &a[0][0] + 9, &A[0][0]);
+		std::copy(&m[0][0], &m[0][0] + 9, &M[0][0]);
+		return true;
+	}
+
+	static Dir Apply(const double T[3][3], Dir v) {
+		return {
+			T[0][0] * v.x + T[0][1] * v.y + T[0][2] * v.z,
+			T[1][0] * v.x + T[1][1] * v.y + T[1][2] * v.z,
+			T[2][0] * v.x + T[2][1] * v.y + T[2][2] * v.z
+		};
+	}
+
+	// normalized, integrates to 1 over the sphere
+	double Eval(Dir L) const {
+		Dir o = Apply(A, L);
+		double length2 = Dot(o, o);
+		return std::max(o.z, 0.0) * det / (PI_D * length2 * length2);
+	}
+
+	Dir Sample(double u1, double u2) const {
+		double r = std::sqrt(u1);
+		double phi = 2.0 * PI_D * u2;
+		Dir o = { r * std::cos(phi), r * std::sin(phi), std::sqrt(1.0 - u1) };
+		return Normalize(Apply(M, o));
+	}
+};
+
+#pragma endregion
+
+#pragma region Fit
+
+// The BRDF side of one table entry: its samples do not depend on the LTC,
+// so they are drawn and evaluated once.
+struct FitTarget {
+	struct Sample {
+		Dir L;
+		double brdf; // normalized by norm
+		double pdf;
+	};
+
+	Dir V;
+	double alpha;
+	double norm;
+	double fresnel;
+	Dir averageDir; // of the BRDF lobe, in the plane of V and N
+	int samples;
+	vector<Sample> brdfSamples;
+
+	FitTarget(double alpha, double theta, int samples)
+		: V{ std::sin(theta), 0.0, std::cos(theta) }, alpha(alpha), norm(0.0), fresnel(0.0), averageDir{ 0, 0, 0 }, samples(samples)
+	{
+		brdfSamples.reserve((size_t)samples * samples);
+		for (int j = 0; j < samples; j++) {
+			for (int i = 0; i < samples; i++) {
+				Sample s;
+				s.L = SampleGGX(V, alpha, (i + 0.5) / samples, (j + 0.5) / samples);
+				s.brdf = EvalGGX(V, s.L, alpha, s.pdf);
+				if (s.pdf > 0.0) {
+					double weight = s.brdf / s.pdf;
+					double VdotH = std::max(Dot(V, Normalize(V + s.L)), 0.0);
+					norm += weight;
+					fresnel += weight * std::pow(1.0 - VdotH, 5.0);
+					averageDir = averageDir + s.L * weight;
+				}
+				brdfSamples.push_back(s);
+			}
+		}
+		norm /= (double)samples * samples;
+		fresnel /= (double)samples * samples;
+		averageDir.y = 0.0;
+		averageDir = Normalize(averageDir);
+		for (Sample& s : brdfSamples)
+			s.brdf = norm > 0.0 ? s.brdf / norm : 0.0;
+	}
+
+	// Multiple importance sampled over both lobes: the L1 distance, and the
+	// sum of cubed differences that the fit minimizes (it weights the peaks).
+	void Compare(const Lobe& lobe, double& cubed, double& l1) const {
+		cubed = 0.0;
+		l1 = 0.0;
+		for (const Sample& s : brdfSamples) {
+			double ltc = lobe.Eval(s.L);
+			double pdfSum = ltc + s.pdf;
+			if (pdfSum <= 0.0)
+				continue;
+
+			double diff = std::fabs(s.brdf - ltc);
+			cubed += diff * diff * diff / pdfSum;
+			l1 += diff / pdfSum;
+		}
+
+		for (int j = 0; j < samples; j++) {
+			for (int i = 0; i < samples; i++) {
+				Dir L = lobe.Sample((i + 0.5) / samples, (j + 0.5) / samples);
+				double ltc = lobe.Eval(L);
+				double pdf;
+				double brdf = EvalGGX(V, L, alpha, pdf) / norm;
+				double pdfSum = ltc + pdf;
+				if (pdfSum <= 0.0)
+					continue;
+
+				double diff = std::fabs(brdf - ltc);
+				cubed += diff * diff * diff / pdfSum;
+				l1 += diff / pdfSum;
+			}
+		}
+
+		double count = (double)samples * samples;
+		cubed /= count;
+		l1 /= count;
+	}
+
+	double Cost(const double p[4]) const {
+		Lobe lobe;
+		if (!lobe.Set(p))
+			return HUGE_VAL;
+
+		double cubed, l1;
+		Compare(lobe, cubed, l1);
+		return cubed;
+	}
+};
+
+// Downhill simplex over the first dims parameters of p, the rest stay fixed.
+template<typename F>
+static void NelderMead(double p[4], const double step[4], int dims, int iterations, const F& cost) {
+	double simplex[5][4];
+	double values[5];
+	for (int v = 0; v <= dims; v++) {
+		std::copy(p, p + 4, simplex[v]);
+		if (v > 0)
+			simplex[v][v - 1] += step[v - 1];
+		values[v] = cost(simplex[v]);
+	}
+
+	auto along = [&](const double centroid[4], const double from[4], double t, double out[4]) {
+		std::copy(from, from + 4, out);
+		for (int d = 0; d < dims; d++)
+			out[d] = centroid[d] + t * (from[d] - centroid[d]);
+	};
+
+	for (int it = 0; it < iterations; it++) {
+		int best = 0, worst = 0;
+		for (int v = 1; v <= dims; v++) {
+			if (values[v] < values[best])
+				best = v;
+			if (values[v] > values[worst])
+				worst = v;
+		}
+		int second = best;
+		for (int v = 0; v <= dims; v++)
+			if (v != worst && values[v] > values[second])
+				second = v;
+
+		if (values[worst] - values[best] <= 1e-7 * std::fabs(values[best]) + 1e-30)
+			break;
+
+		double centroid[4];
+		std::copy(simplex[best], simplex[best] + 4, centroid);
+		for (int d = 0; d < dims; d++) {
+			centroid[d] = 0.0;
+			for (int v = 0; v <= dims; v++)
+				if (v != worst)
+					centroid[d] += simplex[v][d] / dims;
+		}
+
+		double reflected[4], trial[4];
+		along(centroid, simplex[worst], -1.0, reflected);
+		double reflectedValue = cost(reflected);
+		if (reflectedValue < values[best]) {
+			along(centroid, simplex[worst], -2.0, trial);
+			double expandedValue = cost(trial);
+			if (expandedValue < reflectedValue) {
+				std::copy(trial, trial + 4, simplex[worst]);
+				values[worst] = expandedValue;
+			}
+			else {
+				std::copy(reflected, reflected + 4, simplex[worst]);
+				values[worst] = reflectedValue;
+			}
+			continue;
+		}
+		if (reflectedValue < values[second]) {
+			std::copy(reflected, reflected + 4, simplex[worst]);
+			values[worst] = reflectedValue;
+			continue;
+		}
+
+		// contract towards the better of the worst and the reflected point
+		const double* from = reflectedValue < values[worst] ? reflected : simplex[worst];
+		along(centroid, from, 0.5, trial);
+		double contractedValue = cost(trial);
+		if (contractedValue < std::min(reflectedValue, values[worst])) {
+			std::copy(trial, trial + 4, simplex[worst]);
+			values[worst] = contractedValue;
+			continue;
+		}
+
+		for (int v = 0; v <= dims; v++) {
+			if (v == best)
+				continue;
+			for (int d = 0; d < dims; d++)
+				simplex[v][d] = simplex[best][d] + 0.5 * (simplex[v][d] - simplex[best][d]);
+			values[v] = cost(simplex[v]);
+		}
+	}
+
+	int best = (int)(std::min_element(values, values + dims + 1) - values);
+	std::copy(simplex[best], simplex[best] + 4, p);
+}
+
+LTCFitter::LTCFitter(const LTCFitDesc& desc)
+	: _desc(desc), _entries((size_t)desc.size * desc.size)
+{
+}
+
+float LTCFitter::GetAlpha(int column) const {
+	float roughness = column / (float)(_desc.size - 1);
+	return std::max(roughness * roughness, LTC_MIN_ALPHA);
+}
+
+float LTCFitter::GetTheta(int row) const {
+	// grazing views are degenerate, stop just short of pi / 2
+	return std::min(row / (float)(_desc.size - 1) * 0.5f * PI, 1.57f);
+}
+
+void LTCFitter::Fit(ThreadPool& pool) {
+	pool.ParallelFor((size_t)_desc.size, [this](size_t column) {
+		FitColumn((int)column);
+	});
+}
+
+// Heitz et al. parameterization: the LTC is M = (X, Y, Z) * (m11, 0, m13;
+// 0, m22, 0; 0, 0, 1) with Z the average direction of the lobe, which keeps
+// the parameters smooth over theta. Returns the stored form of M^-1.
+static bool ToStored(const double q[4], Dir averageDir, double p[4]) {
+	double m11 = q[0], m22 = q[1], m13 = q[2];
+	if (m11 <= 0.0 || m22 <= 0.0)
+		return false;
+
+	// M^-1 = K^-1 * (X, Y, Z)^T with X = (Z.z, 0, -Z.x), Y = (0, 1, 0)
+	Dir X = { averageDir.z, 0.0, -averageDir.x };
+	Dir Z = averageDir;
+	double a00 = X.x / m11 - m13 / m11 * Z.x;
+	double a02 = X.z / m11 - m13 / m11 * Z.z;
+	double a11 = 1.0 / m22;
+	double a20 = Z.x;
+	double a22 = Z.z;
+	if (a00 <= 0.0)
+		return false;
+
+	p[0] = a22 / a00;
+	p[1] = a20 / a00;
+	p[2] = a11 / a00;
+	p[3] = a02 / a00;
+	return true;
+}
+
+void LTCFitter::FitColumn(int column) {
+	double alpha = GetAlpha(column);
+
+	// the reflected lobe is about twice as wide as the GGX normal distribution
+	double q[4] = { 2.0 * alpha, 2.0 * alpha, 0.0, 0.0 };
+	for (int row = 0; row < _desc.size; row++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		FitTarget target(alpha, GetTheta(row), _desc.samples);
+		double p[4];
+
+		if (row == 0) {
+			// isotropic around the normal at normal incidence, only the width is free
+			auto cost = [&target](const double q[4]) {
+				double p[4] = { q[0], 0.0, 1.0, 0.0 };
+				return target.Cost(p);
+			};
+			double step[4] = { 0.5 * q[0], 0, 0, 0 };
+			NelderMead(q, step, 1, _desc.iterations, cost);
+			q[1] = q[0];
+			const double isotropic[4] = { q[0], 0.0, 1.0, 0.0 };
+			std::copy(isotropic, isotropic + 4, p);
+		}
+		else {
+			// warm start from the previous theta, restarted once to get out of a collapsed simplex
+			auto cost = [&target](const double q[4]) {
+				double p[4];
+				return ToStored(q, target.averageDir, p) ? target.Cost(p) : HUGE_VAL;
+			};
+			for (int pass = 0; pass < 2; pass++) {
+				double width = 0.1 * std::max(q[0], q[1]);
+				double step[4] = { width, width, width, 0 };
+				NelderMead(q, step, 3, _desc.iterations, cost);
+			}
+			if (!ToStored(q, target.averageDir, p)) {
+				const double identity[4] = { 1.0, 0.0, 1.0, 0.0 };
+				std::copy(identity, identity + 4, p);
+			}
+		}
+
+		Lobe lobe;
+		double cubed, l1 = 2.0;
+		if (lobe.Set(p))
+			target.Compare(lobe, cubed, l1);
+
+		LTCFitEntry& entry = _entries[(size_t)row * _desc.size + column];
+		entry.mat = { (float)p[0], (float)p[1], (float)p[2], (float)p[3] };
+		entry.amp = { (float)target.norm, (float)target.fresnel };
+		entry.error = (float)l1;
+		entry.seconds = (float)std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+float LTCFitter::Evaluate(const Float4& mat, int column, int row) const {
+	FitTarget target(GetAlpha(column), GetTheta(row), _desc.samples);
+	const double p[4] = { mat.x, mat.y, mat.z, mat.w };
+	Lobe lobe;
+	if (!lobe.Set(p))
+		return 2.0f;
+
+	double cubed, l1;
+	target.Compare(lobe, cubed, l1);
+	return (float)l1;
+}
+
+void LTCFitter::GetTables(vector<Float4>& mat, vector<Float4>& amp) const {
+	mat.resize(_entries.size());
+	amp.resize(_entries.size());
+	for (size_t i = 0; i < _entries.size(); i++) {
+		mat[i] = _entries[i].mat;
+		amp[i] = { _entries[i].amp.x, _entries[i].amp.y, 0, 1 };
+	}
+}
+
+#pragma endregion
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "CpuMath.h"
+#include "ThreadPool.h"
+#include <vector>
+
+using std::vector;
+
+// Smallest GGX alpha fitted, roughness 0 is clamped to it.
+#define LTC_MIN_ALPHA 0.0001f
+
+// Column u = roughness = i / (size - 1) with alpha = roughness^2, row
+// v = theta = j / (size - 1) * pi / 2, the lookup CalcRectLight does.
+struct LTCFitDesc {
+	int size;        // table width and height
+	int samples;     // per axis of the stratified sample grid, per distribution
+	int iterations;  // Nelder-Mead iterations per entry
+};
+
+// mat is the inverse LTC matrix as stored in ltc_mat.dds: normalized to
+// m00 = 1, holding (m22, m02, m11, m20) of the matrix the shaders build.
+// amp.x is the GGX directional albedo without Fresnel and amp.y its
+// Schlick part; the shaders only read amp.w, which the sampler fills with 1.
+struct LTCFitEntry {
+	Float4 mat;
+	Float2 amp;
+	float error;    // L1 distance between the normalized lobes, 0 = exact, 2 = disjoint
+	float seconds;  // fit time of this entry
+};
+
+// Fits GGX with linearly transformed cosines over (roughness, theta) by
+// minimizing a cubed-difference error with Nelder-Mead, as in Heitz et al.
+// 2016. Every roughness column is a sequential chain warm-started from the
+// previous theta, the columns run in parallel.
+class LTCFitter {
+public:
+	LTCFitter(const LTCFitDesc& desc);
+
+	void Fit(ThreadPool& pool);
+
+	// Same L1 error for any stored matrix, to score existing tables.
+	float Evaluate(const Float4& mat, int column, int row) const;
+
+	const LTCFitDesc& GetDesc() const { return _desc; }
+	const vector<LTCFitEntry>& GetEntries() const { return _entries; }
+	const LTCFitEntry& GetEntry(int column, int row) const { return _entries[(size_t)row * _desc.size + column]; }
+
+	// texels for WriteFloatDDS, amp with (x, y, 0, 1)
+	void GetTables(vector<Float4>& mat, vector<Float4>& amp) const;
+
+	float GetAlpha(int column) const;
+	float GetTheta(int row) const;
+
+private:
+	LTCFitDesc _desc;
+	vector<LTCFitEntry> _entries;
+
+	void FitColumn(int column);
+};
@@ -0,0 +1,210 @@
+#include "LightStore.h"
+#include "ClusterGrid.h"
+#include <algorithm>
+#include <cstring>
+
+// smallest structured buffer, in lights
+#define LIGHT_STORE_MIN_CAPACITY 64
+
+template<typename T>
+T& LightStore::LightArray<T>::Add() {
+	lights.emplace_back();
+	dirty.push_back(1);
+	dirtyList.push_back((uint32_t)(lights.size() - 1));
+	return lights.back();
+}
+
+template<typename T>
+T* LightStore::LightArray<T>::Edit(int index) {
+	if (index < 0 || index >= (int)lights.size())
+		return nullptr;
+	if (!dirty[index]) {
+		dirty[index] = 1;
+		dirtyList.push_back((uint32_t)index);
+	}
+	return &lights[index];
+}
+
+PointLight& LightStore::AddPointLight() {
+	_constantsStale = true;
+	return _points.Add();
+}
+
+SpotLight& LightStore::AddSpotLight() {
+	_constantsStale = true;
+	return _spots.Add();
+}
+
+RectLight& LightStore::AddRectLight() {
+	_constantsStale = true;
+	return _rects.Add();
+}
+
+DirLight* LightStore::AddDirLight() {
+	if (_constants.lightCounts[2] >= LIGHT_BUFFER_SIZE)
+		return nullptr;
+	DirLight& light = _constants.dirLights[_constants.lightCounts[2]++];
+	light = {};
+	return &light;
+}
+
+PolygonLight* LightStore::AddPolygonLight(const Float3* vertices, int count) {
+	if (count < 3 || count > POLYGON_LIGHT_MAX_VERTICES)
+		return nullptr;
+	_constantsStale = true;
+	PolygonLight& light = _polygons.Add();
+	light.Vertices[0] = (uint32_t)count;
+	light.Vertices[1] = (uint32_t)_vertices.lights.size();
+	for (int i = 0; i < count; i++)
+		_vertices.Add() = { vertices[i].x, vertices[i].y, vertices[i].z, 1.0f };
+	return &light;
+}
+
+DiskLight& LightStore::AddDiskLight() {
+	_constantsStale = true;
+	return _disks.Add();
+}
+
+SphereLight& LightStore::AddSphereLight() {
+	_constantsStale = true;
+	return _spheres.Add();
+}
+
+PointLight* LightStore::EditPointLight(int index) {
+	PointLight* light = _points.Edit(index);
+	_constantsStale |= light != nullptr;
+	return light;
+}
+
+SpotLight* LightStore::EditSpotLight(int index) {
+	SpotLight* light = _spots.Edit(index);
+	_constantsStale |= light != nullptr;
+	return light;
+}
+
+RectLight* LightStore::EditRectLight(int index) {
+	RectLight* light = _rects.Edit(index);
+	_constantsStale |= light != nullptr;
+	return light;
+}
+
+PolygonLight* LightStore::EditPolygonLight(int index) {
+	PolygonLight* light = _polygons.Edit(index);
+	_constantsStale |= light != nullptr;
+	return light;
+}
+
+Float4* LightStore::EditPolygonVertices(int index) {
+	PolygonLight* light = EditPolygonLight(index);
+	if (!light)
+		return nullptr;
+	for (uint32_t i = 0; i < light->Vertices[0]; i++)
+		_vertices.Edit((int)(light->Vertices[1] + i));
+	return &_vertices.lights[light->Vertices[1]];
+}
+
+DiskLight* LightStore::EditDiskLight(int index) {
+	DiskLight* light = _disks.Edit(index);
+	_constantsStale |= light != nullptr;
+	return light;
+}
+
+SphereLight* LightStore::EditSphereLight(int index) {
+	SphereLight* light = _spheres.Edit(index);
+	_constantsStale |= light != nullptr;
+	return light;
+}
+
+// written straight into the constants, which Flush compares anyway
+DirLight* LightStore::EditDirLight(int index) {
+	if (index < 0 || index >= _constants.lightCounts[2])
+		return nullptr;
+	return &_constants.dirLights[index];
+}
+
+uint32_t LightStore::GetLightMix() const {
+	uint32_t mix = 0;
+	if (!_points.lights.empty()) mix |= LIGHT_MIX_POINT;
+	if (!_spots.lights.empty()) mix |= LIGHT_MIX_SPOT;
+	if (_constants.lightCounts[2] > 0) mix |= LIGHT_MIX_DIR;
+	if (!_rects.lights.empty()) mix |= LIGHT_MIX_RECT;
+	if (!_polygons.lights.empty()) mix |= LIGHT_MIX_POLYGON;
+	if (!_disks.lights.empty()) mix |= LIGHT_MIX_DISK;
+	if (!_spheres.lights.empty()) mix |= LIGHT_MIX_SPHERE;
+	return mix;
+}
+
+void LightStore::UpdateConstants() {
+	if (!_constantsStale)
+		return;
+	Float3 ambient = SumLightAmbient(
+		_points.lights.data(), _points.lights.size(),
+		_spots.lights.data(), _spots.lights.size(),
+		_rects.lights.data(), _rects.lights.size());
+	_constants.lightAmbient = { ambient.x, ambient.y, ambient.z, 0 };
+	_constants.lightCounts[0] = (int32_t)_points.lights.size();
+	_constants.lightCounts[1] = (int32_t)_spots.lights.size();
+	_constants.lightCounts[3] = (int32_t)_rects.lights.size();
+	_constants.polygonCounts[0] = (int32_t)_polygons.lights.size();
+	_constants.polygonCounts[1] = (int32_t)_vertices.lights.size();
+	_constants.polygonCounts[2] = (int32_t)_disks.lights.size();
+	_constants.polygonCounts[3] = (int32_t)_spheres.lights.size();
+
+	// only edited polygons can have moved or changed their color
+	for (uint32_t i : _polygons.dirtyList)
+		BoundPolygonLight(_polygons.lights[i], &_vertices.lights[_polygons.lights[i].Vertices[1]]);
+	for (uint32_t i : _disks.dirtyList)
+		_disks.lights[i].Range = { DiskLightRange(_disks.lights[i]), 0, 0, 0 };
+	for (uint32_t i : _spheres.dirtyList)
+		_spheres.lights[i].Range = { SphereLightRange(_spheres.lights[i]), 0, 0, 0 };
+	_constantsStale = false;
+}
+
+size_t LightStore::Flush(const std::function<void(const LightUpload&)>& upload) {
+	// polygon bounds and round light ranges come from the dirty lists the arrays clear
+	UpdateConstants();
+	size_t bytes = FlushArray(_points, LightTarget::PointLights, upload);
+	bytes += FlushArray(_spots, LightTarget::SpotLights, upload);
+	bytes += FlushArray(_rects, LightTarget::RectLights, upload);
+	bytes += FlushArray(_polygons, LightTarget::PolygonLights, upload);
+	bytes += FlushArray(_vertices, LightTarget::PolygonVertices, upload);
+	bytes += FlushArray(_disks, LightTarget::DiskLights, upload);
+	bytes += FlushArray(_spheres, LightTarget::SphereLights, upload);
+
+	if (!_constantsCreated || memcmp(&_constants, &_uploadedConstants, sizeof(LightConstants)) != 0) {
+		upload({ LightTarget::Constants, &_constants, 0, sizeof(LightConstants), sizeof(LightConstants), 1, !_constantsCreated });
+		_uploadedConstants = _constants;
+		_constantsCreated = true;
+		bytes += sizeof(LightConstants);
+	}
+	return bytes;
+}
+
+// Dirty lights go out as runs of consecutive indices, one write per run.
+template<typename T>
+size_t LightStore::FlushArray(LightArray<T>& array, LightTarget target, const std::function<void(const LightUpload&)>& upload) {
+	size_t count = array.lights.size();
+	size_t bytes = 0;
+	if (array.capacity == 0 || count > array.capacity) {
+		size_t capacity = std::max<size_t>(array.capacity, LIGHT_STORE_MIN_CAPACITY);
+		while (capacity < count)
+			capacity *= 2;
+		array.capacity = capacity;
+		upload({ target, array.lights.data(), 0, count * sizeof(T), sizeof(T), capacity, true });
+		bytes = count * sizeof(T);
+	}
+	else if (!array.dirtyList.empty()) {
+		vector<uint32_t>& list = array.dirtyList;
+		std::sort(list.begin(), list.end());
+		for (size_t i = 0, run; i < list.size(); i += run) {
+			for (run = 1; i + run < list.size() && list[i + run] == list[i] + run; run++);
+			upload({ target, &array.lights[list[i]], list[i] * sizeof(T), run * sizeof(T), sizeof(T), array.capacity, false });
+			bytes += run * sizeof(T);
+		}
+	}
+
+	for (uint32_t i : array.dirtyList)
+		array.dirty[i] = 0;
+	array.dirtyList.clear();
+	return bytes;
+}
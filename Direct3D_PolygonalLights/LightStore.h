@@ -0,0 +1,118 @@
+#pragma once
+
+#include "Lights.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+using std::vector;
+
+// Matches the pixel shader's light constant buffer (b1)
+struct LightConstants {
+	Float4 lightAmbient;    // ambient terms of all point, spot and rect lights
+	int32_t lightCounts[4]; // point, spot, dir, rect
+	int32_t polygonCounts[4]; // polygon lights, their vertices, disk lights, sphere lights
+	DirLight dirLights[LIGHT_BUFFER_SIZE];
+};
+
+enum class LightTarget {
+	PointLights,
+	SpotLights,
+	RectLights,
+	PolygonLights,
+	PolygonVertices,
+	DiskLights,
+	SphereLights,
+	Constants
+};
+
+// One write Flush asks for: bytes at offset into the target's buffer. With
+// resize the buffer is recreated first, for capacity elements of stride.
+struct LightUpload {
+	LightTarget target;
+	const void* data;
+	size_t offset;
+	size_t bytes;
+	size_t stride;
+	size_t capacity;
+	bool resize;
+};
+
+// The renderer's lights and what changed since they were last uploaded.
+// Point, spot and rect lights live in structured buffers where only the runs
+// of edited lights are rewritten; a buffer is recreated, and written whole,
+// only when its array outgrows it. Directional lights, counts and the
+// ambient sum go to a constant buffer that is rewritten when its contents
+// differ from the last upload. Polygon lights keep their vertices packed in
+// one more array, so moving one rewrites only its own vertices.
+//
+// Edit* hands out a pointer to change the light through, so it marks the
+// light dirty whether or not the caller writes it.
+class LightStore {
+public:
+	PointLight& AddPointLight();
+	SpotLight& AddSpotLight();
+	RectLight& AddRectLight();
+	DirLight* AddDirLight(); // nullptr when all LIGHT_BUFFER_SIZE are taken
+	// nullptr unless 3 <= count <= POLYGON_LIGHT_MAX_VERTICES
+	PolygonLight* AddPolygonLight(const Float3* vertices, int count);
+	DiskLight& AddDiskLight();
+	SphereLight& AddSphereLight();
+
+	// nullptr out of range
+	PointLight* EditPointLight(int index);
+	SpotLight* EditSpotLight(int index);
+	RectLight* EditRectLight(int index);
+	DirLight* EditDirLight(int index);
+	PolygonLight* EditPolygonLight(int index);
+	// the light's Vertices[0] vertices, to move it
+	Float4* EditPolygonVertices(int index);
+	DiskLight* EditDiskLight(int index);
+	SphereLight* EditSphereLight(int index);
+
+	const vector<PointLight>& GetPointLights() const { return _points.lights; }
+	const vector<SpotLight>& GetSpotLights() const { return _spots.lights; }
+	const vector<RectLight>& GetRectLights() const { return _rects.lights; }
+	const vector<PolygonLight>& GetPolygonLights() const { return _polygons.lights; }
+	const vector<Float4>& GetPolygonVertices() const { return _vertices.lights; }
+	const vector<DiskLight>& GetDiskLights() const { return _disks.lights; }
+	const vector<SphereLight>& GetSphereLights() const { return _spheres.lights; }
+	// LightMix bits of the types with at least one light
+	uint32_t GetLightMix() const;
+
+	// Recomputes counts, ambient, polygon bounds and round light ranges if any
+	// light changed since.
+	void UpdateConstants();
+	const LightConstants& GetConstants() const { return _constants; }
+
+	// Updates the constants and calls upload for every write, arrays first;
+	// returns the bytes written.
+	size_t Flush(const std::function<void(const LightUpload&)>& upload);
+
+private:
+	template<typename T>
+	struct LightArray {
+		vector<T> lights;
+		vector<uint8_t> dirty;
+		vector<uint32_t> dirtyList; // unsorted, no duplicates
+		size_t capacity = 0;        // of the GPU buffer, 0 before the first Flush
+
+		T& Add();
+		T* Edit(int index);
+	};
+
+	LightArray<PointLight> _points;
+	LightArray<SpotLight> _spots;
+	LightArray<RectLight> _rects;
+	LightArray<PolygonLight> _polygons;
+	LightArray<Float4> _vertices;
+	LightArray<DiskLight> _disks;
+	LightArray<SphereLight> _spheres;
+	LightConstants _constants = {};
+	LightConstants _uploadedConstants = {};
+	bool _constantsStale = true;  // a light changed since UpdateConstants
+	bool _constantsCreated = false;
+
+	template<typename T>
+	size_t FlushArray(LightArray<T>& array, LightTarget target, const std::function<void(const LightUpload&)>& upload);
+};
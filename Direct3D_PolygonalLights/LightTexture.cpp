@@ -0,0 +1,353 @@
+#include "LightTexture.h"
+#include "DDSFile.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#define FORMAT_R32G32B32A32_FLOAT 2
+#define FORMAT_R8G8B8A8_UNORM 28
+
+// rows handed to one ParallelFor item
+#define FILTER_ROW_BLOCK 16
+
+#pragma region Helpers
+
+static float SrgbToLinear(float c) {
+	return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float LinearToSrgb(float c) {
+	c = Saturate(c);
+	return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+static void ResizeLevel(LightTextureLevel& level, int size) {
+	level.size = size;
+	level.r.assign((size_t)size * size, 0.0f);
+	level.g.assign((size_t)size * size, 0.0f);
+	level.b.assign((size_t)size * size, 0.0f);
+}
+
+// Normalized Gaussian taps -radius..radius, none when sigma is negligible
+static void GaussianWeights(float sigma, vector<float>& weights) {
+	weights.clear();
+	if (sigma < 0.05f)
+		return;
+
+	int radius = (int)std::ceil(3.0f * sigma);
+	float sum = 0.0f;
+	for (int i = -radius; i <= radius; i++) {
+		weights.push_back(std::exp(-0.5f * i * i / (sigma * sigma)));
+		sum += weights.back();
+	}
+	for (float& w : weights)
+		w /= sum;
+}
+
+#pragma endregion
+
+#pragma region Convolution
+
+// out[x] = sum_k weights[k] * in[x + k], in holding count + taps - 1 values
+template<int W>
+static void ConvolveRow(const float* in, float* out, int count, const float* weights, int taps) {
+	int x = 0;
+	for (; x + W <= count; x += W) {
+		SimdF<W> acc(0.0f);
+		for (int k = 0; k < taps; k++)
+			acc = acc + SimdF<W>(weights[k]) * SimdF<W>::Load(in + x + k);
+		acc.Store(out + x);
+	}
+	for (; x < count; x++) {
+		float acc = 0.0f;
+		for (int k = 0; k < taps; k++)
+			acc += weights[k] * in[x + k];
+		out[x] = acc;
+	}
+}
+
+// out[x] = sum_k weights[k] * rows[k][x]
+template<int W>
+static void ConvolveColumns(const float* const* rows, float* out, int count, const float* weights, int taps) {
+	int x = 0;
+	for (; x + W <= count; x += W) {
+		SimdF<W> acc(0.0f);
+		for (int k = 0; k < taps; k++)
+			acc = acc + SimdF<W>(weights[k]) * SimdF<W>::Load(rows[k] + x);
+		acc.Store(out + x);
+	}
+	for (; x < count; x++) {
+		float acc = 0.0f;
+		for (int k = 0; k < taps; k++)
+			acc += weights[k] * rows[k][x];
+		out[x] = acc;
+	}
+}
+
+// Separable blur of one plane in place, edges clamped
+static void BlurPlane(vector<float>& plane, int size, const vector<float>& weights, ThreadPool& pool) {
+	int taps = (int)weights.size();
+	int radius = taps / 2;
+	vector<float> temp(plane.size());
+
+	pool.ParallelFor((size + FILTER_ROW_BLOCK - 1) / FILTER_ROW_BLOCK, [&](size_t block) {
+		vector<float> padded(size + taps - 1);
+		int last = std::min(size, (int)(block + 1) * FILTER_ROW_BLOCK);
+		for (int y = (int)block * FILTER_ROW_BLOCK; y < last; y++) {
+			const float* row = &plane[(size_t)y * size];
+			for (int i = 0; i < size + taps - 1; i++)
+				padded[i] = row[std::min(std::max(i - radius, 0), size - 1)];
+			ConvolveRow<SIMD_WIDTH>(padded.data(), &temp[(size_t)y * size], size, weights.data(), taps);
+		}
+	});
+
+	pool.ParallelFor((size + FILTER_ROW_BLOCK - 1) / FILTER_ROW_BLOCK, [&](size_t block) {
+		vector<const float*> rows(taps);
+		int last = std::min(size, (int)(block + 1) * FILTER_ROW_BLOCK);
+		for (int y = (int)block * FILTER_ROW_BLOCK; y < last; y++) {
+			for (int k = 0; k < taps; k++)
+				rows[k] = &temp[(size_t)std::min(std::max(y + k - radius, 0), size - 1) * size];
+			ConvolveColumns<SIMD_WIDTH>(rows.data(), &plane[(size_t)y * size], size, weights.data(), taps);
+		}
+	});
+}
+
+static void BlurLevel(LightTextureLevel& level, float sigmaTexels, ThreadPool& pool) {
+	vector<float> weights;
+	GaussianWeights(sigmaTexels, weights);
+	if (weights.empty())
+		return;
+
+	for (vector<float>* plane : { &level.r, &level.g, &level.b })
+		BlurPlane(*plane, level.size, weights, pool);
+}
+
+// 2x2 box down to half the size
+static void HalveLevel(const LightTextureLevel& in, LightTextureLevel& out, ThreadPool& pool) {
+	int size = in.size / 2;
+	ResizeLevel(out, size);
+	pool.ParallelFor(size, [&](size_t y) {
+		for (int c = 0; c < 3; c++) {
+			const vector<float>& src = c == 0 ? in.r : (c == 1 ? in.g : in.b);
+			vector<float>& dst = c == 0 ? out.r : (c == 1 ? out.g : out.b);
+			const float* row0 = &src[(2 * y) * in.size];
+			const float* row1 = row0 + in.size;
+			float* row = &dst[y * size];
+			for (int x = 0; x < size; x++)
+				row[x] = 0.25f * (row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1]);
+		}
+	});
+}
+
+#pragma endregion
+
+#pragma region Filter
+
+float LightTextureSigma(int level) {
+	return std::pow(LIGHT_TEXTURE_LOD_BASE, (float)level) / LIGHT_TEXTURE_LOD_SCALE;
+}
+
+// Tent filter as wide as a source texel when magnifying and as a destination
+// texel when minifying, separable: rows first, then columns.
+void PlaceLightTexture(const vector<Float4>& source, int width, int height, int size,
+	ThreadPool& pool, LightTextureLevel& canvas)
+{
+	ResizeLevel(canvas, size);
+	int offset = (int)(size * LIGHT_TEXTURE_PADDING);
+	int inner = size - 2 * offset;
+
+	struct Tap {
+		int first;
+		vector<float> weights;
+	};
+	auto makeTaps = [inner](int sourceSize) {
+		vector<Tap> taps(inner);
+		float scale = (float)sourceSize / inner;
+		float radius = std::max(1.0f, scale);
+		for (int i = 0; i < inner; i++) {
+			float center = (i + 0.5f) * scale - 0.5f;
+			int first = (int)std::ceil(center - radius);
+			int last = (int)std::floor(center + radius);
+			float sum = 0.0f;
+			taps[i].first = first;
+			for (int s = first; s <= last; s++) {
+				float w = std::max(0.0f, 1.0f - std::fabs(s - center) / radius);
+				taps[i].weights.push_back(w);
+				sum += w;
+			}
+			for (float& w : taps[i].weights)
+				w = sum > 0.0f ? w / sum : 0.0f;
+		}
+		return taps;
+	};
+	vector<Tap> tapsX = makeTaps(width);
+	vector<Tap> tapsY = makeTaps(height);
+
+	// rows, source height x inner
+	vector<Float3> rows((size_t)height * inner);
+	pool.ParallelFor(height, [&](size_t y) {
+		const Float4* src = &source[y * width];
+		for (int x = 0; x < inner; x++) {
+			Float3 acc = { 0, 0, 0 };
+			for (size_t k = 0; k < tapsX[x].weights.size(); k++) {
+				const Float4& t = src[std::min(std::max(tapsX[x].first + (int)k, 0), width - 1)];
+				acc += Float3{ t.x, t.y, t.z } * tapsX[x].weights[k];
+			}
+			rows[y * inner + x] = acc;
+		}
+	});
+
+	pool.ParallelFor(inner, [&](size_t y) {
+		const Tap& tap = tapsY[y];
+		size_t out = (y + offset) * size + offset;
+		for (int x = 0; x < inner; x++) {
+			Float3 acc = { 0, 0, 0 };
+			for (size_t k = 0; k < tap.weights.size(); k++)
+				acc += rows[(size_t)std::min(std::max(tap.first + (int)k, 0), height - 1) * inner + x] * tap.weights[k];
+			canvas.r[out + x] = acc.x;
+			canvas.g[out + x] = acc.y;
+			canvas.b[out + x] = acc.z;
+		}
+	});
+}
+
+void PrefilterLightTexture(const vector<Float4>& source, int width, int height, int size,
+	ThreadPool& pool, vector<LightTextureLevel>& levels)
+{
+	int count = 1;
+	while ((size >> (count - 1)) > 1)
+		count++;
+	levels.resize(count);
+
+	PlaceLightTexture(source, width, height, size, pool, levels[0]);
+	BlurLevel(levels[0], LightTextureSigma(0) * size, pool);
+
+	for (int level = 1; level < count; level++) {
+		HalveLevel(levels[level - 1], levels[level], pool);
+
+		// the box adds a quarter of a texel of the level above
+		float above = 1.0f / levels[level - 1].size;
+		float variance = LightTextureSigma(level) * LightTextureSigma(level)
+			- LightTextureSigma(level - 1) * LightTextureSigma(level - 1) - 0.25f * above * above;
+		if (variance > 0.0f)
+			BlurLevel(levels[level], std::sqrt(variance) * levels[level].size, pool);
+	}
+}
+
+Float3 ReferenceLightTexel(const LightTextureLevel& canvas, int level, int x, int y) {
+	int levelSize = std::max(canvas.size >> level, 1);
+	float sigma = LightTextureSigma(level) * canvas.size;
+	float cx = (x + 0.5f) * canvas.size / levelSize - 0.5f;
+	float cy = (y + 0.5f) * canvas.size / levelSize - 0.5f;
+	int radius = (int)std::ceil(4.0f * sigma);
+
+	Float3 acc = { 0, 0, 0 };
+	float sum = 0.0f;
+	for (int sy = (int)cy - radius; sy <= (int)cy + radius; sy++) {
+		for (int sx = (int)cx - radius; sx <= (int)cx + radius; sx++) {
+			float dx = sx - cx, dy = sy - cy;
+			float w = std::exp(-0.5f * (dx * dx + dy * dy) / (sigma * sigma));
+			size_t i = (size_t)std::min(std::max(sy, 0), canvas.size - 1) * canvas.size + std::min(std::max(sx, 0), canvas.size - 1);
+			acc += Float3{ canvas.r[i], canvas.g[i], canvas.b[i] } * w;
+			sum += w;
+		}
+	}
+	return acc / sum;
+}
+
+#pragma endregion
+
+#pragma region Files
+
+bool WriteLightTextureDDS(const char* path, const vector<LightTextureLevel>& levels, bool floatTexels) {
+	if (levels.empty())
+		return false;
+
+	vector<uint8_t> bits;
+	for (const LightTextureLevel& level : levels) {
+		size_t texels = (size_t)level.size * level.size;
+		size_t offset = bits.size();
+		if (floatTexels) {
+			bits.resize(offset + texels * 4 * sizeof(float));
+			float* out = (float*)&bits[offset];
+			for (size_t i = 0; i < texels; i++) {
+				out[4 * i + 0] = level.r[i];
+				out[4 * i + 1] = level.g[i];
+				out[4 * i + 2] = level.b[i];
+				out[4 * i + 3] = 1.0f;
+			}
+		}
+		else {
+			bits.resize(offset + texels * 4);
+			uint8_t* out = &bits[offset];
+			for (size_t i = 0; i < texels; i++) {
+				out[4 * i + 0] = (uint8_t)(LinearToSrgb(level.r[i]) * 255.0f + 0.5f);
+				out[4 * i + 1] = (uint8_t)(LinearToSrgb(level.g[i]) * 255.0f + 0.5f);
+				out[4 * i + 2] = (uint8_t)(LinearToSrgb(level.b[i]) * 255.0f + 0.5f);
+				out[4 * i + 3] = 255;
+			}
+		}
+	}
+
+	return WriteDDS(path, levels[0].size, levels[0].size, (uint32_t)levels.size(),
+		floatTexels ? FORMAT_R32G32B32A32_FLOAT : FORMAT_R8G8B8A8_UNORM, bits.data(), bits.size());
+}
+
+// Next whitespace separated header token, skipping # comments
+static bool ReadPPMToken(FILE* file, int& value) {
+	int c = fgetc(file);
+	for (;;) {
+		while (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+			c = fgetc(file);
+		if (c != '#')
+			break;
+		while (c != '\n' && c != EOF)
+			c = fgetc(file);
+	}
+
+	if (c < '0' || c > '9')
+		return false;
+	value = 0;
+	while (c >= '0' && c <= '9') {
+		value = value * 10 + (c - '0');
+		c = fgetc(file);
+	}
+	return true; // the single whitespace after the token is consumed
+}
+
+bool ReadLightImage(const char* path, int& width, int& height, vector<Float4>& texels) {
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	char magic[2] = {};
+	if (fread(magic, 1, 2, file) != 2 || magic[0] != 'P' || magic[1] != '6') {
+		fclose(file);
+		return ReadFloatDDS(path, width, height, texels);
+	}
+
+	int maxValue;
+	bool ok = ReadPPMToken(file, width) && ReadPPMToken(file, height) && ReadPPMToken(file, maxValue)
+		&& width > 0 && height > 0 && maxValue > 0 && maxValue < 256;
+	vector<uint8_t> bytes;
+	if (ok) {
+		bytes.resize((size_t)width * height * 3);
+		ok = fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	}
+	fclose(file);
+	if (!ok)
+		return false;
+
+	float decode[256];
+	for (int i = 0; i < 256; i++)
+		decode[i] = SrgbToLinear((float)std::min(i, maxValue) / maxValue);
+
+	texels.resize((size_t)width * height);
+	for (size_t i = 0; i < texels.size(); i++)
+		texels[i] = { decode[bytes[3 * i]], decode[bytes[3 * i + 1]], decode[bytes[3 * i + 2]], 1.0f };
+	return true;
+}
+
+#pragma endregion
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "CpuMath.h"
+#include "ThreadPool.h"
+#include <vector>
+
+using std::vector;
+
+// FetchDiffuseFilteredTexture in PixelShader.hlsl looks the light texture up
+// at uv = 0.125 + 0.75 * Puv with lod = log(2048 * d) / log(3), so the
+// source fills the middle 75% and level lod is blurred over 3^lod / 2048.
+#define LIGHT_TEXTURE_PADDING 0.125f
+#define LIGHT_TEXTURE_LOD_SCALE 2048.0f
+#define LIGHT_TEXTURE_LOD_BASE 3.0f
+
+// One mip of the filtered pyramid, linear RGB in separate planes
+struct LightTextureLevel {
+	int size;
+	vector<float> r;
+	vector<float> g;
+	vector<float> b;
+};
+
+// Gaussian standard deviation in uv of a level
+float LightTextureSigma(int level);
+
+// Stretches the source over the middle of a size x size canvas, unblurred.
+void PlaceLightTexture(const vector<Float4>& source, int width, int height, int size,
+	ThreadPool& pool, LightTextureLevel& canvas);
+
+// Places the source as above (size a power of two) and builds the full mip
+// chain down to 1x1. Every level is the one above it halved and blurred by
+// the missing variance, with clamped edges like the sampler. Rows run in
+// parallel, the convolutions in SIMD lanes.
+void PrefilterLightTexture(const vector<Float4>& source, int width, int height, int size,
+	ThreadPool& pool, vector<LightTextureLevel>& levels);
+
+// Same level straight from the unfiltered canvas with one wide Gaussian, at
+// a single texel; slow, to check the incremental chain against.
+Float3 ReferenceLightTexel(const LightTextureLevel& canvas, int level, int x, int y);
+
+// R8G8B8A8 with sRGB encoded texels (Graphics loads it with forceSRGB), or
+// R32G32B32A32_FLOAT with linear ones; alpha is 1.
+bool WriteLightTextureDDS(const char* path, const vector<LightTextureLevel>& levels, bool floatTexels);
+
+// Binary PPM (P6, 8 bit, decoded from sRGB) or a float DDS ReadFloatDDS reads.
+bool ReadLightImage(const char* path, int& width, int& height, vector<Float4>& texels);
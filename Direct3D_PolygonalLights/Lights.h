@@ -0,0 +1,91 @@
+#pragma once
+
+#include "CpuMath.h"
+#include <cstdint>
+
+#define LIGHT_BUFFER_SIZE 10
+#define POLYGON_LIGHT_MAX_VERTICES 8
+
+// Light types a scene has at least one of. Shading kernels are specialized
+// per mix, so the loops of types without lights are compiled out: the
+// LIGHT_* defines of PixelShader.hlsl and the RenderTile instances of
+// SoftwareGraphics. LIGHT_MIX_ALL is the generic kernel.
+enum LightMix : uint32_t {
+	LIGHT_MIX_POINT = 1 << 0,
+	LIGHT_MIX_SPOT = 1 << 1,
+	LIGHT_MIX_DIR = 1 << 2,
+	LIGHT_MIX_RECT = 1 << 3,
+	LIGHT_MIX_POLYGON = 1 << 4,
+	LIGHT_MIX_DISK = 1 << 5,
+	LIGHT_MIX_SPHERE = 1 << 6,
+	LIGHT_MIX_ALL = (1 << 7) - 1
+};
+
+// Light layouts shared by the constant buffer, the pixel shader and the CPU
+// reference code. Every member is a float4 so the structs pack 1:1 into HLSL.
+
+struct PointLight {
+	Float4 Position;
+	Float4 Color;
+	Float4 Range; // x: radius of the windowed falloff, 0 for plain 1 / d^2
+};
+
+struct DirLight {
+	Float4 Direction;
+	Float4 Color;
+};
+
+struct SpotLight {
+	Float4 Position;
+	Float4 Direction;
+	Float4 Color;
+	Float4 Cone;
+	Float4 Range; // x: radius of the windowed falloff, 0 for plain 1 / d^2
+};
+
+struct RectLight {
+	Float4 Position;
+	Float4 Params; // Width, Height, RotY, RotZ
+	Float4 Color;
+};
+
+// A convex, planar, two-sided polygon of 3 to POLYGON_LIGHT_MAX_VERTICES
+// vertices. The vertices are world-space float4s in one buffer shared by all
+// polygon lights, Vertices.x of them starting at Vertices.y.
+struct PolygonLight {
+	Float4 Color;
+	Float4 Bounds;         // xyz: vertex centroid, w: centroid to cutoff, see BoundPolygonLight
+	uint32_t Vertices[4]; // count, first
+};
+
+// Round, two-sided area lights, shaded through their LTC-space ellipse with
+// no polygon clipping. Range is the cutoff distance from Position, set by
+// LightStore from color and size (see DiskLightRange / SphereLightRange).
+struct DiskLight {
+	Float4 Position;
+	Float4 Direction; // xyz: normal, w: radius
+	Float4 Color;
+	Float4 Range;
+};
+
+struct SphereLight {
+	Float4 Position; // xyz: center, w: radius
+	Float4 Color;
+	Float4 Range;
+};
+
+// Where rect lights are shaded as a disk instead of clipping and integrating
+// the quad: the disk facing the shading point with the solid angle the light
+// covers from it, its small-light limit. Each lobe has its own threshold on
+// the solid angle area / distance^2 the light covers at most, in LTC space
+// for the specular lobe: the LUT's matrix stretches it up to a factor per
+// shading point, large for smooth surfaces and about 1 for rough ones. Far
+// lights take both lobes from the disk, mid-range ones on rough surfaces
+// the specular one. Zeros, the default, shade every light exactly; see
+// LTC::FitRectLightLod for thresholds of a given error. One float4 in the
+// pixel shader's constants.
+struct RectLightLod {
+	float diffuseSolidAngle;
+	float specularSolidAngle;
+	float padding[2];
+};
@@ -0,0 +1,81 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+bool MappedFile::Open(const char* path) {
+	Close();
+	return Map(CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+}
+
+bool MappedFile::Open(const wchar_t* path) {
+	Close();
+	return Map(CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+}
+
+// The view keeps the file and the mapping object alive, both handles are closed here.
+bool MappedFile::Map(void* file) {
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size = {};
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && (unsigned long long)size.QuadPart <= SIZE_MAX)
+		mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping)
+		return false;
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!view)
+		return false;
+
+	_data = (const uint8_t*)view;
+	_size = (size_t)size.QuadPart;
+	return true;
+}
+
+void MappedFile::Close() {
+	if (_data)
+		UnmapViewOfFile(_data);
+	_data = nullptr;
+	_size = 0;
+}
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool MappedFile::Open(const char* path) {
+	Close();
+	int file = open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat info;
+	void* view = MAP_FAILED;
+	if (fstat(file, &info) == 0 && info.st_size > 0)
+		view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (view == MAP_FAILED)
+		return false;
+
+	_data = (const uint8_t*)view;
+	_size = (size_t)info.st_size;
+	return true;
+}
+
+void MappedFile::Close() {
+	if (_data)
+		munmap((void*)_data, _size);
+	_data = nullptr;
+	_size = 0;
+}
+
+#endif
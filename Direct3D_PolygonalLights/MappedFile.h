@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only view of a whole file. Parsers point straight into the mapped
+// pages instead of reading the file into a heap copy first; the pages are
+// paged in on first touch and dropped with the mapping.
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile() { Close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const char* path);
+#ifdef _WIN32
+	bool Open(const wchar_t* path);
+#endif
+	void Close();
+
+	const uint8_t* GetData() const { return _data; }
+	size_t GetSize() const { return _size; }
+	bool IsOpen() const { return _data != nullptr; }
+
+private:
+	const uint8_t* _data = nullptr;
+	size_t _size = 0;
+
+#ifdef _WIN32
+	bool Map(void* file);
+#endif
+};
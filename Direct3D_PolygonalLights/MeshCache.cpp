@@ -0,0 +1,225 @@
+#include "MeshCache.h"
+#include <algorithm>
+#include <cmath>
+
+// vertices a 16-bit index can reach from its base vertex
+#define CHUNK_VERTICES 65536u
+
+bool SplitIndices(const unsigned int* indices, size_t count, vector<IndexChunk>& chunks, vector<unsigned short>& rebased) {
+	chunks.clear();
+	rebased.clear();
+	count -= count % 3;
+	rebased.reserve(count);
+
+	// grow the chunk a triangle at a time until its vertex range would not fit
+	IndexChunk chunk = { 0, 0, 0, 0 };
+	unsigned int low = 0, high = 0;
+	for (size_t i = 0; i < count; i += 3) {
+		unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+		unsigned int triangleLow = std::min(a, std::min(b, c));
+		unsigned int triangleHigh = std::max(a, std::max(b, c));
+		if (triangleHigh - triangleLow >= CHUNK_VERTICES)
+			return false;
+
+		if (chunk.indexCount > 0 && std::max(high, triangleHigh) - std::min(low, triangleLow) >= CHUNK_VERTICES) {
+			chunk.baseVertex = low;
+			chunk.vertexCount = high - low + 1;
+			chunks.push_back(chunk);
+			chunk.firstIndex = i;
+			chunk.indexCount = 0;
+		}
+		low = chunk.indexCount == 0 ? triangleLow : std::min(low, triangleLow);
+		high = chunk.indexCount == 0 ? triangleHigh : std::max(high, triangleHigh);
+		chunk.indexCount += 3;
+	}
+	if (chunk.indexCount > 0) {
+		chunk.baseVertex = low;
+		chunk.vertexCount = high - low + 1;
+		chunks.push_back(chunk);
+	}
+
+	for (const IndexChunk& c : chunks)
+		for (size_t i = c.firstIndex; i < c.firstIndex + c.indexCount; i++)
+			rebased.push_back((unsigned short)(indices[i] - c.baseVertex));
+	return true;
+}
+
+MeshCache::MeshCache(RenderDevice& device, size_t dynamicVertices, size_t dynamicIndices)
+	: _device(device)
+{
+	_vertexRing.kind = BufferKind::Vertex;
+	_vertexRing.stride = sizeof(Vertex);
+	_vertexRing.capacity = dynamicVertices;
+	_vertexRing.buffer = _device.CreateBuffer(BufferKind::Vertex, dynamicVertices * sizeof(Vertex), nullptr, true);
+
+	_indexRing.kind = BufferKind::Index;
+	_indexRing.stride = sizeof(unsigned short);
+	_indexRing.capacity = dynamicIndices;
+	_indexRing.buffer = _device.CreateBuffer(BufferKind::Index, dynamicIndices * sizeof(unsigned short), nullptr, true);
+}
+
+MeshCache::~MeshCache() {
+	for (const Mesh& mesh : _meshes) {
+		_device.ReleaseBuffer(mesh.vertexBuffer);
+		_device.ReleaseBuffer(mesh.indexBuffer);
+	}
+	_device.ReleaseBuffer(_vertexRing.buffer);
+	_device.ReleaseBuffer(_indexRing.buffer);
+}
+
+MeshHandle MeshCache::Register(const vector<Vertex>& vertices, const vector<unsigned int>& indices) {
+	return Add(BufferKind::Vertex, vertices.data(), vertices.size() * sizeof(Vertex), indices.data(), indices.size());
+}
+
+MeshHandle MeshCache::Register(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount) {
+	return Add(BufferKind::Vertex, vertices, vertexCount * sizeof(Vertex), indices, indexCount);
+}
+
+MeshHandle MeshCache::Register(const vector<PackedVertex>& vertices, const vector<unsigned int>& indices) {
+	return Add(BufferKind::PackedVertex, vertices.data(), vertices.size() * sizeof(PackedVertex), indices.data(), indices.size());
+}
+
+// Both vertex layouts start with float x, y, z; centered on the box, which
+// is close enough for culling.
+static Float4 BoundingSphere(const void* vertices, size_t vertexBytes, size_t stride) {
+	const unsigned char* first = (const unsigned char*)vertices;
+	size_t count = vertexBytes / stride;
+	Float3 lo = { 1e30f, 1e30f, 1e30f }, hi = { -1e30f, -1e30f, -1e30f };
+	for (size_t i = 0; i < count; i++) {
+		const float* p = (const float*)(first + i * stride);
+		lo = { std::min(lo.x, p[0]), std::min(lo.y, p[1]), std::min(lo.z, p[2]) };
+		hi = { std::max(hi.x, p[0]), std::max(hi.y, p[1]), std::max(hi.z, p[2]) };
+	}
+	Float3 center = (lo + hi) * 0.5f;
+	float radiusSq = 0.0f;
+	for (size_t i = 0; i < count; i++) {
+		const float* p = (const float*)(first + i * stride);
+		Float3 d = Float3{ p[0], p[1], p[2] } - center;
+		radiusSq = std::max(radiusSq, Dot(d, d));
+	}
+	return { center.x, center.y, center.z, std::sqrt(radiusSq) };
+}
+
+MeshHandle MeshCache::Add(BufferKind kind, const void* vertices, size_t vertexBytes, const unsigned int* indices, size_t indexCount) {
+	if (vertexBytes == 0 || indexCount < 3)
+		throw meshException("Empty mesh");
+
+	Mesh mesh;
+	if (SplitIndices(indices, indexCount, mesh.chunks, _rebased))
+		mesh.indexBuffer = _device.CreateBuffer(BufferKind::Index, _rebased.size() * sizeof(unsigned short), _rebased.data(), false);
+	else {
+		mesh.chunks.assign(1, { 0, indexCount - indexCount % 3, 0, 0 });
+		mesh.indexBuffer = _device.CreateBuffer(BufferKind::Index32, indexCount * sizeof(unsigned int), indices, false);
+	}
+	mesh.vertexBuffer = _device.CreateBuffer(kind, vertexBytes, vertices, false);
+	mesh.bounds = BoundingSphere(vertices, vertexBytes, kind == BufferKind::PackedVertex ? sizeof(PackedVertex) : sizeof(Vertex));
+
+	MeshHandle handle;
+	if (!_free.empty()) {
+		handle.id = _free.back();
+		_free.pop_back();
+		_meshes[handle.id - 1] = mesh;
+	}
+	else {
+		_meshes.push_back(mesh);
+		handle.id = (unsigned int)_meshes.size();
+	}
+	return handle;
+}
+
+void MeshCache::Release(MeshHandle mesh) {
+	GetMesh(mesh);
+	Mesh& m = _meshes[mesh.id - 1];
+	_device.ReleaseBuffer(m.vertexBuffer);
+	_device.ReleaseBuffer(m.indexBuffer);
+	m = Mesh();
+	_free.push_back(mesh.id);
+}
+
+void MeshCache::Draw(MeshHandle mesh, unsigned int objectIndex, unsigned int instanceCount) {
+	GetMesh(mesh);
+	if (instanceCount > 0)
+		_queue.push_back({ mesh, objectIndex, instanceCount, 0, 0, 0, 0 });
+}
+
+void MeshCache::DrawDynamic(const vector<Vertex>& vertices, const vector<unsigned int>& indices) {
+	if (indices.size() < 3)
+		return;
+
+	size_t firstVertex = _stagedVertices.size();
+	if (SplitIndices(indices.data(), indices.size(), _chunks, _rebased)) {
+		for (const IndexChunk& chunk : _chunks)
+			if ((size_t)chunk.baseVertex + chunk.vertexCount > vertices.size())
+				throw meshException("Index past the vertex buffer");
+		_stagedVertices.insert(_stagedVertices.end(), vertices.begin(), vertices.end());
+	}
+	else {
+		// a triangle too wide for 16 bits: give every index its own vertex,
+		// then every triangle spans three
+		size_t count = indices.size() - indices.size() % 3;
+		_expanded.resize(count);
+		for (size_t i = 0; i < count; i++) {
+			_stagedVertices.push_back(vertices.at(indices[i]));
+			_expanded[i] = (unsigned int)i;
+		}
+		SplitIndices(_expanded.data(), count, _chunks, _rebased);
+	}
+
+	for (const IndexChunk& chunk : _chunks)
+		_queue.push_back({ MeshHandle(), 0, 1, firstVertex + chunk.baseVertex, chunk.vertexCount, _stagedIndices.size() + chunk.firstIndex, chunk.indexCount });
+	_stagedIndices.insert(_stagedIndices.end(), _rebased.begin(), _rebased.end());
+}
+
+void MeshCache::Flush() {
+	for (const DrawItem& item : _queue) {
+		if (item.mesh.IsValid()) {
+			const Mesh& mesh = GetMesh(item.mesh);
+			for (const IndexChunk& chunk : mesh.chunks)
+				_device.DrawIndexed(mesh.vertexBuffer, mesh.indexBuffer, (unsigned int)chunk.indexCount, (unsigned int)chunk.firstIndex, (int)chunk.baseVertex, item.objectIndex, item.instanceCount);
+			continue;
+		}
+
+		// written right before its draw, so a ring wrap only orphans data of issued draws
+		size_t baseVertex = Push(_vertexRing, &_stagedVertices[item.firstVertex], item.vertexCount);
+		size_t firstIndex = Push(_indexRing, &_stagedIndices[item.firstIndex], item.indexCount);
+		_device.DrawIndexed(_vertexRing.buffer, _indexRing.buffer, (unsigned int)item.indexCount, (unsigned int)firstIndex, (int)baseVertex, 0u);
+	}
+
+	_queue.clear();
+	_stagedVertices.clear();
+	_stagedIndices.clear();
+}
+
+size_t MeshCache::GetChunkCount(MeshHandle mesh) const {
+	if (!mesh.IsValid() || mesh.id > _meshes.size())
+		return 0;
+	return _meshes[mesh.id - 1].chunks.size();
+}
+
+const MeshCache::Mesh& MeshCache::GetMesh(MeshHandle mesh) const {
+	if (!mesh.IsValid() || mesh.id > _meshes.size() || _meshes[mesh.id - 1].chunks.empty())
+		throw meshException("Invalid mesh handle");
+	return _meshes[mesh.id - 1];
+}
+
+// Appends count elements and returns the element offset they landed at.
+size_t MeshCache::Push(Ring& ring, const void* data, size_t count) {
+	if (count > ring.capacity) {
+		// only grows on a frame bigger than anything seen before
+		_device.ReleaseBuffer(ring.buffer);
+		ring.capacity = std::max(count, ring.capacity * 2);
+		ring.buffer = _device.CreateBuffer(ring.kind, ring.capacity * ring.stride, nullptr, true);
+		ring.head = 0;
+		ring.discard = true;
+	}
+	else if (ring.head + count > ring.capacity) {
+		ring.head = 0;
+		ring.discard = true;
+	}
+
+	size_t offset = ring.head;
+	_device.WriteBuffer(ring.buffer, offset * ring.stride, data, count * ring.stride, ring.discard);
+	ring.head += count;
+	ring.discard = false;
+	return offset;
+}
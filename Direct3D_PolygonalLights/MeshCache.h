@@ -0,0 +1,119 @@
+#pragma once
+
+#include "CpuMath.h"
+#include "RenderDevice.h"
+#include "Vertex.h"
+#include <exception>
+#include <vector>
+
+using std::exception;
+using std::vector;
+
+struct MeshHandle {
+	unsigned int id = 0;
+	bool IsValid() const { return id != 0; }
+};
+
+// A run of triangles whose vertices all lie in [baseVertex, baseVertex + vertexCount),
+// vertexCount at most 65536, so 16-bit indices relative to baseVertex reach them.
+struct IndexChunk {
+	size_t firstIndex;
+	size_t indexCount;
+	unsigned int baseVertex;
+	unsigned int vertexCount;
+};
+
+// Splits a triangle list into consecutive chunks and writes their indices
+// relative to each chunk's baseVertex. Trailing indices that do not make a
+// triangle are dropped. False when one triangle alone spans more than 65536
+// vertices, which only 32-bit indices can draw.
+bool SplitIndices(const unsigned int* indices, size_t count, vector<IndexChunk>& chunks, vector<unsigned short>& rebased);
+
+// Static geometry is uploaded once by Register and drawn by handle. Geometry
+// that really changes every frame goes through DrawDynamic, which streams it
+// into a ring of dynamic buffers. Draws are queued and issued by Flush, so
+// the caller can finish its constant buffers first. After the first frame
+// the steady state makes no buffer allocations.
+//
+// Indices come in 32-bit. The GPU gets 16-bit ones wherever SplitIndices can
+// cut the mesh into chunks, one draw per chunk with its own base vertex;
+// static meshes it cannot cut keep 32-bit indices, dynamic ones are expanded
+// to one vertex per index first.
+class MeshCache {
+public:
+	MeshCache(RenderDevice& device, size_t dynamicVertices = 1 << 16, size_t dynamicIndices = 1 << 17);
+	~MeshCache();
+	MeshCache(const MeshCache&) = delete;
+	MeshCache& operator=(const MeshCache&) = delete;
+
+	// Vertices are tagged with object index 0; Draw supplies the real one.
+	MeshHandle Register(const vector<Vertex>& vertices, const vector<unsigned int>& indices);
+	// Straight from memory the caller keeps, such as an ImportedMesh mapping
+	MeshHandle Register(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount);
+	// Half the vertex bytes, see VertexPacking.h
+	MeshHandle Register(const vector<PackedVertex>& vertices, const vector<unsigned int>& indices);
+	void Release(MeshHandle mesh);
+
+	// instanceCount objects from objectIndex on, in one draw
+	void Draw(MeshHandle mesh, unsigned int objectIndex, unsigned int instanceCount = 1);
+	// Vertices keep their own object indices
+	void DrawDynamic(const vector<Vertex>& vertices, const vector<unsigned int>& indices);
+	void Flush();
+
+	size_t GetMeshCount() const { return _meshes.size() - _free.size(); }
+	// draws Flush issues for the mesh, 0 for an invalid handle
+	size_t GetChunkCount(MeshHandle mesh) const;
+	// model-space sphere around the vertices, center xyz and radius w
+	Float4 GetBoundingSphere(MeshHandle mesh) const { return GetMesh(mesh).bounds; }
+	const DeviceStats& GetStats() const { return _device.GetStats(); }
+
+private:
+	struct Mesh {
+		BufferHandle vertexBuffer = 0;
+		BufferHandle indexBuffer = 0; // 16-bit with chunks or 32-bit as one chunk
+		vector<IndexChunk> chunks;
+		Float4 bounds = { 0, 0, 0, 0 };
+	};
+
+	struct Ring {
+		BufferKind kind;
+		size_t stride;
+		BufferHandle buffer = 0;
+		size_t capacity = 0; // elements
+		size_t head = 0;
+		bool discard = true;
+	};
+
+	// mesh.id == 0 for dynamic draws, which index into the staging arrays
+	struct DrawItem {
+		MeshHandle mesh;
+		unsigned int objectIndex;
+		unsigned int instanceCount;
+		size_t firstVertex, vertexCount;
+		size_t firstIndex, indexCount;
+	};
+
+	RenderDevice& _device;
+	vector<Mesh> _meshes;
+	vector<unsigned int> _free;
+	vector<DrawItem> _queue;
+	vector<Vertex> _stagedVertices;
+	vector<unsigned short> _stagedIndices;
+	vector<IndexChunk> _chunks;
+	vector<unsigned short> _rebased;
+	vector<unsigned int> _expanded;
+	Ring _vertexRing;
+	Ring _indexRing;
+
+	MeshHandle Add(BufferKind kind, const void* vertices, size_t vertexBytes, const unsigned int* indices, size_t indexCount);
+	const Mesh& GetMesh(MeshHandle mesh) const;
+	size_t Push(Ring& ring, const void* data, size_t count);
+
+	class meshException : public exception {
+	private:
+		const char* _message;
+	public:
+		meshException(const char* message) : _message(message) {}
+		const char* what() const throw () { return _message; }
+	};
+};
@@ -0,0 +1,101 @@
+#include "MeshFile.h"
+#include <cstring>
+#include <fstream>
+
+#define MESH_MAGIC 0x4853454d // "MESH"
+#define MESH_VERSION 1
+// the vertices start here, so they are aligned in the mapping
+#define MESH_HEADER_SIZE 64
+
+static uint32_t ReadU32(const uint8_t* data, size_t offset) {
+	uint32_t v;
+	memcpy(&v, data + offset, sizeof(v));
+	return v;
+}
+
+static uint64_t ReadU64(const uint8_t* data, size_t offset) {
+	uint64_t v;
+	memcpy(&v, data + offset, sizeof(v));
+	return v;
+}
+
+static void WriteU32(vector<char>& data, size_t offset, uint32_t v) {
+	memcpy(data.data() + offset, &v, sizeof(v));
+}
+
+static void WriteU64(vector<char>& data, size_t offset, uint64_t v) {
+	memcpy(data.data() + offset, &v, sizeof(v));
+}
+
+bool ParseMeshFile(const uint8_t* data, size_t size, MeshFileInfo& info) {
+	if (!data || size < MESH_HEADER_SIZE)
+		return false;
+	if (ReadU32(data, 0) != MESH_MAGIC || ReadU32(data, 4) != MESH_VERSION || ReadU32(data, 8) != sizeof(Vertex))
+		return false;
+
+	uint64_t vertexCount = ReadU64(data, 16);
+	uint64_t indexCount = ReadU64(data, 24);
+	uint64_t subMeshCount = ReadU64(data, 32);
+	info.sourceSize = ReadU64(data, 40);
+	info.sourceTime = ReadU64(data, 48);
+
+	size_t offset = MESH_HEADER_SIZE;
+	if (vertexCount > (size - offset) / sizeof(Vertex))
+		return false;
+	info.vertices = (const Vertex*)(data + offset);
+	info.vertexCount = (size_t)vertexCount;
+	offset += info.vertexCount * sizeof(Vertex);
+
+	if (indexCount > (size - offset) / sizeof(unsigned int))
+		return false;
+	info.indices = (const unsigned int*)(data + offset);
+	info.indexCount = (size_t)indexCount;
+	offset += info.indexCount * sizeof(unsigned int);
+
+	info.subMeshes.clear();
+	for (uint64_t i = 0; i < subMeshCount; i++) {
+		if (size - offset < 12)
+			return false;
+		SubMesh subMesh;
+		subMesh.firstIndex = ReadU32(data, offset);
+		subMesh.indexCount = ReadU32(data, offset + 4);
+		uint32_t nameLength = ReadU32(data, offset + 8);
+		offset += 12;
+		if (size - offset < nameLength || (uint64_t)subMesh.firstIndex + subMesh.indexCount > indexCount)
+			return false;
+		subMesh.material.assign((const char*)data + offset, nameLength);
+		offset += nameLength;
+		info.subMeshes.push_back(std::move(subMesh));
+	}
+	return true;
+}
+
+bool WriteMeshFile(const char* path, const MeshData& mesh, uint64_t sourceSize, uint64_t sourceTime) {
+	vector<char> header(MESH_HEADER_SIZE, 0);
+	WriteU32(header, 0, MESH_MAGIC);
+	WriteU32(header, 4, MESH_VERSION);
+	WriteU32(header, 8, sizeof(Vertex));
+	WriteU64(header, 16, mesh.vertices.size());
+	WriteU64(header, 24, mesh.indices.size());
+	WriteU64(header, 32, mesh.subMeshes.size());
+	WriteU64(header, 40, sourceSize);
+	WriteU64(header, 48, sourceTime);
+
+	vector<char> subMeshes;
+	for (const SubMesh& subMesh : mesh.subMeshes) {
+		size_t offset = subMeshes.size();
+		subMeshes.resize(offset + 12 + subMesh.material.size());
+		memcpy(&subMeshes[offset], &subMesh.firstIndex, 4);
+		memcpy(&subMeshes[offset + 4], &subMesh.indexCount, 4);
+		uint32_t nameLength = (uint32_t)subMesh.material.size();
+		memcpy(&subMeshes[offset + 8], &nameLength, 4);
+		memcpy(subMeshes.data() + offset + 12, subMesh.material.data(), nameLength);
+	}
+
+	std::ofstream file(path, std::ios::binary);
+	return file
+		&& file.write(header.data(), header.size())
+		&& file.write((const char*)mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex))
+		&& file.write((const char*)mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int))
+		&& file.write(subMeshes.data(), subMeshes.size()) ? true : false;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Vertex.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using std::vector;
+
+// A range of indices drawn with one material
+struct SubMesh {
+	std::string material;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
+
+// Geometry in the project's own format, as the importers produce it
+struct MeshData {
+	vector<Vertex> vertices;
+	vector<unsigned int> indices;
+	vector<SubMesh> subMeshes;
+};
+
+// Fields of a binary mesh file parsed in place; vertices and indices point
+// into the caller's buffer (usually a MappedFile), only the submesh names
+// are copied. sourceSize and sourceTime identify the file it was built from.
+struct MeshFileInfo {
+	uint64_t sourceSize;
+	uint64_t sourceTime;
+	const Vertex* vertices;
+	size_t vertexCount;
+	const unsigned int* indices;
+	size_t indexCount;
+	vector<SubMesh> subMeshes;
+};
+
+// False for other files, other versions and a Vertex layout of another size.
+bool ParseMeshFile(const uint8_t* data, size_t size, MeshFileInfo& info);
+
+// Header, vertices and indices in memory order, then the submeshes.
+bool WriteMeshFile(const char* path, const MeshData& mesh, uint64_t sourceSize, uint64_t sourceTime);
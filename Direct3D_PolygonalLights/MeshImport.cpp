@@ -0,0 +1,1081 @@
+#include "MeshImport.h"
+#include "CpuMath.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// OBJ bytes per parse range
+#define OBJ_RANGE_BYTES (1 << 20)
+
+// glTF constants
+#define GLB_MAGIC 0x46546c67 // "glTF"
+#define GLB_CHUNK_JSON 0x4e4f534a
+#define GLB_CHUNK_BIN 0x004e4942
+#define GLTF_BYTE 5120
+#define GLTF_UNSIGNED_BYTE 5121
+#define GLTF_SHORT 5122
+#define GLTF_UNSIGNED_SHORT 5123
+#define GLTF_UNSIGNED_INT 5125
+#define GLTF_FLOAT 5126
+#define GLTF_TRIANGLES 4
+#define GLTF_TRIANGLE_STRIP 5
+#define GLTF_TRIANGLE_FAN 6
+
+static std::string Directory(const char* path) {
+	std::string directory(path);
+	size_t slash = directory.find_last_of("/\\");
+	return slash == std::string::npos ? std::string() : directory.substr(0, slash + 1);
+}
+
+static bool HasExtension(const char* path, const char* extension) {
+	size_t length = strlen(path), extensionLength = strlen(extension);
+	if (length < extensionLength)
+		return false;
+	for (size_t i = 0; i < extensionLength; i++)
+		if (tolower((unsigned char)path[length - extensionLength + i]) != extension[i])
+			return false;
+	return true;
+}
+
+// Adds the face normals of every triangle to the vertices flagged in missing
+// (area weighted, as the cross product comes), then normalizes those.
+static void GenerateNormals(vector<Vertex>& vertices, const unsigned int* indices, size_t indexCount, const vector<uint8_t>& missing) {
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		Vertex* v[3] = { &vertices[indices[i]], &vertices[indices[i + 1]], &vertices[indices[i + 2]] };
+		if (!missing[indices[i]] && !missing[indices[i + 1]] && !missing[indices[i + 2]])
+			continue;
+		Float3 a = { v[0]->x, v[0]->y, v[0]->z }, b = { v[1]->x, v[1]->y, v[1]->z }, c = { v[2]->x, v[2]->y, v[2]->z };
+		// clockwise front faces in left-handed space
+		Float3 normal = Cross(b - a, c - a);
+		for (int k = 0; k < 3; k++) {
+			if (!missing[indices[i + k]])
+				continue;
+			v[k]->nx += normal.x;
+			v[k]->ny += normal.y;
+			v[k]->nz += normal.z;
+		}
+	}
+	for (size_t i = 0; i < vertices.size(); i++) {
+		if (!missing[i])
+			continue;
+		Vertex& v = vertices[i];
+		float length = std::sqrt(v.nx * v.nx + v.ny * v.ny + v.nz * v.nz);
+		if (length > 0) {
+			v.nx /= length;
+			v.ny /= length;
+			v.nz /= length;
+		}
+		else
+			v.ny = 1.0f;
+	}
+}
+
+// Appends the submesh, or grows the previous one when the material is the same.
+static void AddSubMesh(vector<SubMesh>& subMeshes, const std::string& material, uint32_t firstIndex, uint32_t indexCount) {
+	if (indexCount == 0)
+		return;
+	if (!subMeshes.empty() && subMeshes.back().material == material && subMeshes.back().firstIndex + subMeshes.back().indexCount == firstIndex)
+		subMeshes.back().indexCount += indexCount;
+	else
+		subMeshes.push_back({ material, firstIndex, indexCount });
+}
+
+// Joins separately built pieces: vertices copied in parallel, indices offset.
+static void Concatenate(vector<MeshData>& pieces, ThreadPool& pool, MeshData& mesh) {
+	vector<size_t> firstVertex(pieces.size() + 1, 0), firstIndex(pieces.size() + 1, 0);
+	for (size_t i = 0; i < pieces.size(); i++) {
+		firstVertex[i + 1] = firstVertex[i] + pieces[i].vertices.size();
+		firstIndex[i + 1] = firstIndex[i] + pieces[i].indices.size();
+	}
+
+	mesh.vertices.resize(firstVertex.back());
+	mesh.indices.resize(firstIndex.back());
+	pool.ParallelFor(pieces.size(), [&](size_t i) {
+		std::copy(pieces[i].vertices.begin(), pieces[i].vertices.end(), mesh.vertices.begin() + firstVertex[i]);
+		unsigned int offset = (unsigned int)firstVertex[i];
+		unsigned int* out = mesh.indices.data() + firstIndex[i];
+		for (unsigned int index : pieces[i].indices)
+			*out++ = index + offset;
+	});
+
+	mesh.subMeshes.clear();
+	for (size_t i = 0; i < pieces.size(); i++)
+		for (const SubMesh& subMesh : pieces[i].subMeshes)
+			AddSubMesh(mesh.subMeshes, subMesh.material, (uint32_t)firstIndex[i] + subMesh.firstIndex, subMesh.indexCount);
+	pieces.clear();
+}
+
+#pragma region OBJ
+
+struct ObjCorner {
+	int position, uv, normal; // -1 when absent
+	int material;             // into the range's material names
+};
+
+struct ObjCornerHash {
+	size_t operator()(const ObjCorner& c) const {
+		return ((size_t)c.position * 73856093u) ^ ((size_t)c.uv * 19349663u) ^ ((size_t)c.normal * 83492791u) ^ (size_t)c.material;
+	}
+};
+
+inline bool operator==(const ObjCorner& a, const ObjCorner& b) {
+	return a.position == b.position && a.uv == b.uv && a.normal == b.normal && a.material == b.material;
+}
+
+// One line-aligned slice of the file
+struct ObjRange {
+	const char* begin;
+	const char* end;
+	size_t positions = 0, uvs = 0, normals = 0; // counted by the first pass
+	size_t firstPosition = 0, firstUV = 0, firstNormal = 0;
+	std::string lastMaterial; // last usemtl in the range, "" for none
+	std::string mtllib;
+
+	vector<std::string> materials; // [0] is the material active at the start
+	vector<ObjCorner> triangles;   // three corners each
+	vector<std::pair<int, size_t>> materialRuns; // material, first triangle
+	MeshData piece;
+};
+
+static const char* SkipSpaces(const char* p, const char* end) {
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	return p;
+}
+
+static const char* LineEnd(const char* p, const char* end) {
+	const char* newline = (const char*)memchr(p, '\n', end - p);
+	return newline ? newline : end;
+}
+
+// The rest of the line without surrounding blanks
+static std::string LineRest(const char* p, const char* end) {
+	p = SkipSpaces(p, end);
+	while (end > p && (end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t'))
+		end--;
+	return std::string(p, end);
+}
+
+// Decimal with optional sign, fraction and exponent; enough precision for geometry.
+static bool ParseFloat(const char*& p, const char* end, float& value) {
+	p = SkipSpaces(p, end);
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+
+	double mantissa = 0;
+	int digits = 0, exponent = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+		mantissa = mantissa * 10 + (*p - '0');
+	if (p < end && *p == '.') {
+		for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++, exponent--)
+			mantissa = mantissa * 10 + (*p - '0');
+	}
+	if (digits == 0)
+		return false;
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		bool negativeExponent = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negativeExponent = *p++ == '-';
+		int e = 0;
+		for (; p < end && *p >= '0' && *p <= '9'; p++)
+			e = std::min(e * 10 + (*p - '0'), 1000);
+		exponent += negativeExponent ? -e : e;
+	}
+
+	double result = exponent == 0 ? mantissa : mantissa * std::pow(10.0, exponent);
+	value = (float)(negative ? -result : result);
+	return true;
+}
+
+static bool ParseInt(const char*& p, const char* end, int& value) {
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+	if (p >= end || *p < '0' || *p > '9')
+		return false;
+	long long v = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; p++)
+		v = std::min(v * 10 + (*p - '0'), (long long)INT32_MAX);
+	value = (int)(negative ? -v : v);
+	return true;
+}
+
+// 1-based or negative (relative to the count so far) to 0-based, -1 when invalid
+static int ResolveObjIndex(int index, size_t countSoFar) {
+	if (index > 0)
+		return index - 1;
+	if (index < 0 && (size_t)-index <= countSoFar)
+		return (int)(countSoFar + index);
+	return -1;
+}
+
+// Counts elements and notes the materials, without parsing numbers.
+static void CountObjRange(ObjRange& range) {
+	for (const char* p = range.begin; p < range.end;) {
+		const char* end = LineEnd(p, range.end);
+		const char* s = SkipSpaces(p, end);
+		if (end - s >= 2 && s[0] == 'v') {
+			if (s[1] == ' ' || s[1] == '\t')
+				range.positions++;
+			else if (s[1] == 't')
+				range.uvs++;
+			else if (s[1] == 'n')
+				range.normals++;
+		}
+		else if (end - s > 7 && strncmp(s, "usemtl", 6) == 0 && (s[6] == ' ' || s[6] == '\t'))
+			range.lastMaterial = LineRest(s + 6, end);
+		else if (end - s > 7 && strncmp(s, "mtllib", 6) == 0 && (s[6] == ' ' || s[6] == '\t') && range.mtllib.empty())
+			range.mtllib = LineRest(s + 6, end);
+		p = end + 1;
+	}
+}
+
+static void ParseObjRange(ObjRange& range, vector<Float3>& positions, vector<Float3>& colors, vector<Float2>& uvs, vector<Float3>& normals) {
+	size_t position = range.firstPosition, uv = range.firstUV, normal = range.firstNormal;
+	int material = 0;
+	range.materialRuns.push_back({ 0, 0 });
+
+	ObjCorner polygon[64];
+	for (const char* p = range.begin; p < range.end;) {
+		const char* end = LineEnd(p, range.end);
+		const char* s = SkipSpaces(p, end);
+		p = end + 1;
+		if (end - s < 2)
+			continue;
+
+		if (s[0] == 'v' && (s[1] == ' ' || s[1] == '\t')) {
+			s += 2;
+			Float3 v = {}, c = { 1, 1, 1 };
+			ParseFloat(s, end, v.x);
+			ParseFloat(s, end, v.y);
+			ParseFloat(s, end, v.z);
+			// "v x y z r g b" vertex colors
+			if (ParseFloat(s, end, c.x)) {
+				ParseFloat(s, end, c.y);
+				ParseFloat(s, end, c.z);
+			}
+			positions[position] = v;
+			colors[position++] = c;
+		}
+		else if (s[0] == 'v' && s[1] == 't') {
+			s += 2;
+			Float2 t = {};
+			ParseFloat(s, end, t.x);
+			ParseFloat(s, end, t.y);
+			uvs[uv++] = t;
+		}
+		else if (s[0] == 'v' && s[1] == 'n') {
+			s += 2;
+			Float3 n = {};
+			ParseFloat(s, end, n.x);
+			ParseFloat(s, end, n.y);
+			ParseFloat(s, end, n.z);
+			normals[normal++] = n;
+		}
+		else if (s[0] == 'f' && (s[1] == ' ' || s[1] == '\t')) {
+			s += 2;
+			int count = 0;
+			for (;;) {
+				s = SkipSpaces(s, end);
+				int v, t = 0, n = 0;
+				if (!ParseInt(s, end, v))
+					break;
+				if (s < end && *s == '/') {
+					s++;
+					ParseInt(s, end, t);
+					if (s < end && *s == '/') {
+						s++;
+						ParseInt(s, end, n);
+					}
+				}
+				while (s < end && *s != ' ' && *s != '\t')
+					s++;
+
+				ObjCorner corner = { ResolveObjIndex(v, position), ResolveObjIndex(t, uv), ResolveObjIndex(n, normal), material };
+				if (corner.position >= 0 && count < 64)
+					polygon[count++] = corner;
+			}
+			// fan, reversed to clockwise
+			for (int i = 2; i < count; i++) {
+				range.triangles.push_back(polygon[0]);
+				range.triangles.push_back(polygon[i]);
+				range.triangles.push_back(polygon[i - 1]);
+			}
+		}
+		else if (end - s > 7 && strncmp(s, "usemtl", 6) == 0 && (s[6] == ' ' || s[6] == '\t')) {
+			std::string name = LineRest(s + 6, end);
+			auto found = std::find(range.materials.begin(), range.materials.end(), name);
+			material = (int)(found - range.materials.begin());
+			if (found == range.materials.end())
+				range.materials.push_back(name);
+			range.materialRuns.push_back({ material, range.triangles.size() / 3 });
+		}
+	}
+}
+
+// Welds the corners of the range's triangles into vertices.
+static void BuildObjRange(ObjRange& range, const vector<Float3>& positions, const vector<Float3>& colors, const vector<Float2>& uvs,
+	const vector<Float3>& normals, const std::unordered_map<std::string, Float3>& diffuse, vector<uint8_t>& missingNormals)
+{
+	vector<Float3> materialColors;
+	for (const std::string& name : range.materials) {
+		auto found = diffuse.find(name);
+		materialColors.push_back(found != diffuse.end() ? found->second : Float3{ 1, 1, 1 });
+	}
+
+	MeshData& piece = range.piece;
+	std::unordered_map<ObjCorner, unsigned int, ObjCornerHash> welded;
+	welded.reserve(range.triangles.size());
+	piece.indices.reserve(range.triangles.size());
+	for (const ObjCorner& corner : range.triangles) {
+		bool valid = (size_t)corner.position < positions.size();
+		auto inserted = welded.emplace(corner, (unsigned int)piece.vertices.size());
+		if (inserted.second) {
+			Vertex v = {};
+			if (valid) {
+				Float3 position = positions[corner.position];
+				Float3 color = colors[corner.position] * materialColors[corner.material];
+				v.x = position.x;
+				v.y = position.y;
+				v.z = -position.z;
+				v.r = color.x;
+				v.g = color.y;
+				v.b = color.z;
+			}
+			if (corner.uv >= 0 && (size_t)corner.uv < uvs.size()) {
+				v.u = uvs[corner.uv].x;
+				v.v = 1.0f - uvs[corner.uv].y;
+			}
+			bool hasNormal = corner.normal >= 0 && (size_t)corner.normal < normals.size();
+			if (hasNormal) {
+				Float3 n = normals[corner.normal];
+				float length = Length(n);
+				if (length > 0)
+					n = n / length;
+				v.nx = n.x;
+				v.ny = n.y;
+				v.nz = -n.z;
+			}
+			missingNormals.push_back(hasNormal ? 0 : 1);
+			piece.vertices.push_back(v);
+		}
+		piece.indices.push_back(inserted.first->second);
+	}
+
+	for (size_t i = 0; i < range.materialRuns.size(); i++) {
+		size_t first = range.materialRuns[i].second;
+		size_t last = i + 1 < range.materialRuns.size() ? range.materialRuns[i + 1].second : range.triangles.size() / 3;
+		AddSubMesh(piece.subMeshes, range.materials[range.materialRuns[i].first], (uint32_t)first * 3, (uint32_t)(last - first) * 3);
+	}
+	range.triangles = vector<ObjCorner>();
+}
+
+// newmtl / Kd pairs of a .mtl file
+static void ReadMtl(const std::string& path, std::unordered_map<std::string, Float3>& diffuse) {
+	MappedFile file;
+	if (!file.Open(path.c_str()))
+		return;
+
+	const char* data = (const char*)file.GetData();
+	const char* end = data + file.GetSize();
+	std::string current;
+	for (const char* p = data; p < end;) {
+		const char* lineEnd = LineEnd(p, end);
+		const char* s = SkipSpaces(p, lineEnd);
+		if (lineEnd - s > 7 && strncmp(s, "newmtl", 6) == 0) {
+			current = LineRest(s + 6, lineEnd);
+			diffuse[current] = { 1, 1, 1 };
+		}
+		else if (lineEnd - s > 3 && s[0] == 'K' && s[1] == 'd' && !current.empty()) {
+			s += 2;
+			Float3 kd = { 1, 1, 1 };
+			ParseFloat(s, lineEnd, kd.x);
+			ParseFloat(s, lineEnd, kd.y);
+			ParseFloat(s, lineEnd, kd.z);
+			diffuse[current] = kd;
+		}
+		p = lineEnd + 1;
+	}
+}
+
+bool ImportOBJ(const char* path, ThreadPool& pool, MeshData& mesh) {
+	MappedFile file;
+	if (!file.Open(path))
+		return false;
+
+	// cut at the first newline after every OBJ_RANGE_BYTES
+	const char* data = (const char*)file.GetData();
+	const char* dataEnd = data + file.GetSize();
+	vector<ObjRange> ranges;
+	for (const char* p = data; p < dataEnd;) {
+		const char* end = p + std::min((size_t)(dataEnd - p), (size_t)OBJ_RANGE_BYTES);
+		end = end < dataEnd ? LineEnd(end, dataEnd) + 1 : dataEnd;
+		ranges.emplace_back();
+		ranges.back().begin = p;
+		ranges.back().end = std::min(end, dataEnd);
+		p = ranges.back().end;
+	}
+
+	pool.ParallelFor(ranges.size(), [&](size_t i) { CountObjRange(ranges[i]); });
+
+	size_t positionCount = 0, uvCount = 0, normalCount = 0;
+	std::string material, mtllib;
+	for (ObjRange& range : ranges) {
+		range.firstPosition = positionCount;
+		range.firstUV = uvCount;
+		range.firstNormal = normalCount;
+		positionCount += range.positions;
+		uvCount += range.uvs;
+		normalCount += range.normals;
+		range.materials.push_back(material);
+		if (!range.lastMaterial.empty())
+			material = range.lastMaterial;
+		if (mtllib.empty())
+			mtllib = range.mtllib;
+	}
+
+	std::unordered_map<std::string, Float3> diffuse;
+	if (!mtllib.empty())
+		ReadMtl(Directory(path) + mtllib, diffuse);
+
+	vector<Float3> positions(positionCount), colors(positionCount), normals(normalCount);
+	vector<Float2> uvs(uvCount);
+	pool.ParallelFor(ranges.size(), [&](size_t i) { ParseObjRange(ranges[i], positions, colors, uvs, normals); });
+
+	vector<vector<uint8_t>> missing(ranges.size());
+	pool.ParallelFor(ranges.size(), [&](size_t i) { BuildObjRange(ranges[i], positions, colors, uvs, normals, diffuse, missing[i]); });
+
+	vector<MeshData> pieces;
+	vector<uint8_t> missingNormals;
+	for (size_t i = 0; i < ranges.size(); i++) {
+		pieces.push_back(std::move(ranges[i].piece));
+		missingNormals.insert(missingNormals.end(), missing[i].begin(), missing[i].end());
+	}
+	Concatenate(pieces, pool, mesh);
+	if (std::find(missingNormals.begin(), missingNormals.end(), 1) != missingNormals.end())
+		GenerateNormals(mesh.vertices, mesh.indices.data(), mesh.indices.size(), missingNormals);
+	return !mesh.indices.empty();
+}
+
+#pragma endregion
+
+#pragma region glTF
+
+// Just enough JSON for glTF: objects keep their keys in order.
+struct Json {
+	enum Type { Null, Bool, Number, String, Array, Object } type = Null;
+	double number = 0;
+	std::string string;
+	vector<std::string> keys; // objects
+	vector<Json> items;       // array elements, object values
+
+	const Json& operator[](const char* key) const;
+	const Json& operator[](size_t index) const;
+	size_t Size() const { return items.size(); }
+	bool Has(const char* key) const { return (*this)[key].type != Null; }
+	double Num(double fallback) const { return type == Number ? number : fallback; }
+	int Int(int fallback = -1) const { return type == Number ? (int)number : fallback; }
+};
+
+static const Json NullJson;
+
+const Json& Json::operator[](const char* key) const {
+	for (size_t i = 0; i < keys.size(); i++)
+		if (keys[i] == key)
+			return items[i];
+	return NullJson;
+}
+
+const Json& Json::operator[](size_t index) const {
+	return index < items.size() ? items[index] : NullJson;
+}
+
+class JsonParser {
+public:
+	JsonParser(const char* begin, const char* end) : _p(begin), _end(end) {}
+
+	bool Parse(Json& value, int depth = 0) {
+		Skip();
+		if (_p >= _end || depth > 64)
+			return false;
+
+		switch (*_p) {
+		case '{': {
+			value.type = Json::Object;
+			_p++;
+			Skip();
+			if (_p < _end && *_p == '}')
+				return ++_p, true;
+			for (;;) {
+				std::string key;
+				Skip();
+				if (!ParseString(key))
+					return false;
+				Skip();
+				if (_p >= _end || *_p++ != ':')
+					return false;
+				value.keys.push_back(std::move(key));
+				value.items.emplace_back();
+				if (!Parse(value.items.back(), depth + 1))
+					return false;
+				Skip();
+				if (_p < _end && *_p == ',') {
+					_p++;
+					continue;
+				}
+				return _p < _end && *_p++ == '}';
+			}
+		}
+		case '[': {
+			value.type = Json::Array;
+			_p++;
+			Skip();
+			if (_p < _end && *_p == ']')
+				return ++_p, true;
+			for (;;) {
+				value.items.emplace_back();
+				if (!Parse(value.items.back(), depth + 1))
+					return false;
+				Skip();
+				if (_p < _end && *_p == ',') {
+					_p++;
+					continue;
+				}
+				return _p < _end && *_p++ == ']';
+			}
+		}
+		case '"':
+			value.type = Json::String;
+			return ParseString(value.string);
+		case 't':
+		case 'f':
+		case 'n': {
+			const char* word = *_p == 't' ? "true" : *_p == 'f' ? "false" : "null";
+			size_t length = strlen(word);
+			if ((size_t)(_end - _p) < length || strncmp(_p, word, length) != 0)
+				return false;
+			_p += length;
+			value.type = *word == 'n' ? Json::Null : Json::Bool;
+			value.number = *word == 't' ? 1 : 0;
+			return true;
+		}
+		default: {
+			char* numberEnd;
+			std::string text(_p, std::min(_end, _p + 64));
+			value.number = strtod(text.c_str(), &numberEnd);
+			if (numberEnd == text.c_str())
+				return false;
+			value.type = Json::Number;
+			_p += numberEnd - text.c_str();
+			return true;
+		}
+		}
+	}
+
+private:
+	const char* _p;
+	const char* _end;
+
+	void Skip() {
+		while (_p < _end && (*_p == ' ' || *_p == '\t' || *_p == '\n' || *_p == '\r'))
+			_p++;
+	}
+
+	bool ParseString(std::string& out) {
+		if (_p >= _end || *_p++ != '"')
+			return false;
+		while (_p < _end && *_p != '"') {
+			char c = *_p++;
+			if (c != '\\') {
+				out += c;
+				continue;
+			}
+			if (_p >= _end)
+				return false;
+			c = *_p++;
+			switch (c) {
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u': {
+				if (_end - _p < 4)
+					return false;
+				unsigned int code = (unsigned int)strtoul(std::string(_p, 4).c_str(), nullptr, 16);
+				_p += 4;
+				// UTF-8, surrogate pairs left as two code points
+				if (code < 0x80)
+					out += (char)code;
+				else if (code < 0x800) {
+					out += (char)(0xc0 | code >> 6);
+					out += (char)(0x80 | (code & 0x3f));
+				}
+				else {
+					out += (char)(0xe0 | code >> 12);
+					out += (char)(0x80 | (code >> 6 & 0x3f));
+					out += (char)(0x80 | (code & 0x3f));
+				}
+				break;
+			}
+			default: out += c; break;
+			}
+		}
+		return _p < _end && *_p++ == '"';
+	}
+};
+
+static bool DecodeBase64(const char* text, size_t length, vector<uint8_t>& out) {
+	auto value = [](char c) -> int {
+		if (c >= 'A' && c <= 'Z') return c - 'A';
+		if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+		if (c >= '0' && c <= '9') return c - '0' + 52;
+		if (c == '+' || c == '-') return 62;
+		if (c == '/' || c == '_') return 63;
+		return -1;
+	};
+
+	out.clear();
+	out.reserve(length / 4 * 3);
+	unsigned int bits = 0;
+	int count = 0;
+	for (size_t i = 0; i < length && text[i] != '='; i++) {
+		int v = value(text[i]);
+		if (v < 0)
+			return false;
+		bits = bits << 6 | (unsigned int)v;
+		if (++count == 4) {
+			out.push_back((uint8_t)(bits >> 16));
+			out.push_back((uint8_t)(bits >> 8));
+			out.push_back((uint8_t)bits);
+			bits = 0;
+			count = 0;
+		}
+	}
+	if (count == 2)
+		out.push_back((uint8_t)(bits >> 4));
+	else if (count == 3) {
+		out.push_back((uint8_t)(bits >> 10));
+		out.push_back((uint8_t)(bits >> 2));
+	}
+	return count != 1;
+}
+
+// %xx escapes of relative buffer URIs
+static std::string DecodeUri(const std::string& uri) {
+	std::string out;
+	for (size_t i = 0; i < uri.size(); i++) {
+		if (uri[i] == '%' && i + 2 < uri.size()) {
+			out += (char)strtoul(uri.substr(i + 1, 2).c_str(), nullptr, 16);
+			i += 2;
+		}
+		else
+			out += uri[i];
+	}
+	return out;
+}
+
+struct GltfBuffer {
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+};
+
+struct GltfFile {
+	Json json;
+	vector<GltfBuffer> buffers;
+	vector<std::unique_ptr<MappedFile>> mappedBuffers;
+	vector<vector<uint8_t>> decodedBuffers;
+};
+
+// A typed view of an accessor's elements in its buffer
+struct GltfAccessor {
+	const uint8_t* data = nullptr;
+	size_t count = 0;
+	size_t stride = 0;
+	int components = 0;
+	int componentType = 0;
+	bool normalized = false;
+
+	// False when it is sparse or does not fit its buffer.
+	bool Open(const GltfFile& gltf, int index) {
+		const Json& accessor = gltf.json["accessors"][(size_t)index];
+		const Json& view = gltf.json["bufferViews"][(size_t)accessor["bufferView"].Int()];
+		if (accessor.type != Json::Object || view.type != Json::Object || accessor.Has("sparse"))
+			return false;
+
+		const std::string& type = accessor["type"].string;
+		components = type == "SCALAR" ? 1 : type == "VEC2" ? 2 : type == "VEC3" ? 3 : type == "VEC4" ? 4 : 0;
+		componentType = accessor["componentType"].Int();
+		int componentSize = componentType == GLTF_FLOAT || componentType == GLTF_UNSIGNED_INT ? 4
+			: componentType == GLTF_SHORT || componentType == GLTF_UNSIGNED_SHORT ? 2
+			: componentType == GLTF_BYTE || componentType == GLTF_UNSIGNED_BYTE ? 1 : 0;
+		int buffer = view["buffer"].Int();
+		if (components == 0 || componentSize == 0 || buffer < 0 || (size_t)buffer >= gltf.buffers.size())
+			return false;
+
+		count = (size_t)accessor["count"].Num(0);
+		normalized = accessor["normalized"].number != 0;
+		size_t elementSize = (size_t)components * componentSize;
+		stride = (size_t)view["byteStride"].Num((double)elementSize);
+		size_t offset = (size_t)view["byteOffset"].Num(0) + (size_t)accessor["byteOffset"].Num(0);
+		size_t viewEnd = (size_t)view["byteOffset"].Num(0) + (size_t)view["byteLength"].Num(0);
+		if (count == 0 || viewEnd > gltf.buffers[buffer].size || offset + (count - 1) * stride + elementSize > viewEnd)
+			return false;
+
+		data = gltf.buffers[buffer].data + offset;
+		return true;
+	}
+
+	// Element i as floats, (normalized) integers converted; components past the
+	// accessor's own are left alone.
+	void Read(size_t i, float* out, int wanted) const {
+		const uint8_t* element = data + i * stride;
+		for (int c = 0; c < std::min(components, wanted); c++) {
+			switch (componentType) {
+			case GLTF_FLOAT: memcpy(&out[c], element + c * 4, 4); break;
+			case GLTF_UNSIGNED_BYTE: out[c] = element[c] / (normalized ? 255.0f : 1.0f); break;
+			case GLTF_BYTE: out[c] = std::max((int8_t)element[c] / (normalized ? 127.0f : 1.0f), -1.0f); break;
+			case GLTF_UNSIGNED_SHORT: { uint16_t s; memcpy(&s, element + c * 2, 2); out[c] = s / (normalized ? 65535.0f : 1.0f); break; }
+			case GLTF_SHORT: { int16_t s; memcpy(&s, element + c * 2, 2); out[c] = std::max(s / (normalized ? 32767.0f : 1.0f), -1.0f); break; }
+			default: { uint32_t u; memcpy(&u, element + c * 4, 4); out[c] = (float)u; break; }
+			}
+		}
+	}
+};
+
+static bool ReadIndices(const GltfFile& gltf, int index, vector<unsigned int>& out) {
+	GltfAccessor accessor;
+	if (!accessor.Open(gltf, index) || accessor.components != 1)
+		return false;
+
+	out.resize(accessor.count);
+	for (size_t i = 0; i < accessor.count; i++) {
+		const uint8_t* element = accessor.data + i * accessor.stride;
+		switch (accessor.componentType) {
+		case GLTF_UNSIGNED_BYTE: out[i] = element[0]; break;
+		case GLTF_UNSIGNED_SHORT: { uint16_t s; memcpy(&s, element, 2); out[i] = s; break; }
+		case GLTF_UNSIGNED_INT: memcpy(&out[i], element, 4); break;
+		default: return false;
+		}
+	}
+	return true;
+}
+
+// Row-vector local transform of a node, like Float4x4 (glTF stores column-major
+// column-vector matrices, which is the same 16 numbers).
+static Float4x4 NodeTransform(const Json& node) {
+	Float4x4 m = Float4x4::Identity();
+	const Json& matrix = node["matrix"];
+	if (matrix.Size() == 16) {
+		for (int i = 0; i < 16; i++)
+			m.m[i / 4][i % 4] = (float)matrix[(size_t)i].number;
+		return m;
+	}
+
+	const Json& t = node["translation"];
+	const Json& r = node["rotation"];
+	const Json& s = node["scale"];
+	float x = (float)r[(size_t)0].Num(0), y = (float)r[1].Num(0), z = (float)r[2].Num(0), w = (float)r[3].Num(1);
+	Float4x4 rotation = Float4x4::Identity();
+	// transpose of the usual column-vector quaternion matrix
+	rotation.m[0][0] = 1 - 2 * (y * y + z * z); rotation.m[1][0] = 2 * (x * y - z * w);     rotation.m[2][0] = 2 * (x * z + y * w);
+	rotation.m[0][1] = 2 * (x * y + z * w);     rotation.m[1][1] = 1 - 2 * (x * x + z * z); rotation.m[2][1] = 2 * (y * z - x * w);
+	rotation.m[0][2] = 2 * (x * z - y * w);     rotation.m[1][2] = 2 * (y * z + x * w);     rotation.m[2][2] = 1 - 2 * (x * x + y * y);
+	return Float4x4::Scaling((float)s[(size_t)0].Num(1), (float)s[1].Num(1), (float)s[2].Num(1))
+		* rotation
+		* Float4x4::Translation((float)t[(size_t)0].Num(0), (float)t[1].Num(0), (float)t[2].Num(0));
+}
+
+struct GltfDraw {
+	int mesh;
+	int primitive;
+	Float4x4 transform;
+};
+
+static void CollectDraws(const Json& nodes, int node, const Float4x4& parent, int depth, vector<GltfDraw>& draws) {
+	const Json& n = nodes[(size_t)node];
+	if (n.type != Json::Object || depth > 64)
+		return;
+
+	Float4x4 transform = NodeTransform(n) * parent;
+	int mesh = n["mesh"].Int();
+	if (mesh >= 0)
+		draws.push_back({ mesh, -1, transform });
+	const Json& children = n["children"];
+	for (size_t i = 0; i < children.Size(); i++)
+		CollectDraws(nodes, children[i].Int(), transform, depth + 1, draws);
+}
+
+// Only the vertices the primitive's triangles use are decoded, so primitives
+// that share one big accessor do not each copy all of it.
+static bool DecodePrimitive(const GltfFile& gltf, const GltfDraw& draw, MeshData& piece) {
+	const Json& primitive = gltf.json["meshes"][(size_t)draw.mesh]["primitives"][(size_t)draw.primitive];
+	const Json& attributes = primitive["attributes"];
+	int mode = primitive["mode"].Int(GLTF_TRIANGLES);
+	if (mode != GLTF_TRIANGLES && mode != GLTF_TRIANGLE_STRIP && mode != GLTF_TRIANGLE_FAN)
+		return true; // points and lines have nothing to shade
+
+	GltfAccessor positions, normals, uvs, colors;
+	if (!positions.Open(gltf, attributes["POSITION"].Int()))
+		return false;
+	size_t count = positions.count;
+	bool hasNormals = attributes.Has("NORMAL") && normals.Open(gltf, attributes["NORMAL"].Int()) && normals.count == count;
+	bool hasUVs = attributes.Has("TEXCOORD_0") && uvs.Open(gltf, attributes["TEXCOORD_0"].Int()) && uvs.count == count;
+	bool hasColors = attributes.Has("COLOR_0") && colors.Open(gltf, attributes["COLOR_0"].Int()) && colors.count == count;
+
+	vector<unsigned int> indices;
+	if (primitive.Has("indices")) {
+		if (!ReadIndices(gltf, primitive["indices"].Int(), indices))
+			return false;
+	}
+	else {
+		indices.resize(count);
+		for (size_t i = 0; i < count; i++)
+			indices[i] = (unsigned int)i;
+	}
+
+	// to a clockwise list; a mirroring node transform already turned it around
+	const float (*m)[4] = draw.transform.m;
+	bool flip = Dot(Cross(Float3{ m[0][0], m[0][1], m[0][2] }, Float3{ m[1][0], m[1][1], m[1][2] }), Float3{ m[2][0], m[2][1], m[2][2] }) < 0;
+	auto triangle = [&](unsigned int a, unsigned int b, unsigned int c) {
+		piece.indices.push_back(a);
+		piece.indices.push_back(flip ? b : c);
+		piece.indices.push_back(flip ? c : b);
+	};
+	if (mode == GLTF_TRIANGLES)
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			triangle(indices[i], indices[i + 1], indices[i + 2]);
+	else if (mode == GLTF_TRIANGLE_STRIP)
+		for (size_t i = 0; i + 2 < indices.size(); i++)
+			if (i % 2 == 0)
+				triangle(indices[i], indices[i + 1], indices[i + 2]);
+			else
+				triangle(indices[i + 1], indices[i], indices[i + 2]);
+	else
+		for (size_t i = 1; i + 1 < indices.size(); i++)
+			triangle(indices[0], indices[i], indices[i + 1]);
+
+	// accessor element -> vertex, in order of first use
+	vector<unsigned int> remap(count, UINT32_MAX), used;
+	for (unsigned int& index : piece.indices) {
+		if (index >= count)
+			return false;
+		if (remap[index] == UINT32_MAX) {
+			remap[index] = (unsigned int)used.size();
+			used.push_back(index);
+		}
+		index = remap[index];
+	}
+
+	const Json& material = gltf.json["materials"][(size_t)primitive["material"].Int()];
+	const Json& baseColor = material["pbrMetallicRoughness"]["baseColorFactor"];
+	Float3 factor = { (float)baseColor[(size_t)0].Num(1), (float)baseColor[1].Num(1), (float)baseColor[2].Num(1) };
+
+	Float4x4 normalTransform = Transpose(Inverse(draw.transform));
+	piece.vertices.resize(used.size());
+	for (size_t i = 0; i < used.size(); i++) {
+		Vertex& v = piece.vertices[i];
+		Float3 p = {}, n = {}, color = { 1, 1, 1 };
+		Float2 uv = {};
+		positions.Read(used[i], &p.x, 3);
+		p = XYZ(Transform({ p.x, p.y, p.z, 1 }, draw.transform));
+		if (hasColors)
+			colors.Read(used[i], &color.x, 3);
+		color = color * factor;
+		if (hasUVs)
+			uvs.Read(used[i], &uv.x, 2);
+		if (hasNormals) {
+			normals.Read(used[i], &n.x, 3);
+			n = XYZ(Transform({ n.x, n.y, n.z, 0 }, normalTransform));
+			float length = Length(n);
+			if (length > 0)
+				n = n / length;
+		}
+		v = { p.x, p.y, -p.z, color.x, color.y, color.z, uv.x, uv.y, n.x, n.y, -n.z, 0 };
+	}
+
+	if (!hasNormals)
+		GenerateNormals(piece.vertices, piece.indices.data(), piece.indices.size(), vector<uint8_t>(used.size(), 1));
+
+	AddSubMesh(piece.subMeshes, material["name"].string, 0, (uint32_t)piece.indices.size());
+	return true;
+}
+
+static bool LoadGltfBuffers(const char* path, const uint8_t* binChunk, size_t binSize, GltfFile& gltf) {
+	const Json& buffers = gltf.json["buffers"];
+	std::string directory = Directory(path);
+	for (size_t i = 0; i < buffers.Size(); i++) {
+		const Json& buffer = buffers[i];
+		const std::string& uri = buffer["uri"].string;
+		size_t length = (size_t)buffer["byteLength"].Num(0);
+		GltfBuffer view;
+
+		if (!buffer.Has("uri")) {
+			// the GLB binary chunk
+			if (!binChunk)
+				return false;
+			view = { binChunk, binSize };
+		}
+		else if (uri.compare(0, 5, "data:") == 0) {
+			size_t comma = uri.find(";base64,");
+			if (comma == std::string::npos)
+				return false;
+			gltf.decodedBuffers.emplace_back();
+			if (!DecodeBase64(uri.c_str() + comma + 8, uri.size() - comma - 8, gltf.decodedBuffers.back()))
+				return false;
+			view = { gltf.decodedBuffers.back().data(), gltf.decodedBuffers.back().size() };
+		}
+		else {
+			gltf.mappedBuffers.push_back(std::make_unique<MappedFile>());
+			MappedFile& file = *gltf.mappedBuffers.back();
+			if (!file.Open((directory + DecodeUri(uri)).c_str()))
+				return false;
+			view = { file.GetData(), file.GetSize() };
+		}
+
+		if (view.size < length)
+			return false;
+		view.size = length;
+		gltf.buffers.push_back(view);
+	}
+	return true;
+}
+
+bool ImportGLTF(const char* path, ThreadPool& pool, MeshData& mesh) {
+	MappedFile file;
+	if (!file.Open(path))
+		return false;
+
+	const uint8_t* data = file.GetData();
+	size_t size = file.GetSize();
+	const char* json = (const char*)data;
+	size_t jsonSize = size;
+	const uint8_t* binChunk = nullptr;
+	size_t binSize = 0;
+
+	uint32_t magic;
+	memcpy(&magic, data, std::min(size, sizeof(magic)));
+	if (size >= 20 && magic == GLB_MAGIC) {
+		// 12 byte header, then chunks of length, type, data
+		json = nullptr;
+		for (size_t offset = 12; offset + 8 <= size;) {
+			uint32_t length, type;
+			memcpy(&length, data + offset, 4);
+			memcpy(&type, data + offset + 4, 4);
+			if (length > size - offset - 8)
+				return false;
+			if (type == GLB_CHUNK_JSON && !json) {
+				json = (const char*)data + offset + 8;
+				jsonSize = length;
+			}
+			else if (type == GLB_CHUNK_BIN && !binChunk) {
+				binChunk = data + offset + 8;
+				binSize = length;
+			}
+			offset += 8 + ((length + 3) & ~3u);
+		}
+		if (!json)
+			return false;
+	}
+
+	GltfFile gltf;
+	JsonParser parser(json, json + jsonSize);
+	if (!parser.Parse(gltf.json) || gltf.json.type != Json::Object || !LoadGltfBuffers(path, binChunk, binSize, gltf))
+		return false;
+
+	// nodes of the default scene; without scenes every mesh once, untransformed
+	vector<GltfDraw> draws;
+	const Json& nodes = gltf.json["nodes"];
+	const Json& scenes = gltf.json["scenes"];
+	if (scenes.Size() > 0) {
+		const Json& roots = scenes[(size_t)std::max(gltf.json["scene"].Int(0), 0)]["nodes"];
+		for (size_t i = 0; i < roots.Size(); i++)
+			CollectDraws(nodes, roots[i].Int(), Float4x4::Identity(), 0, draws);
+	}
+	else {
+		for (size_t i = 0; i < gltf.json["meshes"].Size(); i++)
+			draws.push_back({ (int)i, -1, Float4x4::Identity() });
+	}
+
+	vector<GltfDraw> primitives;
+	for (const GltfDraw& draw : draws)
+		for (size_t i = 0; i < gltf.json["meshes"][(size_t)draw.mesh]["primitives"].Size(); i++)
+			primitives.push_back({ draw.mesh, (int)i, draw.transform });
+
+	vector<MeshData> pieces(primitives.size());
+	std::atomic<bool> failed{ false };
+	pool.ParallelFor(primitives.size(), [&](size_t i) {
+		if (!DecodePrimitive(gltf, primitives[i], pieces[i]))
+			failed = true;
+	});
+	if (failed)
+		return false;
+
+	Concatenate(pieces, pool, mesh);
+	return !mesh.indices.empty();
+}
+
+#pragma endregion
+
+bool ImportMesh(const char* path, ThreadPool& pool, MeshData& mesh) {
+	mesh = MeshData();
+	if (HasExtension(path, ".obj"))
+		return ImportOBJ(path, pool, mesh);
+	if (HasExtension(path, ".gltf") || HasExtension(path, ".glb"))
+		return ImportGLTF(path, pool, mesh);
+	return false;
+}
+
+#pragma region ImportedMesh
+
+bool ImportedMesh::Open(const char* path, ThreadPool& pool, bool* imported) {
+	Close();
+	if (imported)
+		*imported = false;
+
+	std::error_code error;
+	uint64_t sourceSize = std::filesystem::file_size(path, error);
+	if (error)
+		return false;
+	uint64_t sourceTime = (uint64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+	if (error)
+		return false;
+
+	std::string cachePath = std::string(path) + ".mesh";
+	if (_file.Open(cachePath.c_str())) {
+		if (ParseMeshFile(_file.GetData(), _file.GetSize(), _info) && _info.sourceSize == sourceSize && _info.sourceTime == sourceTime)
+			return true;
+		_file.Close();
+	}
+
+	if (imported)
+		*imported = true;
+	if (!ImportMesh(path, pool, _fallback))
+		return false;
+
+	if (WriteMeshFile(cachePath.c_str(), _fallback, sourceSize, sourceTime) && _file.Open(cachePath.c_str())
+		&& ParseMeshFile(_file.GetData(), _file.GetSize(), _info)) {
+		_fallback = MeshData();
+		return true;
+	}
+
+	_file.Close();
+	_info = { sourceSize, sourceTime, _fallback.vertices.data(), _fallback.vertices.size(), _fallback.indices.data(), _fallback.indices.size(), _fallback.subMeshes };
+	return true;
+}
+
+void ImportedMesh::Close() {
+	_file.Close();
+	_info = MeshFileInfo();
+	_fallback = MeshData();
+}
+
+#pragma endregion
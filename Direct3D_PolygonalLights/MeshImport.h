@@ -0,0 +1,47 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "MeshFile.h"
+#include "ThreadPool.h"
+
+// Model importers. Both convert to this renderer's left-handed space by
+// negating z and reversing the triangles, since the counter-clockwise front
+// faces of OBJ and glTF have to become the clockwise ones D3D culls by.
+// Vertex colors are the material's diffuse / base color (times the file's own
+// vertex colors), object index 0; missing normals are generated smooth.
+
+// Wavefront OBJ with its mtllib. The file is mapped and cut into line-aligned
+// ranges that are parsed in parallel: one pass counts the elements of each
+// range so the second can write them straight to their final place, then
+// every range welds its own corners into vertices.
+bool ImportOBJ(const char* path, ThreadPool& pool, MeshData& mesh);
+
+// glTF 2.0 as .gltf (external or base64 embedded buffers) or .glb, triangle
+// primitives of the default scene with their node transforms applied. The
+// primitives are decoded in parallel.
+bool ImportGLTF(const char* path, ThreadPool& pool, MeshData& mesh);
+
+// By extension: .obj, .gltf or .glb
+bool ImportMesh(const char* path, ThreadPool& pool, MeshData& mesh);
+
+// A model behind its binary cache, <path>.mesh next to it. Open maps the cache
+// when it was built from the source as it is now, otherwise imports the
+// source and rewrites the cache first. Geometry is read straight from the
+// mapping; if the cache cannot be written the import is kept in memory.
+class ImportedMesh {
+public:
+	// imported tells whether the source had to be parsed
+	bool Open(const char* path, ThreadPool& pool, bool* imported = nullptr);
+	void Close();
+
+	const Vertex* GetVertices() const { return _info.vertices; }
+	size_t GetVertexCount() const { return _info.vertexCount; }
+	const unsigned int* GetIndices() const { return _info.indices; }
+	size_t GetIndexCount() const { return _info.indexCount; }
+	const vector<SubMesh>& GetSubMeshes() const { return _info.subMeshes; }
+
+private:
+	MappedFile _file;
+	MeshFileInfo _info = {};
+	MeshData _fallback;
+};
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using std::vector;
+
+// Progressive texture loading. Load publishes the mips up to firstMaxSize
+// right away and queues the file for a background I/O thread, which loads it
+// again at growth times the size until the loader reports the full chain.
+// Finished steps are handed back on the render thread by Update, so T only
+// has to be safe to create off that thread (D3D11 resources are).
+template<typename T>
+class MipStreamer {
+public:
+	// Fills texture with every mip no larger than maxSize (0 = all of them) and
+	// sets complete when nothing was skipped. False on failure.
+	typedef std::function<bool(const std::string& path, size_t maxSize, T& texture, bool& complete)> Loader;
+
+	MipStreamer(Loader loader, size_t firstMaxSize = 64, size_t growth = 4)
+		: _loader(std::move(loader)), _firstMaxSize(firstMaxSize), _growth(growth < 2 ? 2 : growth)
+	{
+		_worker = std::thread([this] { WorkerLoop(); });
+	}
+
+	~MipStreamer() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_quit = true;
+		}
+		_wake.notify_all();
+		_worker.join();
+	}
+
+	MipStreamer(const MipStreamer&) = delete;
+	MipStreamer& operator=(const MipStreamer&) = delete;
+
+	// Returns the id Update reports upgrades with, 0 when the first step failed.
+	unsigned int Load(const std::string& path, T& first) {
+		bool complete = false;
+		if (!_loader(path, _firstMaxSize, first, complete))
+			return 0;
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		unsigned int id = ++_lastId;
+		if (!complete) {
+			_jobs.push_back({ id, path, _firstMaxSize * _growth });
+			_pending++;
+			_wake.notify_one();
+		}
+		return id;
+	}
+
+	// Calls apply(id, texture) for every step finished since the last call and
+	// returns how many there were.
+	template<typename F>
+	int Update(F apply) {
+		vector<std::pair<unsigned int, T>> ready;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			ready.swap(_ready);
+		}
+		for (std::pair<unsigned int, T>& step : ready)
+			apply(step.first, step.second);
+		return (int)ready.size();
+	}
+
+	bool IsIdle() {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _pending == 0;
+	}
+
+	// Blocks until every queued file is fully loaded or failed.
+	void WaitIdle() {
+		std::unique_lock<std::mutex> lock(_mutex);
+		_idle.wait(lock, [this] { return _pending == 0; });
+	}
+
+private:
+	struct Job {
+		unsigned int id;
+		std::string path;
+		size_t maxSize;
+	};
+
+	Loader _loader;
+	size_t _firstMaxSize;
+	size_t _growth;
+
+	std::thread _worker;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::condition_variable _idle;
+	std::deque<Job> _jobs;
+	vector<std::pair<unsigned int, T>> _ready;
+	unsigned int _lastId = 0;
+	int _pending = 0; // files with steps left
+	bool _quit = false;
+
+	// Files take turns a step at a time, so a large one does not hold back
+	// the first upgrade of the others.
+	void WorkerLoop() {
+		for (;;) {
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_wake.wait(lock, [this] { return _quit || !_jobs.empty(); });
+				if (_quit)
+					return;
+				job = std::move(_jobs.front());
+				_jobs.pop_front();
+			}
+
+			T texture{};
+			bool complete = false;
+			bool loaded = _loader(job.path, job.maxSize, texture, complete);
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (loaded)
+				_ready.emplace_back(job.id, std::move(texture));
+			if (loaded && !complete) {
+				job.maxSize *= _growth;
+				_jobs.push_back(std::move(job));
+			}
+			else if (--_pending == 0)
+				_idle.notify_all();
+		}
+	}
+};
@@ -0,0 +1,108 @@
+#include "ObjectLights.h"
+#include <algorithm>
+#include <cmath>
+
+Float4 TransformSphere(const Float4& sphere, const Float4x4& transform) {
+	if (sphere.w < 0.0f)
+		return sphere;
+	Float3 center = XYZ(Transform({ sphere.x, sphere.y, sphere.z, 1 }, transform));
+	float scale = 0.0f;
+	for (int row = 0; row < 3; row++)
+		scale = std::max(scale, Length(Float3{ transform.m[row][0], transform.m[row][1], transform.m[row][2] }));
+	return { center.x, center.y, center.z, sphere.w * scale };
+}
+
+void ObjectLightLists::Build(const Float4* objectSpheres, size_t objectCount,
+	const PointLight* pointLights, size_t pointCount,
+	const SpotLight* spotLights, size_t spotCount,
+	const RectLight* rectLights, size_t rectCount,
+	ThreadPool& pool)
+{
+	// light spheres in the order of the lists: points, spots, rects
+	size_t lightCount = pointCount + spotCount + rectCount;
+	_lights.resize(lightCount);
+	_lightBoxes.resize(lightCount);
+	for (size_t i = 0; i < lightCount; i++) {
+		LightSphere& light = _lights[i];
+		if (i < pointCount) {
+			light.center = XYZ(pointLights[i].Position);
+			light.radius = PointLightRange(pointLights[i]);
+		}
+		else if (i < pointCount + spotCount) {
+			light.center = XYZ(spotLights[i - pointCount].Position);
+			light.radius = SpotLightRange(spotLights[i - pointCount]);
+		}
+		else {
+			light.center = XYZ(rectLights[i - pointCount - spotCount].Position);
+			light.radius = RectLightRange(rectLights[i - pointCount - spotCount]);
+		}
+		Float3 extent = { light.radius, light.radius, light.radius };
+		_lightBoxes[i] = { light.center - extent, light.center + extent };
+	}
+	_bvh.Build(_lightBoxes.data(), lightCount);
+
+	size_t batches = (objectCount + OBJECT_LIGHT_BATCH - 1) / OBJECT_LIGHT_BATCH;
+	_ranges.resize(objectCount);
+	if (_batchIndices.size() < batches)
+		_batchIndices.resize(batches);
+	pool.ParallelFor(batches, [&](size_t batch) {
+		FillBatch(batch, objectSpheres, objectCount, pointCount, spotCount);
+	});
+
+	// batch offsets are local until the batches are concatenated
+	_lightIndices.clear();
+	_boundedCount = 0;
+	for (size_t batch = 0; batch < batches; batch++) {
+		uint32_t base = (uint32_t)_lightIndices.size();
+		size_t last = std::min(objectCount, (batch + 1) * OBJECT_LIGHT_BATCH);
+		for (size_t object = batch * OBJECT_LIGHT_BATCH; object < last; object++) {
+			if (_ranges[object].offset == OBJECT_LIGHTS_NONE)
+				continue;
+			_ranges[object].offset += base;
+			_boundedCount++;
+		}
+		_lightIndices.insert(_lightIndices.end(), _batchIndices[batch].begin(), _batchIndices[batch].end());
+	}
+}
+
+void ObjectLightLists::FillBatch(size_t batch, const Float4* objectSpheres, size_t objectCount, size_t pointCount, size_t spotCount) {
+	vector<uint32_t>& indices = _batchIndices[batch];
+	indices.clear();
+	vector<uint32_t> hits;
+
+	size_t last = std::min(objectCount, (batch + 1) * OBJECT_LIGHT_BATCH);
+	for (size_t object = batch * OBJECT_LIGHT_BATCH; object < last; object++) {
+		const Float4& sphere = objectSpheres[object];
+		ClusterRange& range = _ranges[object];
+		if (sphere.w < 0.0f) {
+			range = { OBJECT_LIGHTS_NONE, 0, 0, 0 };
+			continue;
+		}
+
+		Float3 center = XYZ(sphere);
+		Float3 extent = { sphere.w, sphere.w, sphere.w };
+		hits.clear();
+		_bvh.Query({ center - extent, center + extent }, hits);
+		std::sort(hits.begin(), hits.end());
+
+		range = { (uint32_t)indices.size(), 0, 0, 0 };
+		for (uint32_t light : hits) {
+			float reach = _lights[light].radius + sphere.w;
+			Float3 d = _lights[light].center - center;
+			if (Dot(d, d) >= reach * reach)
+				continue;
+			if (light < pointCount) {
+				range.pointCount++;
+				indices.push_back(light);
+			}
+			else if (light < pointCount + spotCount) {
+				range.spotCount++;
+				indices.push_back(light - (uint32_t)pointCount);
+			}
+			else {
+				range.rectCount++;
+				indices.push_back(light - (uint32_t)(pointCount + spotCount));
+			}
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Bvh.h"
+#include "ClusterGrid.h"
+#include "CpuMath.h"
+#include "Lights.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+// Range offset of an object without a list, which shades from the clusters
+#define OBJECT_LIGHTS_NONE 0xFFFFFFFFu
+
+// Objects per parallel batch
+#define OBJECT_LIGHT_BATCH 256
+
+// Object bounding spheres are center xyz and radius w; w < 0 marks an object
+// without bounds (dynamic geometry, light proxies).
+inline Float4 UnboundedSphere() { return { 0, 0, 0, -1 }; }
+
+// Sphere around a sphere after a row-vector transform, grown by the largest
+// axis scale.
+Float4 TransformSphere(const Float4& sphere, const Float4x4& transform);
+
+// Per-object light lists built on the CPU every frame, so a draw only walks
+// the lights that reach it. Every light is bounded by the same sphere the
+// cluster grid uses (ClusterGrid.h); the spheres go into a BVH, every object
+// queries it with the box of its own sphere, and keeps the lights whose
+// sphere it touches. Batches of objects run in parallel.
+//
+// GetRanges()[object] is laid out like a ClusterRange into GetLightIndices():
+// points, then spots, then rects, each an index into its own light array.
+class ObjectLightLists {
+public:
+	void Build(const Float4* objectSpheres, size_t objectCount,
+		const PointLight* pointLights, size_t pointCount,
+		const SpotLight* spotLights, size_t spotCount,
+		const RectLight* rectLights, size_t rectCount,
+		ThreadPool& pool);
+
+	size_t GetObjectCount() const { return _ranges.size(); }
+	const vector<ClusterRange>& GetRanges() const { return _ranges; }
+	const vector<uint32_t>& GetLightIndices() const { return _lightIndices; }
+	// objects that got a list, for averaging GetLightIndices().size()
+	size_t GetBoundedCount() const { return _boundedCount; }
+
+private:
+	struct LightSphere {
+		Float3 center;
+		float radius;
+	};
+
+	vector<LightSphere> _lights;
+	vector<Aabb> _lightBoxes;
+	Bvh _bvh;
+	vector<vector<uint32_t>> _batchIndices;
+	vector<ClusterRange> _ranges;
+	vector<uint32_t> _lightIndices;
+	size_t _boundedCount = 0;
+
+	void FillBatch(size_t batch, const Float4* objectSpheres, size_t objectCount, size_t pointCount, size_t spotCount);
+};
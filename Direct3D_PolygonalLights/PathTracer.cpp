@@ -0,0 +1,509 @@
+#include "PathTracer.h"
+#include "ClusterGrid.h"
+#include "Geometry.h"
+#include "Shading.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+// Rows of the albedo table over theta, like the LTC table's
+#define ALBEDO_SIZE 64
+// Stratified GGX samples per axis for every albedo row
+#define ALBEDO_SAMPLES 128
+// Shadow rays start this far off the surface
+#define RAY_OFFSET 1e-3f
+
+#pragma region Sampling
+
+// PCG-RXS-M-XS 32, a sequence per pixel
+static uint32_t NextRandom(uint32_t& state) {
+	state = state * 747796405u + 2891336453u;
+	uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+static float NextFloat(uint32_t& state) {
+	return (NextRandom(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+// LTCFit's GGX in float. Smith masking, Heitz 2014
+static float Lambda(float alpha, float cosTheta) {
+	if (cosTheta >= 1.0f)
+		return 0.0f;
+
+	float tanTheta = std::sqrt(1.0f - cosTheta * cosTheta) / cosTheta;
+	float a = 1.0f / (alpha * tanTheta);
+	return 0.5f * (-1.0f + std::sqrt(1.0f + 1.0f / (a * a)));
+}
+
+// GGX times the cosine of L, and the pdf of SampleGGX for L, in the frame
+// with the normal in z
+static float EvalGGX(Float3 V, Float3 L, float alpha, float& pdf) {
+	pdf = 0.0f;
+	if (V.z <= 0.0f)
+		return 0.0f;
+
+	Float3 H = Normalize(V + L);
+	if (H.z <= 0.0f)
+		return 0.0f;
+
+	float slopeX = H.x / H.z;
+	float slopeY = H.y / H.z;
+	float alpha2 = alpha * alpha;
+	float D = 1.0f / (1.0f + (slopeX * slopeX + slopeY * slopeY) / alpha2);
+	D = D * D / (PI * alpha2 * H.z * H.z * H.z * H.z);
+	pdf = std::fabs(D * H.z / (4.0f * Dot(V, H)));
+
+	if (L.z <= 0.0f)
+		return 0.0f;
+
+	float G2 = 1.0f / (1.0f + Lambda(alpha, V.z) + Lambda(alpha, L.z));
+	return D * G2 / (4.0f * V.z);
+}
+
+// reflects V about a normal sampled from D(h) cos(h)
+static Float3 SampleGGX(Float3 V, float alpha, float u1, float u2) {
+	float phi = 2.0f * PI * u1;
+	float r = alpha * std::sqrt(u2 / (1.0f - u2));
+	Float3 N = Normalize(Float3{ r * std::cos(phi), r * std::sin(phi), 1.0f });
+	return N * (2.0f * Dot(N, V)) - V;
+}
+
+#pragma endregion
+
+#pragma region PublicMethods
+
+PathTracer::PathTracer(int width, int height, const char* ltcMatPath, const char* ltcAmpPath, int threads)
+	: PathTracer(width, height, LTC(ltcMatPath, ltcAmpPath), threads)
+{
+}
+
+PathTracer::PathTracer(int width, int height, const LTC& ltc, int threads)
+	: _width(width), _height(height), _pool(threads), _ltc(ltc)
+{
+	if (width <= 0 || height <= 0)
+		throw pathTracerException("Framebuffer size fucked up");
+
+	_backBuffer.resize((size_t)width * height);
+	_frontBuffer.resize((size_t)width * height);
+	FitAlbedo();
+}
+
+void PathTracer::Clear(const float colorRGBA[4]) {
+	_clearColor = { colorRGBA[0], colorRGBA[1], colorRGBA[2] };
+	std::fill(_backBuffer.begin(), _backBuffer.end(), _clearColor);
+}
+
+void PathTracer::SwapBuffers() {
+	_frontBuffer.swap(_backBuffer);
+}
+
+MeshHandle PathTracer::RegisterMesh(const vector<Vertex>& vBuffer, const vector<unsigned int>& iBuffer) {
+	if (vBuffer.empty() || iBuffer.empty())
+		throw pathTracerException("Empty mesh");
+
+	for (size_t i = 0; i < _meshes.size(); i++) {
+		if (_meshes[i].indices.empty()) {
+			_meshes[i] = { vBuffer, iBuffer };
+			return { (unsigned int)i + 1 };
+		}
+	}
+	_meshes.push_back({ vBuffer, iBuffer });
+	return { (unsigned int)_meshes.size() };
+}
+
+void PathTracer::ReleaseMesh(MeshHandle mesh) {
+	if (mesh.IsValid() && mesh.id <= _meshes.size())
+		_meshes[mesh.id - 1] = Mesh();
+}
+
+void PathTracer::DrawMesh(MeshHandle mesh, Float4x4 transform) {
+	if (!mesh.IsValid() || mesh.id > _meshes.size() || _meshes[mesh.id - 1].indices.empty())
+		throw pathTracerException("Invalid mesh handle");
+
+	_drawList.push_back({ mesh, transform });
+}
+
+// Traces every pixel of the frame the draw list and the lights describe
+void PathTracer::Draw(Float3 cameraPos, Float3 cameraRotation) {
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	// Scene, rect light proxies first as the rasterizer draws them
+	//========================================
+	_triangles.clear();
+	_objects.clear();
+	vector<Vertex> quadVertices;
+	vector<unsigned int> quadIndices;
+	for (size_t i = 0; i < _rectLights.size(); i++) {
+		quadVertices.clear();
+		quadIndices.clear();
+		AppendQuadLight(quadVertices, quadIndices, _rectLights[i], 0);
+		AddObject(quadVertices.data(), quadIndices.data(), quadIndices.size(), QuadLightTransform(_rectLights[i]), (int)i);
+	}
+	for (const MeshDraw& draw : _drawList) {
+		const Mesh& mesh = _meshes[draw.mesh.id - 1];
+		AddObject(mesh.vertices.data(), mesh.indices.data(), mesh.indices.size(), draw.transform, -1);
+	}
+	_drawList.clear();
+
+	_ambient = SumLightAmbient(
+		_pointLights.data(), _pointLights.size(),
+		_spotLights.data(), _spotLights.size(),
+		_rectLights.data(), _rectLights.size());
+
+	// Same camera as SoftwareGraphics: primary rays have view depth 1 per
+	// unit of t, so the near and far planes clip them at t
+	//========================================
+	Float3 forward = Normalize(XYZ(Transform({ 0, 0, 1, 0 }, Float4x4::RotationRollPitchYaw(cameraRotation.x, cameraRotation.y, cameraRotation.z))));
+	Float3 right = Normalize(Cross({ 0, 1, 0 }, forward));
+	Float3 up = Cross(forward, right);
+	float aspect = (float)_height / _width;
+
+	vector<PathTracerStats> rowStats(_height);
+	_pool.ParallelFor((size_t)_height, [&](size_t row) {
+		int y = (int)row;
+		PathTracerStats& stats = rowStats[y];
+		for (int x = 0; x < _width; x++) {
+			float ndcX = 2.0f * (x + 0.5f) / _width - 1.0f;
+			float ndcY = 1.0f - 2.0f * (y + 0.5f) / _height;
+			Float3 direction = right * ndcX + up * (ndcY * aspect) + forward;
+
+			Hit hit;
+			Float3& out = _backBuffer[(size_t)y * _width + x];
+			if (!Intersect(cameraPos, direction, 0.5f, 500.0f, false, hit))
+				continue;
+
+			const Triangle& tri = _triangles[hit.triangle];
+			int rectLight = _objects[tri.object].rectLight;
+			if (rectLight >= 0) {
+				out = XYZ(_rectLights[rectLight].Color);
+				continue;
+			}
+
+			float b0 = 1.0f - hit.b1 - hit.b2;
+			Float3 position = cameraPos + direction * hit.t;
+			Float3 normal = Normalize(tri.normal[0] * b0 + tri.normal[1] * hit.b1 + tri.normal[2] * hit.b2);
+			Float3 color = tri.color[0] * b0 + tri.color[1] * hit.b1 + tri.color[2] * hit.b2;
+			Float3 viewDir = Normalize(cameraPos - position);
+			out = ShadePixel(position, normal, color, viewDir, (uint32_t)(y * _width + x), stats);
+		}
+	});
+
+	_stats = {};
+	for (const PathTracerStats& stats : rowStats) {
+		_stats.lightSamples += stats.lightSamples;
+		_stats.shadowRays += stats.shadowRays;
+	}
+	_stats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void PathTracer::AddPointLight(Float3 position, Float3 color, float intensity, float radius) {
+	_pointLights.push_back({
+		{ position.x, position.y, position.z, 1 },
+		{ color.x, color.y, color.z, intensity },
+		{ radius, 0, 0, 0 }
+	});
+}
+
+void PathTracer::AddSpotLight(Float3 position, Float3 color, Float3 direction, float intensity, float innerCone, float outerCone, float radius) {
+	_spotLights.push_back({
+		{ position.x, position.y, position.z, 1 },
+		{ direction.x, direction.y, direction.z, 1 },
+		{ color.x, color.y, color.z, intensity },
+		{ innerCone, outerCone, 0, 0 },
+		{ radius, 0, 0, 0 }
+	});
+}
+
+void PathTracer::AddDirLight(Float3 color, Float3 direction, float intensity) {
+	if (_dirLights.size() >= LIGHT_BUFFER_SIZE)
+		return;
+
+	_dirLights.push_back({
+		{ direction.x, direction.y, direction.z, 1 },
+		{ color.x, color.y, color.z, intensity }
+	});
+}
+
+void PathTracer::AddRectLight(Float3 position, Float3 color, float intensity, float width, float height, float rotationX, float rotationY) {
+	_rectLights.push_back({
+		{ position.x, position.y, position.z, 1 },
+		{ width, height, rotationX, rotationY },
+		{ color.x, color.y, color.z, intensity }
+	});
+}
+
+PointLight* PathTracer::GetPointLight(int index) {
+	return index < (int)_pointLights.size() ? &_pointLights[index] : nullptr;
+}
+
+SpotLight* PathTracer::GetSpotLight(int index) {
+	return index < (int)_spotLights.size() ? &_spotLights[index] : nullptr;
+}
+
+DirLight* PathTracer::GetDirLight(int index) {
+	return index < (int)_dirLights.size() ? &_dirLights[index] : nullptr;
+}
+
+RectLight* PathTracer::GetRectLight(int index) {
+	return index < (int)_rectLights.size() ? &_rectLights[index] : nullptr;
+}
+
+bool PathTracer::SaveFrontBuffer(const char* path) const {
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return false;
+
+	fprintf(file, "P6\n%d %d\n255\n", _width, _height);
+	vector<unsigned char> row(_width * 3);
+	for (int y = 0; y < _height; y++) {
+		for (int x = 0; x < _width; x++) {
+			Float3 c = _frontBuffer[(size_t)y * _width + x];
+			row[x * 3 + 0] = (unsigned char)(Saturate(c.x) * 255.0f + 0.5f);
+			row[x * 3 + 1] = (unsigned char)(Saturate(c.y) * 255.0f + 0.5f);
+			row[x * 3 + 2] = (unsigned char)(Saturate(c.z) * 255.0f + 0.5f);
+		}
+		fwrite(row.data(), 1, row.size(), file);
+	}
+	return fclose(file) == 0;
+}
+
+#pragma endregion
+
+#pragma region PrivateMethods
+
+// The LTC lobe integrates to 1, GGX to its directional albedo: the table
+// rescales the GGX integral to the quantity the LTC approximates.
+void PathTracer::FitAlbedo() {
+	float alpha = _roughness * _roughness;
+	_albedo.resize(ALBEDO_SIZE);
+	for (int row = 0; row < ALBEDO_SIZE; row++) {
+		float theta = std::min(row / (ALBEDO_SIZE - 1.0f) * 0.5f * PI, 0.5f * PI - 1e-3f);
+		Float3 V = { std::sin(theta), 0.0f, std::cos(theta) };
+		double sum = 0.0;
+		for (int i = 0; i < ALBEDO_SAMPLES; i++) {
+			for (int j = 0; j < ALBEDO_SAMPLES; j++) {
+				Float3 L = SampleGGX(V, alpha, (i + 0.5f) / ALBEDO_SAMPLES, (j + 0.5f) / ALBEDO_SAMPLES);
+				float pdf;
+				float value = EvalGGX(V, L, alpha, pdf);
+				if (pdf > 0.0f)
+					sum += value / pdf;
+			}
+		}
+		_albedo[row] = (float)(sum / (ALBEDO_SAMPLES * ALBEDO_SAMPLES));
+	}
+}
+
+float PathTracer::GetAlbedo(float cosTheta) const {
+	float x = std::acos(std::min(std::max(cosTheta, 0.0f), 1.0f)) / (0.5f * PI) * (ALBEDO_SIZE - 1);
+	int row = std::min((int)x, ALBEDO_SIZE - 2);
+	float t = x - row;
+	return _albedo[row] * (1.0f - t) + _albedo[row + 1] * t;
+}
+
+// Mirrors the modelToWorld/normalTransform pair the rasterizers use
+void PathTracer::AddObject(const Vertex* vertices, const unsigned int* indices, size_t indexCount, const Float4x4& transform, int rectLight) {
+	Float4x4 normalTransform = Transpose(Inverse(transform));
+	Object object = { { INFINITY, INFINITY, INFINITY }, { -INFINITY, -INFINITY, -INFINITY }, (uint32_t)_triangles.size(), 0, rectLight };
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		Float3 world[3];
+		Triangle tri;
+		for (int k = 0; k < 3; k++) {
+			const Vertex& v = vertices[indices[i + k]];
+			world[k] = XYZ(Transform({ v.x, v.y, v.z, 1 }, transform));
+			tri.normal[k] = XYZ(Transform({ v.nx, v.ny, v.nz, 0 }, normalTransform));
+			tri.color[k] = { v.r, v.g, v.b };
+			object.min = { std::min(object.min.x, world[k].x), std::min(object.min.y, world[k].y), std::min(object.min.z, world[k].z) };
+			object.max = { std::max(object.max.x, world[k].x), std::max(object.max.y, world[k].y), std::max(object.max.z, world[k].z) };
+		}
+		tri.a = world[0];
+		tri.edge1 = world[1] - world[0];
+		tri.edge2 = world[2] - world[0];
+		tri.object = (uint32_t)_objects.size();
+		_triangles.push_back(tri);
+	}
+
+	object.count = (uint32_t)_triangles.size() - object.first;
+	_objects.push_back(object);
+}
+
+// Closest hit in (tMin, tMax) of origin + t direction. Primary rays see
+// front faces only, as the rasterizer culls back faces; shadow rays return
+// on the first hit of either side and pass through light proxies.
+bool PathTracer::Intersect(Float3 origin, Float3 direction, float tMin, float tMax, bool shadow, Hit& hit) const {
+	Float3 invDirection = { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+	bool found = false;
+	for (const Object& object : _objects) {
+		if (shadow && object.rectLight >= 0)
+			continue;
+
+		// slab test against the object's box
+		float t0x = (object.min.x - origin.x) * invDirection.x, t1x = (object.max.x - origin.x) * invDirection.x;
+		float t0y = (object.min.y - origin.y) * invDirection.y, t1y = (object.max.y - origin.y) * invDirection.y;
+		float t0z = (object.min.z - origin.z) * invDirection.z, t1z = (object.max.z - origin.z) * invDirection.z;
+		float enter = std::max({ std::min(t0x, t1x), std::min(t0y, t1y), std::min(t0z, t1z), tMin });
+		float exit = std::min({ std::max(t0x, t1x), std::max(t0y, t1y), std::max(t0z, t1z), tMax });
+		if (!(enter <= exit))
+			continue;
+
+		// Moller-Trumbore; det > 0 is a front face
+		for (uint32_t i = object.first; i < object.first + object.count; i++) {
+			const Triangle& tri = _triangles[i];
+			Float3 p = Cross(direction, tri.edge2);
+			float det = Dot(tri.edge1, p);
+			if (shadow ? std::fabs(det) < 1e-12f : det < 1e-12f)
+				continue;
+
+			float invDet = 1.0f / det;
+			Float3 s = origin - tri.a;
+			float b1 = Dot(s, p) * invDet;
+			if (b1 < 0.0f || b1 > 1.0f)
+				continue;
+			Float3 q = Cross(s, tri.edge1);
+			float b2 = Dot(direction, q) * invDet;
+			if (b2 < 0.0f || b1 + b2 > 1.0f)
+				continue;
+			float t = Dot(tri.edge2, q) * invDet;
+			if (t <= tMin || t >= tMax)
+				continue;
+
+			if (shadow)
+				return true;
+			tMax = t;
+			hit = { t, b1, b2, i };
+			found = true;
+		}
+	}
+	return found;
+}
+
+bool PathTracer::Visible(Float3 from, Float3 normal, Float3 to) const {
+	Float3 origin = from + normal * RAY_OFFSET;
+	Hit hit;
+	return !Intersect(origin, to - origin, 0.0f, 1.0f - 1e-4f, true, hit);
+}
+
+Float3 PathTracer::ShadePixel(Float3 position, Float3 normal, Float3 color, Float3 viewDir, uint32_t pixel, PathTracerStats& stats) const {
+	bool traced = _mode == PathTracerMode::Reference;
+	bool shadows = traced && _shadows;
+	uint32_t random = pixel;
+	NextRandom(random);
+	random ^= _seed * 0x9E3779B9u;
+
+	auto visible = [&](Float3 to) {
+		if (!shadows)
+			return true;
+		stats.shadowRays++;
+		return Visible(position, normal, to);
+	};
+
+	// per-light ambient is summed into _ambient, as in the rasterizer
+	Float3 light = _ambient * color;
+	for (const PointLight& l : _pointLights)
+		if (visible(XYZ(l.Position)))
+			light += CalcPointLight(l, normal, position, color, viewDir, 1.0f, 64.0f, 0.0f);
+	for (const SpotLight& l : _spotLights)
+		if (visible(XYZ(l.Position)))
+			light += CalcSpotLight(l, normal, position, color, viewDir, 1.0f, 64.0f, 0.0f);
+	for (const DirLight& l : _dirLights)
+		if (visible(position - XYZ(l.Direction) * 1000.0f))
+			light += CalcDirLight(l, normal, color, viewDir);
+	for (const RectLight& l : _rectLights) {
+		light += traced
+			? SampleRectLight(l, position, normal, color, viewDir, random, stats)
+			: _ltc.CalcRectLight(l, normal, position, color, viewDir, _roughness, 0.0f);
+	}
+	return light;
+}
+
+// One light area sample and one GGX sample per iteration. The area sample
+// gives the form factor directly; both give the specular integral, weighted
+// by the balance heuristic.
+Float3 PathTracer::SampleRectLight(const RectLight& light, Float3 position, Float3 normal, Float3 color, Float3 viewDir, uint32_t& random, PathTracerStats& stats) const {
+	Float3 points[4];
+	RectLightPoints(light, points);
+	Float3 origin = points[0];
+	Float3 ex = points[1] - points[0];
+	Float3 ey = points[3] - points[0];
+	Float3 lightNormal = Cross(ex, ey);
+	float area = Length(lightNormal);
+	if (area <= 0.0f)
+		return { 0, 0, 0 };
+	lightNormal = lightNormal / area;
+
+	// the LTC frame: normal in z, the view in the xz plane
+	Float3 T1 = viewDir - normal * Dot(viewDir, normal);
+	T1 = Length(T1) > 1e-6f ? Normalize(T1) : Normalize(Cross(std::fabs(normal.y) < 0.999f ? Float3{ 0, 1, 0 } : Float3{ 1, 0, 0 }, normal));
+	Float3 T2 = Cross(normal, T1);
+	Float3 V = { Dot(viewDir, T1), Dot(viewDir, T2), Dot(viewDir, normal) };
+	float alpha = _roughness * _roughness;
+	auto visible = [&](Float3 to) {
+		if (!_shadows)
+			return true;
+		stats.shadowRays++;
+		return Visible(position, normal, to);
+	};
+
+	double formFactor = 0.0, specular = 0.0;
+	for (int s = 0; s < _samples; s++) {
+		// light area sample
+		Float3 target = origin + ex * NextFloat(random) + ey * NextFloat(random);
+		Float3 toLight = target - position;
+		float distanceSq = Dot(toLight, toLight);
+		Float3 L = toLight / std::sqrt(distanceSq);
+		float cosSurface = Dot(normal, L);
+		float cosLight = std::fabs(Dot(lightNormal, L));
+		if (cosSurface > 0.0f && cosLight > 0.0f && visible(target)) {
+			formFactor += cosSurface * cosLight * area / (PI * distanceSq);
+
+			float pdfLight = distanceSq / (cosLight * area);
+			float pdfGGX;
+			float value = EvalGGX(V, { Dot(L, T1), Dot(L, T2), cosSurface }, alpha, pdfGGX);
+			specular += value / (pdfLight + pdfGGX);
+		}
+
+		// GGX sample, counted when it hits the quad
+		float u1 = NextFloat(random), u2 = NextFloat(random);
+		Float3 local = SampleGGX(V, alpha, u1, u2);
+		if (local.z <= 0.0f || V.z <= 0.0f)
+			continue;
+		Float3 direction = T1 * local.x + T2 * local.y + normal * local.z;
+		float facing = Dot(direction, lightNormal);
+		if (std::fabs(facing) < 1e-8f)
+			continue;
+		float t = Dot(origin - position, lightNormal) / facing;
+		if (t <= 0.0f)
+			continue;
+		Float3 onPlane = position + direction * t - origin;
+		float u = Dot(onPlane, ex) / Dot(ex, ex);
+		float v = Dot(onPlane, ey) / Dot(ey, ey);
+		if (u < 0.0f || u > 1.0f || v < 0.0f || v > 1.0f)
+			continue;
+		if (!visible(position + direction * t))
+			continue;
+
+		float pdfLight = t * t / (std::fabs(facing) * area);
+		float pdfGGX;
+		float value = EvalGGX(V, local, alpha, pdfGGX);
+		if (pdfGGX > 0.0f)
+			specular += value / (pdfLight + pdfGGX);
+	}
+	stats.lightSamples += _samples;
+	formFactor /= _samples;
+	specular /= _samples;
+
+	// the amplitude CalcRectLight reads at the same lookup
+	float lutSize = (float)_ltc.GetLutSize();
+	float theta = std::acos(Dot(normal, viewDir));
+	float amp = _ltc.SampleAmp(
+		_roughness * (lutSize - 1.0f) / lutSize + 0.5f / lutSize,
+		theta / (0.5f * PI) * (lutSize - 1.0f) / lutSize + 0.5f / lutSize).w;
+	float normalized = V.z > 0.0f ? (float)specular / GetAlbedo(V.z) : 0.0f;
+
+	Float3 lightColor = XYZ(light.Color);
+	return (lightColor * (0.2f * amp * normalized) + color * (1.5f * (float)formFactor)) * lightColor * light.Color.w;
+}
+
+#pragma endregion
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "CpuMath.h"
+#include "Lights.h"
+#include "LTC.h"
+#include "MeshCache.h"
+#include "ThreadPool.h"
+#include "Vertex.h"
+#include <cstdint>
+#include <exception>
+#include <vector>
+
+using std::exception;
+using std::vector;
+
+// Light samples per pixel and rect light when SetSamples is not called
+#define PATH_TRACER_DEFAULT_SAMPLES 64
+
+// What Draw computes at every pixel's primary hit
+enum class PathTracerMode {
+	Reference, // rect lights integrated by Monte Carlo
+	Analytic   // rect lights by LTC::CalcRectLight, every light, no clusters
+};
+
+// Counters of the last Draw
+struct PathTracerStats {
+	size_t lightSamples = 0; // per pixel, rect light and sample: one light and one GGX direction
+	size_t shadowRays = 0;
+	double seconds = 0.0;
+};
+
+// Monte Carlo reference for the scene SoftwareGraphics draws, with the same
+// public API for it. One primary ray per pixel center finds the same surface
+// the rasterizer shades. Rect lights are then integrated by explicitly
+// sampling their quads, with the GGX lobe of CalcRectLight's roughness for
+// the specular part: light area samples and GGX samples combined with the
+// balance heuristic. Diffuse and specular are weighted as in CalcRectLight,
+// so the only difference left is the LTC approximation itself:
+//   (0.2 amp.w S lightColor + 1.5 F fragColor) lightColor intensity
+// with F the form factor and S the GGX integral over the light, divided by
+// the GGX albedo the LTC lobe is normalized to. Point, spot and directional
+// lights are delta lights and shaded with their analytic functions.
+//
+// The rasterizer has no shadows and no indirect light, so neither has the
+// reference unless SetShadows turns on visibility rays to every light.
+// Every pixel draws from its own random sequence, so images do not depend on
+// the thread count. Output is linear float RGB, clamped only when saved.
+class PathTracer {
+public:
+	PathTracer(int width, int height, const char* ltcMatPath = "./ltc_mat.dds", const char* ltcAmpPath = "./ltc_amp.dds", int threads = 0);
+	// With tables of the caller's, such as a diffuse-only LTC
+	PathTracer(int width, int height, const LTC& ltc, int threads = 0);
+
+	void SetMode(PathTracerMode mode) { _mode = mode; }
+	void SetSamples(int samples) { _samples = samples > 0 ? samples : 1; }
+	void SetShadows(bool shadows) { _shadows = shadows; }
+	// Decorrelates the random sequences of images with the same settings
+	void SetSeed(uint32_t seed) { _seed = seed; }
+
+	void Clear(const float colorRGBA[4]);
+	void SwapBuffers();
+	MeshHandle RegisterMesh(const vector<Vertex>& vBuffer, const vector<unsigned int>& iBuffer);
+	void ReleaseMesh(MeshHandle mesh);
+	void DrawMesh(MeshHandle mesh, Float4x4 transform);
+	void Draw(Float3 cameraPos, Float3 cameraRotation);
+	void AddPointLight(Float3 position, Float3 color, float intensity = 1.0f, float radius = 0.0f);
+	void AddSpotLight(Float3 position, Float3 color, Float3 direction, float intensity = 10.0f, float innerCone = 0.7f, float outerCone = .75f, float radius = 0.0f);
+	void AddDirLight(Float3 color, Float3 direction, float intensity = 1.0f);
+	void AddRectLight(Float3 position, Float3 color, float intensity = 1.0f, float width = 1.0f, float height = 1.0f, float rotationX = .0f, float rotationY = .0f);
+
+	PointLight* GetPointLight(int index);
+	SpotLight* GetSpotLight(int index);
+	DirLight* GetDirLight(int index);
+	RectLight* GetRectLight(int index);
+
+	// Last presented frame, rows top to bottom
+	const vector<Float3>& GetFrontBuffer() const { return _frontBuffer; }
+	// Binary PPM, clamped to [0, 1] like the rasterizer's RGBA8 output
+	bool SaveFrontBuffer(const char* path) const;
+	const PathTracerStats& GetStats() const { return _stats; }
+	int GetWidth() const { return _width; }
+	int GetHeight() const { return _height; }
+	int GetThreadCount() const { return _pool.GetThreadCount(); }
+
+private:
+	struct Triangle {
+		Float3 a, edge1, edge2;
+		Float3 normal[3];
+		Float3 color[3];
+		uint32_t object;
+	};
+
+	// A draw's world-space triangles [first, first + count) and their box.
+	// Rect light proxies are seen by primary rays but cast no shadows.
+	struct Object {
+		Float3 min, max;
+		uint32_t first, count;
+		int rectLight; // -1 for scene geometry
+	};
+
+	struct Hit {
+		float t, b1, b2;
+		uint32_t triangle;
+	};
+
+	struct Mesh {
+		vector<Vertex> vertices;
+		vector<unsigned int> indices;
+	};
+
+	struct MeshDraw {
+		MeshHandle mesh;
+		Float4x4 transform;
+	};
+
+	int _width;
+	int _height;
+	ThreadPool _pool;
+	LTC _ltc;
+	PathTracerMode _mode = PathTracerMode::Reference;
+	int _samples = PATH_TRACER_DEFAULT_SAMPLES;
+	bool _shadows = false;
+	uint32_t _seed = 0;
+	float _roughness = 0.25f; // what Graphics passes CalcRectLight
+	vector<float> _albedo;    // GGX directional albedo over theta, see FitAlbedo
+
+	Float3 _clearColor = { 0, 0, 0 };
+	vector<Float3> _backBuffer;
+	vector<Float3> _frontBuffer;
+	PathTracerStats _stats;
+
+	vector<PointLight> _pointLights;
+	vector<SpotLight> _spotLights;
+	vector<DirLight> _dirLights;
+	vector<RectLight> _rectLights;
+	Float3 _ambient = { 0, 0, 0 };
+
+	vector<Mesh> _meshes;
+	vector<MeshDraw> _drawList;
+	vector<Triangle> _triangles;
+	vector<Object> _objects;
+
+	void FitAlbedo();
+	float GetAlbedo(float cosTheta) const;
+	void AddObject(const Vertex* vertices, const unsigned int* indices, size_t indexCount, const Float4x4& transform, int rectLight);
+	bool Intersect(Float3 origin, Float3 direction, float tMin, float tMax, bool shadow, Hit& hit) const;
+	bool Visible(Float3 from, Float3 normal, Float3 to) const;
+	Float3 ShadePixel(Float3 position, Float3 normal, Float3 color, Float3 viewDir, uint32_t pixel, PathTracerStats& stats) const;
+	Float3 SampleRectLight(const RectLight& light, Float3 position, Float3 normal, Float3 color, Float3 viewDir, uint32_t& random, PathTracerStats& stats) const;
+
+	class pathTracerException : public exception {
+	private:
+		const char* _message;
+	public:
+		pathTracerException(const char* message) : _message(message) {}
+		const char* what() const throw () { return _message; }
+	};
+};
@@ -1,17 +1,45 @@
 static const int LightBufferSize = 10;
+static const int PolygonMaxVertices = 8;
 static const float pi = 3.14159265;
-static const float LUT_SIZE = 64.0;
-static const float LUT_SCALE = (LUT_SIZE - 1.0) / LUT_SIZE;
-static const float LUT_BIAS = 0.5 / LUT_SIZE;
-static const bool TEXTURED = false;
+
+// Light types main shades, 0 compiles a type's loop out. Graphics picks the
+// variant of the scene's LightMix; every type is on unless the compile
+// defines otherwise, which is the generic shader.
+#ifndef LIGHT_POINT
+#define LIGHT_POINT 1
+#endif
+#ifndef LIGHT_SPOT
+#define LIGHT_SPOT 1
+#endif
+#ifndef LIGHT_DIR
+#define LIGHT_DIR 1
+#endif
+#ifndef LIGHT_RECT
+#define LIGHT_RECT 1
+#endif
+#ifndef LIGHT_POLYGON
+#define LIGHT_POLYGON 1
+#endif
+#ifndef LIGHT_DISK
+#define LIGHT_DISK 1
+#endif
+#ifndef LIGHT_SPHERE
+#define LIGHT_SPHERE 1
+#endif
+#define LIGHT_CLUSTERED (LIGHT_POINT || LIGHT_SPOT || LIGHT_RECT)
+
+// Rect lights and their proxies sample lightTexture
+#ifndef TEXTURED
+#define TEXTURED 0
+#endif
 
 // Structures and buffers
 //=========================
 
-Texture2D ltcMat;
-Texture2D ltcAmp;
-Texture2D lightTexture;
-SamplerState ltcSampler;
+Texture2D ltcMat : register(t0);
+Texture2D ltcAmp : register(t1);
+Texture2D lightTexture : register(t2);
+SamplerState ltcSampler : register(s0);
 
 struct PSIn {
 	float4 position : SV_POSITION;
@@ -25,6 +53,7 @@ struct PSIn {
 struct PointLight {
 	float4 Position;
 	float4 Color;
+	float4 Range; // x: radius of the windowed falloff, 0 for plain 1 / d^2
 };
 
 struct DirLight {
@@ -37,6 +66,7 @@ struct SpotLight {
 	float4 Direction;
 	float4 Color;
 	float4 Cone;
+	float4 Range; // x: radius of the windowed falloff, 0 for plain 1 / d^2
 };
 
 struct RectLight {
@@ -45,16 +75,70 @@ struct RectLight {
 	float4 Color;
 };
 
-cbuffer CBuf {
+// two-sided, Range.x: cutoff distance from Position
+struct DiskLight {
+	float4 Position;
+	float4 Direction; // xyz: normal, w: radius
+	float4 Color;
+	float4 Range;
+};
+
+struct SphereLight {
+	float4 Position; // xyz: center, w: radius
+	float4 Color;
+	float4 Range;
+};
+
+// convex, two-sided; vertices.x of them from polygonVertices[vertices.y]
+struct PolygonLight {
+	float4 Color;
+	float4 Bounds; // xyz: centroid, w: range from it
+	uint4 Vertices;
+};
+
+cbuffer CBuf : register(b0) {
 	float4 viewPos;
-	int4 lightCounts; // point, spot, dir, rect
-	PointLight pointLights[LightBufferSize];
-	SpotLight spotLights[LightBufferSize];
+	float4 viewForward;
+	int4 clusterGrid;    // tiles x, tiles y, slices, tile size in pixels
+	float4 clusterDepth; // slice = log(depth) * x + y
+	uint4 rectProxies;   // x: rect light proxies drawn this frame, y: objects
+	float4 rectLod;      // x, y: diffuse and specular solid angle, see RectLightLod
+};
+
+// Rewritten only when a light changes (LightStore on the CPU)
+cbuffer LightCBuf : register(b1) {
+	float4 lightAmbient; // ambient terms of all point, spot and rect lights
+	int4 lightCounts;    // point, spot, dir, rect
+	int4 polygonCounts;  // polygon lights, their vertices, disk lights, sphere lights
 	DirLight dirLights[LightBufferSize];
-	RectLight rectLights[LightBufferSize];
 };
 
-// LTC FUNCTIONS
+// Point, spot and rect lights are culled per cluster (ClusterGrid on the CPU).
+// clusters[i] = (first index, point count, spot count, rect count) into clusterLights.
+StructuredBuffer<PointLight> pointLights : register(t3);
+StructuredBuffer<SpotLight> spotLights : register(t4);
+StructuredBuffer<RectLight> rectLights : register(t5);
+StructuredBuffer<uint4> clusters : register(t6);
+StructuredBuffer<uint> clusterLights : register(t7);
+
+// Per-object lists (ObjectLightLists on the CPU) laid out like the clusters;
+// objects without bounds have offset 0xFFFFFFFF. A pixel walks whichever of
+// its object's and its cluster's list is shorter.
+StructuredBuffer<uint4> objectLights : register(t8);
+StructuredBuffer<uint> objectLightIndices : register(t9);
+
+// Polygon lights are few and not clustered
+StructuredBuffer<PolygonLight> polygonLights : register(t10);
+StructuredBuffer<float4> polygonVertices : register(t11);
+StructuredBuffer<DiskLight> diskLights : register(t12);
+StructuredBuffer<SphereLight> sphereLights : register(t13);
+
+uint ListedLight(bool perObject, uint i)
+{
+	return perObject ? objectLightIndices[i] : clusterLights[i];
+}
+
+// LTC FUNCTIONS (CPU port in LTC.cpp, keep in sync)
 //=========================
 
 float3 rotation_y(float3 v, float a)
@@ -278,6 +362,275 @@ float3 LTCEvaluate(
 	return float3(sum, sum, sum) * texturedCol;
 }
 
+// Sutherland-Hodgman against the horizon for any convex polygon; the
+// crossing points are scaled like ClipQuadToHorizon's. Returns 0 or 3 and up.
+int ClipPolygonToHorizon(float3 L[PolygonMaxVertices], int count, out float3 clipped[PolygonMaxVertices + 1])
+{
+	int n = 0;
+	for (int i = 0; i < count; i++)
+	{
+		float3 a = L[i];
+		float3 b = L[(i + 1) % count];
+		bool aUp = a.z > 0.0;
+		if (aUp)
+			clipped[n++] = a;
+		if (aUp != (b.z > 0.0))
+			clipped[n++] = abs(a.z) * b + abs(b.z) * a;
+	}
+	return n >= 3 ? n : 0;
+}
+
+float3 LTCEvaluatePolygon(
+	float3 fragPos,
+	float3 viewDir,
+	float3 normal,
+	float3 points[PolygonMaxVertices],
+	int count,
+	float3x3 Minv
+) {
+	float3 T1, T2;
+	T1 = normalize(viewDir - normal * dot(viewDir, normal));
+	T2 = cross(normal, T1);
+
+	float3x3 M;
+	M[0] = T1;
+	M[1] = T2;
+	M[2] = normal;
+	Minv = mul(transpose(M), Minv);
+
+	float3 L[PolygonMaxVertices];
+	for (int i = 0; i < count; i++)
+		L[i] = mul(points[i] - fragPos, Minv);
+
+	float3 clipped[PolygonMaxVertices + 1];
+	int n = ClipPolygonToHorizon(L, count, clipped);
+	if (n == 0)
+		return float3(0, 0, 0);
+
+	// project onto sphere
+	for (i = 0; i < n; i++)
+		clipped[i] = normalize(clipped[i]);
+
+	float sum = 0;
+	for (i = 0; i < n; i++)
+		sum += IntegrateEdge(clipped[i], clipped[(i + 1) % n]);
+
+	sum = abs(sum);
+	return float3(sum, sum, sum);
+}
+
+// Blinn's cubic solver, as in Heitz and Hill's disk light code: the roots of
+// c.x + c.y t + c.z t^2 + c.w t^3, the smallest one in y.
+float3 SolveCubic(float4 c)
+{
+	c.xyz /= c.w;
+	c.yz /= 3.0;
+
+	float A = c.w;
+	float B = c.z;
+	float C = c.y;
+	float D = c.x;
+
+	// Hessian and discriminant
+	float3 delta = float3(-c.z * c.z + c.y, -c.y * c.z + c.x, c.z * c.x - c.y * c.y);
+	float discriminant = max(4.0 * delta.x * delta.z - delta.y * delta.y, 0.0);
+
+	// largest root
+	float xlNum, xlDen;
+	{
+		float Ca = delta.x;
+		float Da = -2.0 * B * delta.x + delta.y;
+		float theta = atan2(sqrt(discriminant), -Da) / 3.0;
+		float x1 = 2.0 * sqrt(max(-Ca, 0.0)) * cos(theta);
+		float x3 = 2.0 * sqrt(max(-Ca, 0.0)) * (-0.5 * cos(theta) - 0.8660254 * sin(theta));
+		float xl = (x1 + x3 > 2.0 * B) ? x1 : x3;
+		xlNum = xl - B;
+		xlDen = A;
+	}
+
+	// smallest root
+	float xsNum, xsDen;
+	{
+		float Cd = delta.z;
+		float Dd = -D * delta.y + 2.0 * C * delta.z;
+		float theta = atan2(D * sqrt(discriminant), -Dd) / 3.0;
+		float x1 = 2.0 * sqrt(max(-Cd, 0.0)) * cos(theta);
+		float x3 = 2.0 * sqrt(max(-Cd, 0.0)) * (-0.5 * cos(theta) - 0.8660254 * sin(theta));
+		float xs = (x1 + x3 < 2.0 * C) ? x1 : x3;
+		xsNum = -D;
+		xsDen = xs + C;
+	}
+
+	// middle root from the other two
+	float E = xlDen * xsDen;
+	float F = -xlNum * xsDen - xlDen * xsNum;
+	float G = xlNum * xsNum;
+	float3 root = float3(xsNum / xsDen, (C * F - B * G) / (-B * F + C * E), xlNum / xlDen);
+
+	if (root.x < root.y && root.x < root.z)
+		root.xyz = root.yxz;
+	else if (root.z < root.x && root.z < root.y)
+		root.xyz = root.xzy;
+	return root;
+}
+
+// Cosine-weighted integral over the part of a sphere cap above the horizon,
+// over pi (Snyder's closed form)
+float SphereIntegral(float cosTheta, float formFactor)
+{
+	formFactor = min(formFactor, 0.9999);
+	if (cosTheta * cosTheta > formFactor)
+		return max(formFactor * cosTheta, 0.0);
+
+	float sinTheta = sqrt(max(1.0 - cosTheta * cosTheta, 0.0));
+	float x = sqrt(1.0 / formFactor - 1.0);
+	float y = clamp(-x * cosTheta / sinTheta, -1.0, 1.0);
+	float sinThetaSqrtY = sinTheta * sqrt(1.0 - y * y);
+	float integral = (cosTheta * acos(y) - x * sinThetaSqrtY) * formFactor + atan(sinThetaSqrtY / x);
+	return max(integral / pi, 0.0);
+}
+
+// The ellipse under Minv replaced by the sphere cap of the same vector form
+// factor; no clipping
+float3 LTCEvaluateDisk(
+	float3 fragPos,
+	float3 viewDir,
+	float3 normal,
+	float3 center,
+	float3 axisX,
+	float3 axisY,
+	float3x3 Minv
+) {
+	float3 T1, T2;
+	T1 = normalize(viewDir - normal * dot(viewDir, normal));
+	T2 = cross(normal, T1);
+
+	float3x3 M;
+	M[0] = T1;
+	M[1] = T2;
+	M[2] = normal;
+	Minv = mul(transpose(M), Minv);
+
+	float3 C = mul(center - fragPos, Minv);
+	float3 V1 = mul(axisX, Minv);
+	float3 V2 = mul(axisY, Minv);
+
+	// principal axes of the ellipse
+	float a, b;
+	float d11 = dot(V1, V1);
+	float d22 = dot(V2, V2);
+	float d12 = dot(V1, V2);
+	if (abs(d12) / sqrt(d11 * d22) > 0.0001)
+	{
+		float tr = d11 + d22;
+		float det = sqrt(max(-d12 * d12 + d11 * d22, 0.0));
+		float u = 0.5 * sqrt(max(tr - 2.0 * det, 0.0));
+		float v = 0.5 * sqrt(tr + 2.0 * det);
+		float eMax = (u + v) * (u + v);
+		float eMin = (u - v) * (u - v);
+
+		float3 V1_, V2_;
+		if (d11 > d22)
+		{
+			V1_ = d12 * V1 + (eMax - d11) * V2;
+			V2_ = d12 * V1 + (eMin - d11) * V2;
+		}
+		else
+		{
+			V1_ = d12 * V2 + (eMax - d22) * V1;
+			V2_ = d12 * V2 + (eMin - d22) * V1;
+		}
+		a = 1.0 / eMax;
+		b = 1.0 / eMin;
+		V1 = normalize(V1_);
+		V2 = normalize(V2_);
+	}
+	else
+	{
+		a = 1.0 / d11;
+		b = 1.0 / d22;
+		V1 *= sqrt(a);
+		V2 *= sqrt(b);
+	}
+
+	float3 V3 = cross(V1, V2);
+	if (dot(C, V3) < 0.0)
+		V3 = -V3;
+
+	// edge-on through the shading point
+	float L = dot(V3, C);
+	if (L < 1e-6)
+		return float3(0, 0, 0);
+	float x0 = dot(V1, C) / L;
+	float y0 = dot(V2, C) / L;
+
+	a *= L * L;
+	b *= L * L;
+
+	float c0 = a * b;
+	float c1 = a * b * (1.0 + x0 * x0 + y0 * y0) - a - b;
+	float c2 = 1.0 - a * (1.0 + x0 * x0) - b * (1.0 + y0 * y0);
+	float3 roots = SolveCubic(float4(c0, c1, c2, 1.0));
+	float e1 = roots.x;
+	float e2 = roots.y;
+	float e3 = roots.z;
+
+	float3 avgDir = normalize(V1 * (a * x0 / (a - e2)) + V2 * (b * y0 / (b - e2)) + V3);
+
+	float L1 = sqrt(-e2 / e3);
+	float L2 = sqrt(-e2 / e1);
+	float formFactor = L1 * L2 / sqrt((1.0 + L1 * L1) * (1.0 + L2 * L2));
+
+	float sum = 2.0 * pi * SphereIntegral(avgDir.z, formFactor);
+	return float3(sum, sum, sum);
+}
+
+// A far rect light as the sphere cap of its disk form factor under Minv, no
+// clipping or cubic (RectLightLod on the CPU); the texture as LTCEvaluate
+float3 LTCEvaluateRectDisk(
+	float3 fragPos,
+	float3 viewDir,
+	float3 normal,
+	float3 center,
+	float3 ex,
+	float3 ey,
+	float3x3 Minv
+) {
+	float3 T1, T2;
+	T1 = normalize(viewDir - normal * dot(viewDir, normal));
+	T2 = cross(normal, T1);
+
+	float3x3 M;
+	M[0] = T1;
+	M[1] = T2;
+	M[2] = normal;
+	Minv = mul(transpose(M), Minv);
+
+	float3 C = mul(center - fragPos, Minv);
+	float3 Ex = mul(ex, Minv);
+	float3 Ey = mul(ey, Minv);
+	float3 area = cross(Ex, Ey) * 4.0;
+	float invLength = rsqrt(dot(C, C));
+	float solidAngle = abs(dot(area, C)) * invLength * invLength * invLength;
+
+	float3 texturedCol = (TEXTURED)
+		? FetchDiffuseFilteredTexture(C - Ex - Ey, C + Ex - Ey, C + Ex + Ey, C - Ex + Ey)
+		: float3(1, 1, 1);
+
+	float sum = 2.0 * pi * SphereIntegral(C.z * invLength, solidAngle / pi);
+	return float3(sum, sum, sum) * texturedCol;
+}
+
+// Most a solid angle grows by under the LUT matrix t, as LTC::SetMatrix
+float LTCStretch(float4 t)
+{
+	float det = t.x - t.w * t.y;
+	float sum = 1.0 + t.w * t.w + t.y * t.y + t.x * t.x;
+	float largest = (sum + sqrt(max(sum * sum - 4.0 * det * det, 0.0))) * 0.5;
+	float smallest = sqrt(min(det * det / largest, t.z * t.z));
+	return abs(t.z * det) / (smallest * smallest * smallest);
+}
+
 // LIGHT CALCULATIONS
 //=========================
 
@@ -306,6 +659,17 @@ float3 CalcDirLight(
 	return float3(fragColor * (ambient + diffuse) + specular * lightColor) * lightColor * intensity;
 }
 
+// (1 - (d / r)^4)^2, zero from the light's radius on; 1 for radius 0
+float DistanceWindow(float distance, float radius)
+{
+	if (radius <= 0)
+		return 1;
+	float x = distance / radius;
+	x *= x;
+	float window = saturate(1 - x * x);
+	return window * window;
+}
+
 float3 CalcPointLight(
 	PointLight light,
 	float3 normal,
@@ -331,8 +695,9 @@ float3 CalcPointLight(
 	float intensitySpec = pow(saturate(NdotH), exponent);
 
 	float3 ambient = float3(1, 1, 1) * ambientStr;
-	float specular = intensitySpec / distanceSq;
-	float diffuse = intensityDiff / distanceSq;
+	float window = DistanceWindow(distance, light.Range.x);
+	float specular = intensitySpec * window / distanceSq;
+	float diffuse = intensityDiff * window / distanceSq;
 
 	return ((ambient + diffuse) * fragColor + specular * lightColor) * lightColor * lightIntensity;
 }
@@ -363,8 +728,9 @@ float3 CalcSpotLight(SpotLight light,
 	float intensitySpec = pow(saturate(NdotH), exponent);
 
 	float3 ambient = float3(1, 1, 1) * ambientStr;
-	float specular = intensitySpec / distanceSq;
-	float diffuse = intensityDiff / distanceSq;
+	float window = DistanceWindow(distance, light.Range.x);
+	float specular = intensitySpec * window / distanceSq;
+	float diffuse = intensityDiff * window / distanceSq;
 
 	float theta = dot(lightDir, normalize(-light.Direction.xyz));
 	float epsilon = outerCone.x - innerCone.x;
@@ -383,7 +749,8 @@ float3 CalcRectLight(
 	float3 fragPos,
 	float3 fragColor,
 	float3 viewDir,
-	float roughness = 0.25
+	float roughness = 0.25,
+	float ambientStr = 0.05
 	)
 {
 	float3 lightPos = light.Position.xyz;
@@ -406,17 +773,29 @@ float3 CalcRectLight(
 	points[2] = lightPos + ex + ey;
 	points[3] = lightPos - ex + ey;
 
+	// far lights by their disk, per lobe (RectLightLod)
+	float3 toLight = lightPos - fragPos;
+	float distance2 = dot(toLight, toLight);
+	float area = 4.0 * halfWidth * halfHeight;
+
 	float3x3 identity = float3x3(
 		1, 0, 0,
 		0, 1, 0,
 		0, 0, 1);
-	float3 diffuse = LTCEvaluate(light, fragPos, viewDir, normal, points, identity);
+	float3 diffuse;
+	if (area < distance2 * rectLod.x)
+		diffuse = LTCEvaluateRectDisk(fragPos, viewDir, normal, lightPos, ex, ey, identity);
+	else
+		diffuse = LTCEvaluate(light, fragPos, viewDir, normal, points, identity);
 	diffuse *= 1.5;
 
 	// MAKE MATRIX SAMPLE
 	float theta = acos(dot(normal, viewDir));
 	float2 uv = float2(roughness, theta/(0.5*pi));
-	uv = uv * LUT_SCALE + LUT_BIAS;
+	// texel centers, for whatever table size ltc-fit generated
+	float lutSize, lutHeight;
+	ltcMat.GetDimensions(lutSize, lutHeight);
+	uv = uv * (lutSize - 1.0) / lutSize + 0.5 / lutSize;
 
 	float4 t = ltcMat.Sample(ltcSampler, uv);
 	float3x3 Minv = float3x3(
@@ -424,10 +803,14 @@ float3 CalcRectLight(
 		0, t.z, 0,
 		t.w, 0, t.x
 		);
-	float3 specular = LTCEvaluate(light, fragPos, viewDir, normal, points, Minv);
+	float3 specular;
+	if (area * LTCStretch(t) < distance2 * rectLod.y)
+		specular = LTCEvaluateRectDisk(fragPos, viewDir, normal, lightPos, ex, ey, Minv);
+	else
+		specular = LTCEvaluate(light, fragPos, viewDir, normal, points, Minv);
 	specular *= ltcAmp.Sample(ltcSampler, uv).w * 0.2;
 
-	float3 ambient = float3(0.05, 0.05, 0.05);
+	float3 ambient = float3(1, 1, 1) * ambientStr;
 
 	float3 col = (specular * lightColor + diffuse * fragColor) * lightColor;
 	col *= lightIntensity;
@@ -436,31 +819,241 @@ float3 CalcRectLight(
 	return col;
 }
 
+float3 CalcPolygonLight(
+	PolygonLight light,
+	float3 normal,
+	float3 fragPos,
+	float3 fragColor,
+	float3 viewDir,
+	float roughness = 0.25,
+	float ambientStr = 0.0
+	)
+{
+	float3 lightColor = light.Color.xyz;
+	float lightIntensity = light.Color.w;
+
+	int count = min((int)light.Vertices.x, PolygonMaxVertices);
+	float3 points[PolygonMaxVertices];
+	for (int i = 0; i < count; i++)
+		points[i] = polygonVertices[light.Vertices.y + i].xyz;
+
+	float3x3 identity = float3x3(
+		1, 0, 0,
+		0, 1, 0,
+		0, 0, 1);
+	float3 diffuse = LTCEvaluatePolygon(fragPos, viewDir, normal, points, count, identity);
+	diffuse *= 1.5;
+
+	float theta = acos(dot(normal, viewDir));
+	float2 uv = float2(roughness, theta/(0.5*pi));
+	float lutSize, lutHeight;
+	ltcMat.GetDimensions(lutSize, lutHeight);
+	uv = uv * (lutSize - 1.0) / lutSize + 0.5 / lutSize;
+
+	float4 t = ltcMat.Sample(ltcSampler, uv);
+	float3x3 Minv = float3x3(
+		1, 0, t.y,
+		0, t.z, 0,
+		t.w, 0, t.x
+		);
+	float3 specular = LTCEvaluatePolygon(fragPos, viewDir, normal, points, count, Minv);
+	specular *= ltcAmp.Sample(ltcSampler, uv).w * 0.2;
+
+	float3 ambient = float3(1, 1, 1) * ambientStr;
+
+	float3 col = (specular * lightColor + diffuse * fragColor) * lightColor;
+	col *= lightIntensity;
+	col /= 2.0 * pi;
+	col += ambient * fragColor * lightColor;
+	return col;
+}
+
+// CalcRectLight's shading around LTCEvaluateDisk, for the diffuse term the
+// caller worked out
+float3 CalcEllipseLight(
+	float3 center,
+	float3 axisX,
+	float3 axisY,
+	float4 color,
+	float diffuse,
+	float3 normal,
+	float3 fragPos,
+	float3 fragColor,
+	float3 viewDir,
+	float roughness,
+	float ambientStr
+	)
+{
+	float3 lightColor = color.xyz;
+	float lightIntensity = color.w;
+
+	float theta = acos(dot(normal, viewDir));
+	float2 uv = float2(roughness, theta/(0.5*pi));
+	float lutSize, lutHeight;
+	ltcMat.GetDimensions(lutSize, lutHeight);
+	uv = uv * (lutSize - 1.0) / lutSize + 0.5 / lutSize;
+
+	float4 t = ltcMat.Sample(ltcSampler, uv);
+	float3x3 Minv = float3x3(
+		1, 0, t.y,
+		0, t.z, 0,
+		t.w, 0, t.x
+		);
+	float3 specular = LTCEvaluateDisk(fragPos, viewDir, normal, center, axisX, axisY, Minv);
+	specular *= ltcAmp.Sample(ltcSampler, uv).w * 0.2;
+
+	float3 ambient = float3(1, 1, 1) * ambientStr;
+
+	float3 col = (specular * lightColor + diffuse * fragColor) * lightColor;
+	col *= lightIntensity;
+	col /= 2.0 * pi;
+	col += ambient * fragColor * lightColor;
+	return col;
+}
+
+// Any two axes in the disk's plane, radius long
+void DiskAxes(float3 normal, float radius, out float3 axisX, out float3 axisY)
+{
+	float3 up = abs(normal.y) < 0.999 ? float3(0, 1, 0) : float3(1, 0, 0);
+	axisX = normalize(cross(up, normal));
+	axisY = cross(normal, axisX) * radius;
+	axisX *= radius;
+}
+
+float3 CalcDiskLight(
+	DiskLight light,
+	float3 normal,
+	float3 fragPos,
+	float3 fragColor,
+	float3 viewDir,
+	float roughness = 0.25,
+	float ambientStr = 0.0
+	)
+{
+	float3 axisX, axisY;
+	DiskAxes(normalize(light.Direction.xyz), light.Direction.w, axisX, axisY);
+
+	float3x3 identity = float3x3(
+		1, 0, 0,
+		0, 1, 0,
+		0, 0, 1);
+	float diffuse = LTCEvaluateDisk(fragPos, viewDir, normal, light.Position.xyz, axisX, axisY, identity).x * 1.5;
+	return CalcEllipseLight(light.Position.xyz, axisX, axisY, light.Color, diffuse, normal, fragPos, fragColor, viewDir, roughness, ambientStr);
+}
+
+// A sphere covers the directions of the disk its silhouette circle bounds
+float3 CalcSphereLight(
+	SphereLight light,
+	float3 normal,
+	float3 fragPos,
+	float3 fragColor,
+	float3 viewDir,
+	float roughness = 0.25,
+	float ambientStr = 0.0
+	)
+{
+	float3 toLight = light.Position.xyz - fragPos;
+	float distance = length(toLight);
+	float radius = light.Position.w;
+	if (distance <= radius)
+		return float3(0, 0, 0);
+
+	float3 direction = toLight / distance;
+	float ratio = radius / distance;
+
+	// the diffuse term is the cap's integral itself
+	float diffuse = 2.0 * pi * SphereIntegral(dot(normal, direction), ratio * ratio) * 1.5;
+
+	float3 center = light.Position.xyz - direction * (radius * ratio);
+	float3 axisX, axisY;
+	DiskAxes(direction, radius * sqrt(1.0 - ratio * ratio), axisX, axisY);
+	return CalcEllipseLight(center, axisX, axisY, light.Color, diffuse, normal, fragPos, fragColor, viewDir, roughness, ambientStr);
+}
 
 float4 main(PSIn input) : SV_TARGET{
 
-	if (input.lightIndex <= (unsigned int)lightCounts.w)
+#if LIGHT_RECT
+	if (input.lightIndex <= rectProxies.x)
 	{
 		float4 texColor = (TEXTURED)
 			? lightTexture.SampleLevel(ltcSampler, float2(0.125, 0.125) + input.uv * 0.75, 1)
 			: float4(1, 1, 1, 1);
 		return texColor * rectLights[input.lightIndex - 1].Color;
 	}
+#endif
 
 	float3 viewDir = normalize(viewPos.xyz - input.worldPosition.xyz);
 
-	float3 finalLight = float3(0, 0, 0);
-	for (int i = 0; i < lightCounts.x; i++)
-		finalLight += CalcPointLight(pointLights[i], input.normal, input.worldPosition.xyz, input.color, viewDir);
-
-	for (i = 0; i < lightCounts.y; i++)
-		finalLight += CalcSpotLight(spotLights[i], input.normal, input.worldPosition.xyz, input.color, viewDir);
+	// per-light ambient is already summed into lightAmbient
+	float3 finalLight = lightAmbient.rgb * input.color;
+
+#if LIGHT_CLUSTERED
+	float depth = dot(input.worldPosition.xyz - viewPos.xyz, viewForward.xyz);
+	uint2 tile = min(uint2(input.position.xy) / (uint)clusterGrid.w, uint2(clusterGrid.xy) - 1);
+	int slice = clamp(int(floor(log(max(depth, 1e-6)) * clusterDepth.x + clusterDepth.y)), 0, clusterGrid.z - 1);
+	uint4 cluster = clusters[(slice * clusterGrid.y + tile.y) * clusterGrid.x + tile.x];
+
+	uint4 object = objectLights[rectProxies.y - input.lightIndex];
+	bool perObject = object.x != 0xFFFFFFFF && object.y + object.z + object.w < cluster.y + cluster.z + cluster.w;
+	if (perObject)
+		cluster = object;
+	uint next = cluster.x;
+	uint i;
+#endif
+
+#if LIGHT_POINT
+	for (i = 0; i < cluster.y; i++)
+		finalLight += CalcPointLight(pointLights[ListedLight(perObject, next++)], input.normal, input.worldPosition.xyz, input.color, viewDir, 1.0, 64, 0.0);
+#elif LIGHT_CLUSTERED
+	next += cluster.y;
+#endif
+
+#if LIGHT_SPOT
+	for (i = 0; i < cluster.z; i++)
+		finalLight += CalcSpotLight(spotLights[ListedLight(perObject, next++)], input.normal, input.worldPosition.xyz, input.color, viewDir, 1.0, 64, 0.0);
+#elif LIGHT_CLUSTERED
+	next += cluster.z;
+#endif
+
+#if LIGHT_DIR
+	for (int d = 0; d < lightCounts.z; d++)
+		finalLight += CalcDirLight(dirLights[d], input.normal, input.color, viewDir);
+#endif
+
+#if LIGHT_RECT
+	for (i = 0; i < cluster.w; i++)
+		finalLight += CalcRectLight(rectLights[ListedLight(perObject, next++)], input.normal, input.worldPosition.xyz, input.color, viewDir, 0.25, 0.0);
+#endif
+
+#if LIGHT_POLYGON
+	for (int p = 0; p < polygonCounts.x; p++)
+	{
+		PolygonLight polygon = polygonLights[p];
+		float3 offset = input.worldPosition.xyz - polygon.Bounds.xyz;
+		if (dot(offset, offset) < polygon.Bounds.w * polygon.Bounds.w)
+			finalLight += CalcPolygonLight(polygon, input.normal, input.worldPosition.xyz, input.color, viewDir);
+	}
+#endif
 
-	for (i = 0; i < lightCounts.z; i++)
-		finalLight += CalcDirLight(dirLights[i], input.normal, input.color, viewDir);
+#if LIGHT_DISK
+	for (int k = 0; k < polygonCounts.z; k++)
+	{
+		DiskLight disk = diskLights[k];
+		float3 offset = input.worldPosition.xyz - disk.Position.xyz;
+		if (dot(offset, offset) < disk.Range.x * disk.Range.x)
+			finalLight += CalcDiskLight(disk, input.normal, input.worldPosition.xyz, input.color, viewDir);
+	}
+#endif
 
-	for (i = 0; i < lightCounts.w; i++)
-		finalLight += CalcRectLight(rectLights[i], input.normal, input.worldPosition.xyz, input.color, viewDir);
+#if LIGHT_SPHERE
+	for (int s = 0; s < polygonCounts.w; s++)
+	{
+		SphereLight sphere = sphereLights[s];
+		float3 offset = input.worldPosition.xyz - sphere.Position.xyz;
+		if (dot(offset, offset) < sphere.Range.x * sphere.Range.x)
+			finalLight += CalcSphereLight(sphere, input.normal, input.worldPosition.xyz, input.color, viewDir);
+	}
+#endif
 
 	return float4(finalLight, 1);
-}
\ No newline at end of file
+}
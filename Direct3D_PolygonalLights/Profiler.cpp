@@ -0,0 +1,131 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+
+static_assert((PROFILER_EVENTS_PER_THREAD & (PROFILER_EVENTS_PER_THREAD - 1)) == 0, "PROFILER_EVENTS_PER_THREAD must be a power of two");
+
+typedef std::chrono::steady_clock Clock;
+
+// The ring of one thread. Only that thread writes, and it publishes every
+// event by advancing written.
+struct ThreadEvents {
+	std::unique_ptr<ProfileEvent[]> events{ new ProfileEvent[PROFILER_EVENTS_PER_THREAD] };
+	std::atomic<uint64_t> written{ 0 };
+	uint64_t cleared = 0; // written at the last Clear
+	std::string name;
+	int thread = 0;
+};
+
+// Rings outlive their threads, so a pool torn down before the export still
+// shows up in it.
+static std::mutex s_mutex;
+static vector<std::unique_ptr<ThreadEvents>> s_threads;
+static thread_local ThreadEvents* t_events = nullptr;
+
+// Ticks and clock time at Clear; ticks are converted by the rate between
+// then and the last Collect
+static uint64_t s_baseTicks = Profiler::Now();
+static Clock::time_point s_baseTime = Clock::now();
+static double s_ticksPerMicrosecond = 1.0;
+
+std::atomic<bool> Profiler::s_enabled{ false };
+
+static ThreadEvents& GetThreadEvents() {
+	if (!t_events) {
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_threads.push_back(std::make_unique<ThreadEvents>());
+		t_events = s_threads.back().get();
+		t_events->thread = (int)s_threads.size() - 1;
+		t_events->name = "thread " + std::to_string(t_events->thread);
+	}
+	return *t_events;
+}
+
+void Profiler::Clear() {
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_baseTicks = Now();
+	s_baseTime = Clock::now();
+	for (const std::unique_ptr<ThreadEvents>& thread : s_threads)
+		thread->cleared = thread->written.load(std::memory_order_acquire);
+}
+
+void Profiler::SetThreadName(const char* name) {
+	ThreadEvents& events = GetThreadEvents();
+	std::lock_guard<std::mutex> lock(s_mutex);
+	events.name = name;
+}
+
+void Profiler::Record(const char* name, uint64_t start, uint64_t end) {
+	ThreadEvents& events = GetThreadEvents();
+	uint64_t index = events.written.load(std::memory_order_relaxed);
+	events.events[index & (PROFILER_EVENTS_PER_THREAD - 1)] = { name, start, end, events.thread };
+	events.written.store(index + 1, std::memory_order_release);
+}
+
+size_t Profiler::Collect(vector<ProfileEvent>& events) {
+	std::lock_guard<std::mutex> lock(s_mutex);
+	events.clear();
+
+	// a rate measured over less than 10 ms would skew every event
+	Clock::time_point minimum = s_baseTime + std::chrono::milliseconds(10);
+	while (Clock::now() < minimum);
+	uint64_t ticks = Now();
+	double microseconds = std::chrono::duration<double, std::micro>(Clock::now() - s_baseTime).count();
+	s_ticksPerMicrosecond = std::max(1e-9, (double)(ticks - s_baseTicks) / microseconds);
+
+	size_t lost = 0;
+	for (const std::unique_ptr<ThreadEvents>& thread : s_threads) {
+		uint64_t written = thread->written.load(std::memory_order_acquire);
+		uint64_t first = std::max(thread->cleared, written > PROFILER_EVENTS_PER_THREAD ? written - PROFILER_EVENTS_PER_THREAD : 0);
+		size_t begin = events.size();
+		for (uint64_t i = first; i < written; i++)
+			events.push_back(thread->events[i & (PROFILER_EVENTS_PER_THREAD - 1)]);
+
+		// the thread went on writing meanwhile, over the oldest of the copy
+		uint64_t after = thread->written.load(std::memory_order_acquire);
+		uint64_t overwritten = after > PROFILER_EVENTS_PER_THREAD ? after - PROFILER_EVENTS_PER_THREAD : 0;
+		uint64_t firstKept = std::min(written, std::max(first, overwritten));
+		events.erase(events.begin() + begin, events.begin() + begin + (size_t)(firstKept - first));
+		lost += (size_t)(firstKept - thread->cleared);
+	}
+
+	// zones still open at Clear closed after it
+	uint64_t base = s_baseTicks;
+	events.erase(std::remove_if(events.begin(), events.end(), [base](const ProfileEvent& e) { return e.start < base; }), events.end());
+	std::sort(events.begin(), events.end(), [](const ProfileEvent& a, const ProfileEvent& b) {
+		return a.thread != b.thread ? a.thread < b.thread : a.start < b.start;
+	});
+	return lost;
+}
+
+double Profiler::ToMicroseconds(uint64_t ticks) {
+	return (double)(int64_t)(ticks - s_baseTicks) / s_ticksPerMicrosecond;
+}
+
+bool Profiler::WriteChromeTrace(const char* path) {
+	vector<ProfileEvent> events;
+	Collect(events);
+
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return false;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		for (size_t i = 0; i < s_threads.size(); i++)
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s\"}}\n",
+				i > 0 ? "," : "", s_threads[i]->thread, s_threads[i]->name.c_str());
+	}
+	for (const ProfileEvent& e : events) {
+		double start = ToMicroseconds(e.start);
+		fprintf(file, ",{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}\n",
+			e.name, e.thread, start, ToMicroseconds(e.end) - start);
+	}
+	fprintf(file, "]}\n");
+	return fclose(file) == 0;
+}
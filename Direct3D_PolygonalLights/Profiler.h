@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define PROFILER_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_RDTSC 1
+#else
+#include <chrono>
+#endif
+
+using std::vector;
+
+// Zones a thread keeps, a power of two; past that the oldest are overwritten
+#define PROFILER_EVENTS_PER_THREAD 65536
+
+// Defining PROFILER_DISABLED compiles every PROFILE_ZONE out. Otherwise the
+// zones are always there and cost a flag test until SetEnabled(true).
+#define PROFILER_CONCAT_(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_(a, b)
+#ifdef PROFILER_DISABLED
+#define PROFILE_ZONE(name) ((void)0)
+#else
+#define PROFILE_ZONE(name) ProfileZone PROFILER_CONCAT(_profileZone, __LINE__)(name)
+#endif
+
+// A closed zone, in ticks of Profiler::Now
+struct ProfileEvent {
+	const char* name;
+	uint64_t start;
+	uint64_t end;
+	int thread; // registration order, the tid of the trace
+};
+
+// Process-wide CPU timer for scoped zones. Every thread writes the zones it
+// closes into its own ring of events: one store and a release of its counter,
+// no locks and no allocation after the thread's first zone. Zones nest by
+// their times, as Chrome's trace viewer draws them. Names are not copied and
+// have to outlive the export, string literals in practice.
+//
+// Collect and WriteChromeTrace read the rings while threads may still write:
+// an event overwritten during the copy is dropped, but for a consistent trace
+// export between frames.
+class Profiler {
+public:
+	static void SetEnabled(bool enabled) { s_enabled.store(enabled, std::memory_order_relaxed); }
+	static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+	// Drops what was recorded so far, the trace starts from here
+	static void Clear();
+	// Shown for the calling thread instead of "thread N"
+	static void SetThreadName(const char* name);
+
+	static uint64_t Now() {
+#ifdef PROFILER_RDTSC
+		return __rdtsc();
+#else
+		return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+	static void Record(const char* name, uint64_t start, uint64_t end);
+
+	// Every event since Clear, sorted by thread and start. Returns how many
+	// of them the rings overwrote before they could be read.
+	static size_t Collect(vector<ProfileEvent>& events);
+	// Microseconds since Clear of a tick count
+	static double ToMicroseconds(uint64_t ticks);
+	// Complete ("X") events in the Chrome trace JSON format, for
+	// chrome://tracing or ui.perfetto.dev
+	static bool WriteChromeTrace(const char* path);
+
+private:
+	static std::atomic<bool> s_enabled;
+};
+
+// Times its scope, from construction to destruction
+class ProfileZone {
+public:
+	ProfileZone(const char* name) : _name(name), _start(Profiler::IsEnabled() ? Profiler::Now() : 0) {}
+	~ProfileZone() {
+		if (_start)
+			Profiler::Record(_name, _start, Profiler::Now());
+	}
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+	const char* _name;
+	uint64_t _start;
+};
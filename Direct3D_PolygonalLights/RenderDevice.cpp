@@ -0,0 +1,111 @@
+#include "RenderDevice.h"
+#include "Vertex.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+
+using std::exception;
+
+class deviceException : public exception {
+private:
+	const char* _message;
+public:
+	deviceException(const char* message) : _message(message) {}
+	const char* what() const throw () { return _message; }
+};
+
+BufferHandle NullRenderDevice::CreateBuffer(BufferKind kind, size_t bytes, const void* data, bool dynamic) {
+	if (!dynamic && !data)
+		throw deviceException("Static buffer without data");
+
+	BufferHandle handle;
+	if (!_free.empty()) {
+		handle = _free.back();
+		_free.pop_back();
+	}
+	else {
+		_buffers.emplace_back();
+		handle = (BufferHandle)_buffers.size();
+	}
+
+	Buffer& buffer = _buffers[handle - 1];
+	buffer.data.assign(bytes, 0);
+	if (data)
+		memcpy(buffer.data.data(), data, bytes);
+	buffer.kind = kind;
+	buffer.dynamic = dynamic;
+	buffer.live = true;
+
+	_stats.bufferAllocations++;
+	_stats.bytesAllocated += bytes;
+	return handle;
+}
+
+void NullRenderDevice::ReleaseBuffer(BufferHandle buffer) {
+	if (buffer == 0 || buffer > _buffers.size() || !_buffers[buffer - 1].live)
+		return;
+
+	_buffers[buffer - 1].live = false;
+	_buffers[buffer - 1].data = vector<unsigned char>();
+	_free.push_back(buffer);
+}
+
+void NullRenderDevice::WriteBuffer(BufferHandle buffer, size_t offset, const void* data, size_t bytes, bool discard) {
+	Buffer& target = _buffers.at(buffer - 1);
+	if (!target.live || !target.dynamic)
+		throw deviceException("Write to a static or released buffer");
+	if (offset + bytes > target.data.size())
+		throw deviceException("Buffer write out of range");
+
+	// the old contents are gone, as on the GPU; a draw still reading them sees zeros
+	if (discard) {
+		memset(target.data.data(), 0, offset);
+		memset(target.data.data() + offset + bytes, 0, target.data.size() - offset - bytes);
+		_stats.bufferDiscards++;
+	}
+
+	memcpy(target.data.data() + offset, data, bytes);
+	_stats.bufferWrites++;
+	_stats.bytesWritten += bytes;
+}
+
+void NullRenderDevice::DrawIndexed(BufferHandle vertexBuffer, BufferHandle indexBuffer, unsigned int indexCount, unsigned int firstIndex, int baseVertex, unsigned int objectBase, unsigned int instanceCount) {
+	if (!_buffers.at(vertexBuffer - 1).live || !_buffers.at(indexBuffer - 1).live)
+		throw deviceException("Draw with a released buffer");
+	const Buffer& indices = _buffers[indexBuffer - 1];
+	if (indices.kind != BufferKind::Index && indices.kind != BufferKind::Index32)
+		throw deviceException("Draw with a vertex buffer as indices");
+	size_t indexSize = indices.kind == BufferKind::Index32 ? sizeof(unsigned int) : sizeof(unsigned short);
+	if (((size_t)firstIndex + indexCount) * indexSize > indices.data.size())
+		throw deviceException("Draw reads past the index buffer");
+
+	// every index the draw reads, moved by baseVertex, has to land in the vertex buffer
+	const Buffer& vertices = _buffers[vertexBuffer - 1];
+	if (vertices.kind != BufferKind::Vertex && vertices.kind != BufferKind::PackedVertex)
+		throw deviceException("Draw with an index buffer as vertices");
+	size_t vertexSize = vertices.kind == BufferKind::PackedVertex ? sizeof(PackedVertex) : sizeof(Vertex);
+	if (indexCount > 0) {
+		unsigned int lowest, highest;
+		if (indexSize == sizeof(unsigned int)) {
+			const unsigned int* first = (const unsigned int*)indices.data.data() + firstIndex;
+			auto range = std::minmax_element(first, first + indexCount);
+			lowest = *range.first;
+			highest = *range.second;
+		}
+		else {
+			const unsigned short* first = (const unsigned short*)indices.data.data() + firstIndex;
+			auto range = std::minmax_element(first, first + indexCount);
+			lowest = *range.first;
+			highest = *range.second;
+		}
+		if ((long long)lowest + baseVertex < 0 || ((long long)highest + baseVertex + 1) * vertexSize > vertices.data.size())
+			throw deviceException("Draw reads past the vertex buffer");
+	}
+
+	// object indices are 32-bit in the shader
+	if ((unsigned long long)objectBase + instanceCount > 0x100000000ull)
+		throw deviceException("Draw's object indices wrap around");
+
+	_stats.draws++;
+	_stats.instances += instanceCount;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+using std::vector;
+
+// The few GPU operations mesh submission needs, so the same submission code
+// runs on D3D11 and on a null device in headless checks.
+
+enum class BufferKind {
+	Vertex,
+	PackedVertex, // PackedVertex, drawn with the packed input layout
+	Index,        // 16-bit
+	Index32
+};
+
+typedef unsigned int BufferHandle; // 0 = no buffer
+
+struct DeviceStats {
+	size_t bufferAllocations = 0;
+	size_t bytesAllocated = 0;
+	size_t bufferWrites = 0;
+	size_t bufferDiscards = 0; // writes that orphaned the old contents
+	size_t bytesWritten = 0;
+	size_t draws = 0;
+	size_t instances = 0;
+};
+
+class RenderDevice {
+public:
+	virtual ~RenderDevice() {}
+
+	// Static buffers are immutable and need data; dynamic ones are written with WriteBuffer.
+	virtual BufferHandle CreateBuffer(BufferKind kind, size_t bytes, const void* data, bool dynamic) = 0;
+	virtual void ReleaseBuffer(BufferHandle buffer) = 0;
+	// discard = orphan the old contents (ring wrap), otherwise the written range must be unused by pending draws
+	virtual void WriteBuffer(BufferHandle buffer, size_t offset, const void* data, size_t bytes, bool discard) = 0;
+	// index width from the index buffer's kind; objectBase plus the instance is added to every vertex's object index
+	virtual void DrawIndexed(BufferHandle vertexBuffer, BufferHandle indexBuffer, unsigned int indexCount, unsigned int firstIndex, int baseVertex, unsigned int objectBase, unsigned int instanceCount = 1) = 0;
+
+	const DeviceStats& GetStats() const { return _stats; }
+
+protected:
+	DeviceStats _stats;
+};
+
+// Keeps buffers in system memory and only counts what would reach the GPU.
+class NullRenderDevice : public RenderDevice {
+public:
+	BufferHandle CreateBuffer(BufferKind kind, size_t bytes, const void* data, bool dynamic) override;
+	void ReleaseBuffer(BufferHandle buffer) override;
+	void WriteBuffer(BufferHandle buffer, size_t offset, const void* data, size_t bytes, bool discard) override;
+	void DrawIndexed(BufferHandle vertexBuffer, BufferHandle indexBuffer, unsigned int indexCount, unsigned int firstIndex, int baseVertex, unsigned int objectBase, unsigned int instanceCount = 1) override;
+
+	const vector<unsigned char>& GetBufferData(BufferHandle buffer) const { return _buffers[buffer - 1].data; }
+
+private:
+	struct Buffer {
+		vector<unsigned char> data;
+		BufferKind kind = BufferKind::Vertex;
+		bool dynamic = false;
+		bool live = false;
+	};
+
+	vector<Buffer> _buffers;
+	vector<BufferHandle> _free;
+};
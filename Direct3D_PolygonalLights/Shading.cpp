@@ -0,0 +1,82 @@
+#include "Shading.h"
+#include <algorithm>
+#include <cmath>
+
+float DistanceWindow(float distance, float radius) {
+	if (radius <= 0.0f)
+		return 1.0f;
+	float x = distance / radius;
+	x *= x;
+	float window = Saturate(1.0f - x * x);
+	return window * window;
+}
+
+Float3 CalcDirLight(const DirLight& light, Float3 normal, Float3 fragColor, Float3 viewDir, float shadow, float specularity, float exponent) {
+	Float3 lightDir = -XYZ(light.Direction);
+	float intensity = light.Color.w;
+	float lightColor = light.Color.x; // declared float in the shader, so only .x survives
+
+	float NdotH = Dot(normal, Normalize(lightDir + viewDir));
+	float NdotL = Dot(lightDir, Normalize(normal));
+	float intensityDiff = Saturate(NdotL);
+	float intensitySpec = std::pow(Saturate(NdotH), exponent);
+
+	Float3 ambient = Float3{ 1, 1, 1 } * 0.01f;
+	Float3 specular = { intensitySpec, intensitySpec, intensitySpec };
+	Float3 diffuse = { intensityDiff, intensityDiff, intensityDiff };
+
+	return (fragColor * (ambient + diffuse) + specular * lightColor) * lightColor * intensity;
+}
+
+Float3 CalcPointLight(const PointLight& light, Float3 normal, Float3 fragPos, Float3 fragColor, Float3 viewDir, float specularity, float exponent, float ambientStr) {
+	Float3 lightColor = XYZ(light.Color);
+	float lightIntensity = light.Color.w;
+	Float3 lightDir = XYZ(light.Position) - fragPos;
+
+	float distance = Length(lightDir);
+	float distanceSq = distance * distance;
+	lightDir = lightDir / distance;
+
+	float NdotH = Dot(normal, Normalize(lightDir + viewDir));
+	float NdotL = Dot(lightDir, normal);
+	float intensityDiff = Saturate(NdotL) * 5;
+	float intensitySpec = std::pow(Saturate(NdotH), exponent);
+
+	Float3 ambient = Float3{ 1, 1, 1 } * ambientStr;
+	float window = DistanceWindow(distance, light.Range.x);
+	float specular = intensitySpec * window / distanceSq;
+	float diffuse = intensityDiff * window / distanceSq;
+
+	return ((ambient + Float3{ diffuse, diffuse, diffuse }) * fragColor + specular * lightColor) * lightColor * lightIntensity;
+}
+
+Float3 CalcSpotLight(const SpotLight& light, Float3 normal, Float3 fragPos, Float3 fragColor, Float3 viewDir, float specularity, float exponent, float ambientStr) {
+	float innerCone = light.Cone.x;
+	float outerCone = light.Cone.y;
+	Float3 lightColor = XYZ(light.Color);
+	float lightIntensity = light.Color.w;
+
+	Float3 lightDir = XYZ(light.Position) - fragPos;
+	float distance = Length(lightDir);
+	float distanceSq = distance * distance;
+	lightDir = lightDir / distance;
+
+	float NdotH = Dot(normal, Normalize(lightDir + viewDir));
+	float NdotL = Dot(lightDir, normal);
+	float intensityDiff = Saturate(NdotL);
+	float intensitySpec = std::pow(Saturate(NdotH), exponent);
+
+	Float3 ambient = Float3{ 1, 1, 1 } * ambientStr;
+	float window = DistanceWindow(distance, light.Range.x);
+	float specular = intensitySpec * window / distanceSq;
+	float diffuse = intensityDiff * window / distanceSq;
+
+	float theta = Dot(lightDir, Normalize(-XYZ(light.Direction)));
+	float epsilon = outerCone - innerCone;
+	float intensity = std::clamp((theta - outerCone) / epsilon, 0.0f, 1.0f);
+
+	diffuse *= intensity;
+	specular *= intensity;
+
+	return ((ambient + Float3{ diffuse, diffuse, diffuse }) * fragColor + specular * lightColor) * lightColor * lightIntensity;
+}
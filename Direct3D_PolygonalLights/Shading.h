@@ -0,0 +1,14 @@
+#pragma once
+
+#include "Lights.h"
+
+// CPU ports of the analytic light functions in PixelShader.hlsl. Rect lights
+// live in LTC.h since they need the LTC tables.
+
+// (1 - (d / r)^4)^2 clamped to [0, 1]: smooth down to zero at the light's
+// radius r, and close to 1 well inside it. 1 everywhere when r is 0.
+float DistanceWindow(float distance, float radius);
+
+Float3 CalcDirLight(const DirLight& light, Float3 normal, Float3 fragColor, Float3 viewDir, float shadow = 0.0f, float specularity = 1.0f, float exponent = 64);
+Float3 CalcPointLight(const PointLight& light, Float3 normal, Float3 fragPos, Float3 fragColor, Float3 viewDir, float specularity = 1.0f, float exponent = 64, float ambientStr = 0.01f);
+Float3 CalcSpotLight(const SpotLight& light, Float3 normal, Float3 fragPos, Float3 fragColor, Float3 viewDir, float specularity = 1.0f, float exponent = 64, float ambientStr = 0.01f);
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <cmath>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// SSE2 is part of x64, so a 4-wide SimdF is there even without AVX flags.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Thin wrappers over the SIMD registers the CPU kernels are written against.
+// Kernels are templated on the lane count W, so the same source compiles to
+// AVX-512 (16), AVX2 (8), SSE2 (4) or plain scalar (1) code. SIMD_WIDTH is
+// the widest width the current compiler flags allow for the shading kernels;
+// kernels with a fixed layout (Bvh) may pick SSE2 below that.
+
+#if defined(__AVX512F__)
+#define SIMD_WIDTH 16
+#elif defined(__AVX2__)
+#define SIMD_WIDTH 8
+#else
+#define SIMD_WIDTH 1
+#endif
+
+template<int W> struct SimdF;
+
+// Scalar fallback
+//========================================
+
+template<> struct SimdF<1> {
+	typedef bool Mask;
+	float v;
+
+	SimdF() = default;
+	SimdF(float s) : v(s) {}
+
+	static SimdF Load(const float* p) { return SimdF(*p); }
+	void Store(float* p) const { *p = v; }
+
+	friend SimdF operator+(SimdF a, SimdF b) { return a.v + b.v; }
+	friend SimdF operator-(SimdF a, SimdF b) { return a.v - b.v; }
+	friend SimdF operator*(SimdF a, SimdF b) { return a.v * b.v; }
+	friend SimdF operator/(SimdF a, SimdF b) { return a.v / b.v; }
+	friend SimdF operator-(SimdF a) { return -a.v; }
+
+	friend SimdF Sqrt(SimdF a) { return std::sqrt(a.v); }
+	friend SimdF Abs(SimdF a) { return std::fabs(a.v); }
+	friend SimdF Min(SimdF a, SimdF b) { return a.v < b.v ? a.v : b.v; }
+	friend SimdF Max(SimdF a, SimdF b) { return a.v > b.v ? a.v : b.v; }
+	friend SimdF Floor(SimdF a) { return std::floor(a.v); }
+
+	friend Mask Greater(SimdF a, SimdF b) { return a.v > b.v; }
+	friend Mask Less(SimdF a, SimdF b) { return a.v < b.v; }
+	friend SimdF Select(Mask m, SimdF a, SimdF b) { return m ? a : b; }
+
+	static Mask And(Mask a, Mask b) { return a && b; }
+	static Mask Or(Mask a, Mask b) { return a || b; }
+	static Mask AndNot(Mask a, Mask b) { return !a && b; }
+	static bool Any(Mask m) { return m; }
+	static int Bits(Mask m) { return m ? 1 : 0; }
+};
+
+// SSE2
+//========================================
+
+#if defined(SIMD_SSE2)
+template<> struct SimdF<4> {
+	typedef __m128 Mask;
+	__m128 v;
+
+	SimdF() = default;
+	SimdF(__m128 r) : v(r) {}
+	SimdF(float s) : v(_mm_set1_ps(s)) {}
+
+	static SimdF Load(const float* p) { return _mm_loadu_ps(p); }
+	void Store(float* p) const { _mm_storeu_ps(p, v); }
+
+	friend SimdF operator+(SimdF a, SimdF b) { return _mm_add_ps(a.v, b.v); }
+	friend SimdF operator-(SimdF a, SimdF b) { return _mm_sub_ps(a.v, b.v); }
+	friend SimdF operator*(SimdF a, SimdF b) { return _mm_mul_ps(a.v, b.v); }
+	friend SimdF operator/(SimdF a, SimdF b) { return _mm_div_ps(a.v, b.v); }
+	friend SimdF operator-(SimdF a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+
+	friend SimdF Sqrt(SimdF a) { return _mm_sqrt_ps(a.v); }
+	friend SimdF Abs(SimdF a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+	friend SimdF Min(SimdF a, SimdF b) { return _mm_min_ps(a.v, b.v); }
+	friend SimdF Max(SimdF a, SimdF b) { return _mm_max_ps(a.v, b.v); }
+	// no roundps before SSE4.1: truncate, then step down where that rounded up
+	friend SimdF Floor(SimdF a) {
+		__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+		return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f)));
+	}
+
+	friend Mask Greater(SimdF a, SimdF b) { return _mm_cmpgt_ps(a.v, b.v); }
+	friend Mask Less(SimdF a, SimdF b) { return _mm_cmplt_ps(a.v, b.v); }
+	friend SimdF Select(Mask m, SimdF a, SimdF b) { return _mm_or_ps(_mm_and_ps(m, a.v), _mm_andnot_ps(m, b.v)); }
+
+	static Mask And(Mask a, Mask b) { return _mm_and_ps(a, b); }
+	static Mask Or(Mask a, Mask b) { return _mm_or_ps(a, b); }
+	static Mask AndNot(Mask a, Mask b) { return _mm_andnot_ps(a, b); }
+	static bool Any(Mask m) { return _mm_movemask_ps(m) != 0; }
+	static int Bits(Mask m) { return _mm_movemask_ps(m); }
+};
+#endif
+
+// AVX2
+//========================================
+
+#if defined(__AVX2__)
+template<> struct SimdF<8> {
+	typedef __m256 Mask;
+	__m256 v;
+
+	SimdF() = default;
+	SimdF(__m256 r) : v(r) {}
+	SimdF(float s) : v(_mm256_set1_ps(s)) {}
+
+	static SimdF Load(const float* p) { return _mm256_loadu_ps(p); }
+	void Store(float* p) const { _mm256_storeu_ps(p, v); }
+
+	friend SimdF operator+(SimdF a, SimdF b) { return _mm256_add_ps(a.v, b.v); }
+	friend SimdF operator-(SimdF a, SimdF b) { return _mm256_sub_ps(a.v, b.v); }
+	friend SimdF operator*(SimdF a, SimdF b) { return _mm256_mul_ps(a.v, b.v); }
+	friend SimdF operator/(SimdF a, SimdF b) { return _mm256_div_ps(a.v, b.v); }
+	friend SimdF operator-(SimdF a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+
+	friend SimdF Sqrt(SimdF a) { return _mm256_sqrt_ps(a.v); }
+	friend SimdF Abs(SimdF a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+	friend SimdF Min(SimdF a, SimdF b) { return _mm256_min_ps(a.v, b.v); }
+	friend SimdF Max(SimdF a, SimdF b) { return _mm256_max_ps(a.v, b.v); }
+	friend SimdF Floor(SimdF a) { return _mm256_floor_ps(a.v); }
+
+	friend Mask Greater(SimdF a, SimdF b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+	friend Mask Less(SimdF a, SimdF b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+	friend SimdF Select(Mask m, SimdF a, SimdF b) { return _mm256_blendv_ps(b.v, a.v, m); }
+
+	static Mask And(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+	static Mask Or(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+	static Mask AndNot(Mask a, Mask b) { return _mm256_andnot_ps(a, b); }
+	static bool Any(Mask m) { return _mm256_movemask_ps(m) != 0; }
+	static int Bits(Mask m) { return _mm256_movemask_ps(m); }
+};
+#endif
+
+// AVX-512
+//========================================
+
+#if defined(__AVX512F__)
+template<> struct SimdF<16> {
+	typedef __mmask16 Mask;
+	__m512 v;
+
+	SimdF() = default;
+	SimdF(__m512 r) : v(r) {}
+	SimdF(float s) : v(_mm512_set1_ps(s)) {}
+
+	static SimdF Load(const float* p) { return _mm512_loadu_ps(p); }
+	void Store(float* p) const { _mm512_storeu_ps(p, v); }
+
+	friend SimdF operator+(SimdF a, SimdF b) { return _mm512_add_ps(a.v, b.v); }
+	friend SimdF operator-(SimdF a, SimdF b) { return _mm512_sub_ps(a.v, b.v); }
+	friend SimdF operator*(SimdF a, SimdF b) { return _mm512_mul_ps(a.v, b.v); }
+	friend SimdF operator/(SimdF a, SimdF b) { return _mm512_div_ps(a.v, b.v); }
+	friend SimdF operator-(SimdF a) { return _mm512_sub_ps(_mm512_setzero_ps(), a.v); }
+
+	friend SimdF Sqrt(SimdF a) { return _mm512_sqrt_ps(a.v); }
+	friend SimdF Abs(SimdF a) { return _mm512_abs_ps(a.v); }
+	friend SimdF Min(SimdF a, SimdF b) { return _mm512_min_ps(a.v, b.v); }
+	friend SimdF Max(SimdF a, SimdF b) { return _mm512_max_ps(a.v, b.v); }
+	friend SimdF Floor(SimdF a) { return _mm512_roundscale_ps(a.v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+
+	friend Mask Greater(SimdF a, SimdF b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ); }
+	friend Mask Less(SimdF a, SimdF b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ); }
+	friend SimdF Select(Mask m, SimdF a, SimdF b) { return _mm512_mask_blend_ps(m, b.v, a.v); }
+
+	static Mask And(Mask a, Mask b) { return a & b; }
+	static Mask Or(Mask a, Mask b) { return a | b; }
+	static Mask AndNot(Mask a, Mask b) { return ~a & b; }
+	static bool Any(Mask m) { return m != 0; }
+	static int Bits(Mask m) { return (int)m; }
+};
+#endif
+
+// Shared math built from the primitives above
+//========================================
+
+template<int W>
+struct SimdF3 {
+	SimdF<W> x;
+	SimdF<W> y;
+	SimdF<W> z;
+};
+
+template<int W> inline SimdF3<W> operator+(const SimdF3<W>& a, const SimdF3<W>& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+template<int W> inline SimdF3<W> operator-(const SimdF3<W>& a, const SimdF3<W>& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+template<int W> inline SimdF3<W> operator*(const SimdF3<W>& a, SimdF<W> s) { return { a.x * s, a.y * s, a.z * s }; }
+
+template<int W> inline SimdF<W> Dot(const SimdF3<W>& a, const SimdF3<W>& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+template<int W> inline SimdF3<W> Cross(const SimdF3<W>& a, const SimdF3<W>& b) {
+	return {
+		a.y * b.z - a.z * b.y,
+		a.z * b.x - a.x * b.z,
+		a.x * b.y - a.y * b.x
+	};
+}
+
+template<int W> inline SimdF3<W> Normalize(const SimdF3<W>& a) {
+	return a * (SimdF<W>(1.0f) / Sqrt(Dot(a, a)));
+}
+
+template<int W> inline SimdF3<W> Select(typename SimdF<W>::Mask m, const SimdF3<W>& a, const SimdF3<W>& b) {
+	return { Select(m, a.x, b.x), Select(m, a.y, b.y), Select(m, a.z, b.z) };
+}
+
+// acos with |error| < 2e-7 rad (Abramowitz & Stegun 4.4.46)
+template<int W> inline SimdF<W> Acos(SimdF<W> x) {
+	SimdF<W> ax = Min(Abs(x), SimdF<W>(1.0f));
+	SimdF<W> p = SimdF<W>(-0.0012624911f);
+	p = p * ax + SimdF<W>(0.0066700901f);
+	p = p * ax + SimdF<W>(-0.0170881256f);
+	p = p * ax + SimdF<W>(0.0308918810f);
+	p = p * ax + SimdF<W>(-0.0501743046f);
+	p = p * ax + SimdF<W>(0.0889789874f);
+	p = p * ax + SimdF<W>(-0.2145988016f);
+	p = p * ax + SimdF<W>(1.5707963050f);
+	SimdF<W> r = Sqrt(SimdF<W>(1.0f) - ax) * p;
+	return Select(Less(x, SimdF<W>(0.0f)), SimdF<W>(3.14159265f) - r, r);
+}
@@ -0,0 +1,597 @@
+#include "SoftwareGraphics.h"
+#include "Profiler.h"
+#include "Shading.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#define TRIANGLES_PER_CHUNK 256
+
+static uint32_t PackColor(float r, float g, float b, float a) {
+	auto unorm = [](float v) { return (uint32_t)(Saturate(v) * 255.0f + 0.5f); };
+	return unorm(r) | (unorm(g) << 8) | (unorm(b) << 16) | (unorm(a) << 24);
+}
+
+#pragma region PublicMethods
+
+SoftwareGraphics::SoftwareGraphics(int width, int height, const char* ltcMatPath, const char* ltcAmpPath, int threads)
+	: _width(width), _height(height), _pool(threads), _ltc(ltcMatPath, ltcAmpPath)
+{
+	if (width <= 0 || height <= 0)
+		throw graphicsException("Framebuffer size fucked up");
+
+	_tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	_tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	_backBuffer.resize((size_t)width * height);
+	_frontBuffer.resize((size_t)width * height);
+	_depthBuffer.resize((size_t)width * height, 1.0f);
+}
+
+void SoftwareGraphics::Clear(const float colorRGBA[4]) {
+	PROFILE_ZONE("Clear");
+	std::fill(_backBuffer.begin(), _backBuffer.end(), PackColor(colorRGBA[0], colorRGBA[1], colorRGBA[2], colorRGBA[3]));
+	std::fill(_depthBuffer.begin(), _depthBuffer.end(), 1.0f);
+}
+
+void SoftwareGraphics::SwapBuffers() {
+	_frontBuffer.swap(_backBuffer);
+	_objectIndex = 0;
+}
+
+void SoftwareGraphics::DrawTriangles(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, Float3 cameraPos, Float3 cameraRotation) {
+	PROFILE_ZONE("DrawTriangles");
+	Float4x4 worldToView, projection;
+	Float3 cameraForward;
+	GetCamera(cameraPos, cameraRotation, worldToView, projection, cameraForward);
+	Float4x4 viewProjection = worldToView * projection;
+
+	// culled light proxies keep their object slot, without geometry
+	{
+		PROFILE_ZONE("proxy culling");
+		const Aabb quadBox = { { -1, -1, 0 }, { 1, 1, 0 } };
+		_proxyBounds.resize(_rectLights.size());
+		for (size_t i = 0; i < _rectLights.size(); i++)
+			_proxyBounds[i] = TransformAabb(quadBox, QuadLightTransform(_rectLights[i]));
+		_proxyBvh.Build(_proxyBounds.data(), _proxyBounds.size());
+		_visibleProxies.clear();
+		_proxyBvh.Cull(ExtractFrustum(viewProjection), _visibleProxies);
+		std::sort(_visibleProxies.begin(), _visibleProxies.end());
+		for (size_t i = 0, next = 0; i < _rectLights.size(); i++) {
+			if (next < _visibleProxies.size() && _visibleProxies[next] == i) {
+				FillQuadLight(vBuffer, iBuffer, _rectLights[i]);
+				next++;
+			}
+			else
+				SetObjectTransform(QuadLightTransform(_rectLights[i]));
+		}
+	}
+	unsigned int objects = (unsigned int)_objectIndex;
+
+	// Light culling
+	//========================================
+	{
+		PROFILE_ZONE("light culling");
+		ClusterGridDesc desc = {
+			_width, _height, TILE_SIZE, CLUSTER_SLICES, 0.5f, 500.0f,
+			1.0f / projection.m[0][0], 1.0f / projection.m[1][1]
+		};
+		_clusterGrid.Build(desc, worldToView,
+			_pointLights.data(), _pointLights.size(),
+			_spotLights.data(), _spotLights.size(),
+			_rectLights.data(), _rectLights.size(),
+			_pool);
+		_ambient = SumLightAmbient(
+			_pointLights.data(), _pointLights.size(),
+			_spotLights.data(), _spotLights.size(),
+			_rectLights.data(), _rectLights.size());
+	}
+
+	// Vertex stage
+	//========================================
+	{
+		PROFILE_ZONE("vertex stage");
+		_clipVertices.resize(vBuffer.size());
+		size_t vertexBlocks = (vBuffer.size() + 1023) / 1024;
+		_pool.ParallelFor(vertexBlocks, [&](size_t block) {
+			size_t last = std::min(vBuffer.size(), (block + 1) * 1024);
+			for (size_t i = block * 1024; i < last; i++) {
+				const Vertex& v = vBuffer[i];
+				ClipVertex& out = _clipVertices[i];
+				Float4 world = Transform({ v.x, v.y, v.z, 1 }, _modelToWorld[v.index]);
+				out.position = Transform(world, viewProjection);
+				out.world = XYZ(world);
+				out.color = { v.r, v.g, v.b };
+				out.normal = XYZ(Transform({ v.nx, v.ny, v.nz, 1 }, _normalTransform[v.index]));
+				out.lightIndex = objects - v.index;
+			}
+		});
+	}
+
+	// Setup and binning
+	//========================================
+	{
+		PROFILE_ZONE("setup and binning");
+		size_t triangleCount = iBuffer.size() / 3;
+		size_t chunkCount = (triangleCount + TRIANGLES_PER_CHUNK - 1) / TRIANGLES_PER_CHUNK;
+		if (_chunks.size() < chunkCount)
+			_chunks.resize(chunkCount);
+		_pool.ParallelFor(chunkCount, [&](size_t chunk) {
+			size_t first = chunk * TRIANGLES_PER_CHUNK;
+			SetupTriangles(_chunks[chunk], iBuffer, first, std::min(triangleCount, first + TRIANGLES_PER_CHUNK));
+		});
+		for (size_t i = chunkCount; i < _chunks.size(); i++)
+			SetupTriangles(_chunks[i], iBuffer, 0, 0);
+	}
+
+	// Raster and shading, one tile per job
+	//========================================
+	{
+		PROFILE_ZONE("raster and shading");
+		TileKernel kernel = GetTileKernel(_lightPermutations ? GetLightMix() : LIGHT_MIX_ALL);
+		_pool.ParallelFor((size_t)_tilesX * _tilesY, [&](size_t tile) {
+			(this->*kernel)((int)tile, cameraPos, cameraForward);
+		});
+	}
+}
+
+uint32_t SoftwareGraphics::GetLightMix() const {
+	uint32_t mix = 0;
+	if (!_pointLights.empty()) mix |= LIGHT_MIX_POINT;
+	if (!_spotLights.empty()) mix |= LIGHT_MIX_SPOT;
+	if (!_dirLights.empty()) mix |= LIGHT_MIX_DIR;
+	if (!_rectLights.empty()) mix |= LIGHT_MIX_RECT;
+	return mix;
+}
+
+MeshHandle SoftwareGraphics::RegisterMesh(const vector<Vertex>& vBuffer, const vector<unsigned int>& iBuffer) {
+	if (vBuffer.empty() || iBuffer.empty())
+		throw graphicsException("Empty mesh");
+
+	for (size_t i = 0; i < _meshes.size(); i++) {
+		if (_meshes[i].indices.empty()) {
+			_meshes[i] = { vBuffer, iBuffer };
+			return { (unsigned int)i + 1 };
+		}
+	}
+	_meshes.push_back({ vBuffer, iBuffer });
+	return { (unsigned int)_meshes.size() };
+}
+
+MeshHandle SoftwareGraphics::RegisterMesh(const vector<PackedVertex>& vBuffer, const vector<unsigned int>& iBuffer) {
+	vector<Vertex> vertices;
+	vertices.reserve(vBuffer.size());
+	for (const PackedVertex& v : vBuffer)
+		vertices.push_back(UnpackVertex(v));
+	return RegisterMesh(vertices, iBuffer);
+}
+
+MeshHandle SoftwareGraphics::RegisterMesh(const ImportedMesh& mesh) {
+	return RegisterMesh(vector<Vertex>(mesh.GetVertices(), mesh.GetVertices() + mesh.GetVertexCount()),
+		vector<unsigned int>(mesh.GetIndices(), mesh.GetIndices() + mesh.GetIndexCount()));
+}
+
+void SoftwareGraphics::ReleaseMesh(MeshHandle mesh) {
+	if (mesh.IsValid() && mesh.id <= _meshes.size())
+		_meshes[mesh.id - 1] = Mesh();
+}
+
+void SoftwareGraphics::DrawMesh(MeshHandle mesh, Float4x4 transform) {
+	if (!mesh.IsValid() || mesh.id > _meshes.size() || _meshes[mesh.id - 1].indices.empty())
+		throw graphicsException("Invalid mesh handle");
+
+	_drawList.push_back({ mesh, (unsigned int)_objectIndex });
+	SetObjectTransform(transform);
+}
+
+// the vertex stage expands every draw anyway, so instances are plain draws
+void SoftwareGraphics::DrawMeshInstanced(MeshHandle mesh, const Float4x4* transforms, size_t count) {
+	for (size_t i = 0; i < count; i++)
+		DrawMesh(mesh, transforms[i]);
+}
+
+void SoftwareGraphics::Draw(Float3 cameraPos, Float3 cameraRotation) {
+	PROFILE_ZONE("Draw");
+	_frameVertices.clear();
+	_frameIndices.clear();
+	for (const MeshDraw& draw : _drawList) {
+		const Mesh& mesh = _meshes[draw.mesh.id - 1];
+		unsigned int offset = (unsigned int)_frameVertices.size();
+		for (Vertex v : mesh.vertices) {
+			v.index += draw.objectIndex;
+			_frameVertices.push_back(v);
+		}
+		for (unsigned int index : mesh.indices)
+			_frameIndices.push_back(offset + index);
+	}
+	_drawList.clear();
+
+	DrawTriangles(_frameVertices, _frameIndices, cameraPos, cameraRotation);
+}
+
+void SoftwareGraphics::SetCullBounds(const Aabb* bounds, size_t count) {
+	_objectBvh.Build(bounds, count);
+}
+
+void SoftwareGraphics::UpdateCullBounds(const Aabb* bounds) {
+	_objectBvh.Refit(bounds);
+}
+
+const vector<uint32_t>& SoftwareGraphics::CullObjects(Float3 cameraPos, Float3 cameraRotation) {
+	Float4x4 worldToView, projection;
+	Float3 cameraForward;
+	GetCamera(cameraPos, cameraRotation, worldToView, projection, cameraForward);
+	_visibleObjects.clear();
+	_objectBvh.Cull(ExtractFrustum(worldToView * projection), _visibleObjects);
+	return _visibleObjects;
+}
+
+void SoftwareGraphics::FillTriangle(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer) {
+	AppendTriangle(vBuffer, iBuffer);
+}
+
+void SoftwareGraphics::FillCubeShared(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer) {
+	AppendCubeShared(vBuffer, iBuffer);
+}
+
+void SoftwareGraphics::FillCube(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, Float4x4 transform) {
+	AppendCube(vBuffer, iBuffer, (unsigned int)_objectIndex);
+	SetObjectTransform(transform);
+}
+
+void SoftwareGraphics::FillFloor(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, Float4x4 transform) {
+	AppendFloor(vBuffer, iBuffer, (unsigned int)_objectIndex);
+	SetObjectTransform(transform);
+}
+
+void SoftwareGraphics::FillQuadLight(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, RectLight light) {
+	AppendQuadLight(vBuffer, iBuffer, light, (unsigned int)_objectIndex);
+	SetObjectTransform(QuadLightTransform(light));
+}
+
+void SoftwareGraphics::AddPointLight(Float3 position, Float3 color, float intensity, float radius) {
+	_pointLights.push_back({
+		{ position.x, position.y, position.z, 1 },
+		{ color.x, color.y, color.z, intensity },
+		{ radius, 0, 0, 0 }
+	});
+}
+
+void SoftwareGraphics::AddSpotLight(Float3 position, Float3 color, Float3 direction, float intensity, float innerCone, float outerCone, float radius) {
+	_spotLights.push_back({
+		{ position.x, position.y, position.z, 1 },
+		{ direction.x, direction.y, direction.z, 1 },
+		{ color.x, color.y, color.z, intensity },
+		{ innerCone, outerCone, 0, 0 },
+		{ radius, 0, 0, 0 }
+	});
+}
+
+void SoftwareGraphics::AddDirLight(Float3 color, Float3 direction, float intensity) {
+	if (_dirLights.size() >= LIGHT_BUFFER_SIZE)
+		return;
+
+	_dirLights.push_back({
+		{ direction.x, direction.y, direction.z, 1 },
+		{ color.x, color.y, color.z, intensity }
+	});
+}
+
+void SoftwareGraphics::AddRectLight(Float3 position, Float3 color, float intensity, float width, float height, float rotationX, float rotationY) {
+	_rectLights.push_back({
+		{ position.x, position.y, position.z, 1 },
+		{ width, height, rotationX, rotationY },
+		{ color.x, color.y, color.z, intensity }
+	});
+}
+
+PointLight* SoftwareGraphics::GetPointLight(int index) {
+	return index < (int)_pointLights.size() ? &_pointLights[index] : nullptr;
+}
+
+SpotLight* SoftwareGraphics::GetSpotLight(int index) {
+	return index < (int)_spotLights.size() ? &_spotLights[index] : nullptr;
+}
+
+DirLight* SoftwareGraphics::GetDirLight(int index) {
+	return index < (int)_dirLights.size() ? &_dirLights[index] : nullptr;
+}
+
+RectLight* SoftwareGraphics::GetRectLight(int index) {
+	return index < (int)_rectLights.size() ? &_rectLights[index] : nullptr;
+}
+
+// Binary PPM, alpha dropped
+bool SoftwareGraphics::SaveFrontBuffer(const char* path) const {
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return false;
+
+	fprintf(file, "P6\n%d %d\n255\n", _width, _height);
+	vector<unsigned char> row(_width * 3);
+	for (int y = 0; y < _height; y++) {
+		for (int x = 0; x < _width; x++) {
+			uint32_t c = _frontBuffer[(size_t)y * _width + x];
+			row[x * 3 + 0] = c & 0xff;
+			row[x * 3 + 1] = (c >> 8) & 0xff;
+			row[x * 3 + 2] = (c >> 16) & 0xff;
+		}
+		fwrite(row.data(), 1, row.size(), file);
+	}
+	return fclose(file) == 0;
+}
+
+#pragma endregion
+
+#pragma region PrivateMethods
+
+// Same camera as Graphics
+void SoftwareGraphics::GetCamera(Float3 cameraPos, Float3 cameraRotation, Float4x4& worldToView, Float4x4& projection, Float3& cameraForward) const {
+	projection = Float4x4::PerspectiveLH(1.0f, (float)_height / _width, 0.5f, 500.0f);
+	Float4 forward = Transform({ 0, 0, 1, 0 }, Float4x4::RotationRollPitchYaw(cameraRotation.x, cameraRotation.y, cameraRotation.z));
+	cameraForward = Normalize(XYZ(forward));
+	worldToView = Float4x4::LookToLH(cameraPos, cameraForward, { 0, 1, 0 });
+}
+
+// Mirrors the modelToWorld/normalTransform pair Graphics uploads per object
+void SoftwareGraphics::SetObjectTransform(const Float4x4& transform) {
+	if (_modelToWorld.size() <= _objectIndex) {
+		_modelToWorld.resize(_objectIndex + 1);
+		_normalTransform.resize(_objectIndex + 1);
+	}
+	_modelToWorld[_objectIndex] = transform;
+	_normalTransform[_objectIndex] = Transpose(Inverse(transform));
+	_objectIndex++;
+}
+
+void SoftwareGraphics::SetupTriangles(Chunk& chunk, const vector<unsigned int>& iBuffer, size_t firstTriangle, size_t lastTriangle) {
+	chunk.triangles.clear();
+	chunk.bins.resize((size_t)_tilesX * _tilesY);
+	for (vector<uint32_t>& bin : chunk.bins)
+		bin.clear();
+
+	auto lerp = [](const ClipVertex& a, const ClipVertex& b, float t) {
+		ClipVertex r;
+		r.position = a.position + (b.position - a.position) * t;
+		r.world = a.world + (b.world - a.world) * t;
+		r.color = a.color + (b.color - a.color) * t;
+		r.normal = a.normal + (b.normal - a.normal) * t;
+		r.lightIndex = a.lightIndex;
+		return r;
+	};
+
+	for (size_t t = firstTriangle; t < lastTriangle; t++) {
+		const ClipVertex* in[3] = {
+			&_clipVertices[iBuffer[t * 3 + 0]],
+			&_clipVertices[iBuffer[t * 3 + 1]],
+			&_clipVertices[iBuffer[t * 3 + 2]]
+		};
+
+		// clip against the near plane (z >= 0), the only plane that can flip w
+		ClipVertex clipped[4];
+		int count = 0;
+		for (int i = 0; i < 3; i++) {
+			const ClipVertex& a = *in[i];
+			const ClipVertex& b = *in[(i + 1) % 3];
+			bool aInside = a.position.z >= 0.0f;
+			bool bInside = b.position.z >= 0.0f;
+			if (aInside)
+				clipped[count++] = a;
+			if (aInside != bInside)
+				clipped[count++] = lerp(a, b, a.position.z / (a.position.z - b.position.z));
+		}
+
+		for (int i = 1; i + 1 < count; i++)
+			SetupTriangle(chunk, clipped[0], clipped[i], clipped[i + 1]);
+	}
+}
+
+void SoftwareGraphics::SetupTriangle(Chunk& chunk, const ClipVertex& a, const ClipVertex& b, const ClipVertex& c) {
+	const ClipVertex* v[3] = { &a, &b, &c };
+	ScreenTriangle tri;
+	float sx[3], sy[3];
+	for (int i = 0; i < 3; i++) {
+		float invW = 1.0f / v[i]->position.w;
+		sx[i] = (v[i]->position.x * invW * 0.5f + 0.5f) * _width;
+		sy[i] = (0.5f - v[i]->position.y * invW * 0.5f) * _height;
+		tri.z[i] = v[i]->position.z * invW;
+		tri.invW[i] = invW;
+		tri.world[i] = v[i]->world;
+		tri.color[i] = v[i]->color;
+		tri.normal[i] = v[i]->normal;
+	}
+	tri.lightIndex = a.lightIndex;
+
+	// default rasterizer state: clockwise is front facing, back faces are culled
+	float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sy[1] - sy[0]) * (sx[2] - sx[0]);
+	if (!(area > 0.0f))
+		return;
+
+	float minX = std::min({ sx[0], sx[1], sx[2] });
+	float maxX = std::max({ sx[0], sx[1], sx[2] });
+	float minY = std::min({ sy[0], sy[1], sy[2] });
+	float maxY = std::max({ sy[0], sy[1], sy[2] });
+	tri.minX = std::max(0, (int)std::floor(minX));
+	tri.minY = std::max(0, (int)std::floor(minY));
+	tri.maxX = std::min(_width - 1, (int)std::ceil(maxX));
+	tri.maxY = std::min(_height - 1, (int)std::ceil(maxY));
+	if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+		return;
+
+	// edge i is opposite vertex i; E(p) >= 0 inside, normalized by the area
+	// so the three values are the screen-space barycentrics
+	float invArea = 1.0f / area;
+	for (int i = 0; i < 3; i++) {
+		int j = (i + 1) % 3, k = (i + 2) % 3;
+		float A = -(sy[k] - sy[j]);
+		float B = sx[k] - sx[j];
+		tri.edgeA[i] = A * invArea;
+		tri.edgeB[i] = B * invArea;
+		tri.edgeC[i] = -(A * sx[j] + B * sy[j]) * invArea;
+		tri.edgeTopLeft[i] = A > 0.0f || (A == 0.0f && B > 0.0f);
+	}
+
+	uint32_t index = (uint32_t)chunk.triangles.size();
+	chunk.triangles.push_back(tri);
+	for (int ty = tri.minY / TILE_SIZE; ty <= tri.maxY / TILE_SIZE; ty++)
+		for (int tx = tri.minX / TILE_SIZE; tx <= tri.maxX / TILE_SIZE; tx++)
+			chunk.bins[(size_t)ty * _tilesX + tx].push_back(index);
+}
+
+SoftwareGraphics::TileKernel SoftwareGraphics::GetTileKernel(uint32_t mix) {
+	return GetTileKernel(mix & TILE_KERNEL_MIX, std::make_index_sequence<TILE_KERNEL_MIX + 1>());
+}
+
+template<size_t... Mix>
+SoftwareGraphics::TileKernel SoftwareGraphics::GetTileKernel(uint32_t mix, std::index_sequence<Mix...>) {
+	static const TileKernel kernels[] = { &SoftwareGraphics::RenderTile<(uint32_t)Mix>... };
+	return kernels[mix];
+}
+
+// Visibility first, then shading once per covered pixel: the tile keeps the
+// winning triangle and barycentrics per pixel and shades in one SoA batch.
+// Mix compiles out the loops, and the cluster lookup, of absent light types.
+template<uint32_t Mix>
+void SoftwareGraphics::RenderTile(int tile, Float3 cameraPos, Float3 cameraForward) {
+	PROFILE_ZONE("tile");
+	struct Scratch {
+		const ScreenTriangle* triangle[TILE_SIZE * TILE_SIZE];
+		float b0[TILE_SIZE * TILE_SIZE];
+		float b1[TILE_SIZE * TILE_SIZE];
+		vector<int> pixels;
+		ShadingPoints points;
+		vector<uint32_t> rectIndices;
+		vector<RectLight> rectLights;
+	};
+	thread_local Scratch scratch;
+
+	int x0 = (tile % _tilesX) * TILE_SIZE;
+	int y0 = (tile / _tilesX) * TILE_SIZE;
+	int x1 = std::min(x0 + TILE_SIZE, _width) - 1;
+	int y1 = std::min(y0 + TILE_SIZE, _height) - 1;
+	std::fill(std::begin(scratch.triangle), std::end(scratch.triangle), nullptr);
+
+	// Raster
+	//========================================
+	for (const Chunk& chunk : _chunks) {
+		for (uint32_t index : chunk.bins[tile]) {
+			const ScreenTriangle& tri = chunk.triangles[index];
+			int minX = std::max(x0, tri.minX), maxX = std::min(x1, tri.maxX);
+			int minY = std::max(y0, tri.minY), maxY = std::min(y1, tri.maxY);
+
+			for (int y = minY; y <= maxY; y++) {
+				float py = y + 0.5f;
+				for (int x = minX; x <= maxX; x++) {
+					float px = x + 0.5f;
+					float w[3];
+					bool inside = true;
+					for (int e = 0; e < 3; e++) {
+						w[e] = tri.edgeA[e] * px + tri.edgeB[e] * py + tri.edgeC[e];
+						inside = inside && (w[e] > 0.0f || (w[e] == 0.0f && tri.edgeTopLeft[e]));
+					}
+					if (!inside)
+						continue;
+
+					float z = w[0] * tri.z[0] + w[1] * tri.z[1] + w[2] * tri.z[2];
+					float& depth = _depthBuffer[(size_t)y * _width + x];
+					if (!(z < depth) || z < 0.0f)
+						continue;
+
+					depth = z;
+					int local = (y - y0) * TILE_SIZE + (x - x0);
+					float p0 = w[0] * tri.invW[0], p1 = w[1] * tri.invW[1], p2 = w[2] * tri.invW[2];
+					float norm = 1.0f / (p0 + p1 + p2);
+					scratch.triangle[local] = &tri;
+					scratch.b0[local] = p0 * norm;
+					scratch.b1[local] = p1 * norm;
+				}
+			}
+		}
+	}
+
+	// Shading
+	//========================================
+	unsigned int rectCount = (unsigned int)_rectLights.size();
+	scratch.pixels.clear();
+	for (int y = y0; y <= y1; y++) {
+		for (int x = x0; x <= x1; x++) {
+			int local = (y - y0) * TILE_SIZE + (x - x0);
+			const ScreenTriangle* tri = scratch.triangle[local];
+			if (!tri)
+				continue;
+
+			// rect light proxies are emissive, as in the pixel shader
+			if (tri->lightIndex >= 1 && tri->lightIndex <= rectCount) {
+				const Float4& c = _rectLights[tri->lightIndex - 1].Color;
+				_backBuffer[(size_t)y * _width + x] = PackColor(c.x, c.y, c.z, c.w);
+				continue;
+			}
+			scratch.pixels.push_back(local);
+		}
+	}
+
+	// point and spot lights per pixel from its cluster, like the pixel shader
+	const vector<ClusterRange>& clusters = _clusterGrid.GetClusters();
+	const vector<uint32_t>& lightIndices = _clusterGrid.GetLightIndices();
+	int tileX = tile % _tilesX, tileY = tile / _tilesX;
+	int minSlice = CLUSTER_SLICES, maxSlice = -1;
+
+	ShadingPoints& points = scratch.points;
+	points.Resize(scratch.pixels.size());
+	points.ClearResults();
+	for (size_t i = 0; i < scratch.pixels.size(); i++) {
+		int local = scratch.pixels[i];
+		const ScreenTriangle& tri = *scratch.triangle[local];
+		float b0 = scratch.b0[local], b1 = scratch.b1[local], b2 = 1.0f - b0 - b1;
+		Float3 world = tri.world[0] * b0 + tri.world[1] * b1 + tri.world[2] * b2;
+		Float3 color = tri.color[0] * b0 + tri.color[1] * b1 + tri.color[2] * b2;
+		Float3 normal = tri.normal[0] * b0 + tri.normal[1] * b1 + tri.normal[2] * b2;
+		Float3 viewDir = Normalize(cameraPos - world);
+		points.Set(i, world, normal, viewDir, color);
+
+		Float3 light = _ambient * color;
+		if constexpr ((Mix & (LIGHT_MIX_POINT | LIGHT_MIX_SPOT | LIGHT_MIX_RECT)) != 0) {
+			int slice = _clusterGrid.GetSlice(Dot(world - cameraPos, cameraForward));
+			minSlice = std::min(minSlice, slice);
+			maxSlice = std::max(maxSlice, slice);
+			const ClusterRange& cluster = clusters[_clusterGrid.GetClusterIndex(tileX, tileY, slice)];
+			const uint32_t* next = lightIndices.data() + cluster.offset;
+
+			if constexpr ((Mix & LIGHT_MIX_POINT) != 0)
+				for (uint32_t l = 0; l < cluster.pointCount; l++)
+					light += CalcPointLight(_pointLights[*next++], normal, world, color, viewDir, 1.0f, 64.0f, 0.0f);
+			if constexpr ((Mix & LIGHT_MIX_SPOT) != 0)
+				for (uint32_t l = 0; l < cluster.spotCount; l++)
+					light += CalcSpotLight(_spotLights[*next++], normal, world, color, viewDir, 1.0f, 64.0f, 0.0f);
+		}
+		if constexpr ((Mix & LIGHT_MIX_DIR) != 0)
+			for (const DirLight& l : _dirLights)
+				light += CalcDirLight(l, normal, color, viewDir);
+		points.outR[i] = light.x;
+		points.outG[i] = light.y;
+		points.outB[i] = light.z;
+	}
+
+	// rect lights in one batch over the union of the tile's clusters
+	if constexpr ((Mix & LIGHT_MIX_RECT) != 0) {
+		scratch.rectIndices.clear();
+		for (int slice = minSlice; slice <= maxSlice; slice++) {
+			const ClusterRange& cluster = clusters[_clusterGrid.GetClusterIndex(tileX, tileY, slice)];
+			const uint32_t* first = lightIndices.data() + cluster.offset + cluster.pointCount + cluster.spotCount;
+			scratch.rectIndices.insert(scratch.rectIndices.end(), first, first + cluster.rectCount);
+		}
+		std::sort(scratch.rectIndices.begin(), scratch.rectIndices.end());
+		scratch.rectIndices.erase(std::unique(scratch.rectIndices.begin(), scratch.rectIndices.end()), scratch.rectIndices.end());
+
+		scratch.rectLights.clear();
+		for (uint32_t index : scratch.rectIndices)
+			scratch.rectLights.push_back(_rectLights[index]);
+		if (!scratch.rectLights.empty())
+			_ltc.CalcRectLights(scratch.rectLights.data(), (int)scratch.rectLights.size(), points, 0.25f, 0.0f);
+	}
+
+	for (size_t i = 0; i < scratch.pixels.size(); i++) {
+		int local = scratch.pixels[i];
+		int x = x0 + local % TILE_SIZE, y = y0 + local / TILE_SIZE;
+		_backBuffer[(size_t)y * _width + x] = PackColor(points.outR[i], points.outG[i], points.outB[i], 1.0f);
+	}
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "Bvh.h"
+#include "ClusterGrid.h"
+#include "CpuMath.h"
+#include "Geometry.h"
+#include "Lights.h"
+#include "LTC.h"
+#include "MeshCache.h"
+#include "MeshImport.h"
+#include "ThreadPool.h"
+#include "Vertex.h"
+#include "VertexPacking.h"
+#include <cstdint>
+#include <exception>
+#include <utility>
+#include <vector>
+
+using std::exception;
+using std::vector;
+
+#define TILE_SIZE 32
+// LightMix bits RenderTile is specialized on, the rest take the generic path
+#define TILE_KERNEL_MIX (LIGHT_MIX_POINT | LIGHT_MIX_SPOT | LIGHT_MIX_DIR | LIGHT_MIX_RECT)
+
+// CPU rendering backend with the same public API as Graphics, for machines
+// without a GPU or a window. Triangles are binned into TILE_SIZE screen tiles,
+// then every tile is rasterized and shaded independently on the thread pool.
+// Lights are culled with the same cluster grid as Graphics, using the tiles
+// as cluster columns. Output goes to an in-memory RGBA8 framebuffer.
+class SoftwareGraphics {
+public:
+	SoftwareGraphics(int width, int height, const char* ltcMatPath = "./ltc_mat.dds", const char* ltcAmpPath = "./ltc_amp.dds", int threads = 0);
+	void Clear(const float colorRGBA[4]);
+	void SwapBuffers();
+	void DrawTriangles(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, Float3 cameraPos, Float3 cameraRotation);
+	MeshHandle RegisterMesh(const vector<Vertex>& vBuffer, const vector<unsigned int>& iBuffer);
+	// decoded back to Vertex, so it renders what the packed input layout would
+	MeshHandle RegisterMesh(const vector<PackedVertex>& vBuffer, const vector<unsigned int>& iBuffer);
+	MeshHandle RegisterMesh(const ImportedMesh& mesh);
+	void ReleaseMesh(MeshHandle mesh);
+	void DrawMesh(MeshHandle mesh, Float4x4 transform);
+	void DrawMeshInstanced(MeshHandle mesh, const Float4x4* transforms, size_t count);
+	void Draw(Float3 cameraPos, Float3 cameraRotation);
+	// Same object culling as Graphics
+	void SetCullBounds(const Aabb* bounds, size_t count);
+	void UpdateCullBounds(const Aabb* bounds);
+	const vector<uint32_t>& CullObjects(Float3 cameraPos, Float3 cameraRotation);
+	void FillTriangle(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer);
+	void FillCubeShared(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer);
+	void FillCube(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, Float4x4 transform);
+	void FillFloor(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, Float4x4 transform);
+	void FillQuadLight(vector<Vertex>& vBuffer, vector<unsigned int>& iBuffer, RectLight light);
+	// radius > 0 windows the falloff down to zero there, see DistanceWindow
+	void AddPointLight(Float3 position, Float3 color, float intensity = 1.0f, float radius = 0.0f);
+	void AddSpotLight(Float3 position, Float3 color, Float3 direction, float intensity = 10.0f, float innerCone = 0.7f, float outerCone = .75f, float radius = 0.0f);
+	void AddDirLight(Float3 color, Float3 direction, float intensity = 1.0f);
+	void AddRectLight(Float3 position, Float3 color, float intensity = 1.0f, float width = 1.0f, float height = 1.0f, float rotationX = .0f, float rotationY = .0f);
+
+	PointLight* GetPointLight(int index);
+	SpotLight* GetSpotLight(int index);
+	DirLight* GetDirLight(int index);
+	RectLight* GetRectLight(int index);
+	const vector<RectLight>& GetRectLights() const { return _rectLights; }
+	// LightMix bits of the types with at least one light
+	uint32_t GetLightMix() const;
+	// false shades every frame with the generic kernel, LIGHT_MIX_ALL
+	void SetLightPermutations(bool enabled) { _lightPermutations = enabled; }
+	// Far rect lights from their disk, see LTC::FitRectLightLod
+	void SetRectLightLod(const RectLightLod& lod) { _ltc.SetRectLightLod(lod); }
+
+	// Last presented frame, RGBA8 rows top to bottom
+	const vector<uint32_t>& GetFrontBuffer() const { return _frontBuffer; }
+	bool SaveFrontBuffer(const char* path) const;
+	int GetWidth() const { return _width; }
+	int GetHeight() const { return _height; }
+	int GetThreadCount() const { return _pool.GetThreadCount(); }
+
+private:
+	struct ClipVertex {
+		Float4 position;
+		Float3 world;
+		Float3 color;
+		Float3 normal;
+		unsigned int lightIndex;
+	};
+
+	struct ScreenTriangle {
+		float edgeA[3], edgeB[3], edgeC[3];
+		bool edgeTopLeft[3];
+		float z[3];
+		float invW[3];
+		Float3 world[3];
+		Float3 color[3];
+		Float3 normal[3];
+		unsigned int lightIndex;
+		int minX, minY, maxX, maxY;
+	};
+
+	// Triangles set up by one worker and their per-tile bins
+	struct Chunk {
+		vector<ScreenTriangle> triangles;
+		vector<vector<uint32_t>> bins;
+	};
+
+	int _width;
+	int _height;
+	int _tilesX;
+	int _tilesY;
+	ThreadPool _pool;
+	LTC _ltc;
+
+	vector<uint32_t> _backBuffer;
+	vector<uint32_t> _frontBuffer;
+	vector<float> _depthBuffer;
+
+	vector<PointLight> _pointLights;
+	vector<SpotLight> _spotLights;
+	vector<DirLight> _dirLights;
+	vector<RectLight> _rectLights;
+	ClusterGrid _clusterGrid;
+	Float3 _ambient = { 0, 0, 0 };
+	bool _lightPermutations = true;
+
+	vector<Float4x4> _modelToWorld;
+	vector<Float4x4> _normalTransform;
+	size_t _objectIndex = 0;
+
+	// retained meshes are copied into the frame buffers, tagged with their object index
+	struct Mesh {
+		vector<Vertex> vertices;
+		vector<unsigned int> indices;
+	};
+
+	struct MeshDraw {
+		MeshHandle mesh;
+		unsigned int objectIndex;
+	};
+
+	vector<Mesh> _meshes;
+	vector<MeshDraw> _drawList;
+	vector<Vertex> _frameVertices;
+	vector<unsigned int> _frameIndices;
+
+	vector<ClipVertex> _clipVertices;
+	vector<Chunk> _chunks;
+
+	Bvh _objectBvh;
+	Bvh _proxyBvh;
+	vector<Aabb> _proxyBounds;
+	vector<uint32_t> _visibleObjects;
+	vector<uint32_t> _visibleProxies;
+
+	void GetCamera(Float3 cameraPos, Float3 cameraRotation, Float4x4& worldToView, Float4x4& projection, Float3& cameraForward) const;
+	void SetObjectTransform(const Float4x4& transform);
+	void SetupTriangles(Chunk& chunk, const vector<unsigned int>& iBuffer, size_t firstTriangle, size_t lastTriangle);
+	void SetupTriangle(Chunk& chunk, const ClipVertex& a, const ClipVertex& b, const ClipVertex& c);
+	// One instance per mix of point, spot, dir and rect lights, see LightMix
+	template<uint32_t Mix> void RenderTile(int tile, Float3 cameraPos, Float3 cameraForward);
+	typedef void (SoftwareGraphics::*TileKernel)(int tile, Float3 cameraPos, Float3 cameraForward);
+	// The instance for a mix's TILE_KERNEL_MIX bits
+	static TileKernel GetTileKernel(uint32_t mix);
+	template<size_t... Mix> static TileKernel GetTileKernel(uint32_t mix, std::index_sequence<Mix...>);
+
+	class graphicsException : public exception {
+	private:
+		const char* _message;
+	public:
+		graphicsException(const char* message) : _message(message) {}
+		const char* what() const throw () { return _message; }
+	};
+};
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+
+// Smallest top mip a texture is cut down to before it is evicted whole
+#define TEXTURE_CACHE_MIN_SIZE 64
+
+struct TextureCacheStats {
+	unsigned long long hits = 0;
+	unsigned long long misses = 0;       // first loads and reloads after an eviction
+	unsigned long long evictions = 0;    // whole textures dropped
+	unsigned long long mipEvictions = 0; // top mips dropped by a smaller reload
+	unsigned long long restores = 0;     // hits that reloaded dropped mips
+	size_t bytes = 0;
+	size_t peakBytes = 0;
+	size_t textures = 0;
+};
+
+// Textures keyed by path and load flags, so every material naming the same
+// file shares one load. Resident bytes are kept under a budget by walking
+// the least recently used textures: they first lose their top mip through a
+// reload with a smaller maxSize, then they are evicted whole. Textures acquired in
+// the current frame are never touched, so the pointers Acquire returns stay
+// valid until NextFrame; a frame that needs more than the budget goes over.
+template<typename T>
+class TextureCache {
+public:
+	// Fills texture with every mip no larger than maxSize (0 = all), the bytes
+	// they take and the largest dimension of the top mip. False on failure.
+	typedef std::function<bool(const std::string& path, uint32_t flags, size_t maxSize, T& texture, size_t& bytes, size_t& size)> Loader;
+
+	TextureCache(Loader loader, size_t budget)
+		: _loader(std::move(loader)), _budget(budget) {}
+
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+
+	// nullptr when the file does not load
+	T* Acquire(const std::string& path, uint32_t flags = 0) {
+		Key key(path, flags);
+		typename std::map<Key, EntryIterator>::iterator found = _lookup.find(key);
+		if (found != _lookup.end()) {
+			Entry& entry = *found->second;
+			_lru.splice(_lru.begin(), _lru, found->second);
+			entry.frame = _frame;
+			if (entry.maxSize == 0) {
+				_stats.hits++;
+				return &entry.texture;
+			}
+
+			// lost mips earlier, bring them back now that it is in use again
+			_stats.restores++;
+			if (Reload(entry, 0))
+				Trim();
+			return &entry.texture;
+		}
+
+		_stats.misses++;
+		Entry entry;
+		entry.key = key;
+		entry.frame = _frame;
+		if (!_loader(path, flags, 0, entry.texture, entry.bytes, entry.size))
+			return nullptr;
+		entry.fullBytes = entry.bytes;
+
+		_lru.push_front(std::move(entry));
+		_lookup[key] = _lru.begin();
+		Account((long long)_lru.front().bytes);
+		_stats.textures = _lru.size();
+		Trim();
+		return &_lru.front().texture;
+	}
+
+	// Starts a new frame; textures acquired before it may be trimmed again.
+	void NextFrame() { _frame++; }
+
+	void SetBudget(size_t budget) {
+		_budget = budget;
+		Trim();
+	}
+
+	size_t GetBudget() const { return _budget; }
+	const TextureCacheStats& GetStats() const { return _stats; }
+	void ResetCounters() {
+		_stats.hits = _stats.misses = _stats.evictions = _stats.mipEvictions = _stats.restores = 0;
+		_stats.peakBytes = _stats.bytes;
+	}
+
+	void Clear() {
+		_lru.clear();
+		_lookup.clear();
+		_stats.bytes = 0;
+		_stats.textures = 0;
+	}
+
+private:
+	typedef std::pair<std::string, uint32_t> Key;
+
+	struct Entry {
+		Key key;
+		T texture{};
+		size_t bytes = 0;
+		size_t fullBytes = 0;
+		size_t size = 0;    // largest dimension of the top mip
+		size_t maxSize = 0; // 0 while every mip is resident
+		bool noMips = false; // a smaller maxSize did not shrink it
+		unsigned long long frame = 0;
+	};
+	typedef typename std::list<Entry>::iterator EntryIterator;
+
+	Loader _loader;
+	size_t _budget;
+	unsigned long long _frame = 0;
+	std::list<Entry> _lru; // most recently used first
+	std::map<Key, EntryIterator> _lookup;
+	TextureCacheStats _stats;
+
+	void Account(long long delta) {
+		_stats.bytes = (size_t)((long long)_stats.bytes + delta);
+		if (_stats.bytes > _stats.peakBytes)
+			_stats.peakBytes = _stats.bytes;
+	}
+
+	// Replaces the texture with a load capped at maxSize, keeping the old one
+	// when the load fails.
+	bool Reload(Entry& entry, size_t maxSize) {
+		T texture{};
+		size_t bytes, size;
+		if (!_loader(entry.key.first, entry.key.second, maxSize, texture, bytes, size))
+			return false;
+
+		Account((long long)bytes - (long long)entry.bytes);
+		if (maxSize == 0)
+			entry.fullBytes = bytes;
+		entry.texture = std::move(texture);
+		entry.bytes = bytes;
+		entry.size = size;
+		entry.maxSize = bytes < entry.fullBytes ? maxSize : 0;
+		return true;
+	}
+
+	// Cuts every texture not used this frame by one mip, oldest first, then
+	// evicts oldest first while that is not enough.
+	void Trim() {
+		if (_lru.empty())
+			return;
+
+		for (EntryIterator it = std::prev(_lru.end()); _stats.bytes > _budget && it->frame != _frame; --it) {
+			if (it->size > TEXTURE_CACHE_MIN_SIZE && !it->noMips) {
+				size_t bytes = it->bytes;
+				if (Reload(*it, it->size / 2) && it->bytes < bytes)
+					_stats.mipEvictions++;
+				else
+					it->noMips = true;
+			}
+			if (it == _lru.begin())
+				break;
+		}
+
+		while (_stats.bytes > _budget && !_lru.empty() && _lru.back().frame != _frame) {
+			Entry& entry = _lru.back();
+			_stats.evictions++;
+			Account(-(long long)entry.bytes);
+			_lookup.erase(entry.key);
+			_lru.pop_back();
+			_stats.textures = _lru.size();
+		}
+	}
+};
@@ -0,0 +1,218 @@
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <string>
+
+static_assert((THREAD_POOL_DEQUE_SIZE & (THREAD_POOL_DEQUE_SIZE - 1)) == 0, "THREAD_POOL_DEQUE_SIZE must be a power of two");
+
+// pool and index of the worker running on this thread
+static thread_local const ThreadPool* t_pool = nullptr;
+static thread_local int t_index = -1;
+
+ThreadPool::ThreadPool(int threads) {
+	if (threads <= 0)
+		threads = (int)std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min(threads, THREAD_POOL_MAX_THREADS);
+
+	_owner = std::this_thread::get_id();
+	for (int i = 0; i < threads; i++)
+		_deques.push_back(std::make_unique<Deque>());
+	for (int i = 1; i < threads; i++)
+		_workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+	}
+	_wake.notify_all();
+	for (std::thread& worker : _workers)
+		worker.join();
+}
+
+int ThreadPool::GetWorkerIndex() const {
+	if (t_pool == this)
+		return t_index;
+	return std::this_thread::get_id() == _owner ? 0 : -1;
+}
+
+#pragma region Jobs
+
+void ThreadPool::Submit(Job& job) {
+	if (job.counter)
+		job.counter->_value.fetch_add(1);
+
+	int index = GetWorkerIndex();
+	if (_workers.empty() || (index >= 0 && !_deques[index]->Push(&job))) {
+		Execute(&job);
+		return;
+	}
+	if (index < 0) {
+		std::lock_guard<std::mutex> lock(_injectMutex);
+		_injected.push_back(&job);
+	}
+
+	// A worker going to sleep counts itself before it checks _queued, so
+	// either it sees this job or this sees it sleeping.
+	_queued.fetch_add(1);
+	if (_sleeping.load() > 0) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_wake.notify_one();
+	}
+}
+
+void ThreadPool::Wait(JobCounter& counter) {
+	int index = GetWorkerIndex();
+	while (!counter.IsDone()) {
+		if (Job* job = FindJob(index))
+			Execute(job);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void ThreadPool::Execute(Job* job) {
+	// the job may be gone once its counter drops
+	JobCounter* counter = job->counter;
+	job->function(*job);
+	if (counter)
+		counter->_value.fetch_sub(1, std::memory_order_release);
+}
+
+// Own deque first, newest job on top; then the shared queue, then the other
+// deques from the next one on, oldest job first.
+Job* ThreadPool::FindJob(int index) {
+	Job* job = index >= 0 ? _deques[index]->Pop() : nullptr;
+	if (!job && _queued.load() == 0)
+		return nullptr;
+
+	if (!job) {
+		std::lock_guard<std::mutex> lock(_injectMutex);
+		if (!_injected.empty()) {
+			job = _injected.front();
+			_injected.pop_front();
+		}
+	}
+	int count = (int)_deques.size();
+	for (int i = 1; !job && i <= count; i++)
+		job = _deques[(index + i + count) % count]->Steal();
+
+	if (job)
+		_queued.fetch_sub(1);
+	return job;
+}
+
+void ThreadPool::WorkerLoop(int index) {
+	t_pool = this;
+	t_index = index;
+	Profiler::SetThreadName(("worker " + std::to_string(index)).c_str());
+	while (true) {
+		if (Job* job = FindJob(index)) {
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_sleeping.fetch_add(1);
+		_wake.wait(lock, [this] { return _quit || _queued.load() > 0; });
+		_sleeping.fetch_sub(1);
+		if (_quit)
+			return;
+	}
+}
+
+#pragma endregion
+
+#pragma region ParallelFor
+
+// Helpers share one item counter with the caller, so items go out one at a
+// time to whoever is free; a helper that starts after they ran out returns.
+struct ParallelLoop {
+	const std::function<void(size_t)>* body;
+	size_t count;
+	std::atomic<size_t> next{ 0 };
+
+	static void Run(const Job& job) {
+		ParallelLoop& loop = *(ParallelLoop*)job.context;
+		for (size_t i = loop.next++; i < loop.count; i = loop.next++)
+			(*loop.body)(i);
+	}
+};
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& body) {
+	if (count == 0)
+		return;
+
+	if (_workers.empty() || count == 1) {
+		for (size_t i = 0; i < count; i++)
+			body(i);
+		return;
+	}
+
+	ParallelLoop loop;
+	loop.body = &body;
+	loop.count = count;
+	JobCounter counter;
+	Job helpers[THREAD_POOL_MAX_THREADS];
+	size_t helperCount = std::min(count - 1, _workers.size());
+	for (size_t i = 0; i < helperCount; i++) {
+		helpers[i] = { &ParallelLoop::Run, &loop, i, &counter };
+		Submit(helpers[i]);
+	}
+
+	Job self = { &ParallelLoop::Run, &loop, helperCount, nullptr };
+	ParallelLoop::Run(self);
+	Wait(counter);
+}
+
+#pragma endregion
+
+#pragma region Deque
+
+bool ThreadPool::Deque::Push(Job* job) {
+	int64_t bottom = _bottom.load(std::memory_order_relaxed);
+	int64_t top = _top.load(std::memory_order_acquire);
+	if (bottom - top >= THREAD_POOL_DEQUE_SIZE)
+		return false;
+	_slots[bottom & (THREAD_POOL_DEQUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	_bottom.store(bottom + 1, std::memory_order_relaxed);
+	return true;
+}
+
+// The owner takes the bottom; only for the last job can it race a thief,
+// and then the top decides.
+Job* ThreadPool::Deque::Pop() {
+	int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+	_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = _top.load(std::memory_order_relaxed);
+	if (top > bottom) {
+		_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = _slots[bottom & (THREAD_POOL_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+	if (top == bottom) {
+		if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+		_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job* ThreadPool::Deque::Steal() {
+	int64_t top = _top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t bottom = _bottom.load(std::memory_order_acquire);
+	if (top >= bottom)
+		return nullptr;
+
+	Job* job = _slots[top & (THREAD_POOL_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+	if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+	return job;
+}
+
+#pragma endregion
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::vector;
+
+#define THREAD_POOL_MAX_THREADS 64
+
+// Jobs a worker's deque holds, a power of two; a job pushed beyond that runs
+// in place.
+#define THREAD_POOL_DEQUE_SIZE 1024
+
+// Number of submitted jobs that have not finished; Wait returns at zero.
+class JobCounter {
+public:
+	bool IsDone() const { return _value.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class ThreadPool;
+	std::atomic<int> _value{ 0 };
+};
+
+// A unit of work the submitter owns until it has run, so the pool allocates
+// nothing per job: function(job) is called once on some thread, then the
+// counter, if any, is decremented.
+struct Job {
+	void (*function)(const Job& job) = nullptr;
+	void* context = nullptr;
+	size_t index = 0;
+	JobCounter* counter = nullptr;
+};
+
+// Work-stealing scheduler. Every thread of the pool has a deque of jobs: it
+// pushes and pops at the bottom, idle threads steal from the top of the
+// others'. Threads outside the pool submit through a shared queue. Idle
+// workers sleep until something is queued. The calling thread takes part in
+// every ParallelFor and Wait, so a pool of N threads runs N-1 workers, and
+// since a waiting thread runs other jobs meanwhile, jobs may ParallelFor and
+// Wait on the pool themselves.
+class ThreadPool {
+public:
+	ThreadPool(int threads = 0); // 0 = one per hardware thread
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Calls body(i) for every i in [0, count), spread dynamically over the pool.
+	void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+	int GetThreadCount() const { return (int)_workers.size() + 1; }
+
+	// The job must stay alive until its counter says it ran.
+	void Submit(Job& job);
+	void Wait(JobCounter& counter);
+	// 0 for the thread that made the pool, 1.. for workers, -1 elsewhere
+	int GetWorkerIndex() const;
+
+private:
+	// Chase-Lev deque over a fixed ring of job pointers
+	class Deque {
+	public:
+		bool Push(Job* job);
+		Job* Pop();
+		Job* Steal();
+
+	private:
+		alignas(64) std::atomic<int64_t> _top{ 0 };
+		alignas(64) std::atomic<int64_t> _bottom{ 0 };
+		std::atomic<Job*> _slots[THREAD_POOL_DEQUE_SIZE] = {};
+	};
+
+	vector<std::thread> _workers;
+	vector<std::unique_ptr<Deque>> _deques; // [0] belongs to the owner thread
+	std::thread::id _owner;
+	std::mutex _injectMutex;
+	std::deque<Job*> _injected;
+	std::atomic<int> _queued{ 0 };   // submitted and not yet taken
+	std::atomic<int> _sleeping{ 0 };
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	bool _quit = false;
+
+	void WorkerLoop(int index);
+	Job* FindJob(int index);
+	static void Execute(Job* job);
+};
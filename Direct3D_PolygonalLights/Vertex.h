@@ -0,0 +1,43 @@
+#pragma once
+
+// Vertex layout of the "Position, Color, Texture, Normal, Index" input layout.
+// index selects the object's transform in the vertex shader.
+struct Vertex {
+	float x;
+	float y;
+	float z;
+
+	float r;
+	float g;
+	float b;
+
+	float u;
+	float v;
+
+	float nx;
+	float ny;
+	float nz;
+
+	unsigned int index;
+};
+
+// Vertex layout of the packed input layout, 24 bytes against Vertex's 48:
+// the normal is octahedral encoded in two snorm16, the uv two halves and the
+// color RGBA8 (clamped to [0, 1]). There is no object index, packed vertices
+// always belong to object 0 of their draw (retained meshes), see VertexPacking.h.
+struct PackedVertex {
+	float x;
+	float y;
+	float z;
+
+	short nx;
+	short ny;
+
+	unsigned short u;
+	unsigned short v;
+
+	unsigned int color; // r in the low byte
+};
+
+static_assert(sizeof(Vertex) == 48, "Vertex no longer matches its input layout");
+static_assert(sizeof(PackedVertex) == 24, "PackedVertex no longer matches its input layout");
@@ -0,0 +1,168 @@
+#include "VertexPacking.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// vertices per ParallelFor item, and the smallest buffer worth spreading
+#define PACK_BLOCK 4096
+
+unsigned short FloatToHalf(float value) {
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	unsigned int sign = (bits >> 16) & 0x8000u;
+	unsigned int exponent = (bits >> 23) & 0xffu;
+	unsigned int mantissa = bits & 0x7fffffu;
+
+	if (exponent == 0xffu) // inf, nan keeps a mantissa bit
+		return (unsigned short)(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+
+	int halfExponent = (int)exponent - 127 + 15;
+	if (halfExponent >= 0x1f)
+		return (unsigned short)(sign | 0x7c00u);
+
+	if (halfExponent <= 0) {
+		// denormal or zero; the implicit bit joins the mantissa before the shift
+		if (halfExponent < -10)
+			return (unsigned short)sign;
+		mantissa |= 0x800000u;
+		unsigned int shift = (unsigned int)(14 - halfExponent);
+		unsigned int half = mantissa >> shift;
+		unsigned int rest = mantissa & ((1u << shift) - 1u);
+		unsigned int halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1u)))
+			half++;
+		return (unsigned short)(sign | half);
+	}
+
+	unsigned int half = ((unsigned int)halfExponent << 10) | (mantissa >> 13);
+	unsigned int rest = mantissa & 0x1fffu;
+	// a carry out of the mantissa correctly bumps the exponent
+	if (rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+		half++;
+	return (unsigned short)(sign | half);
+}
+
+float HalfToFloat(unsigned short half) {
+	unsigned int sign = (unsigned int)(half & 0x8000u) << 16;
+	unsigned int exponent = (half >> 10) & 0x1fu;
+	unsigned int mantissa = half & 0x3ffu;
+
+	unsigned int bits;
+	if (exponent == 0x1fu)
+		bits = sign | 0x7f800000u | (mantissa << 13);
+	else if (exponent != 0)
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	else if (mantissa == 0)
+		bits = sign;
+	else {
+		// denormal, normalize it
+		int e = -1;
+		do {
+			mantissa <<= 1;
+			e++;
+		} while (!(mantissa & 0x400u));
+		bits = sign | ((unsigned int)(127 - 15 - e) << 23) | ((mantissa & 0x3ffu) << 13);
+	}
+
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+// rounded half away from zero, like the D3D float to snorm conversion
+static short ToSnorm16(float value) {
+	value = std::max(-1.0f, std::min(1.0f, value)) * 32767.0f;
+	return (short)(value >= 0 ? value + 0.5f : value - 0.5f);
+}
+
+static float FromSnorm16(short value) {
+	return std::max(value / 32767.0f, -1.0f);
+}
+
+static float SignNotZero(float value) {
+	return value >= 0 ? 1.0f : -1.0f;
+}
+
+// The sphere projected on the octahedron |x| + |y| + |z| = 1, the lower half
+// folded over the diagonals of the upper one.
+void EncodeOctahedral(float x, float y, float z, short& u, short& v) {
+	float l1 = std::fabs(x) + std::fabs(y) + std::fabs(z);
+	if (l1 == 0) {
+		u = v = 0;
+		return;
+	}
+	float px = x / l1, py = y / l1;
+	if (z < 0) {
+		float fx = (1 - std::fabs(py)) * SignNotZero(px);
+		float fy = (1 - std::fabs(px)) * SignNotZero(py);
+		px = fx;
+		py = fy;
+	}
+	u = ToSnorm16(px);
+	v = ToSnorm16(py);
+}
+
+void DecodeOctahedral(short u, short v, float& x, float& y, float& z) {
+	x = FromSnorm16(u);
+	y = FromSnorm16(v);
+	z = 1 - std::fabs(x) - std::fabs(y);
+	if (z < 0) {
+		float fx = (1 - std::fabs(y)) * SignNotZero(x);
+		float fy = (1 - std::fabs(x)) * SignNotZero(y);
+		x = fx;
+		y = fy;
+	}
+	float length = std::sqrt(x * x + y * y + z * z);
+	x /= length;
+	y /= length;
+	z /= length;
+}
+
+static unsigned int ToUnorm8(float value) {
+	return (unsigned int)(std::max(0.0f, std::min(1.0f, value)) * 255.0f + 0.5f);
+}
+
+PackedVertex PackVertex(const Vertex& vertex) {
+	PackedVertex packed;
+	packed.x = vertex.x;
+	packed.y = vertex.y;
+	packed.z = vertex.z;
+	EncodeOctahedral(vertex.nx, vertex.ny, vertex.nz, packed.nx, packed.ny);
+	packed.u = FloatToHalf(vertex.u);
+	packed.v = FloatToHalf(vertex.v);
+	packed.color = ToUnorm8(vertex.r) | ToUnorm8(vertex.g) << 8 | ToUnorm8(vertex.b) << 16 | 0xff000000u;
+	return packed;
+}
+
+Vertex UnpackVertex(const PackedVertex& vertex) {
+	Vertex unpacked;
+	unpacked.x = vertex.x;
+	unpacked.y = vertex.y;
+	unpacked.z = vertex.z;
+	unpacked.r = (vertex.color & 0xffu) / 255.0f;
+	unpacked.g = (vertex.color >> 8 & 0xffu) / 255.0f;
+	unpacked.b = (vertex.color >> 16 & 0xffu) / 255.0f;
+	unpacked.u = HalfToFloat(vertex.u);
+	unpacked.v = HalfToFloat(vertex.v);
+	DecodeOctahedral(vertex.nx, vertex.ny, unpacked.nx, unpacked.ny, unpacked.nz);
+	unpacked.index = 0;
+	return unpacked;
+}
+
+static void PackRange(const Vertex* vertices, PackedVertex* packed, size_t count) {
+	for (size_t i = 0; i < count; i++)
+		packed[i] = PackVertex(vertices[i]);
+}
+
+void PackVertices(const vector<Vertex>& vertices, vector<PackedVertex>& packed, ThreadPool* pool) {
+	size_t count = vertices.size();
+	packed.resize(count);
+	if (!pool || count < 2 * PACK_BLOCK) {
+		PackRange(vertices.data(), packed.data(), count);
+		return;
+	}
+	pool->ParallelFor((count + PACK_BLOCK - 1) / PACK_BLOCK, [&](size_t block) {
+		size_t begin = block * PACK_BLOCK;
+		PackRange(&vertices[begin], &packed[begin], std::min(count - begin, (size_t)PACK_BLOCK));
+	});
+}
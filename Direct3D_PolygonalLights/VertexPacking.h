@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ThreadPool.h"
+#include "Vertex.h"
+#include <vector>
+
+using std::vector;
+
+// Conversion between Vertex and PackedVertex, shared by the renderers and the
+// headless checks. The decode side matches what the packed input layout and
+// VertexShaderPacked.hlsl do on the GPU.
+
+unsigned short FloatToHalf(float value); // round to nearest even
+float HalfToFloat(unsigned short half);
+
+// Unit normal to the octahedral square in snorm16, and back (normalized)
+void EncodeOctahedral(float x, float y, float z, short& u, short& v);
+void DecodeOctahedral(short u, short v, float& x, float& y, float& z);
+
+PackedVertex PackVertex(const Vertex& vertex);
+// object index 0
+Vertex UnpackVertex(const PackedVertex& vertex);
+
+// Packs a whole vertex buffer, e.g. the output of the Fill* functions, in
+// parallel when a pool is given and the buffer is large.
+void PackVertices(const vector<Vertex>& vertices, vector<PackedVertex>& packed, ThreadPool* pool = nullptr);
@@ -1,5 +1,3 @@
-static const int MAX_OBJECTS = 100;
-
 struct VSOut {
 	float4 position : SV_POSITION;
 	float4 worldPosition : Position;
@@ -9,21 +7,33 @@ struct VSOut {
 	unsigned int lightIndex : Index;
 };
 
-cbuffer CBuf {
-	matrix modelToWorld[MAX_OBJECTS];
+struct ObjectTransform {
+	matrix modelToWorld;
+	matrix normalTransform;
+};
+
+cbuffer CBuf : register(b0) {
 	matrix worldToView;
 	matrix projection;
-	matrix normalTransform[MAX_OBJECTS];
 	unsigned int objects;
 };
 
-VSOut main(float3 pos : Position, float3 col : Color, float2 uv : Texture, float3 normal : Normal, unsigned int index : Index)
+// per draw: retained meshes are stored with object index 0
+cbuffer DrawCBuf : register(b1) {
+	unsigned int objectBase;
+};
+
+StructuredBuffer<ObjectTransform> objectTransforms : register(t0);
+
+VSOut main(float3 pos : Position, float3 col : Color, float2 uv : Texture, float3 normal : Normal, unsigned int index : Index, unsigned int instance : SV_InstanceID)
 {
+	index += objectBase + instance;
+	ObjectTransform object = objectTransforms[index];
 	VSOut o;
-	o.worldPosition = mul(float4(pos, 1), modelToWorld[index]);
+	o.worldPosition = mul(float4(pos, 1), object.modelToWorld);
 	o.position = mul(o.worldPosition, worldToView);
 	o.position = mul(o.position, projection);
-	o.normal = mul(float4(normal, 1), normalTransform[index]).xyz;
+	o.normal = mul(float4(normal, 1), object.normalTransform).xyz;
 	o.color = col;
 	o.lightIndex = objects - index;
 	o.uv = uv;
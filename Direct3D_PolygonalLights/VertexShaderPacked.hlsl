@@ -0,0 +1,50 @@
+// VertexShader.hlsl for the packed input layout (PackedVertex): the input
+// assembler already expands the snorm normal, half uv and unorm color, only
+// the octahedral normal is decoded here. Keep the two in sync.
+struct VSOut {
+	float4 position : SV_POSITION;
+	float4 worldPosition : Position;
+	float3 color : Color;
+	float2 uv : Texture;
+	float3 normal : Normal;
+	unsigned int lightIndex : Index;
+};
+
+struct ObjectTransform {
+	matrix modelToWorld;
+	matrix normalTransform;
+};
+
+cbuffer CBuf : register(b0) {
+	matrix worldToView;
+	matrix projection;
+	unsigned int objects;
+};
+
+cbuffer DrawCBuf : register(b1) {
+	unsigned int objectBase;
+};
+
+StructuredBuffer<ObjectTransform> objectTransforms : register(t0);
+
+float3 DecodeOctahedral(float2 e) {
+	float3 n = float3(e, 1 - abs(e.x) - abs(e.y));
+	if (n.z < 0)
+		n.xy = (1 - abs(n.yx)) * (n.xy >= 0 ? 1.0 : -1.0);
+	return normalize(n);
+}
+
+VSOut main(float3 pos : Position, float4 col : Color, float2 uv : Texture, float2 normal : Normal, unsigned int instance : SV_InstanceID)
+{
+	unsigned int index = objectBase + instance;
+	ObjectTransform object = objectTransforms[index];
+	VSOut o;
+	o.worldPosition = mul(float4(pos, 1), object.modelToWorld);
+	o.position = mul(o.worldPosition, worldToView);
+	o.position = mul(o.position, projection);
+	o.normal = mul(float4(DecodeOctahedral(normal), 1), object.normalTransform).xyz;
+	o.color = col.rgb;
+	o.lightIndex = objects - index;
+	o.uv = uv;
+	return o;
+}
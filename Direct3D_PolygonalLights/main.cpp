@@ -1,53 +1,32 @@
 #include "Window.h"
 #include "Graphics.h"
+#include "Camera.h"
+#include "CameraPath.h"
+#include "InputLog.h"
 #include <Windows.h>
+#include <shellapi.h>
+#include <string>
 
 #define WIDTH 800
 #define HEIGHT 600
 
+// P starts a capture, P again writes it here, for chrome://tracing
+#define PROFILE_PATH "./profile.json"
 
-class Keyboard {
-private:
-	static bool keys[255];
-public:
-	static void PressKey(char key) { keys[key] = true; }
-	static void ReleaseKey(char key) { keys[key] = false; }
-	static bool IsPressed(char key) { return keys[key]; }
-};
-
-bool Keyboard::keys[255];
-
-
-struct Camera {
-	dx::XMFLOAT3 Position = { -4, 1, -4 };
-	dx::XMFLOAT3 Rotation = { 0, 0, 0 };
-
-	void Update() {
-		dx::XMFLOAT3 cameraMove = { 0, 0, 0 };
-		if (Keyboard::IsPressed('W')) cameraMove.z += 0.1f;
-		if (Keyboard::IsPressed('A')) cameraMove.x -= 0.1f;
-		if (Keyboard::IsPressed('S')) cameraMove.z -= 0.1f;
-		if (Keyboard::IsPressed('D')) cameraMove.x += 0.1f;
-		if (Keyboard::IsPressed('F')) cameraMove.y -= 0.1f;
-		if (Keyboard::IsPressed('R')) cameraMove.y += 0.1f;
-		if (Keyboard::IsPressed('I')) Rotation.x -= 0.01f;
-		if (Keyboard::IsPressed('K')) Rotation.x += 0.01f;
-		if (Keyboard::IsPressed('J')) Rotation.y -= 0.01f;
-		if (Keyboard::IsPressed('L')) Rotation.y += 0.01f;
-
-		dx::XMMATRIX translation = dx::XMMatrixTranslation(cameraMove.x, cameraMove.y, cameraMove.z);
-		dx::XMMATRIX rotation = dx::XMMatrixRotationRollPitchYaw(Rotation.x, Rotation.y, Rotation.z);
-		dx::XMVECTOR movement = dx::XMVector3Transform(
-			dx::XMLoadFloat3(&cameraMove),
-			translation * rotation
-		);
-
-		dx::XMStoreFloat3(&cameraMove, movement);
-		Position.x += cameraMove.x;
-		Position.y += cameraMove.y;
-		Position.z += cameraMove.z;
-	}
-};
+// C starts recording the camera and light path, C again writes it here for
+// Headless scene-bench --path, one key per frame at the vsync rate
+#define CAMERA_PATH_PATH "./camera.path"
+#define CAMERA_PATH_TIMESTEP (1.0f / 60.0f)
+
+// F9 starts recording keys and rect light changes, F9 again writes them here.
+// "--replay FILE" plays such a log back without vsync and quits at its end.
+#define INPUT_LOG_PATH "./input.log"
+
+// Rect lights under these solid angles are shaded from their disk, the
+// thresholds LTC::FitRectLightLod gives ltc_mat.dds for 1% error (Headless
+// rect-lod-bench --max-error 0.01); diffuse, then specular in LTC space
+#define RECT_LOD_DIFFUSE 0.001642f
+#define RECT_LOD_SPECULAR 0.003906f
 
 
 LRESULT CALLBACK window_callback(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
@@ -71,13 +50,37 @@ int WINAPI wWinMain(
 	_In_ int nCmdShow
 ) {
 	UNREFERENCED_PARAMETER(hPrevInstance);
-	UNREFERENCED_PARAMETER(lpCmdLine);
+	UNREFERENCED_PARAMETER(lpCmdLine); // parsed from GetCommandLineW, quotes and all
 
 	try {
+		Profiler::SetThreadName("main");
 		Window wnd(hInstance, nCmdShow, WIDTH, HEIGHT, window_callback);
 		Graphics gr(wnd.GetHandle(), WIDTH, HEIGHT);
+		gr.SetRectLightLod({ RECT_LOD_DIFFUSE, RECT_LOD_SPECULAR });
 		Camera camera;
 
+		InputLog replayLog;
+		std::wstring replayFile;
+		int argc = 0;
+		if (LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc)) {
+			for (int i = 1; i + 1 < argc; i++)
+				if (wcscmp(argv[i], L"--replay") == 0)
+					replayFile = argv[i + 1];
+			LocalFree(argv);
+		}
+		if (!replayFile.empty()) {
+			char path[MAX_PATH] = {};
+			WideCharToMultiByte(CP_ACP, 0, replayFile.c_str(), -1, path, MAX_PATH, nullptr, nullptr);
+			if (!replayLog.Load(path)) {
+				std::wstring message = L"Cannot read the input log " + replayFile;
+				MessageBoxW(wnd.GetHandle(), message.c_str(), L"--replay", MB_OK | MB_ICONERROR);
+				return -1;
+			}
+			gr.SetVSync(false);
+		}
+		InputReplay replay(replayLog);
+		bool replaying = replayLog.GetFrameCount() > 0;
+
 		// LIGHTS
 		{
 			/*/
@@ -122,40 +125,156 @@ int WINAPI wWinMain(
 				0.0, 0.5	   // rotationX, rotationY
 			);
 			//*/
+
+			/*/
+			dx::XMFLOAT3 hexagon[6];
+			for (int i = 0; i < 6; i++)
+				hexagon[i] = { -4 + cosf(i * dx::XM_PI / 3), 1.5f + sinf(i * dx::XM_PI / 3), 6 };
+			gr.AddPolygonLight(
+				hexagon, 6,    // vertices, convex
+				{ 1, 0.5, 0 }, // color
+				4			   // intensity
+			);
+			//*/
+
+			/*/
+			gr.AddDiskLight(
+				{ 0, 2, 6 },   // position
+				{ 0, -1, 0 },  // normal
+				0.5f,          // radius
+				{ 1, 1, 0.8 }, // color
+				4			   // intensity
+			);
+			gr.AddSphereLight(
+				{ 2, 1, 4 },   // position
+				0.25f,         // radius
+				{ 0.8, 1, 1 }, // color
+				4			   // intensity
+			);
+			//*/
 		}
 
+		// MESHES
+		MeshHandle floorMesh, cubeMesh, modelMesh;
+		{
+			vector<Vertex> vBuffer;
+			vector<unsigned int> iBuffer;
+			AppendFloor(vBuffer, iBuffer, 0);
+			floorMesh = gr.RegisterMesh(vBuffer, iBuffer);
+
+			vBuffer.clear();
+			iBuffer.clear();
+			AppendCube(vBuffer, iBuffer, 0);
+			cubeMesh = gr.RegisterMesh(vBuffer, iBuffer);
+
+			// optional model next to the executable, imported once into sponza.obj.mesh
+			ImportedMesh model;
+			if (model.Open("./sponza.obj", gr.GetThreadPool()))
+				modelMesh = gr.RegisterMesh(model);
+		}
+		dx::XMMATRIX modelTransform = dx::XMMatrixScaling(0.01f, 0.01f, 0.01f);
+
 		dx::XMFLOAT3 cubeLocation = { 0, 0, 4 };
 		dx::XMFLOAT3 cubeRotation = { 0, 0, 0 };
 		dx::XMMATRIX cubeTransform = dx::XMMatrixIdentity();
 
+		// UPDATE JOBS, on the renderer's pool; Draw runs its own graph after
+		FrameGraph update;
+		update.Add("camera", [&] {
+			camera.Update();
+		});
+		update.Add("lights", [&] {
+			if (replaying)
+				return;
+			//gr.GetRectLight(0)->Params.w += 0.001;
+			gr.GetRectLight(0)->Params.z += 0.001;
+		});
+		update.Add("objects", [&] {
+			cubeRotation.y += 0.01;
+			cubeTransform =
+				dx::XMMatrixRotationRollPitchYaw(cubeRotation.x, cubeRotation.y, cubeRotation.z)
+				* dx::XMMatrixTranslation(cubeLocation.x, cubeLocation.y, cubeLocation.z);
+		});
+
+		bool profileKey = false;
+		bool pathKey = false;
+		bool recordingPath = false;
+		CameraPath path;
+		bool inputKey = false;
+		bool recordingInput = false;
+		InputLog inputLog;
 		while (true) {
+			PROFILE_ZONE("frame");
 
 			if (auto wParam = wnd.PollEvents())
 				return (int)wParam.value();
-			
+
+			// the log's keys replace the live ones, its lights what "lights" does
+			if (replaying) {
+				bool keys[KEYBOARD_KEYS];
+				if (!replay.NextFrame(keys, [&](int index, Float4 params) {
+					if (index < (int)gr.GetRectLights().size())
+						gr.GetRectLight(index)->Params = params;
+				}))
+					return 0;
+				Keyboard::SetKeys(keys);
+			}
+			else {
+				if (Keyboard::IsPressed(VK_F9) && !inputKey) {
+					if (recordingInput)
+						inputLog.Save(INPUT_LOG_PATH);
+					inputLog.Clear();
+					recordingInput = !recordingInput;
+				}
+				inputKey = Keyboard::IsPressed(VK_F9);
+			}
+
+			if (Keyboard::IsPressed('P') && !profileKey) {
+				if (Profiler::IsEnabled())
+					Profiler::WriteChromeTrace(PROFILE_PATH);
+				else
+					Profiler::Clear();
+				Profiler::SetEnabled(!Profiler::IsEnabled());
+			}
+			profileKey = Keyboard::IsPressed('P');
+
+			if (Keyboard::IsPressed('C') && !pathKey) {
+				if (recordingPath)
+					path.Save(CAMERA_PATH_PATH);
+				path.Clear();
+				recordingPath = !recordingPath;
+			}
+			pathKey = Keyboard::IsPressed('C');
+
 			// Update
 			{
-				camera.Update();
-				//gr.GetRectLight(0)->Params.w += 0.001;
-				gr.GetRectLight(0)->Params.z += 0.001;
-				cubeRotation.y += 0.01;
-				cubeTransform =
-					dx::XMMatrixRotationRollPitchYaw(cubeRotation.x, cubeRotation.y, cubeRotation.z)
-					* dx::XMMatrixTranslation(cubeLocation.x, cubeLocation.y, cubeLocation.z);
+				PROFILE_ZONE("update");
+				update.Run(gr.GetThreadPool());
 			}
+			if (recordingPath) {
+				const RectLight& light = gr.GetRectLights()[0];
+				path.AddKey({
+					path.GetKeyCount() * CAMERA_PATH_TIMESTEP,
+					camera.Position,
+					camera.Rotation,
+					{ light.Params.z, light.Params.w }
+				});
+			}
+			if (recordingInput)
+				inputLog.RecordFrame(Keyboard::GetKeys(), gr.GetRectLights().data(), gr.GetRectLights().size());
 
 			// Render
 			{
+				PROFILE_ZONE("render");
 				gr.Clear(DirectX::Colors::Gray);
 
-				vector<Vertex> vBuffer;
-				vector<unsigned short> iBuffer;
-				gr.FillFloor(vBuffer, iBuffer, dx::XMMatrixIdentity());
-				gr.FillCube(vBuffer, iBuffer, cubeTransform);
-				gr.DrawTriangles(vBuffer, iBuffer, camera.Position, camera.Rotation);
-
-				vBuffer.clear();
-				iBuffer.clear();
+				gr.DrawMesh(floorMesh, dx::XMMatrixIdentity());
+				gr.DrawMesh(cubeMesh, cubeTransform);
+				if (modelMesh.IsValid())
+					gr.DrawMesh(modelMesh, modelTransform);
+				gr.Draw(
+					{ camera.Position.x, camera.Position.y, camera.Position.z },
+					{ camera.Rotation.x, camera.Rotation.y, camera.Rotation.z });
 				gr.SwapBuffers();
 			}
 		}
@@ -0,0 +1,2878 @@
+#include "Bvh.h"
+#include "Camera.h"
+#include "CameraPath.h"
+#include "ClusterGrid.h"
+#include "DDSFile.h"
+#include "FrameGraph.h"
+#include "LTC.h"
+#include "LTCFit.h"
+#include "LightStore.h"
+#include "InputLog.h"
+#include "InstanceBuffer.h"
+#include "LightTexture.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "MeshImport.h"
+#include "MipStreamer.h"
+#include "ObjectLights.h"
+#include "PathTracer.h"
+#include "Profiler.h"
+#include "RenderDevice.h"
+#include "Shading.h"
+#include "Simd.h"
+#include "SoftwareGraphics.h"
+#include "TextureCache.h"
+#include "VertexPacking.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <psapi.h>
+#endif
+
+// Console entry point for everything that has to run without a window or a
+// GPU: CPU reference code, offline tools and benchmarks.
+//
+//   Headless <command> [--option value ...] [--profile FILE.json]
+//
+// --profile records the command's profiler zones as a Chrome trace.
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double SecondsSince(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static const char* GetOption(int argc, char** argv, const char* name, const char* fallback) {
+	for (int i = 2; i + 1 < argc; i++)
+		if (strcmp(argv[i], name) == 0)
+			return argv[i + 1];
+	return fallback;
+}
+
+static int GetIntOption(int argc, char** argv, const char* name, int fallback) {
+	const char* value = GetOption(argc, argv, name, nullptr);
+	return value ? atoi(value) : fallback;
+}
+
+// Peak resident set and the current private (anonymous) bytes of this process.
+static void GetMemoryUsage(size_t& peakResident, size_t& privateBytes) {
+	peakResident = 0;
+	privateBytes = 0;
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS_EX counters = {};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&counters, sizeof(counters))) {
+		peakResident = counters.PeakWorkingSetSize;
+		privateBytes = counters.PrivateUsage;
+	}
+#else
+	FILE* status = fopen("/proc/self/status", "r");
+	if (!status)
+		return;
+
+	char line[256];
+	unsigned long kb;
+	while (fgets(line, sizeof(line), status)) {
+		if (sscanf(line, "VmHWM: %lu kB", &kb) == 1)
+			peakResident = kb * 1024;
+		else if (sscanf(line, "RssAnon: %lu kB", &kb) == 1)
+			privateBytes = kb * 1024;
+	}
+	fclose(status);
+#endif
+}
+
+static std::string LutPath(int argc, char** argv, const char* file) {
+	std::string dir = GetOption(argc, argv, "--lut-dir", "../Direct3D_PolygonalLights/");
+	if (!dir.empty() && dir.back() != '/' && dir.back() != '\\')
+		dir += '/';
+	return dir + file;
+}
+
+// The rect light from wWinMain plus random ones scattered above the floor.
+static vector<RectLight> MakeRectLights(int count, std::mt19937& rng) {
+	std::uniform_real_distribution<float> pos(-8.0f, 8.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	vector<RectLight> lights;
+	lights.push_back({ { 4, 0.3f, 5, 1 }, { 1, 1, 0.0f, 0.5f }, { 1, 1, 1, 4 } });
+	while ((int)lights.size() < count) {
+		lights.push_back({
+			{ pos(rng), 0.5f + 3 * unit(rng), pos(rng), 1 },
+			{ 0.25f + unit(rng), 0.25f + unit(rng), unit(rng), unit(rng) },
+			{ unit(rng), unit(rng), unit(rng), 1 + 4 * unit(rng) }
+		});
+	}
+	return lights;
+}
+
+// Many small lights over a 200 x 200 area, split 40/30/30 between point,
+// spot and rect lights.
+static void MakeLightField(int count, std::mt19937& rng, vector<PointLight>& points, vector<SpotLight>& spots, vector<RectLight>& rects) {
+	std::uniform_real_distribution<float> pos(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	for (int i = 0; i < count; i++) {
+		Float4 position = { pos(rng), -0.5f + 6 * unit(rng), pos(rng) + 60.0f, 1 };
+		Float4 color = { unit(rng), unit(rng), unit(rng), 0.002f + 0.02f * unit(rng) };
+		float kind = unit(rng);
+		if (kind < 0.4f)
+			points.push_back({ position, color, { 0, 0, 0, 0 } });
+		else if (kind < 0.7f)
+			spots.push_back({ position, { unit(rng) - 0.5f, -1, unit(rng) - 0.5f, 1 }, color, { 0.7f, 0.75f, 0, 0 }, { 0, 0, 0, 0 } });
+		else
+			rects.push_back({ position, { 0.1f + 0.4f * unit(rng), 0.1f + 0.4f * unit(rng), unit(rng), unit(rng) }, color });
+	}
+}
+
+// Points on the floor and the cube, seen from random camera positions.
+static void MakeShadingPoints(ShadingPoints& points, size_t count, std::mt19937& rng) {
+	std::uniform_real_distribution<float> pos(-10.0f, 10.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const Float3 normals[] = { { 0, 1, 0 }, { 0, 0, -1 }, { 1, 0, 0 }, { -1, 0, 0 } };
+
+	points.Resize(count);
+	for (size_t i = 0; i < count; i++) {
+		Float3 normal = normals[i % 4];
+		Float3 position = (i % 4 == 0)
+			? Float3{ pos(rng), -1.0f, pos(rng) }
+			: Float3{ 2 * unit(rng) - 1, 2 * unit(rng) - 1, 4 + 2 * unit(rng) - 1 } + normal;
+		Float3 camera = { pos(rng), 0.5f + 4 * unit(rng), pos(rng) - 10.0f };
+		Float3 viewDir = Normalize(camera - position);
+		if (Dot(viewDir, normal) < 0.05f)
+			viewDir = Normalize(viewDir + normal);
+		points.Set(i, position, normal, viewDir, { unit(rng), unit(rng), unit(rng) });
+	}
+}
+
+// Commands
+//========================================
+
+static int RunLTCBench(int argc, char** argv) {
+	size_t pointCount = (size_t)GetIntOption(argc, argv, "--points", 1 << 16);
+	int lightCount = GetIntOption(argc, argv, "--lights", 4);
+	int iterations = GetIntOption(argc, argv, "--iterations", 10);
+
+	LTC ltc(LutPath(argc, argv, "ltc_mat.dds").c_str(), LutPath(argc, argv, "ltc_amp.dds").c_str());
+
+	std::mt19937 rng(1234);
+	vector<RectLight> lights = MakeRectLights(lightCount, rng);
+	ShadingPoints points;
+	MakeShadingPoints(points, pointCount, rng);
+
+	// scalar port of the shader, one point at a time
+	vector<Float3> reference(pointCount);
+	Clock::time_point start = Clock::now();
+	for (size_t i = 0; i < pointCount; i++) {
+		Float3 normal = { points.nx[i], points.ny[i], points.nz[i] };
+		Float3 position = { points.px[i], points.py[i], points.pz[i] };
+		Float3 viewDir = { points.vx[i], points.vy[i], points.vz[i] };
+		Float3 color = { points.r[i], points.g[i], points.b[i] };
+		Float3 sum = { 0, 0, 0 };
+		for (const RectLight& light : lights)
+			sum += ltc.CalcRectLight(light, normal, position, color, viewDir);
+		reference[i] = sum;
+	}
+	double scalarTime = SecondsSince(start);
+
+	start = Clock::now();
+	for (int it = 0; it < iterations; it++) {
+		points.ClearResults();
+		ltc.CalcRectLights(lights.data(), lightCount, points);
+	}
+	double batchTime = SecondsSince(start) / iterations;
+
+	double maxAbsError = 0.0, maxRelError = 0.0;
+	for (size_t i = 0; i < pointCount; i++) {
+		Float3 result = points.GetResult(i);
+		const float got[3] = { result.x, result.y, result.z };
+		const float want[3] = { reference[i].x, reference[i].y, reference[i].z };
+		for (int c = 0; c < 3; c++) {
+			double error = std::fabs((double)got[c] - want[c]);
+			maxAbsError = std::max(maxAbsError, error);
+			maxRelError = std::max(maxRelError, error / std::max(std::fabs((double)want[c]), 1e-2));
+		}
+	}
+
+	printf("ltc: %zu points x %d rect lights, simd width %d\n", pointCount, lightCount, LTC::BatchWidth());
+	printf("  scalar port: %10.3f Mpoints/s per core\n", pointCount / scalarTime * 1e-6);
+	printf("  batch:       %10.3f Mpoints/s per core (%.2fx)\n", pointCount / batchTime * 1e-6, scalarTime / batchTime);
+	printf("  parity:      max abs error %.3g, max rel error %.3g\n", maxAbsError, maxRelError);
+	return 0;
+}
+
+// Regular polygons of the given vertex count, randomly placed and turned,
+// appended to vertices the way LightStore packs them.
+static vector<PolygonLight> MakePolygonLights(int count, int vertexCount, std::mt19937& rng, vector<Float4>& vertices) {
+	std::uniform_real_distribution<float> pos(-8.0f, 8.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	vector<PolygonLight> lights(count);
+	for (PolygonLight& light : lights) {
+		Float3 center = { pos(rng), 0.5f + 3 * unit(rng), pos(rng) };
+		Float3 normal = Normalize(Float3{ unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f });
+		Float3 u = Normalize(Cross(normal, std::fabs(normal.y) < 0.9f ? Float3{ 0, 1, 0 } : Float3{ 1, 0, 0 }));
+		Float3 v = Cross(normal, u);
+		float radius = 0.3f + 0.7f * unit(rng);
+		float turn = unit(rng) * 2 * PI;
+
+		light.Color = { unit(rng), unit(rng), unit(rng), 1 + 4 * unit(rng) };
+		light.Vertices[0] = (uint32_t)vertexCount;
+		light.Vertices[1] = (uint32_t)vertices.size();
+		for (int i = 0; i < vertexCount; i++) {
+			float a = turn + i * 2 * PI / vertexCount;
+			Float3 p = center + radius * std::cos(a) * u + radius * std::sin(a) * v;
+			vertices.push_back({ p.x, p.y, p.z, 1 });
+		}
+		BoundPolygonLight(light, &vertices[light.Vertices[1]]);
+	}
+	return lights;
+}
+
+// Cost of CalcPolygonLight per shading point over vertex counts, against
+// CalcRectLight. Checks that an unturned rect light shades the same as a
+// polygon, and that a polygon shades the same as the fan of triangles it
+// splits into, both of which only hold with the clipper right.
+static int RunPolygonLightBench(int argc, char** argv) {
+	size_t pointCount = (size_t)GetIntOption(argc, argv, "--points", 1 << 14);
+	int lightCount = GetIntOption(argc, argv, "--lights", 4);
+	int maxVertices = std::min(GetIntOption(argc, argv, "--max-vertices", POLYGON_LIGHT_MAX_VERTICES), POLYGON_LIGHT_MAX_VERTICES);
+
+	LTC ltc(LutPath(argc, argv, "ltc_mat.dds").c_str(), LutPath(argc, argv, "ltc_amp.dds").c_str());
+
+	std::mt19937 rng(1234);
+	ShadingPoints points;
+	MakeShadingPoints(points, pointCount, rng);
+	auto shade = [&](size_t i, const std::function<Float3(Float3, Float3, Float3, Float3)>& light) {
+		Float3 normal = { points.nx[i], points.ny[i], points.nz[i] };
+		Float3 position = { points.px[i], points.py[i], points.pz[i] };
+		Float3 viewDir = { points.vx[i], points.vy[i], points.vz[i] };
+		Float3 color = { points.r[i], points.g[i], points.b[i] };
+		return light(normal, position, color, viewDir);
+	};
+	double maxRelError = 0.0;
+	auto compare = [&maxRelError](Float3 got, Float3 want) {
+		const float g[3] = { got.x, got.y, got.z };
+		const float w[3] = { want.x, want.y, want.z };
+		double worst = 0.0;
+		for (int c = 0; c < 3; c++)
+			worst = std::max(worst, std::fabs((double)g[c] - w[c]) / std::max(std::fabs((double)w[c]), 1e-2));
+		maxRelError = std::max(maxRelError, worst);
+	};
+
+	printf("polygon lights: %zu points x %d lights\n", pointCount, lightCount);
+
+	// rect lights as the baseline, and unturned ones as 4-gons for parity
+	vector<RectLight> rects = MakeRectLights(lightCount, rng);
+	Clock::time_point start = Clock::now();
+	Float3 checksum = { 0, 0, 0 };
+	for (size_t i = 0; i < pointCount; i++)
+		for (const RectLight& light : rects)
+			checksum += shade(i, [&](Float3 n, Float3 p, Float3 c, Float3 v) { return ltc.CalcRectLight(light, n, p, c, v, 0.25f, 0.0f); });
+	double rectTime = SecondsSince(start) * 1e9 / (pointCount * lightCount);
+	printf("  rect (4, switch clip): %7.1f ns per point and light\n", rectTime);
+
+	vector<Float4> quadVertices;
+	vector<PolygonLight> quads;
+	for (RectLight& rect : rects) {
+		rect.Params.z = rect.Params.w = 0.0f;
+		Float3 center = XYZ(rect.Position);
+		Float3 ex = { rect.Params.x, 0, 0 }, ey = { 0, rect.Params.y, 0 };
+		for (Float3 corner : { center - ex - ey, center + ex - ey, center + ex + ey, center - ex + ey })
+			quadVertices.push_back({ corner.x, corner.y, corner.z, 1 });
+		quads.push_back({ rect.Color, {}, { 4, (uint32_t)quadVertices.size() - 4 } });
+	}
+	for (size_t i = 0; i < pointCount; i++)
+		for (int l = 0; l < lightCount; l++)
+			compare(
+				shade(i, [&](Float3 n, Float3 p, Float3 c, Float3 v) { return ltc.CalcPolygonLight(quads[l], quadVertices.data(), n, p, c, v); }),
+				shade(i, [&](Float3 n, Float3 p, Float3 c, Float3 v) { return ltc.CalcRectLight(rects[l], n, p, c, v, 0.25f, 0.0f); }));
+	double rectError = maxRelError;
+
+	maxRelError = 0.0;
+	for (int vertexCount = 3; vertexCount <= maxVertices; vertexCount++) {
+		// same places for every count, so only the vertices differ
+		std::mt19937 placement(5678);
+		vector<Float4> vertices;
+		vector<PolygonLight> lights = MakePolygonLights(lightCount, vertexCount, placement, vertices);
+
+		start = Clock::now();
+		for (size_t i = 0; i < pointCount; i++)
+			for (const PolygonLight& light : lights)
+				checksum += shade(i, [&](Float3 n, Float3 p, Float3 c, Float3 v) { return ltc.CalcPolygonLight(light, vertices.data(), n, p, c, v); });
+		double time = SecondsSince(start) * 1e9 / (pointCount * lightCount);
+		printf("  polygon %d:             %7.1f ns per point and light (%.2fx rect)\n", vertexCount, time, time / rectTime);
+
+		// fan of triangles around vertex 0, on every 16th point
+		for (const PolygonLight& light : lights) {
+			for (size_t i = 0; i < pointCount; i += 16) {
+				Float3 fan = { 0, 0, 0 };
+				for (int t = 1; t + 1 < vertexCount; t++) {
+					uint32_t first = light.Vertices[1];
+					const Float4 triangle[3] = { vertices[first], vertices[first + t], vertices[first + t + 1] };
+					PolygonLight part = { light.Color, light.Bounds, { 3, 0 } };
+					fan += shade(i, [&](Float3 n, Float3 p, Float3 c, Float3 v) { return ltc.CalcPolygonLight(part, triangle, n, p, c, v); });
+				}
+				compare(fan, shade(i, [&](Float3 n, Float3 p, Float3 c, Float3 v) { return ltc.CalcPolygonLight(light, vertices.data(), n, p, c, v); }));
+			}
+		}
+	}
+
+	printf("  parity: 4-gon vs rect max rel error %.3g, polygon vs triangle fan %.3g (checksum %.3g)\n",
+		rectError, maxRelError, checksum.x + checksum.y + checksum.z);
+	if (rectError > 1e-3 || maxRelError > 1e-2) {
+		printf("FAILED: polygon shading does not match\n");
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
+
+// Form factors by midpoint quadrature, to check the round lights against:
+// over the two-sided disk's area, and over the directions of the sphere's cone.
+static double DiskFormFactor(Float3 center, Float3 normal, float radius, Float3 position, Float3 surfaceNormal) {
+	const int rings = 96, segments = 96;
+	Float3 up = std::fabs(normal.y) < 0.999f ? Float3{ 0, 1, 0 } : Float3{ 1, 0, 0 };
+	Float3 axisX = Normalize(Cross(up, normal));
+	Float3 axisY = Cross(normal, axisX);
+	double area = PI * radius * radius / (rings * segments);
+	double sum = 0.0;
+	for (int i = 0; i < rings; i++) {
+		float r = radius * std::sqrt((i + 0.5f) / rings);
+		for (int j = 0; j < segments; j++) {
+			float a = 2 * PI * (j + 0.5f) / segments;
+			Float3 d = center + axisX * (r * std::cos(a)) + axisY * (r * std::sin(a)) - position;
+			double distanceSq = Dot(d, d);
+			double distance = std::sqrt(distanceSq);
+			double cosSurface = std::max(Dot(surfaceNormal, d) / distance, 0.0);
+			double cosLight = std::fabs(Dot(normal, d)) / distance;
+			sum += cosSurface * cosLight / distanceSq * area;
+		}
+	}
+	return sum / PI;
+}
+
+static double SphereFormFactor(Float3 center, float radius, Float3 position, Float3 surfaceNormal) {
+	const int rings = 96, segments = 96;
+	Float3 axis = center - position;
+	float distance = Length(axis);
+	axis = axis / distance;
+	Float3 up = std::fabs(axis.y) < 0.999f ? Float3{ 0, 1, 0 } : Float3{ 1, 0, 0 };
+	Float3 axisX = Normalize(Cross(up, axis));
+	Float3 axisY = Cross(axis, axisX);
+	double cosCone = std::sqrt(1.0 - (double)radius * radius / ((double)distance * distance));
+	double solidAngle = 2 * PI * (1.0 - cosCone) / (rings * segments);
+	double sum = 0.0;
+	for (int i = 0; i < rings; i++) {
+		double cosA = 1.0 - (1.0 - cosCone) * (i + 0.5) / rings;
+		double sinA = std::sqrt(1.0 - cosA * cosA);
+		for (int j = 0; j < segments; j++) {
+			double b = 2 * PI * (j + 0.5) / segments;
+			Float3 direction = axis * (float)cosA + axisX * (float)(sinA * std::cos(b)) + axisY * (float)(sinA * std::sin(b));
+			sum += std::max((double)Dot(surfaceNormal, direction), 0.0) * solidAngle;
+		}
+	}
+	return sum / PI;
+}
+
+// Cost of disk and sphere lights per shading point against CalcRectLight and
+// a point light. Their diffuse term is checked against quadrature with LTC
+// tables that leave only diffuse; the full shading of a disk against a
+// 256-gon of triangles. Clipped lights are approximated, so those errors are
+// reported apart from the ones fully above the horizon.
+static int RunRoundLightBench(int argc, char** argv) {
+	size_t pointCount = (size_t)GetIntOption(argc, argv, "--points", 1 << 14);
+	int lightCount = GetIntOption(argc, argv, "--lights", 4);
+	int checkPoints = GetIntOption(argc, argv, "--check-points", 512);
+
+	LTC ltc(LutPath(argc, argv, "ltc_mat.dds").c_str(), LutPath(argc, argv, "ltc_amp.dds").c_str());
+	// Minv = identity and no specular: the result is 1.5 * form factor
+	LTC diffuseOnly(2, vector<Float4>(4, { 1, 0, 1, 0 }), vector<Float4>(4, { 0, 0, 0, 0 }));
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> pos(-8.0f, 8.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	ShadingPoints points;
+	MakeShadingPoints(points, pointCount, rng);
+	vector<RectLight> rects = MakeRectLights(lightCount, rng);
+	vector<DiskLight> disks(lightCount);
+	vector<SphereLight> spheres(lightCount);
+	vector<PointLight> pointLights(lightCount);
+	for (int l = 0; l < lightCount; l++) {
+		Float4 position = { pos(rng), 0.5f + 3 * unit(rng), pos(rng), 1 };
+		Float3 normal = Normalize(Float3{ unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f });
+		Float4 color = { unit(rng), unit(rng), unit(rng), 1 + 4 * unit(rng) };
+		float radius = 0.25f + unit(rng);
+		disks[l] = { position, { normal.x, normal.y, normal.z, radius }, color, {} };
+		spheres[l] = { { position.x, position.y, position.z, 0.5f * radius }, color, {} };
+		pointLights[l] = { position, color, {} };
+	}
+
+	auto pointAt = [&](size_t i, Float3& normal, Float3& position, Float3& viewDir, Float3& color) {
+		normal = { points.nx[i], points.ny[i], points.nz[i] };
+		position = { points.px[i], points.py[i], points.pz[i] };
+		viewDir = { points.vx[i], points.vy[i], points.vz[i] };
+		color = { points.r[i], points.g[i], points.b[i] };
+	};
+	Float3 checksum = { 0, 0, 0 };
+	auto time = [&](auto&& shade) {
+		Clock::time_point start = Clock::now();
+		for (size_t i = 0; i < pointCount; i++) {
+			Float3 normal, position, viewDir, color;
+			pointAt(i, normal, position, viewDir, color);
+			for (int l = 0; l < lightCount; l++)
+				checksum += shade(l, normal, position, color, viewDir);
+		}
+		return SecondsSince(start) * 1e9 / (pointCount * lightCount);
+	};
+
+	double rectTime = time([&](int l, Float3 n, Float3 p, Float3 c, Float3 v) { return ltc.CalcRectLight(rects[l], n, p, c, v, 0.25f, 0.0f); });
+	double diskTime = time([&](int l, Float3 n, Float3 p, Float3 c, Float3 v) { return ltc.CalcDiskLight(disks[l], n, p, c, v); });
+	double sphereTime = time([&](int l, Float3 n, Float3 p, Float3 c, Float3 v) { return ltc.CalcSphereLight(spheres[l], n, p, c, v); });
+	double pointTime = time([&](int l, Float3 n, Float3 p, Float3 c, Float3 v) { return CalcPointLight(pointLights[l], n, p, c, v, 1.0f, 64, 0.0f); });
+
+	printf("round lights: %zu points x %d lights\n", pointCount, lightCount);
+	printf("  rect:   %7.1f ns per point and light\n", rectTime);
+	printf("  disk:   %7.1f ns per point and light (%.2fx rect)\n", diskTime, diskTime / rectTime);
+	printf("  sphere: %7.1f ns per point and light (%.2fx rect)\n", sphereTime, sphereTime / rectTime);
+	printf("  point:  %7.1f ns per point and light (%.2fx rect)\n", pointTime, pointTime / rectTime);
+
+	// Errors relative to the light's largest form factor over the check points
+	struct Error {
+		double worst = 0.0, sum = 0.0;
+		int count = 0;
+		void Add(double e) { worst = std::max(worst, e); sum += e; count++; }
+	};
+	Error diskAbove, diskClipped, sphereAbove, sphereClipped, fanAbove, fanClipped;
+	const int fanSegments = 256;
+	for (int l = 0; l < lightCount; l++) {
+		const DiskLight& disk = disks[l];
+		const SphereLight& sphere = spheres[l];
+		Float3 center = XYZ(disk.Position);
+		Float3 normal = XYZ(disk.Direction);
+		float radius = disk.Direction.w;
+
+		// the disk as a fan of thin triangles, for the full shading
+		Float3 up = std::fabs(normal.y) < 0.999f ? Float3{ 0, 1, 0 } : Float3{ 1, 0, 0 };
+		Float3 axisX = Normalize(Cross(up, normal));
+		Float3 axisY = Cross(normal, axisX);
+		vector<Float4> fan;
+		for (int k = 0; k <= fanSegments; k++) {
+			float a = 2 * PI * k / fanSegments;
+			Float3 p = center + axisX * (radius * std::cos(a)) + axisY * (radius * std::sin(a));
+			fan.push_back({ p.x, p.y, p.z, 1 });
+		}
+		fan.push_back({ center.x, center.y, center.z, 1 });
+
+		vector<double> diskFF, diskLTC, sphereFF, sphereLTC, fanFull, diskFull;
+		vector<bool> diskAboveHorizon, sphereAboveHorizon;
+		for (size_t i = 0; i < pointCount && (int)diskFF.size() < checkPoints; i += pointCount / checkPoints + 1) {
+			Float3 n, p, v, c;
+			pointAt(i, n, p, v, c);
+			if (Length(center - p) < 2 * radius)
+				continue;
+
+			diskFF.push_back(DiskFormFactor(center, normal, radius, p, n));
+			diskLTC.push_back(diffuseOnly.CalcDiskLight({ disk.Position, disk.Direction, { 1, 1, 1, 1 }, {} }, n, p, { 1, 1, 1 }, v).x / 1.5);
+			sphereFF.push_back(SphereFormFactor(XYZ(sphere.Position), sphere.Position.w, p, n));
+			sphereLTC.push_back(diffuseOnly.CalcSphereLight({ sphere.Position, { 1, 1, 1, 1 }, {} }, n, p, { 1, 1, 1 }, v).x / 1.5);
+
+			bool above = true;
+			for (int k = 0; k < fanSegments; k++)
+				above = above && Dot(XYZ(fan[k]) - p, n) > 0.0f;
+			diskAboveHorizon.push_back(above);
+			Float3 toSphere = XYZ(sphere.Position) - p;
+			sphereAboveHorizon.push_back(Dot(toSphere, n) > sphere.Position.w);
+
+			Float3 sum = { 0, 0, 0 };
+			for (int k = 0; k < fanSegments; k++) {
+				const Float4 triangle[3] = { fan[fanSegments + 1], fan[k], fan[k + 1] };
+				PolygonLight part = { disk.Color, {}, { 3, 0 } };
+				sum += ltc.CalcPolygonLight(part, triangle, n, p, c, v);
+			}
+			fanFull.push_back(sum.x + sum.y + sum.z);
+			Float3 full = ltc.CalcDiskLight(disk, n, p, c, v);
+			diskFull.push_back(full.x + full.y + full.z);
+		}
+
+		double diskScale = 1e-6, sphereScale = 1e-6, fanScale = 1e-6;
+		for (size_t k = 0; k < diskFF.size(); k++) {
+			diskScale = std::max(diskScale, diskFF[k]);
+			sphereScale = std::max(sphereScale, sphereFF[k]);
+			fanScale = std::max(fanScale, fanFull[k]);
+		}
+		for (size_t k = 0; k < diskFF.size(); k++) {
+			(diskAboveHorizon[k] ? diskAbove : diskClipped).Add(std::fabs(diskLTC[k] - diskFF[k]) / diskScale);
+			(sphereAboveHorizon[k] ? sphereAbove : sphereClipped).Add(std::fabs(sphereLTC[k] - sphereFF[k]) / sphereScale);
+			(diskAboveHorizon[k] ? fanAbove : fanClipped).Add(std::fabs(diskFull[k] - fanFull[k]) / fanScale);
+		}
+	}
+
+	auto report = [](const char* name, const Error& above, const Error& clipped) {
+		printf("  %-28s above horizon max %.2g (%d points), clipped mean %.2g max %.2g (%d points)\n", name,
+			above.worst, above.count, clipped.count ? clipped.sum / clipped.count : 0.0, clipped.worst, clipped.count);
+	};
+	printf("errors relative to each light's largest value:\n");
+	report("disk diffuse vs quadrature", diskAbove, diskClipped);
+	report("sphere diffuse vs quadrature", sphereAbove, sphereClipped);
+	report("disk vs 256-gon", fanAbove, fanClipped);
+	printf("  (checksum %.3g)\n", checksum.x + checksum.y + checksum.z);
+
+	// unclipped, the sphere cap stand-in is exact
+	if (diskAbove.worst > 1e-2 || sphereAbove.worst > 1e-2 || fanAbove.worst > 1e-2) {
+		printf("FAILED: round lights do not match above the horizon\n");
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
+
+// The wWinMain scene and update loop, rendered by the software backend or
+// the path tracer. With a path, the camera and the first rect light follow
+// it at a fixed timestep from the path's start, and frameMs gets the time of
+// every frame.
+template<typename Renderer>
+static double RenderScene(Renderer& gr, int frames, const CameraPath* path = nullptr, float timestep = 1.0f / 60.0f, vector<double>* frameMs = nullptr) {
+	const float gray[4] = { 0.5f, 0.5f, 0.5f, 1.0f };
+	Float3 cubeRotation = { 0, 0, 0 };
+
+	vector<Vertex> vBuffer;
+	vector<unsigned int> iBuffer;
+	AppendFloor(vBuffer, iBuffer, 0);
+	MeshHandle floorMesh = gr.RegisterMesh(vBuffer, iBuffer);
+	vBuffer.clear();
+	iBuffer.clear();
+	AppendCube(vBuffer, iBuffer, 0);
+	MeshHandle cubeMesh = gr.RegisterMesh(vBuffer, iBuffer);
+
+	Clock::time_point start = Clock::now();
+	for (int frame = 0; frame < frames; frame++) {
+		PROFILE_ZONE("frame");
+		Clock::time_point frameStart = Clock::now();
+		PathKey key = { 0, { -4, 1, -4 }, { 0, 0, 0 }, { 0, 0 } };
+		if (path) {
+			key = path->Sample(frame * timestep);
+			gr.GetRectLight(0)->Params.z = key.lightRotation[0];
+			gr.GetRectLight(0)->Params.w = key.lightRotation[1];
+		}
+		else
+			gr.GetRectLight(0)->Params.z += 0.001f;
+		cubeRotation.y += 0.01f;
+		Float4x4 cubeTransform =
+			Float4x4::RotationRollPitchYaw(cubeRotation.x, cubeRotation.y, cubeRotation.z)
+			* Float4x4::Translation(0, 0, 4);
+
+		gr.Clear(gray);
+		gr.DrawMesh(floorMesh, Float4x4::Identity());
+		gr.DrawMesh(cubeMesh, cubeTransform);
+		gr.Draw(key.position, key.rotation);
+		gr.SwapBuffers();
+		if (frameMs)
+			frameMs->push_back(SecondsSince(frameStart) * 1000.0);
+	}
+	double seconds = SecondsSince(start);
+
+	gr.ReleaseMesh(floorMesh);
+	gr.ReleaseMesh(cubeMesh);
+	return seconds;
+}
+
+static int RunRasterBench(int argc, char** argv) {
+	int width = GetIntOption(argc, argv, "--width", 800);
+	int height = GetIntOption(argc, argv, "--height", 600);
+	int frames = GetIntOption(argc, argv, "--frames", 60);
+	int maxThreads = GetIntOption(argc, argv, "--threads", (int)std::max(1u, std::thread::hardware_concurrency()));
+	int lightCount = GetIntOption(argc, argv, "--lights", 0);
+	const char* out = GetOption(argc, argv, "--out", nullptr);
+	std::string matPath = LutPath(argc, argv, "ltc_mat.dds");
+	std::string ampPath = LutPath(argc, argv, "ltc_amp.dds");
+
+	std::mt19937 rng(1234);
+	vector<PointLight> points;
+	vector<SpotLight> spots;
+	vector<RectLight> rects;
+	MakeLightField(lightCount, rng, points, spots, rects);
+
+	printf("raster: %dx%d, %d frames, tile %d, %d extra lights\n", width, height, frames, TILE_SIZE, lightCount);
+	double singleThreaded = 0.0;
+	for (int threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+		SoftwareGraphics gr(width, height, matPath.c_str(), ampPath.c_str(), threads);
+		gr.AddRectLight({ 4, 0.3f, 5 }, { 1, 1, 1 }, 4, 1, 1, 0.0f, 0.5f);
+		for (const PointLight& l : points)
+			gr.AddPointLight(XYZ(l.Position), XYZ(l.Color), l.Color.w);
+		for (const SpotLight& l : spots)
+			gr.AddSpotLight(XYZ(l.Position), XYZ(l.Color), XYZ(l.Direction), l.Color.w, l.Cone.x, l.Cone.y);
+		for (const RectLight& l : rects)
+			gr.AddRectLight(XYZ(l.Position), XYZ(l.Color), l.Color.w, l.Params.x, l.Params.y, l.Params.z, l.Params.w);
+		RenderScene(gr, 1); // warm up scratch buffers and bins
+		double seconds = RenderScene(gr, frames);
+		if (threads == 1)
+			singleThreaded = seconds;
+
+		printf("  %2d threads: %8.2f fps, %7.2f ms/frame (%.2fx)\n",
+			threads, frames / seconds, seconds * 1000.0 / frames, singleThreaded / seconds);
+		if (threads == maxThreads) {
+			if (out && !gr.SaveFrontBuffer(out))
+				fprintf(stderr, "raster: could not write %s\n", out);
+			break;
+		}
+	}
+	return 0;
+}
+
+// The floor and cube of the wWinMain scene under every mix of point, spot,
+// directional and rect lights, each rendered by the generic tile kernel and
+// by the one specialized for the mix. Both have to give the same image.
+static int RunPermutationBench(int argc, char** argv) {
+	int width = GetIntOption(argc, argv, "--width", 800);
+	int height = GetIntOption(argc, argv, "--height", 600);
+	int frames = GetIntOption(argc, argv, "--frames", 20);
+	int rounds = GetIntOption(argc, argv, "--rounds", 3);
+	int threads = GetIntOption(argc, argv, "--threads", 1);
+	int lightCount = GetIntOption(argc, argv, "--lights", 200);
+	std::string matPath = LutPath(argc, argv, "ltc_mat.dds");
+	std::string ampPath = LutPath(argc, argv, "ltc_amp.dds");
+
+	std::mt19937 rng(1234);
+	vector<PointLight> points;
+	vector<SpotLight> spots;
+	vector<RectLight> rects;
+	MakeLightField(lightCount, rng, points, spots, rects);
+
+	vector<Vertex> vBuffer;
+	vector<unsigned int> iBuffer;
+	AppendFloor(vBuffer, iBuffer, 0);
+	vector<Vertex> floorVertices = vBuffer;
+	vector<unsigned int> floorIndices = iBuffer;
+	vBuffer.clear();
+	iBuffer.clear();
+	AppendCube(vBuffer, iBuffer, 0);
+	Float4x4 cubeTransform = Float4x4::RotationRollPitchYaw(0, 0.5f, 0) * Float4x4::Translation(0, 0, 4);
+
+	printf("permutations: %dx%d, %d threads, %d frames x %d rounds, %d field lights\n", width, height, threads, frames, rounds, lightCount);
+	printf("  %-22s %12s %12s %8s\n", "mix", "generic ms", "special ms", "speedup");
+	const float gray[4] = { 0.5f, 0.5f, 0.5f, 1.0f };
+	size_t mismatches = 0;
+	for (uint32_t mix = 0; mix <= TILE_KERNEL_MIX; mix++) {
+		SoftwareGraphics gr(width, height, matPath.c_str(), ampPath.c_str(), threads);
+		// one light of each type near the cube, so every type shows
+		if (mix & LIGHT_MIX_POINT) {
+			gr.AddPointLight({ 2, 2, 3 }, { 1, 0.8f, 0.6f }, 1.0f);
+			for (const PointLight& l : points)
+				gr.AddPointLight(XYZ(l.Position), XYZ(l.Color), l.Color.w);
+		}
+		if (mix & LIGHT_MIX_SPOT) {
+			gr.AddSpotLight({ 0, 3, 4 }, { 0.6f, 0.8f, 1 }, { 0, -1, 0 });
+			for (const SpotLight& l : spots)
+				gr.AddSpotLight(XYZ(l.Position), XYZ(l.Color), XYZ(l.Direction), l.Color.w, l.Cone.x, l.Cone.y);
+		}
+		if (mix & LIGHT_MIX_DIR) {
+			gr.AddDirLight({ 1, 1, 1 }, { -1, -1, 0.5f }, 0.5f);
+			gr.AddDirLight({ 0.5f, 0.5f, 1 }, { 1, -0.5f, -1 }, 0.25f);
+		}
+		if (mix & LIGHT_MIX_RECT) {
+			gr.AddRectLight({ 4, 0.3f, 5 }, { 1, 1, 1 }, 4, 1, 1, 0.0f, 0.5f);
+			for (const RectLight& l : rects)
+				gr.AddRectLight(XYZ(l.Position), XYZ(l.Color), l.Color.w, l.Params.x, l.Params.y, l.Params.z, l.Params.w);
+		}
+		MeshHandle floorMesh = gr.RegisterMesh(floorVertices, floorIndices);
+		MeshHandle cubeMesh = gr.RegisterMesh(vBuffer, iBuffer);
+
+		vector<uint32_t> images[2];
+		double best[2] = { 1e30, 1e30 };
+		for (int round = 0; round <= rounds; round++) {
+			for (int specialized = 0; specialized < 2; specialized++) {
+				gr.SetLightPermutations(specialized != 0);
+				Clock::time_point start = Clock::now();
+				for (int frame = 0; frame < (round == 0 ? 1 : frames); frame++) {
+					gr.Clear(gray);
+					gr.DrawMesh(floorMesh, Float4x4::Identity());
+					gr.DrawMesh(cubeMesh, cubeTransform);
+					gr.Draw({ -4, 1, -4 }, { 0, 0, 0 });
+					gr.SwapBuffers();
+				}
+				// round 0 warms the scratch buffers and keeps the images
+				if (round == 0)
+					images[specialized] = gr.GetFrontBuffer();
+				else
+					best[specialized] = std::min(best[specialized], SecondsSince(start) * 1000.0 / frames);
+			}
+		}
+		gr.ReleaseMesh(floorMesh);
+		gr.ReleaseMesh(cubeMesh);
+
+		std::string name;
+		const char* types[] = { "point", "spot", "dir", "rect" };
+		for (int i = 0; i < 4; i++)
+			if (mix & (1u << i))
+				name += name.empty() ? types[i] : std::string("+") + types[i];
+		bool same = images[0] == images[1];
+		mismatches += same ? 0 : 1;
+		printf("  %-22s %12.3f %12.3f %7.2fx%s\n", name.empty() ? "none" : name.c_str(),
+			best[0], best[1], best[0] / best[1], same ? "" : "  image differs");
+	}
+
+	bool ok = mismatches == 0;
+	printf("  %zu of %u mixes render differently\n", mismatches, TILE_KERNEL_MIX + 1);
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
+
+// Thresholds of the rect light LOD for an error bound, then what they save
+// and cost on many lights: shading points batched against every light, and
+// the raster-bench scene with a light field.
+static int RunRectLodBench(int argc, char** argv) {
+	float maxError = (float)atof(GetOption(argc, argv, "--max-error", "0.01"));
+	int samples = GetIntOption(argc, argv, "--samples", 1 << 20);
+	size_t pointCount = (size_t)GetIntOption(argc, argv, "--points", 1 << 14);
+	int lightCount = GetIntOption(argc, argv, "--lights", 1000);
+	int iterations = GetIntOption(argc, argv, "--iterations", 5);
+	int frames = GetIntOption(argc, argv, "--frames", 10);
+	int threads = GetIntOption(argc, argv, "--threads", 0);
+	std::string matPath = LutPath(argc, argv, "ltc_mat.dds");
+	std::string ampPath = LutPath(argc, argv, "ltc_amp.dds");
+	LTC ltc(matPath.c_str(), ampPath.c_str());
+
+	// Error bound
+	//========================================
+	vector<RectLightLodError> errors;
+	Clock::time_point start = Clock::now();
+	RectLightLod lod = ltc.FitRectLightLod(maxError, samples, &errors);
+	printf("rect-lod: max error %.3g of a lobe's head-on value, %d samples (%.2f s)\n", maxError, samples, SecondsSince(start));
+	printf("  %12s %14s %14s\n", "solid angle", "diffuse error", "specular error");
+	for (size_t b = 3; b < errors.size(); b += 4)
+		printf("  %12.3g %14.3g %14.3g\n", errors[b].solidAngle, errors[b].diffuse, errors[b].specular);
+	printf("  disk diffuse below %.3g sr (distance %.1fx the light's size), disk specular below %.3g sr in LTC space\n",
+		lod.diffuseSolidAngle, 1.0f / std::sqrt(lod.diffuseSolidAngle), lod.specularSolidAngle);
+
+	// Shading points, every light on every point
+	//========================================
+	std::mt19937 rng(1234);
+	vector<RectLight> lights = MakeRectLights(lightCount / 4, rng);
+	{
+		vector<PointLight> points;
+		vector<SpotLight> spots;
+		vector<RectLight> field;
+		while ((int)(lights.size() + field.size()) < lightCount)
+			MakeLightField(1, rng, points, spots, field);
+		lights.insert(lights.end(), field.begin(), field.end());
+	}
+	ShadingPoints points;
+	MakeShadingPoints(points, pointCount, rng);
+
+	auto shade = [&](const RectLightLod& level, float roughness, RectLightLodStats* stats, vector<Float3>& results) {
+		ltc.SetRectLightLod(level);
+		double best = 1e30;
+		for (int it = 0; it < iterations; it++) {
+			points.ClearResults();
+			Clock::time_point start = Clock::now();
+			ltc.CalcRectLights(lights.data(), (int)lights.size(), points, roughness, 0.0f, it == 0 ? stats : nullptr);
+			best = std::min(best, SecondsSince(start));
+		}
+		results.resize(pointCount);
+		for (size_t i = 0; i < pointCount; i++)
+			results[i] = points.GetResult(i);
+		return best;
+	};
+
+	printf("  %zu points x %zu rect lights, simd width %d\n", pointCount, lights.size(), LTC::BatchWidth());
+	printf("    %9s %10s %8s %8s %8s %10s %9s %8s %10s %10s\n",
+		"roughness", "integrated", "diffuse", "specular", "both", "exact ms", "lod ms", "speedup", "mean error", "max error");
+	bool ok = lod.diffuseSolidAngle > 0.0f && lod.specularSolidAngle > 0.0f;
+	for (float roughness : { 0.25f, 0.5f, 1.0f }) {
+		vector<Float3> exact, approximate;
+		RectLightLodStats stats;
+		double exactTime = shade(RectLightLod{}, roughness, nullptr, exact);
+		double lodTime = shade(lod, roughness, &stats, approximate);
+
+		// relative to the point's sum over every light; points touching a light have none
+		double sumError = 0.0, maxRelative = 0.0;
+		size_t finite = 0;
+		for (size_t i = 0; i < pointCount; i++) {
+			double want = exact[i].x + exact[i].y + exact[i].z;
+			if (!std::isfinite(want))
+				continue;
+			double error = std::fabs(approximate[i].x - exact[i].x) + std::fabs(approximate[i].y - exact[i].y) + std::fabs(approximate[i].z - exact[i].z);
+			sumError += error / std::max(want, 1e-3);
+			maxRelative = std::max(maxRelative, error / std::max(want, 1e-3));
+			finite++;
+		}
+		double evaluations = (double)(stats.full + stats.diffuse + stats.specular + stats.far) / 100.0;
+		printf("    %9.2f %9.1f%% %7.1f%% %7.1f%% %7.1f%% %10.2f %9.2f %7.2fx %10.3g %10.3g\n",
+			roughness, stats.full / evaluations, stats.diffuse / evaluations, stats.specular / evaluations, stats.far / evaluations,
+			exactTime * 1000.0, lodTime * 1000.0, exactTime / lodTime, sumError / finite, maxRelative);
+		ok = ok && stats.far > 0 && lodTime < exactTime && sumError / finite <= maxError;
+	}
+	printf("    levels: lobes integrated, diffuse or specular alone from the disk, or both\n");
+
+	// Rasterized light field
+	//========================================
+	vector<PointLight> fieldPoints;
+	vector<SpotLight> fieldSpots;
+	vector<RectLight> fieldRects;
+	MakeLightField(lightCount, rng, fieldPoints, fieldSpots, fieldRects);
+	vector<uint32_t> images[2];
+	double frameMs[2];
+	for (int level = 0; level < 2; level++) {
+		SoftwareGraphics gr(800, 600, matPath.c_str(), ampPath.c_str(), threads);
+		gr.SetRectLightLod(level ? lod : RectLightLod{});
+		gr.AddRectLight({ 4, 0.3f, 5 }, { 1, 1, 1 }, 4, 1, 1, 0.0f, 0.5f);
+		for (const RectLight& l : fieldRects)
+			gr.AddRectLight(XYZ(l.Position), XYZ(l.Color), l.Color.w, l.Params.x, l.Params.y, l.Params.z, l.Params.w);
+		RenderScene(gr, 1);
+		frameMs[level] = RenderScene(gr, frames) * 1000.0 / frames;
+		images[level] = gr.GetFrontBuffer();
+	}
+	int maxLevels = 0;
+	size_t changed = 0;
+	for (size_t i = 0; i < images[0].size(); i++) {
+		int worst = 0;
+		for (int c = 0; c < 24; c += 8)
+			worst = std::max(worst, std::abs((int)((images[0][i] >> c) & 0xFF) - (int)((images[1][i] >> c) & 0xFF)));
+		maxLevels = std::max(maxLevels, worst);
+		changed += worst > 0 ? 1 : 0;
+	}
+	printf("  raster 800x600, %zu rect lights: exact %.2f ms/frame, lod %.2f ms/frame (%.2fx)\n",
+		fieldRects.size() + 1, frameMs[0], frameMs[1], frameMs[0] / frameMs[1]);
+	printf("    %.2f%% of pixels changed, by at most %d of 255\n", 100.0 * changed / images[0].size(), maxLevels);
+
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
+
+// nearest rank of a sorted list
+static double Percentile(const vector<double>& sorted, double p) {
+	size_t rank = (size_t)std::ceil(p * sorted.size());
+	return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+// The wWinMain scene on the software rasterizer along a scripted or
+// recorded camera path at a fixed timestep, so that two runs of the same
+// build render the same frames. Frame times go out as JSON, with a hash of
+// the last image to tell whether two runs really rendered the same.
+static int RunSceneBench(int argc, char** argv) {
+	int width = GetIntOption(argc, argv, "--width", 800);
+	int height = GetIntOption(argc, argv, "--height", 600);
+	int frames = GetIntOption(argc, argv, "--frames", 600);
+	int warmup = GetIntOption(argc, argv, "--warmup", 10);
+	int threads = GetIntOption(argc, argv, "--threads", 0);
+	int lightCount = GetIntOption(argc, argv, "--lights", 0);
+	float timestep = (float)atof(GetOption(argc, argv, "--timestep", "0.0166667"));
+	const char* pathFile = GetOption(argc, argv, "--path", nullptr);
+	const char* record = GetOption(argc, argv, "--record", nullptr);
+	const char* out = GetOption(argc, argv, "--out", nullptr);
+	std::string matPath = LutPath(argc, argv, "ltc_mat.dds");
+	std::string ampPath = LutPath(argc, argv, "ltc_amp.dds");
+	if (frames <= 0 || timestep <= 0.0f) {
+		fprintf(stderr, "scene-bench: --frames and --timestep must be positive\n");
+		return -1;
+	}
+
+	CameraPath path = CameraPath::Orbit(frames * timestep);
+	if (pathFile && !path.Load(pathFile)) {
+		fprintf(stderr, "scene-bench: could not read a camera path from %s\n", pathFile);
+		return -1;
+	}
+	if (record && !path.Save(record))
+		fprintf(stderr, "scene-bench: could not write %s\n", record);
+
+	std::mt19937 rng(1234);
+	vector<PointLight> points;
+	vector<SpotLight> spots;
+	vector<RectLight> rects;
+	MakeLightField(lightCount, rng, points, spots, rects);
+	SoftwareGraphics gr(width, height, matPath.c_str(), ampPath.c_str(), threads);
+	gr.AddRectLight({ 4, 0.3f, 5 }, { 1, 1, 1 }, 4, 1, 1, 0.0f, 0.5f);
+	for (const PointLight& l : points)
+		gr.AddPointLight(XYZ(l.Position), XYZ(l.Color), l.Color.w);
+	for (const SpotLight& l : spots)
+		gr.AddSpotLight(XYZ(l.Position), XYZ(l.Color), XYZ(l.Direction), l.Color.w, l.Cone.x, l.Cone.y);
+	for (const RectLight& l : rects)
+		gr.AddRectLight(XYZ(l.Position), XYZ(l.Color), l.Color.w, l.Params.x, l.Params.y, l.Params.z, l.Params.w);
+
+	// the warm-up frames replay the start of the path, then it runs again
+	vector<double> frameMs;
+	if (warmup > 0)
+		RenderScene(gr, warmup, &path, timestep);
+	double seconds = RenderScene(gr, frames, &path, timestep, &frameMs);
+
+	uint64_t hash = 14695981039346656037ull;
+	for (uint32_t pixel : gr.GetFrontBuffer())
+		hash = (hash ^ pixel) * 1099511628211ull;
+
+	vector<double> sorted = frameMs;
+	std::sort(sorted.begin(), sorted.end());
+	double mean = 0.0;
+	for (double ms : frameMs)
+		mean += ms;
+	mean /= frameMs.size();
+
+	char json[1024];
+	snprintf(json, sizeof(json),
+		"{\n"
+		"  \"benchmark\": \"scene-bench\",\n"
+		"  \"width\": %d, \"height\": %d, \"threads\": %d, \"lights\": %d,\n"
+		"  \"path\": \"%s\", \"path_keys\": %zu, \"timestep\": %.7g,\n"
+		"  \"warmup\": %d, \"frames\": %d, \"seconds\": %.6f,\n"
+		"  \"frame_ms\": { \"min\": %.4f, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f },\n"
+		"  \"image_hash\": \"%016llx\"\n"
+		"}\n",
+		width, height, gr.GetThreadCount(), lightCount,
+		pathFile ? "recorded" : "orbit", path.GetKeyCount(), timestep,
+		warmup, frames, seconds,
+		sorted.front(), mean, Percentile(sorted, 0.50), Percentile(sorted, 0.95), Percentile(sorted, 0.99), sorted.back(),
+		(unsigned long long)hash);
+	printf("%s", json);
+
+	if (out) {
+		FILE* file = fopen(out, "wb");
+		if (!file || fputs(json, file) < 0 || fclose(file) != 0) {
+			fprintf(stderr, "scene-bench: could not write %s\n", out);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// Replays an input log through Camera::Update and the software rasterizer,
+// unpaced, and lists the slowest frames to find the spikes of a session.
+// Without --log it first runs a scripted session of key presses and light
+// edits, and checks that its saved log moves camera and lights bit for bit
+// as the session did.
+static int RunInputReplay(int argc, char** argv) {
+	const char* logFile = GetOption(argc, argv, "--log", nullptr);
+	const char* save = GetOption(argc, argv, "--save", nullptr);
+	int frames = GetIntOption(argc, argv, "--frames", 600);
+	int width = GetIntOption(argc, argv, "--width", 800);
+	int height = GetIntOption(argc, argv, "--height", 600);
+	int threads = GetIntOption(argc, argv, "--threads", 0);
+	int spikes = GetIntOption(argc, argv, "--spikes", 5);
+	std::string matPath = LutPath(argc, argv, "ltc_mat.dds");
+	std::string ampPath = LutPath(argc, argv, "ltc_amp.dds");
+
+	struct FrameState { Float3 position, rotation; Float4 params; };
+	vector<FrameState> session;
+	InputLog log;
+	if (logFile) {
+		if (!log.Load(logFile)) {
+			fprintf(stderr, "input-replay: could not read an input log from %s\n", logFile);
+			return -1;
+		}
+	}
+	else {
+		// hold a few movement keys for a while, resize and turn the light
+		std::mt19937 rng(1234);
+		const char moves[] = "WASDRFIJKL";
+		bool keys[KEYBOARD_KEYS] = {};
+		Camera camera;
+		RectLight light = { { 4, 0.3f, 5, 1 }, { 1, 1, 0, 0.5f }, { 1, 1, 1, 4 } };
+		for (int frame = 0; frame < frames; frame++) {
+			if (frame % 40 == 0)
+				for (const char* key = moves; *key; key++)
+					keys[(unsigned char)*key] = rng() % 4 == 0;
+			Keyboard::SetKeys(keys);
+			camera.Update();
+			light.Params.z += 0.001f;
+			if (frame % 97 == 96)
+				light.Params.x = light.Params.y = 0.5f + (rng() % 100) / 100.0f;
+			log.RecordFrame(keys, &light, 1);
+			session.push_back({ camera.Position, camera.Rotation, light.Params });
+		}
+
+		std::string path = save ? save : (std::filesystem::temp_directory_path() / "input-replay.log").string();
+		if (!log.Save(path.c_str()) || !log.Load(path.c_str())) {
+			fprintf(stderr, "input-replay: could not write and read back %s\n", path.c_str());
+			return -1;
+		}
+		if (!save)
+			std::filesystem::remove(path);
+	}
+	printf("input replay: %s, %zu frames, %zu bytes (%.2f bytes/frame)\n",
+		logFile ? logFile : "scripted session", log.GetFrameCount(), log.GetByteCount(),
+		(double)log.GetByteCount() / std::max<size_t>(1, log.GetFrameCount()));
+
+	SoftwareGraphics gr(width, height, matPath.c_str(), ampPath.c_str(), threads);
+	gr.AddRectLight({ 4, 0.3f, 5 }, { 1, 1, 1 }, 4, 1, 1, 0.0f, 0.5f);
+	vector<Vertex> vBuffer;
+	vector<unsigned int> iBuffer;
+	AppendFloor(vBuffer, iBuffer, 0);
+	MeshHandle floorMesh = gr.RegisterMesh(vBuffer, iBuffer);
+	vBuffer.clear();
+	iBuffer.clear();
+	AppendCube(vBuffer, iBuffer, 0);
+	MeshHandle cubeMesh = gr.RegisterMesh(vBuffer, iBuffer);
+
+	// the scene loop of wWinMain, with the log in place of the window
+	const float gray[4] = { 0.5f, 0.5f, 0.5f, 1.0f };
+	InputReplay replay(log);
+	Camera camera;
+	Float3 cubeRotation = { 0, 0, 0 };
+	bool keys[KEYBOARD_KEYS];
+	vector<double> frameMs;
+	size_t matching = 0;
+	Clock::time_point start = Clock::now();
+	while (true) {
+		Clock::time_point frameStart = Clock::now();
+		bool more = replay.NextFrame(keys, [&](int index, Float4 params) {
+			if (RectLight* light = gr.GetRectLight(index))
+				light->Params = params;
+		});
+		if (!more)
+			break;
+		Keyboard::SetKeys(keys);
+		camera.Update();
+		cubeRotation.y += 0.01f;
+		Float4x4 cubeTransform =
+			Float4x4::RotationRollPitchYaw(cubeRotation.x, cubeRotation.y, cubeRotation.z)
+			* Float4x4::Translation(0, 0, 4);
+
+		gr.Clear(gray);
+		gr.DrawMesh(floorMesh, Float4x4::Identity());
+		gr.DrawMesh(cubeMesh, cubeTransform);
+		gr.Draw(camera.Position, camera.Rotation);
+		gr.SwapBuffers();
+		frameMs.push_back(SecondsSince(frameStart) * 1000.0);
+
+		size_t frame = frameMs.size() - 1;
+		if (frame < session.size()) {
+			FrameState state = { camera.Position, camera.Rotation, gr.GetRectLights()[0].Params };
+			matching += memcmp(&state, &session[frame], sizeof(state)) == 0;
+		}
+	}
+	double seconds = SecondsSince(start);
+	gr.ReleaseMesh(floorMesh);
+	gr.ReleaseMesh(cubeMesh);
+	if (frameMs.empty())
+		return 0;
+
+	printf("  replayed unpaced in %.3f s, %.3f ms/frame\n", seconds, seconds * 1000.0 / frameMs.size());
+	vector<size_t> order(frameMs.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	size_t shown = std::min(order.size(), (size_t)std::max(spikes, 0));
+	std::partial_sort(order.begin(), order.begin() + shown, order.end(), [&](size_t a, size_t b) { return frameMs[a] > frameMs[b]; });
+	printf("  slowest frames:");
+	for (size_t i = 0; i < shown; i++)
+		printf(" #%zu %.3f ms%s", order[i], frameMs[order[i]], i + 1 < shown ? "," : "\n");
+	printf("  final camera (%.4f, %.4f, %.4f), rotation (%.4f, %.4f)\n",
+		camera.Position.x, camera.Position.y, camera.Position.z, camera.Rotation.x, camera.Rotation.y);
+	if (logFile)
+		return 0;
+
+	bool ok = matching == session.size() && frameMs.size() == session.size();
+	printf("  camera and light match the session in %zu of %zu frames\n", matching, session.size());
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
+
+// sqrt of the mean squared channel difference over the mean reference channel
+static double RelativeRMSE(const vector<Float3>& image, const vector<Float3>& reference) {
+	double squared = 0.0, mean = 0.0;
+	for (size_t i = 0; i < image.size(); i++) {
+		Float3 d = image[i] - reference[i];
+		squared += Dot(d, d);
+		mean += reference[i].x + reference[i].y + reference[i].z;
+	}
+	return std::sqrt(squared / (3.0 * image.size())) / std::max(mean / (3.0 * image.size()), 1e-12);
+}
+
+// The raster-bench scene rendered by Monte Carlo: converges to the image the
+// LTC shading approximates. Reports light samples per second per core, the
+// error against the reference over sample counts, the LTC error and the
+// software rasterizer's error (clusters, SIMD batch, RGBA8) against it.
+// The path tracer itself is checked against LTC diffuse, which is exact.
+static int RunReferenceRender(int argc, char** argv) {
+	int width = GetIntOption(argc, argv, "--width", 320);
+	int height = GetIntOption(argc, argv, "--height", 240);
+	int maxSamples = GetIntOption(argc, argv, "--samples", 256);
+	int referenceSamples = GetIntOption(argc, argv, "--reference", 1024);
+	int threads = GetIntOption(argc, argv, "--threads", (int)std::max(1u, std::thread::hardware_concurrency()));
+	int lightCount = GetIntOption(argc, argv, "--lights", 0);
+	bool shadows = GetIntOption(argc, argv, "--shadows", 0) != 0;
+	const char* out = GetOption(argc, argv, "--out", nullptr);
+	std::string matPath = LutPath(argc, argv, "ltc_mat.dds");
+	std::string ampPath = LutPath(argc, argv, "ltc_amp.dds");
+
+	std::mt19937 rng(1234);
+	vector<PointLight> points;
+	vector<SpotLight> spots;
+	vector<RectLight> rects;
+	MakeLightField(lightCount, rng, points, spots, rects);
+	auto addLights = [&](auto& gr) {
+		gr.AddRectLight({ 4, 0.3f, 5 }, { 1, 1, 1 }, 4, 1, 1, 0.0f, 0.5f);
+		for (const PointLight& l : points)
+			gr.AddPointLight(XYZ(l.Position), XYZ(l.Color), l.Color.w);
+		for (const SpotLight& l : spots)
+			gr.AddSpotLight(XYZ(l.Position), XYZ(l.Color), XYZ(l.Direction), l.Color.w, l.Cone.x, l.Cone.y);
+		for (const RectLight& l : rects)
+			gr.AddRectLight(XYZ(l.Position), XYZ(l.Color), l.Color.w, l.Params.x, l.Params.y, l.Params.z, l.Params.w);
+	};
+
+	// every render is the scene's first frame
+	auto render = [](PathTracer& pt, PathTracerMode mode, int samples, uint32_t seed) {
+		RectLight light = *pt.GetRectLight(0);
+		pt.SetMode(mode);
+		pt.SetSamples(samples);
+		pt.SetSeed(seed);
+		RenderScene(pt, 1);
+		*pt.GetRectLight(0) = light;
+		return pt.GetFrontBuffer();
+	};
+	auto samplesPerCore = [&](const PathTracer& pt) {
+		return pt.GetStats().lightSamples / pt.GetStats().seconds / pt.GetThreadCount();
+	};
+
+	PathTracer pt(width, height, matPath.c_str(), ampPath.c_str(), threads);
+	addLights(pt);
+	printf("reference render: %dx%d, %d rect lights, %d point, %d spot, %d threads\n",
+		width, height, (int)rects.size() + 1, (int)points.size(), (int)spots.size(), pt.GetThreadCount());
+
+	vector<Float3> reference = render(pt, PathTracerMode::Reference, referenceSamples, 1);
+	printf("  reference: %d samples per pixel and rect light, %.2f s, %.2f M light samples/s per core\n",
+		referenceSamples, pt.GetStats().seconds, samplesPerCore(pt) * 1e-6);
+	if (out && !pt.SaveFrontBuffer(out))
+		fprintf(stderr, "reference-render: could not write %s\n", out);
+
+	// halving per 4x samples is the 1 / sqrt(N) of an unbiased estimator
+	printf("error against the reference, relative RMSE:\n");
+	printf("  samples     error  vs 1/4 the samples   seconds  M light samples/s per core\n");
+	double previous = 0.0;
+	for (int samples = 1; samples <= maxSamples; samples *= 4) {
+		double error = RelativeRMSE(render(pt, PathTracerMode::Reference, samples, 2), reference);
+		printf("  %7d  %8.4f  %18.2fx  %8.3f  %.2f\n",
+			samples, error, previous > 0.0 ? error / previous : 1.0, pt.GetStats().seconds, samplesPerCore(pt) * 1e-6);
+		previous = error;
+	}
+
+	double ltcError = RelativeRMSE(render(pt, PathTracerMode::Analytic, 1, 0), reference);
+	printf("  LTC (CalcRectLight, every light):  %.4f\n", ltcError);
+
+	// clusters, SIMD batches and 8-bit output, against the clamped reference
+	SoftwareGraphics gr(width, height, matPath.c_str(), ampPath.c_str(), threads);
+	addLights(gr);
+	RenderScene(gr, 1);
+	vector<Float3> raster(reference.size()), clamped(reference.size());
+	for (size_t i = 0; i < reference.size(); i++) {
+		uint32_t c = gr.GetFrontBuffer()[i];
+		raster[i] = { (c & 0xff) / 255.0f, ((c >> 8) & 0xff) / 255.0f, ((c >> 16) & 0xff) / 255.0f };
+		clamped[i] = { Saturate(reference[i].x), Saturate(reference[i].y), Saturate(reference[i].z) };
+	}
+	printf("  software rasterizer, clamped:      %.4f\n", RelativeRMSE(raster, clamped));
+
+	if (shadows) {
+		pt.SetShadows(true);
+		double shadowError = RelativeRMSE(reference, render(pt, PathTracerMode::Reference, referenceSamples, 1));
+		printf("  without shadows against with:      %.4f (%.2f M light samples/s per core, %zu shadow rays)\n",
+			shadowError, samplesPerCore(pt) * 1e-6, pt.GetStats().shadowRays);
+		pt.SetShadows(false);
+	}
+
+	// LTC diffuse is the exact form factor: only sampling noise may remain
+	LTC diffuseOnly(2, vector<Float4>(4, { 1, 0, 1, 0 }), vector<Float4>(4, { 0, 0, 0, 0 }));
+	PathTracer diffuse(width, height, diffuseOnly, threads);
+	addLights(diffuse);
+	double noise = RelativeRMSE(render(diffuse, PathTracerMode::Reference, referenceSamples, 2), render(diffuse, PathTracerMode::Reference, referenceSamples, 1));
+	double diffuseError = RelativeRMSE(render(diffuse, PathTracerMode::Reference, referenceSamples, 1), render(diffuse, PathTracerMode::Analytic, 1, 0));
+	printf("  diffuse only, against exact LTC:   %.4f (two references apart: %.4f)\n", diffuseError, noise);
+
+	if (diffuseError > noise) {
+		printf("FAILED: the path tracer does not converge to the exact diffuse term\n");
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
+
+// Replays the Graphics frame (floor, cube, light proxy, plus one piece of
+// per-frame geometry) on a null device and fails if a steady-state frame
+// allocates a buffer.
+static int RunMeshCheck(int argc, char** argv) {
+	int frames = GetIntOption(argc, argv, "--frames", 5000);
+
+	NullRenderDevice device;
+	MeshCache meshes(device);
+
+	vector<Vertex> vBuffer;
+	vector<unsigned int> iBuffer;
+	AppendFloor(vBuffer, iBuffer, 0);
+	MeshHandle floorMesh = meshes.Register(vBuffer, iBuffer);
+	vBuffer.clear();
+	iBuffer.clear();
+	AppendCube(vBuffer, iBuffer, 0);
+	MeshHandle cubeMesh = meshes.Register(vBuffer, iBuffer);
+	vBuffer.clear();
+	iBuffer.clear();
+	AppendQuadLight(vBuffer, iBuffer, { { 0, 0, 0, 1 }, { 1, 1, 0, 0 }, { 1, 1, 1, 1 } }, 0);
+	MeshHandle quadMesh = meshes.Register(vBuffer, iBuffer);
+
+	auto frame = [&](int index) {
+		vBuffer.clear();
+		iBuffer.clear();
+		AppendCube(vBuffer, iBuffer, 3);
+		for (Vertex& v : vBuffer)
+			v.y += 0.001f * index;
+
+		meshes.Draw(floorMesh, 0);
+		meshes.Draw(cubeMesh, 1);
+		meshes.DrawDynamic(vBuffer, iBuffer);
+		meshes.Draw(quadMesh, 2);
+		meshes.Flush();
+	};
+
+	frame(0); // first frame may still size the staging arrays
+	DeviceStats before = device.GetStats();
+	for (int i = 1; i <= frames; i++)
+		frame(i);
+	DeviceStats after = device.GetStats();
+
+	size_t allocations = after.bufferAllocations - before.bufferAllocations;
+	printf("meshes: %zu registered, %d steady-state frames\n", meshes.GetMeshCount(), frames);
+	printf("  buffer allocations: %zu (setup %zu, %zu bytes)\n", allocations, before.bufferAllocations, before.bytesAllocated);
+	printf("  per frame:          %.1f draws, %.1f buffer writes (%.4f discards), %.0f bytes written\n",
+		(double)(after.draws - before.draws) / frames,
+		(double)(after.bufferWrites - before.bufferWrites) / frames,
+		(double)(after.bufferDiscards - before.bufferDiscards) / frames,
+		(double)(after.bytesWritten - before.bytesWritten) / frames);
+	if (allocations != 0) {
+		printf("FAILED: steady-state frames allocated buffers\n");
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
+
+// Edits lights the way the demo does and checks what LightStore::Flush asks
+// to write: nothing for an untouched frame, one run per group of consecutive
+// edits, a full write only when an array outgrows its buffer.
+static int RunUploadCheck(int argc, char** argv) {
+	int pointCount = GetIntOption(argc, argv, "--points", 256);
+	int spotCount = GetIntOption(argc, argv, "--spots", 64);
+	int rectCount = GetIntOption(argc, argv, "--rects", 64);
+	int edits = GetIntOption(argc, argv, "--edits", 4);
+	int frames = GetIntOption(argc, argv, "--frames", 1000);
+
+	LightStore lights;
+	for (int i = 0; i < pointCount; i++)
+		lights.AddPointLight().Color = { 1, 1, 1, 1 };
+	for (int i = 0; i < spotCount; i++)
+		lights.AddSpotLight().Color = { 1, 1, 1, 1 };
+	for (int i = 0; i < rectCount; i++)
+		lights.AddRectLight().Color = { 1, 1, 1, 1 };
+	lights.AddDirLight()->Color = { 1, 1, 1, 1 };
+
+	size_t writes = 0;
+	size_t resizes = 0;
+	auto flush = [&] {
+		writes = resizes = 0;
+		return lights.Flush([&](const LightUpload& upload) {
+			writes += upload.bytes > 0;
+			resizes += upload.resize;
+		});
+	};
+
+	int failures = 0;
+	auto expect = [&](const char* what, size_t bytes, size_t expectedBytes, size_t expectedWrites) {
+		bool ok = bytes == expectedBytes && writes == expectedWrites;
+		printf("  %-28s %6zu bytes, %zu writes%s\n", what, bytes, writes, ok ? "" : "  FAILED");
+		if (!ok) {
+			printf("    expected %zu bytes, %zu writes\n", expectedBytes, expectedWrites);
+			failures++;
+		}
+	};
+
+	size_t arrays = pointCount * sizeof(PointLight) + spotCount * sizeof(SpotLight) + rectCount * sizeof(RectLight);
+	size_t full = arrays + sizeof(LightConstants);
+	printf("lights: %d point, %d spot, %d rect, 1 dir; %zu bytes of lights, %zu of constants\n",
+		pointCount, spotCount, rectCount, arrays, sizeof(LightConstants));
+
+	expect("first flush", flush(), full, (pointCount > 0) + (spotCount > 0) + (rectCount > 0) + 1);
+	expect("nothing changed", flush(), 0, 0);
+
+	if (rectCount > 0) {
+		lights.EditRectLight(rectCount / 2)->Position.x += 1.0f;
+		expect("one rect light moved", flush(), sizeof(RectLight), 1);
+	}
+	if (pointCount >= 8) {
+		// 1-3 is one run, 6 another, 7 joins it
+		for (int i : { 3, 1, 2, 6, 7 })
+			lights.EditPointLight(i)->Position.y += 1.0f;
+		expect("point lights 1-3, 6-7", flush(), 5 * sizeof(PointLight), 2);
+	}
+	if (pointCount > 0) {
+		// the ambient sum changes with the color, so the constants go too
+		lights.EditPointLight(0)->Color.x = 0.5f;
+		expect("point light recolored", flush(), sizeof(PointLight) + sizeof(LightConstants), 2);
+	}
+	lights.EditDirLight(0)->Direction = { 0, -1, 0, 0 };
+	expect("dir light turned", flush(), sizeof(LightConstants), 1);
+
+	// the first flush sized the buffer for at least 64 lights
+	int added = std::max(64, rectCount) + 1 - rectCount;
+	for (int i = 0; i < added; i++)
+		lights.AddRectLight();
+	rectCount += added;
+	size_t grown = rectCount * sizeof(RectLight) + sizeof(LightConstants);
+	expect("rect lights outgrow buffer", flush(), grown, 2);
+	if (resizes != 1) {
+		printf("    expected 1 resize, got %zu\n", resizes);
+		failures++;
+	}
+
+	// steady state: a few lights move every frame, as the demo's rect lights do
+	std::mt19937 random(1);
+	size_t total = 0;
+	size_t totalWrites = 0;
+	Clock::time_point start = Clock::now();
+	for (int frame = 0; frame < frames; frame++) {
+		for (int i = 0; i < edits; i++)
+			lights.EditRectLight((int)(random() % rectCount))->Params.z += 0.01f;
+		lights.UpdateConstants();
+		total += flush();
+		totalWrites += writes;
+	}
+	double seconds = SecondsSince(start);
+
+	full = pointCount * sizeof(PointLight) + spotCount * sizeof(SpotLight) + rectCount * sizeof(RectLight) + sizeof(LightConstants);
+	printf("%d frames, %d rect lights edited per frame:\n", frames, edits);
+	printf("  dirty ranges:  %.0f bytes, %.1f writes per frame (%.3f us flush)\n",
+		(double)total / frames, (double)totalWrites / frames, seconds * 1e6 / frames);
+	printf("  full rewrite:  %zu bytes, 4 writes per frame\n", full);
+	if (failures) {
+		printf("FAILED: %d checks\n", failures);
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
+
+static int RunLargeMeshCheck(int argc, char** argv) {
+	int count = GetIntOption(argc, argv, "--vertices", 1000000);
+
+	// a grid of cubes, far past what one 16-bit index buffer can address
+	vector<Vertex> vBuffer;
+	vector<unsigned int> iBuffer;
+	Clock::time_point start = Clock::now();
+	for (int cube = 0; (int)vBuffer.size() < count; cube++) {
+		size_t first = vBuffer.size();
+		AppendCube(vBuffer, iBuffer, 0);
+		for (size_t i = first; i < vBuffer.size(); i++) {
+			vBuffer[i].x += 3.0f * (cube % 256);
+			vBuffer[i].z += 3.0f * (cube / 256);
+		}
+	}
+	double buildTime = SecondsSince(start);
+
+	NullRenderDevice device;
+	MeshCache meshes(device);
+	start = Clock::now();
+	MeshHandle mesh = meshes.Register(vBuffer, iBuffer);
+	double registerTime = SecondsSince(start);
+
+	// the uploaded 16-bit indices must give back every original index; Register
+	// creates the index buffer right before the vertex buffer
+	vector<IndexChunk> chunks;
+	vector<unsigned short> rebased;
+	bool split = SplitIndices(iBuffer.data(), iBuffer.size(), chunks, rebased);
+	const vector<unsigned char>& uploaded = device.GetBufferData((BufferHandle)(device.GetStats().bufferAllocations - 1));
+	size_t mismatches = 0;
+	if (!split || uploaded.size() != rebased.size() * sizeof(unsigned short) || memcmp(uploaded.data(), rebased.data(), uploaded.size()) != 0)
+		mismatches++;
+	for (const IndexChunk& chunk : chunks) {
+		if (chunk.vertexCount > 65536)
+			mismatches++;
+		for (size_t i = chunk.firstIndex; i < chunk.firstIndex + chunk.indexCount; i++)
+			if (rebased[i] + chunk.baseVertex != iBuffer[i])
+				mismatches++;
+	}
+
+	DeviceStats before = device.GetStats();
+	meshes.Draw(mesh, 0);
+	meshes.Flush();
+	size_t staticDraws = device.GetStats().draws - before.draws;
+
+	before = device.GetStats();
+	meshes.DrawDynamic(vBuffer, iBuffer);
+	meshes.Flush();
+	size_t dynamicDraws = device.GetStats().draws - before.draws;
+
+	// a triangle spanning more than 65536 vertices cannot be chunked
+	vector<Vertex> wideVertices(70000);
+	vector<unsigned int> wideIndices = { 0, 1, 69999, 1, 2, 3 };
+	MeshHandle wideMesh = meshes.Register(wideVertices, wideIndices);
+	size_t wideBytes = device.GetBufferData((BufferHandle)(device.GetStats().bufferAllocations - 1)).size();
+	before = device.GetStats();
+	meshes.Draw(wideMesh, 0);
+	meshes.DrawDynamic(wideVertices, wideIndices);
+	meshes.Flush();
+	size_t wideDraws = device.GetStats().draws - before.draws;
+
+	printf("large mesh: %zu vertices, %zu triangles, built in %.1f ms, registered in %.1f ms\n",
+		vBuffer.size(), iBuffer.size() / 3, buildTime * 1e3, registerTime * 1e3);
+	printf("  16-bit chunks: %zu, %zu bytes of indices (32-bit: %zu), %zu mismatches\n",
+		chunks.size(), rebased.size() * sizeof(unsigned short), iBuffer.size() * sizeof(unsigned int), mismatches);
+	printf("  draws: %zu static, %zu dynamic\n", staticDraws, dynamicDraws);
+	printf("  wide triangle: %zu-byte 32-bit index buffer, %zu draws static + dynamic\n", wideBytes, wideDraws);
+	if (mismatches != 0 || chunks.size() < vBuffer.size() / 65536 || staticDraws != chunks.size()
+		|| dynamicDraws != chunks.size() || wideBytes != wideIndices.size() * sizeof(unsigned int) || wideDraws != 2) {
+		printf("FAILED\n");
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
+
+// Thousands of spinning cubes per frame, one draw per cube against one
+// instanced draw, on the null device. Times building the object structured
+// buffer and checks both paths produce the same data the shader reads.
+// Many lights over a field of small objects: how many lights each draw walks
+// with per-object lists instead of all of them, with the cutoff ranges alone
+// and with windowed point and spot lights.
+static int RunLightListBench(int argc, char** argv) {
+	int lightCount = GetIntOption(argc, argv, "--lights", 10000);
+	int objectCount = GetIntOption(argc, argv, "--objects", 20000);
+	int iterations = GetIntOption(argc, argv, "--iterations", 20);
+	int threads = GetIntOption(argc, argv, "--threads", (int)std::max(1u, std::thread::hardware_concurrency()));
+	float radius = (float)atof(GetOption(argc, argv, "--radius", "3"));
+
+	std::mt19937 rng(1234);
+	vector<PointLight> points;
+	vector<SpotLight> spots;
+	vector<RectLight> rects;
+	MakeLightField(lightCount, rng, points, spots, rects);
+
+	// objects spread over the light field, half a unit to a few units across
+	std::uniform_real_distribution<float> pos(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	vector<Float4> spheres(objectCount);
+	for (Float4& s : spheres)
+		s = { pos(rng), 6 * unit(rng), pos(rng) + 60.0f, 0.5f + 2.5f * unit(rng) * unit(rng) };
+
+	printf("light lists: %d lights (%zu point, %zu spot, %zu rect), %d objects, %d threads\n",
+		lightCount, points.size(), spots.size(), rects.size(), objectCount, threads);
+
+	ThreadPool pool(threads);
+	for (int pass = 0; pass < 2; pass++) {
+		if (pass == 1) {
+			for (PointLight& l : points)
+				l.Range.x = radius;
+			for (SpotLight& l : spots)
+				l.Range.x = radius;
+		}
+
+		ObjectLightLists lists;
+		double best = 1e30, total = 0.0;
+		for (int it = 0; it <= iterations; it++) {
+			Clock::time_point start = Clock::now();
+			lists.Build(spheres.data(), spheres.size(), points.data(), points.size(), spots.data(), spots.size(), rects.data(), rects.size(), pool);
+			double seconds = SecondsSince(start);
+			if (it == 0)
+				continue; // first build sizes the buffers
+			best = std::min(best, seconds);
+			total += seconds;
+		}
+
+		size_t maxLights = 0;
+		for (const ClusterRange& r : lists.GetRanges())
+			maxLights = std::max(maxLights, (size_t)(r.pointCount + r.spotCount + r.rectCount));
+		double average = lists.GetBoundedCount() ? (double)lists.GetLightIndices().size() / lists.GetBoundedCount() : 0.0;
+		if (pass == 0)
+			printf("  cutoff ranges:\n");
+		else
+			printf("  point and spot lights windowed to radius %.2f:\n", radius);
+		printf("    build %7.3f ms min, %7.3f ms mean\n", best * 1000.0, total * 1000.0 / iterations);
+		printf("    %.1f lights per object (max %zu) against %d, %.0fx fewer\n",
+			average, maxLights, lightCount, average > 0.0 ? lightCount / average : 0.0);
+
+		// brute force: every light whose sphere touches the object's, and only those
+		auto touches = [](const Float4& object, Float3 center, float reach) {
+			Float3 d = center - XYZ(object);
+			return Dot(d, d) < (reach + object.w) * (reach + object.w);
+		};
+		size_t wrong = 0;
+		for (size_t o = 0; o < spheres.size(); o++) {
+			const ClusterRange& r = lists.GetRanges()[o];
+			vector<uint32_t> expected;
+			for (size_t l = 0; l < points.size(); l++)
+				if (touches(spheres[o], XYZ(points[l].Position), PointLightRange(points[l])))
+					expected.push_back((uint32_t)l);
+			uint32_t pointCount = (uint32_t)expected.size();
+			for (size_t l = 0; l < spots.size(); l++)
+				if (touches(spheres[o], XYZ(spots[l].Position), SpotLightRange(spots[l])))
+					expected.push_back((uint32_t)l);
+			uint32_t spotCount = (uint32_t)expected.size() - pointCount;
+			for (size_t l = 0; l < rects.size(); l++)
+				if (touches(spheres[o], XYZ(rects[l].Position), RectLightRange(rects[l])))
+					expected.push_back((uint32_t)l);
+
+			const uint32_t* list = lists.GetLightIndices().data() + r.offset;
+			if (r.pointCount != pointCount || r.spotCount != spotCount || r.pointCount + r.spotCount + r.rectCount != expected.size()
+				|| !std::equal(expected.begin(), expected.end(), list))
+				wrong++;
+		}
+		printf("    validation: %zu of %zu objects differ from brute force\n", wrong, spheres.size());
+		if (wrong > 0)
+			return 1;
+	}
+	return 0;
+}
+
+// The CPU side of a frame with many moving objects as a frame graph: object
+// and light update, culling, instance building, light lists and constant
+// packing. Frame time per thread count, per-job timings of the widest run,
+// and a check that nested ParallelFor inside jobs covers every item once.
+static int RunFrameGraphBench(int argc, char** argv) {
+	int objectCount = GetIntOption(argc, argv, "--objects", 100000);
+	int lightCount = GetIntOption(argc, argv, "--lights", 2000);
+	int frames = GetIntOption(argc, argv, "--frames", 50);
+	int maxThreads = GetIntOption(argc, argv, "--threads", (int)std::max(1u, std::thread::hardware_concurrency()));
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> pos(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	vector<PointLight> points, basePoints;
+	vector<SpotLight> spots;
+	vector<RectLight> rects;
+	MakeLightField(lightCount, rng, basePoints, spots, rects);
+	vector<Float4> origins(objectCount);
+	for (Float4& o : origins)
+		o = { pos(rng), 6 * unit(rng), pos(rng) + 60.0f, unit(rng) * 6.28f };
+
+	printf("frame graph: %d objects, %d lights, %d frames\n", objectCount, lightCount, frames);
+	const Aabb cube = { { -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f } };
+	double singleThreaded = 0.0;
+	for (int threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+		ThreadPool pool(threads);
+		vector<Float4x4> transforms(objectCount);
+		vector<Aabb> boxes(objectCount);
+		vector<uint32_t> visible;
+		vector<Float4x4> visibleTransforms;
+		vector<Float4> visibleSpheres;
+		InstanceBuffer instances;
+		Bvh bvh;
+		ClusterGrid grid;
+		ObjectLightLists lists;
+		struct { Float4x4 viewProjection; Float4 viewPos; uint32_t objects, clusters, lights, pad; } constants;
+		float time = 0.0f;
+		Float4x4 worldToView, projection = Float4x4::PerspectiveLH(1.0f, 9.0f / 16.0f, 0.5f, 500.0f);
+		Frustum frustum;
+		points = basePoints;
+
+		FrameGraph graph;
+		FrameGraph::Node camera = graph.Add("camera", [&] {
+			worldToView = Float4x4::LookToLH({ 0, 4, -50 }, Normalize(Float3{ std::sin(time * 0.5f), -0.2f, 1 }), { 0, 1, 0 });
+			frustum = ExtractFrustum(worldToView * projection);
+		});
+		FrameGraph::Node objects = graph.Add("object update", [&] {
+			pool.ParallelFor((objectCount + 1023) / 1024, [&](size_t batch) {
+				size_t last = std::min((size_t)objectCount, (batch + 1) * 1024);
+				for (size_t i = batch * 1024; i < last; i++) {
+					const Float4& o = origins[i];
+					transforms[i] = Float4x4::RotationRollPitchYaw(0, o.w + time, 0) * Float4x4::Translation(o.x, o.y + std::sin(o.w + time), o.z);
+					boxes[i] = TransformAabb(cube, transforms[i]);
+				}
+			});
+		});
+		FrameGraph::Node lightUpdate = graph.Add("light update", [&] {
+			for (size_t i = 0; i < points.size(); i++)
+				points[i].Position.y = basePoints[i].Position.y + std::sin(time + i);
+		});
+		FrameGraph::Node culling = graph.Add("culling", [&] {
+			if (bvh.GetObjectCount() != boxes.size())
+				bvh.Build(boxes.data(), boxes.size());
+			else
+				bvh.Refit(boxes.data());
+			visible.clear();
+			bvh.Cull(frustum, visible);
+			std::sort(visible.begin(), visible.end());
+		}, { camera, objects });
+		FrameGraph::Node instancing = graph.Add("instances", [&] {
+			visibleTransforms.resize(visible.size());
+			for (size_t i = 0; i < visible.size(); i++)
+				visibleTransforms[i] = transforms[visible[i]];
+			instances.Clear();
+			instances.Append(visibleTransforms.data(), visibleTransforms.size(), &pool);
+		}, { culling });
+		FrameGraph::Node clusters = graph.Add("cluster grid", [&] {
+			ClusterGridDesc desc = { 1920, 1080, CLUSTER_TILE_SIZE, CLUSTER_SLICES, 0.5f, 500.0f, 1.0f / projection.m[0][0], 1.0f / projection.m[1][1] };
+			grid.Build(desc, worldToView, points.data(), points.size(), spots.data(), spots.size(), rects.data(), rects.size(), pool);
+		}, { camera, lightUpdate });
+		FrameGraph::Node objectLights = graph.Add("object lights", [&] {
+			visibleSpheres.resize(visible.size());
+			for (size_t i = 0; i < visible.size(); i++)
+				visibleSpheres[i] = TransformSphere({ 0, 0, 0, 0.87f }, transforms[visible[i]]);
+			lists.Build(visibleSpheres.data(), visibleSpheres.size(), points.data(), points.size(), spots.data(), spots.size(), rects.data(), rects.size(), pool);
+		}, { culling, lightUpdate });
+		graph.Add("constants", [&] {
+			constants.viewProjection = Transpose(worldToView * projection);
+			constants.viewPos = { 0, 4, -50, 1 };
+			constants.objects = (uint32_t)instances.GetCount();
+			constants.clusters = (uint32_t)grid.GetClusterCount();
+			constants.lights = (uint32_t)lists.GetLightIndices().size();
+		}, { instancing, clusters, objectLights });
+
+		graph.Run(pool); // sizes the buffers and builds the BVH
+		Clock::time_point start = Clock::now();
+		for (int frame = 0; frame < frames; frame++) {
+			time += 0.016f;
+			graph.Run(pool);
+		}
+		double seconds = SecondsSince(start);
+		if (threads == 1)
+			singleThreaded = seconds;
+		printf("  %2d threads: %7.3f ms/frame (%.2fx), %u visible, %u light indices\n",
+			threads, seconds * 1000.0 / frames, singleThreaded / seconds, constants.objects, constants.lights);
+
+		if (threads == maxThreads) {
+			printf("  last frame:\n");
+			for (const JobTiming& t : graph.GetTimings())
+				printf("    %-14s worker %2d  start %7.3f ms  %7.3f ms\n", t.name, t.worker, t.start, t.duration);
+			break;
+		}
+	}
+
+	// nested ParallelFor from inside jobs, every item exactly once
+	ThreadPool pool(maxThreads);
+	vector<std::atomic<int>> hits(64 * 1024);
+	FrameGraph nested;
+	for (int j = 0; j < 16; j++)
+		nested.Add("nested", [&, j] {
+			pool.ParallelFor(64, [&](size_t outer) {
+				pool.ParallelFor(64, [&](size_t inner) {
+					hits[(j * 64 + outer) * 64 + inner]++;
+				});
+			});
+		}, j > 0 ? std::initializer_list<FrameGraph::Node>{ j / 2 } : std::initializer_list<FrameGraph::Node>{});
+	nested.Run(pool);
+	size_t wrong = 0;
+	for (std::atomic<int>& h : hits)
+		wrong += h != 1;
+	printf("  nested jobs: %zu of %zu items not run exactly once\n", wrong, hits.size());
+	return wrong == 0 ? 0 : 1;
+}
+
+// Cost of a zone, nesting of the zones a rasterized frame records on every
+// thread, and where that frame's time goes
+static int RunProfileCheck(int argc, char** argv) {
+	int iterations = GetIntOption(argc, argv, "--iterations", 1000000);
+	int frames = GetIntOption(argc, argv, "--frames", 10);
+	int threads = GetIntOption(argc, argv, "--threads", 0);
+	const char* out = GetOption(argc, argv, "--out", nullptr);
+	std::string matPath = LutPath(argc, argv, "ltc_mat.dds");
+	std::string ampPath = LutPath(argc, argv, "ltc_amp.dds");
+	bool wasEnabled = Profiler::IsEnabled();
+
+	// two nested zones per iteration, against the same loop without them
+	volatile int sink = 0;
+	auto loop = [&](bool zones) {
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < iterations; i++) {
+			if (zones) {
+				PROFILE_ZONE("outer");
+				PROFILE_ZONE("inner");
+				sink = sink + 1;
+			}
+			else
+				sink = sink + 1;
+		}
+		return SecondsSince(start) * 1e9 / iterations;
+	};
+	Profiler::SetEnabled(true);
+	loop(true); // first touch of the ring
+	double bare = loop(false);
+	double enabled = (loop(true) - bare) / 2;
+	Profiler::SetEnabled(false);
+	double disabled = (loop(true) - bare) / 2;
+	printf("profiler: %d x 2 nested zones\n", iterations);
+	printf("  %.1f ns per zone recording, %.1f ns disabled\n", enabled, disabled);
+
+	Profiler::SetEnabled(true);
+	Profiler::Clear();
+	{
+		SoftwareGraphics gr(800, 600, matPath.c_str(), ampPath.c_str(), threads);
+		gr.AddRectLight({ 4, 0.3f, 5 }, { 1, 1, 1 }, 4, 1, 1, 0.0f, 0.5f);
+		PROFILE_ZONE("raster frames");
+		RenderScene(gr, frames);
+	}
+	vector<ProfileEvent> events;
+	size_t lost = Profiler::Collect(events);
+	if (out && !Profiler::WriteChromeTrace(out))
+		fprintf(stderr, "profile-check: could not write %s\n", out);
+	Profiler::SetEnabled(wasEnabled);
+
+	// per thread, a zone either ends before the next starts or contains it
+	size_t crossed = 0;
+	int threadCount = 0;
+	vector<const ProfileEvent*> open;
+	for (size_t i = 0; i < events.size(); i++) {
+		if (i == 0 || events[i].thread != events[i - 1].thread) {
+			open.clear();
+			threadCount++;
+		}
+		while (!open.empty() && open.back()->end <= events[i].start)
+			open.pop_back();
+		if (!open.empty() && events[i].end > open.back()->end)
+			crossed++;
+		open.push_back(&events[i]);
+	}
+
+	struct ZoneTotal { const char* name; size_t count; double ms; };
+	vector<ZoneTotal> totals;
+	for (const ProfileEvent& e : events) {
+		auto it = std::find_if(totals.begin(), totals.end(), [&](const ZoneTotal& t) { return strcmp(t.name, e.name) == 0; });
+		if (it == totals.end())
+			it = totals.insert(totals.end(), { e.name, 0, 0.0 });
+		it->count++;
+		it->ms += (Profiler::ToMicroseconds(e.end) - Profiler::ToMicroseconds(e.start)) / 1000.0;
+	}
+	std::sort(totals.begin(), totals.end(), [](const ZoneTotal& a, const ZoneTotal& b) { return a.ms > b.ms; });
+	printf("  %d raster frames: %zu zones on %d threads, %zu lost to full rings\n", frames, events.size(), threadCount, lost);
+	printf("    %-20s %8s %10s %10s\n", "zone", "count", "total ms", "mean us");
+	for (const ZoneTotal& t : totals)
+		printf("    %-20s %8zu %10.3f %10.2f\n", t.name, t.count, t.ms, t.ms * 1000.0 / t.count);
+
+	bool ok = crossed == 0 && enabled < 50.0 && !totals.empty();
+	printf("  %zu zones cross their parent\n", crossed);
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
+
+static int RunInstanceBench(int argc, char** argv) {
+	int count = GetIntOption(argc, argv, "--objects", 10000);
+	int frames = GetIntOption(argc, argv, "--frames", 100);
+	ThreadPool pool(GetIntOption(argc, argv, "--threads", 0));
+
+	NullRenderDevice device;
+	MeshCache meshes(device);
+	vector<Vertex> vBuffer;
+	vector<unsigned int> iBuffer;
+	AppendCube(vBuffer, iBuffer, 0);
+	MeshHandle cubeMesh = meshes.Register(vBuffer, iBuffer);
+
+	vector<Float4x4> transforms(count);
+	auto animate = [&](int frame) {
+		int side = (int)std::ceil(std::sqrt((double)count));
+		for (int i = 0; i < count; i++)
+			transforms[i] = Float4x4::RotationRollPitchYaw(0.01f * frame, 0.02f * frame + i, 0.0f)
+				* Float4x4::Translation(2.0f * (i % side), 0.0f, 2.0f * (i / side));
+	};
+
+	InstanceBuffer single, instanced;
+	double singleTime = 0.0, instancedTime = 0.0, threadedTime = 0.0;
+	size_t singleDraws = 0, instancedDraws = 0;
+	for (int frame = 0; frame < frames; frame++) {
+		animate(frame);
+
+		DeviceStats before = device.GetStats();
+		Clock::time_point start = Clock::now();
+		single.Clear();
+		for (int i = 0; i < count; i++)
+			meshes.Draw(cubeMesh, single.Append(&transforms[i], 1));
+		meshes.Flush();
+		singleTime += SecondsSince(start);
+		singleDraws += device.GetStats().draws - before.draws;
+
+		before = device.GetStats();
+		start = Clock::now();
+		instanced.Clear();
+		meshes.Draw(cubeMesh, instanced.Append(transforms.data(), count), (unsigned int)count);
+		meshes.Flush();
+		instancedTime += SecondsSince(start);
+		instancedDraws += device.GetStats().draws - before.draws;
+
+		start = Clock::now();
+		instanced.Clear();
+		meshes.Draw(cubeMesh, instanced.Append(transforms.data(), count, &pool), (unsigned int)count);
+		meshes.Flush();
+		threadedTime += SecondsSince(start);
+	}
+
+	bool same = single.GetCount() == instanced.GetCount()
+		&& memcmp(single.GetData(), instanced.GetData(), single.GetBytes()) == 0;
+
+	// stored normal transforms are the inverse model matrices
+	float maxError = 0.0f;
+	for (int i = 0; i < count; i += std::max(1, count / 64)) {
+		Float4x4 product = transforms[i] * instanced.GetData()[i].normalTransform;
+		for (int r = 0; r < 4; r++)
+			for (int c = 0; c < 4; c++)
+				maxError = std::max(maxError, std::fabs(product.m[r][c] - (r == c ? 1.0f : 0.0f)));
+	}
+
+	printf("instances: %d cubes, %d frames, %zu bytes of transforms per frame (%zu per object)\n",
+		count, frames, instanced.GetBytes(), sizeof(ObjectTransform));
+	printf("  one draw per cube: %8.3f ms per frame, %.0f draws\n", singleTime / frames * 1e3, (double)singleDraws / frames);
+	printf("  instanced:         %8.3f ms per frame, %.0f draws\n", instancedTime / frames * 1e3, (double)instancedDraws / frames);
+	printf("  instanced, %2d thr: %8.3f ms per frame\n", pool.GetThreadCount(), threadedTime / frames * 1e3);
+	printf("  single/instanced data %s, normal transform max error %.2g\n", same ? "identical" : "DIFFERENT", maxError);
+	if (!same || maxError > 1e-3f || instancedDraws != (size_t)frames) {
+		printf("FAILED\n");
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
+
+static int RunVertexPackBench(int argc, char** argv) {
+	int count = GetIntOption(argc, argv, "--vertices", 1 << 20);
+	int iterations = GetIntOption(argc, argv, "--iterations", 10);
+	ThreadPool pool(GetIntOption(argc, argv, "--threads", 0));
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	// the Fill* shapes repeated up to the vertex count, with the normals,
+	// uvs and colors of a real asset: random directions, tiled uvs, colors in [0, 1]
+	vector<Vertex> vertices;
+	vector<unsigned int> indices;
+	while ((int)vertices.size() < count) {
+		AppendCube(vertices, indices, 0);
+		AppendFloor(vertices, indices, 0);
+		AppendQuadLight(vertices, indices, { { 0, 0, 0, 1 }, { 1, 1, 0, 0 }, { 1, 1, 1, 1 } }, 0);
+		indices.clear();
+	}
+	vertices.resize(count);
+	for (Vertex& v : vertices) {
+		float z = 2.0f * unit(rng) - 1.0f, phi = 6.2831853f * unit(rng), r = std::sqrt(1.0f - z * z);
+		v.nx = r * std::cos(phi);
+		v.ny = r * std::sin(phi);
+		v.nz = z;
+		v.u = 4.0f * unit(rng);
+		v.v = 4.0f * unit(rng);
+		v.r = unit(rng);
+		v.g = unit(rng);
+		v.b = unit(rng);
+	}
+
+	vector<PackedVertex> packed;
+	PackVertices(vertices, packed);
+	double singleTime = 0.0, threadedTime = 0.0;
+	for (int i = 0; i < iterations; i++) {
+		Clock::time_point start = Clock::now();
+		PackVertices(vertices, packed);
+		singleTime += SecondsSince(start);
+
+		start = Clock::now();
+		PackVertices(vertices, packed, &pool);
+		threadedTime += SecondsSince(start);
+	}
+
+	float normalError = 0.0f, uvError = 0.0f, colorError = 0.0f;
+	for (int i = 0; i < count; i++) {
+		const Vertex& a = vertices[i];
+		Vertex b = UnpackVertex(packed[i]);
+		float dot = std::min(1.0f, a.nx * b.nx + a.ny * b.ny + a.nz * b.nz);
+		normalError = std::max(normalError, std::acos(dot));
+		uvError = std::max(uvError, std::max(std::fabs(a.u - b.u), std::fabs(a.v - b.v)));
+		colorError = std::max(colorError, std::max(std::fabs(a.r - b.r), std::max(std::fabs(a.g - b.g), std::fabs(a.b - b.b))));
+	}
+
+	// every finite half survives the round trip
+	int halfMismatches = 0;
+	for (unsigned int h = 0; h < 0x10000u; h++) {
+		if ((h & 0x7c00u) == 0x7c00u && (h & 0x3ffu))
+			continue;
+		if (FloatToHalf(HalfToFloat((unsigned short)h)) != h)
+			halfMismatches++;
+	}
+
+	NullRenderDevice device;
+	MeshCache meshes(device);
+	size_t before = device.GetStats().bytesAllocated;
+	vector<unsigned int> meshIndices = { 0, 1, 2 };
+	meshes.Register(vertices, meshIndices);
+	size_t fullBytes = device.GetStats().bytesAllocated - before;
+	before = device.GetStats().bytesAllocated;
+	meshes.Register(packed, meshIndices);
+	size_t packedBytes = device.GetStats().bytesAllocated - before;
+
+	size_t indexBytes = meshIndices.size() * sizeof(unsigned short);
+	fullBytes -= indexBytes;
+	packedBytes -= indexBytes;
+
+	double megabytes = count * (double)sizeof(Vertex) / (1 << 20);
+	printf("vertex packing: %d vertices, %d iterations\n", count, iterations);
+	printf("  bytes per vertex: %zu -> %zu, vertex buffer %.1f MB -> %.1f MB\n",
+		sizeof(Vertex), sizeof(PackedVertex), fullBytes / (double)(1 << 20), packedBytes / (double)(1 << 20));
+	printf("  1 thread:  %8.3f ms, %7.1f Mvertices/s, %7.0f MB/s read\n",
+		singleTime / iterations * 1e3, count * iterations / singleTime * 1e-6, megabytes * iterations / singleTime);
+	printf("  %2d threads: %7.3f ms, %7.1f Mvertices/s, %7.0f MB/s read\n", pool.GetThreadCount(),
+		threadedTime / iterations * 1e3, count * iterations / threadedTime * 1e-6, megabytes * iterations / threadedTime);
+	printf("  max error: normal %.3g deg, uv %.3g, color %.3g; half round trip mismatches %d\n",
+		normalError * 57.29578f, uvError, colorError, halfMismatches);
+
+	// snorm16 octahedral stays under ~0.04 degree, half uvs in [2, 4) are 2^-9
+	// apart and RGBA8 rounds to 1/510
+	if (normalError * 57.29578f > 0.05f || uvError > 1.0f / 1024 || colorError > 1.0f / 510 + 1e-6f
+		|| halfMismatches != 0 || packedBytes * 2 != fullBytes) {
+		printf("FAILED\n");
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
+
+static int RunClusterBench(int argc, char** argv) {
+	int lightCount = GetIntOption(argc, argv, "--lights", 10000);
+	int width = GetIntOption(argc, argv, "--width", 1920);
+	int height = GetIntOption(argc, argv, "--height", 1080);
+	int iterations = GetIntOption(argc, argv, "--iterations", 20);
+	int maxThreads = GetIntOption(argc, argv, "--threads", (int)std::max(1u, std::thread::hardware_concurrency()));
+
+	std::mt19937 rng(1234);
+	vector<PointLight> points;
+	vector<SpotLight> spots;
+	vector<RectLight> rects;
+	MakeLightField(lightCount, rng, points, spots, rects);
+
+	// the Graphics camera and projection, looking over the light field
+	Float4x4 projection = Float4x4::PerspectiveLH(1.0f, (float)height / width, 0.5f, 500.0f);
+	Float4x4 worldToView = Float4x4::LookToLH({ 0, 4, -50 }, Normalize(Float3{ 0, -0.2f, 1 }), { 0, 1, 0 });
+	ClusterGridDesc desc = {
+		width, height, CLUSTER_TILE_SIZE, CLUSTER_SLICES, 0.5f, 500.0f,
+		1.0f / projection.m[0][0], 1.0f / projection.m[1][1]
+	};
+
+	printf("clusters: %d lights (%zu point, %zu spot, %zu rect), %dx%d\n",
+		lightCount, points.size(), spots.size(), rects.size(), width, height);
+
+	ClusterGrid reference;
+	double singleThreaded = 0.0;
+	for (int threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+		ThreadPool pool(threads);
+		ClusterGrid grid;
+		double best = 1e30, total = 0.0;
+		for (int it = 0; it <= iterations; it++) {
+			Clock::time_point start = Clock::now();
+			grid.Build(desc, worldToView, points.data(), points.size(), spots.data(), spots.size(), rects.data(), rects.size(), pool);
+			double seconds = SecondsSince(start);
+			if (it == 0)
+				continue; // first build sizes the buffers
+			best = std::min(best, seconds);
+			total += seconds;
+		}
+		if (threads == 1) {
+			singleThreaded = best;
+			reference = grid;
+		}
+
+		bool same = grid.GetLightIndices() == reference.GetLightIndices()
+			&& memcmp(grid.GetClusters().data(), reference.GetClusters().data(), grid.GetClusterCount() * sizeof(ClusterRange)) == 0;
+		printf("  %2d threads: %7.3f ms min, %7.3f ms mean (%.2fx)%s\n",
+			threads, best * 1000.0, total * 1000.0 / iterations, singleThreaded / best, same ? "" : "  MISMATCH vs 1 thread");
+		if (!same)
+			return 1;
+		if (threads == maxThreads)
+			break;
+	}
+
+	const vector<ClusterRange>& clusters = reference.GetClusters();
+	size_t nonEmpty = 0, maxLights = 0;
+	for (const ClusterRange& c : clusters) {
+		size_t n = c.pointCount + c.spotCount + c.rectCount;
+		nonEmpty += n > 0;
+		maxLights = std::max(maxLights, n);
+	}
+	printf("  %zu clusters, %zu non-empty, %zu light indices, %.1f per non-empty cluster, max %zu\n",
+		clusters.size(), nonEmpty, reference.GetLightIndices().size(),
+		nonEmpty ? (double)reference.GetLightIndices().size() / nonEmpty : 0.0, maxLights);
+
+	// Every light whose range contains a point must be in the point's cluster.
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	Float4x4 viewToWorld = Inverse(worldToView);
+	int samples = GetIntOption(argc, argv, "--samples", 20000), missing = 0;
+	for (int i = 0; i < samples; i++) {
+		float sx = unit(rng), sy = unit(rng);
+		float z = desc.nearZ * std::pow(desc.farZ / desc.nearZ, unit(rng));
+		Float3 view = { (2 * sx - 1) * desc.tanHalfFovX * z, (1 - 2 * sy) * desc.tanHalfFovY * z, z };
+		Float3 world = XYZ(Transform({ view.x, view.y, view.z, 1 }, viewToWorld));
+		int tileX = std::min((int)(sx * width) / desc.tileSize, reference.GetTilesX() - 1);
+		int tileY = std::min((int)(sy * height) / desc.tileSize, reference.GetTilesY() - 1);
+		const ClusterRange& c = clusters[reference.GetClusterIndex(tileX, tileY, reference.GetSlice(z))];
+		const uint32_t* list = reference.GetLightIndices().data() + c.offset;
+
+		auto listed = [](const uint32_t* first, uint32_t count, uint32_t index) {
+			return std::find(first, first + count, index) != first + count;
+		};
+		for (size_t l = 0; l < points.size(); l++)
+			if (Length(XYZ(points[l].Position) - world) < PointLightRange(points[l]) && !listed(list, c.pointCount, (uint32_t)l))
+				missing++;
+		for (size_t l = 0; l < spots.size(); l++)
+			if (Length(XYZ(spots[l].Position) - world) < SpotLightRange(spots[l]) && !listed(list + c.pointCount, c.spotCount, (uint32_t)l))
+				missing++;
+		for (size_t l = 0; l < rects.size(); l++)
+			if (Length(XYZ(rects[l].Position) - world) < RectLightRange(rects[l]) && !listed(list + c.pointCount + c.spotCount, c.rectCount, (uint32_t)l))
+				missing++;
+	}
+	printf("  validation: %d sample points, %d lights missing from their cluster\n", samples, missing);
+	return missing == 0 ? 0 : 1;
+}
+
+// Regenerates ltc_mat.dds / ltc_amp.dds. The shipped tables are scored with
+// the same error when they have the requested size.
+static int RunLTCFit(int argc, char** argv) {
+	LTCFitDesc desc;
+	desc.size = GetIntOption(argc, argv, "--size", LTC_LUT_SIZE);
+	desc.samples = GetIntOption(argc, argv, "--samples", 32);
+	desc.iterations = GetIntOption(argc, argv, "--iterations", 200);
+	std::string outDir = GetOption(argc, argv, "--out-dir", ".");
+	const char* errorsPath = GetOption(argc, argv, "--errors", nullptr);
+	if (desc.size < 2 || desc.samples < 1)
+		return -1;
+	if (outDir.back() != '/' && outDir.back() != '\\')
+		outDir += '/';
+
+	ThreadPool pool(GetIntOption(argc, argv, "--threads", 0));
+	LTCFitter fitter(desc);
+	Clock::time_point start = Clock::now();
+	fitter.Fit(pool);
+	double fitTime = SecondsSince(start);
+
+	const vector<LTCFitEntry>& entries = fitter.GetEntries();
+	vector<float> errors;
+	double errorSum = 0.0, entrySeconds = 0.0;
+	size_t worst = 0;
+	for (size_t i = 0; i < entries.size(); i++) {
+		errors.push_back(entries[i].error);
+		errorSum += entries[i].error;
+		entrySeconds += entries[i].seconds;
+		if (entries[i].error > entries[worst].error)
+			worst = i;
+	}
+	std::sort(errors.begin(), errors.end());
+
+	printf("ltc-fit: %dx%d GGX table, %dx%d samples per lobe, %d threads\n", desc.size, desc.size, desc.samples, desc.samples, pool.GetThreadCount());
+	printf("  fit time:  %.2f s, %.2f ms per entry\n", fitTime, entrySeconds / entries.size() * 1e3);
+	printf("  L1 error:  mean %.4f, p95 %.4f, max %.4f (roughness %.3f, theta %.3f)\n",
+		errorSum / entries.size(), errors[errors.size() * 95 / 100], errors.back(),
+		(worst % desc.size) / (float)(desc.size - 1), fitter.GetTheta((int)(worst / desc.size)));
+
+	vector<Float4> shippedMat;
+	int shippedWidth, shippedHeight;
+	if (ReadFloatDDS(LutPath(argc, argv, "ltc_mat.dds").c_str(), shippedWidth, shippedHeight, shippedMat) && shippedWidth == desc.size && shippedHeight == desc.size) {
+		vector<float> shippedErrors(shippedMat.size());
+		pool.ParallelFor(shippedMat.size(), [&](size_t i) {
+			shippedErrors[i] = fitter.Evaluate(shippedMat[i], (int)(i % desc.size), (int)(i / desc.size));
+		});
+		double shippedSum = 0.0;
+		for (float error : shippedErrors)
+			shippedSum += error;
+		printf("  shipped:   mean %.4f, max %.4f\n", shippedSum / shippedErrors.size(), *std::max_element(shippedErrors.begin(), shippedErrors.end()));
+	}
+
+	if (errorsPath) {
+		FILE* file = fopen(errorsPath, "w");
+		if (!file)
+			return -1;
+		fprintf(file, "roughness,theta,error,ms,m22,m02,m11,m20,norm,fresnel\n");
+		for (size_t i = 0; i < entries.size(); i++) {
+			const LTCFitEntry& e = entries[i];
+			fprintf(file, "%g,%g,%g,%g,%g,%g,%g,%g,%g,%g\n",
+				(i % desc.size) / (float)(desc.size - 1), fitter.GetTheta((int)(i / desc.size)), e.error, e.seconds * 1e3,
+				e.mat.x, e.mat.y, e.mat.z, e.mat.w, e.amp.x, e.amp.y);
+		}
+		fclose(file);
+	}
+
+	vector<Float4> mat, amp;
+	fitter.GetTables(mat, amp);
+	std::string matPath = outDir + "ltc_mat.dds";
+	std::string ampPath = outDir + "ltc_amp.dds";
+	if (!WriteFloatDDS(matPath.c_str(), desc.size, desc.size, 4, mat) || !WriteFloatDDS(ampPath.c_str(), desc.size, desc.size, 2, amp)) {
+		fprintf(stderr, "ltc-fit: writing %s fucked up\n", matPath.c_str());
+		return 1;
+	}
+
+	// read back through the renderer's loader
+	LTC check(matPath.c_str(), ampPath.c_str());
+	printf("  wrote %s, %s (%d x %d)\n", matPath.c_str(), ampPath.c_str(), check.GetLutSize(), check.GetLutSize());
+	return 0;
+}
+
+// Prefilters an image into dataFiltered.dds; without --in a test pattern of
+// colored bars and fine checkers. Checks the incremental mip chain against a
+// direct Gaussian of the unfiltered canvas on the levels whose blur stays
+// inside the padding.
+static int RunLightFilter(int argc, char** argv) {
+	const char* in = GetOption(argc, argv, "--in", nullptr);
+	const char* out = GetOption(argc, argv, "--out", "dataFiltered.dds");
+	int size = GetIntOption(argc, argv, "--size", (int)LIGHT_TEXTURE_LOD_SCALE);
+	int checks = GetIntOption(argc, argv, "--check", 32);
+	bool floatTexels = GetOption(argc, argv, "--float", nullptr) != nullptr;
+	if (size < 8 || (size & (size - 1)))
+		return -1;
+
+	int width, height;
+	vector<Float4> source;
+	if (in) {
+		if (!ReadLightImage(in, width, height, source)) {
+			fprintf(stderr, "light-filter: cannot read %s\n", in);
+			return 1;
+		}
+	}
+	else {
+		width = height = 512;
+		source.resize((size_t)width * height);
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				float bar = (float)(x * 6 / width);
+				Float4 color = { 0.5f + 0.5f * std::cos(bar), 0.5f + 0.5f * std::cos(bar + 2.1f), 0.5f + 0.5f * std::cos(bar + 4.2f), 1.0f };
+				float checker = ((x / 8 + y / 8) & 1) ? 1.0f : 0.2f;
+				source[(size_t)y * width + x] = y < height / 2 ? color : Float4{ checker, checker, checker, 1.0f };
+			}
+		}
+	}
+
+	ThreadPool pool(GetIntOption(argc, argv, "--threads", 0));
+	vector<LightTextureLevel> levels;
+	Clock::time_point start = Clock::now();
+	PrefilterLightTexture(source, width, height, size, pool, levels);
+	double filterTime = SecondsSince(start);
+
+	start = Clock::now();
+	if (!WriteLightTextureDDS(out, levels, floatTexels)) {
+		fprintf(stderr, "light-filter: cannot write %s\n", out);
+		return 1;
+	}
+	double writeTime = SecondsSince(start);
+
+	printf("light-filter: %s %dx%d -> %s, %dx%d, %zu mips, %s, %d threads, SIMD width %d\n",
+		in ? in : "test pattern", width, height, out, size, size, levels.size(),
+		floatTexels ? "R32G32B32A32_FLOAT" : "R8G8B8A8 sRGB", pool.GetThreadCount(), SIMD_WIDTH);
+	printf("  filter %.3f s, write %.3f s\n", filterTime, writeTime);
+
+	LightTextureLevel canvas;
+	PlaceLightTexture(source, width, height, size, pool, canvas);
+	std::mt19937 rng(5);
+	int failed = 0;
+	for (int level = 0; level < (int)levels.size() && checks > 0; level++) {
+		if (3.0f * LightTextureSigma(level) > LIGHT_TEXTURE_PADDING)
+			break;
+
+		const LightTextureLevel& filtered = levels[level];
+		float maxError = 0.0f;
+		for (int i = 0; i < checks; i++) {
+			int x = (int)(rng() % filtered.size), y = (int)(rng() % filtered.size);
+			size_t t = (size_t)y * filtered.size + x;
+			Float3 reference = ReferenceLightTexel(canvas, level, x, y);
+			maxError = std::max({ maxError, std::fabs(filtered.r[t] - reference.x),
+				std::fabs(filtered.g[t] - reference.y), std::fabs(filtered.b[t] - reference.z) });
+		}
+		// a few percent of the box filter's shape is not Gaussian
+		bool ok = maxError < 0.03f;
+		failed += !ok;
+		printf("  level %2d: %4d px, sigma %.5f uv, max error vs direct Gaussian %.4f%s\n",
+			level, filtered.size, LightTextureSigma(level), maxError, ok ? "" : "  FAILED");
+	}
+	return failed ? 1 : 0;
+}
+
+// One load the way each DDSTextureLoader path does it, up to handing the
+// subresources to the driver, which is modeled by copying them into a
+// texture-sized allocation. privateBytes is sampled at the peak of the load.
+static bool LoadDDSOnce(const char* path, bool mapped, vector<uint8_t>& texture, size_t* privateBytes) {
+	MappedFile file;
+	std::unique_ptr<uint8_t[]> heapCopy;
+	const uint8_t* data;
+	size_t size;
+
+	if (mapped) {
+		if (!file.Open(path))
+			return false;
+		data = file.GetData();
+		size = file.GetSize();
+	}
+	else {
+		FILE* f = fopen(path, "rb");
+		if (!f)
+			return false;
+		fseek(f, 0, SEEK_END);
+		size = (size_t)ftell(f);
+		fseek(f, 0, SEEK_SET);
+		heapCopy.reset(new uint8_t[size]);
+		size_t read = fread(heapCopy.get(), 1, size, f);
+		fclose(f);
+		if (read != size)
+			return false;
+		data = heapCopy.get();
+	}
+
+	DDSInfo info;
+	if (!ParseDDS(data, size, info))
+		return false;
+
+	texture.resize(info.bitSize);
+	memcpy(texture.data(), info.bits, info.bitSize);
+	if (privateBytes) {
+		size_t peakResident;
+		GetMemoryUsage(peakResident, *privateBytes);
+	}
+	return true;
+}
+
+// Without --mode, runs each path in its own process so peak RSS is per path.
+static int RunDDSLoadBench(int argc, char** argv) {
+	const char* path = GetOption(argc, argv, "--file", "../Direct3D_PolygonalLights/Sponza_Bricks_a_Albedo.dds");
+	int iterations = GetIntOption(argc, argv, "--iterations", 200);
+	const char* mode = GetOption(argc, argv, "--mode", nullptr);
+
+	if (!mode) {
+		MappedFile file;
+		DDSInfo info;
+		if (!file.Open(path) || !ParseDDS(file.GetData(), file.GetSize(), info)) {
+			fprintf(stderr, "dds-load-bench: %s is not a DDS file\n", path);
+			return 1;
+		}
+		printf("dds-load: %s, %ux%u, %u mips, %zu bytes, %d loads (warm page cache)\n",
+			path, info.width, info.height, info.mipCount, file.GetSize(), iterations);
+		fflush(stdout);
+
+		int result = 0;
+		for (const char* child : { "read", "mmap" }) {
+			std::string command = std::string("\"") + argv[0] + "\" dds-load-bench --mode " + child
+				+ " --file \"" + path + "\" --iterations " + std::to_string(iterations);
+			result |= std::system(command.c_str());
+		}
+		return result ? 1 : 0;
+	}
+
+	bool mapped = strcmp(mode, "mmap") == 0;
+	size_t peakBefore, privateBefore;
+	GetMemoryUsage(peakBefore, privateBefore);
+
+	vector<uint8_t> texture;
+	double best = 1e30, total = 0.0;
+	for (int it = 0; it < iterations; it++) {
+		// a fresh texture every time, like a real load
+		vector<uint8_t>().swap(texture);
+		Clock::time_point start = Clock::now();
+		if (!LoadDDSOnce(path, mapped, texture, nullptr))
+			return 1;
+		double time = SecondsSince(start);
+		best = std::min(best, time);
+		total += time;
+	}
+
+	// Mapped pages count towards RSS once touched, but they are clean page
+	// cache pages; the private bytes show the heap copy the mapping avoids.
+	size_t privateAtPeak = 0, peakResident, privateNow;
+	vector<uint8_t>().swap(texture);
+	if (!LoadDDSOnce(path, mapped, texture, &privateAtPeak))
+		return 1;
+	GetMemoryUsage(peakResident, privateNow);
+
+	printf("  %-5s %8.3f ms min, %8.3f ms mean, peak RSS +%.2f MB, private at peak +%.2f MB\n", mode,
+		best * 1e3, total / iterations * 1e3,
+		(peakResident - std::min(peakResident, peakBefore)) / 1048576.0,
+		(privateAtPeak - std::min(privateAtPeak, privateBefore)) / 1048576.0);
+	return 0;
+}
+
+// Stand-in for a GPU upload: maps the file and copies every mip no larger
+// than maxSize, as FillInitData hands them to the driver. size is the
+// largest dimension of the top mip copied, complete when none was skipped.
+static bool LoadMips(const std::string& path, size_t maxSize, vector<uint8_t>& texture, size_t& size, bool& complete) {
+	MappedFile file;
+	DDSInfo info;
+	vector<DDSMip> mips;
+	if (!file.Open(path.c_str()) || !ParseDDS(file.GetData(), file.GetSize(), info) || !GetDDSMipLayout(info, mips))
+		return false;
+
+	size_t first = 0;
+	while (maxSize && first + 1 < mips.size() && std::max(mips[first].width, mips[first].height) > maxSize)
+		first++;
+
+	size_t offset = mips[first].offset;
+	texture.resize(mips.back().offset + mips.back().bytes - offset);
+	memcpy(texture.data(), info.bits + offset, texture.size());
+	size = std::max(mips[first].width, mips[first].height);
+	complete = first == 0;
+	return true;
+}
+
+#define TEST_TEXTURE_FORMAT 71 // DXGI_FORMAT_BC1_UNORM
+
+// Square BC1 texture with a full mip chain of random blocks; returns its bytes, 0 on failure.
+static size_t WriteTestTexture(const std::string& path, uint32_t size, std::mt19937& rng) {
+	uint32_t mipCount = 1;
+	while ((size >> (mipCount - 1)) > 1)
+		mipCount++;
+
+	vector<DDSMip> mips;
+	GetDDSMipLayout(size, size, mipCount, TEST_TEXTURE_FORMAT, mips);
+	vector<uint8_t> bits(mips.back().offset + mips.back().bytes);
+	for (uint8_t& b : bits)
+		b = (uint8_t)rng();
+
+	if (!WriteDDS(path.c_str(), size, size, mipCount, TEST_TEXTURE_FORMAT, bits.data(), bits.size()))
+		return 0;
+	return bits.size();
+}
+
+// Writes BC1 files with full mip chains and compares the time until the first
+// frame can sample a texture, streamed against loading every mip up front.
+static int RunMipStreamBench(int argc, char** argv) {
+	std::string dir = GetOption(argc, argv, "--dir", ".");
+	int firstSize = GetIntOption(argc, argv, "--first-size", 64);
+	int iterations = GetIntOption(argc, argv, "--iterations", 20);
+
+	printf("mip-stream: BC1, first step <= %d px, growth 4x, %d loads each (warm page cache)\n", firstSize, iterations);
+	printf("  %6s %10s %14s %14s %14s\n", "size", "MB", "full load ms", "first mip ms", "all mips ms");
+
+	std::mt19937 rng(7);
+	auto loader = [](const std::string& path, size_t maxSize, vector<uint8_t>& texture, bool& complete) {
+		size_t size;
+		return LoadMips(path, maxSize, texture, size, complete);
+	};
+	for (uint32_t size : { 256u, 1024u, 4096u, 8192u }) {
+		std::string path = dir + "/mip_stream_" + std::to_string(size) + ".dds";
+		size_t bytes = WriteTestTexture(path, size, rng);
+		if (!bytes) {
+			fprintf(stderr, "mip-stream-bench: cannot write %s\n", path.c_str());
+			return 1;
+		}
+
+		double full = 1e30, first = 1e30, all = 1e30;
+		bool ok = true;
+		for (int it = 0; it < iterations && ok; it++) {
+			vector<uint8_t> texture;
+			size_t loaded;
+			bool complete;
+			Clock::time_point start = Clock::now();
+			ok = LoadMips(path, 0, texture, loaded, complete);
+			full = std::min(full, SecondsSince(start));
+
+			MipStreamer<vector<uint8_t>> streamer(loader, (size_t)firstSize);
+			start = Clock::now();
+			ok = ok && streamer.Load(path, texture) != 0;
+			first = std::min(first, SecondsSince(start));
+			streamer.WaitIdle();
+			all = std::min(all, SecondsSince(start));
+
+			size_t largest = 0;
+			streamer.Update([&](unsigned int, vector<uint8_t>& step) { largest = std::max(largest, step.size()); });
+			ok = ok && (largest == bytes || texture.size() == bytes);
+		}
+		remove(path.c_str());
+		if (!ok) {
+			fprintf(stderr, "mip-stream-bench: streaming %s fucked up\n", path.c_str());
+			return 1;
+		}
+
+		printf("  %6u %10.2f %14.3f %14.3f %14.3f\n", size, bytes / 1048576.0, full * 1e3, first * 1e3, all * 1e3);
+	}
+	return 0;
+}
+
+// Materials drawn by a camera panning over a row of them, with several
+// materials sharing each texture file. Checks that equal path+flags share
+// one load and that the resident bytes stay under the budget whenever a
+// frame's own textures fit in it.
+static int RunTextureCacheBench(int argc, char** argv) {
+	std::string dir = GetOption(argc, argv, "--dir", ".");
+	int textureCount = GetIntOption(argc, argv, "--textures", 24);
+	int materialCount = GetIntOption(argc, argv, "--materials", 64);
+	int visible = GetIntOption(argc, argv, "--visible", 12);
+	int frames = GetIntOption(argc, argv, "--frames", 400);
+	size_t budget = (size_t)GetIntOption(argc, argv, "--budget-mb", 4) << 20;
+
+	std::mt19937 rng(11);
+	vector<std::string> paths(textureCount);
+	size_t fileBytes = 0;
+	for (int i = 0; i < textureCount; i++) {
+		paths[i] = dir + "/texture_cache_" + std::to_string(i) + ".dds";
+		size_t bytes = WriteTestTexture(paths[i], 256u << (i % 4), rng);
+		if (!bytes) {
+			fprintf(stderr, "texture-cache-bench: cannot write %s\n", paths[i].c_str());
+			return 1;
+		}
+		fileBytes += bytes;
+	}
+
+	// material -> texture, neighbours tend to share files like a real level
+	vector<int> materials(materialCount);
+	for (int i = 0; i < materialCount; i++)
+		materials[i] = (i / 2 + (int)(rng() % 3)) % textureCount;
+
+	unsigned long long loads = 0;
+	TextureCache<vector<uint8_t>> cache(
+		[&](const std::string& path, uint32_t, size_t maxSize, vector<uint8_t>& texture, size_t& bytes, size_t& size) {
+			bool complete;
+			loads++;
+			if (!LoadMips(path, maxSize, texture, size, complete))
+				return false;
+			bytes = texture.size();
+			return true;
+		}, budget);
+
+	bool ok = cache.Acquire(paths[0]) == cache.Acquire(paths[0]) && cache.Acquire(paths[0], 1) != cache.Acquire(paths[0]) && loads == 2;
+	cache.Clear();
+	cache.ResetCounters();
+
+	size_t worstOver = 0;
+	Clock::time_point start = Clock::now();
+	for (int frame = 0; frame < frames && ok; frame++) {
+		// back and forth over the row, a material every other frame
+		int span = materialCount - visible;
+		int pan = span > 0 ? frame / 2 % (2 * span) : 0;
+		int first = pan < span ? pan : 2 * span - pan;
+		size_t frameBytes = 0;
+		for (int m = first; m < first + visible && m < materialCount; m++) {
+			const vector<uint8_t>* texture = cache.Acquire(paths[materials[m]]);
+			ok = ok && texture;
+			frameBytes += texture ? texture->size() : 0;
+		}
+		if (cache.GetStats().bytes > std::max(budget, frameBytes))
+			worstOver = std::max(worstOver, cache.GetStats().bytes - std::max(budget, frameBytes));
+		cache.NextFrame();
+	}
+	double seconds = SecondsSince(start);
+
+	for (const std::string& path : paths)
+		remove(path.c_str());
+
+	const TextureCacheStats& stats = cache.GetStats();
+	printf("texture-cache: %d textures (%.2f MB on disk), %d materials, %d visible, %d frames, budget %.2f MB\n",
+		textureCount, fileBytes / 1048576.0, materialCount, visible, frames, budget / 1048576.0);
+	printf("  hits %llu, misses %llu, evictions %llu, mip evictions %llu, restores %llu, loads %llu\n",
+		stats.hits, stats.misses, stats.evictions, stats.mipEvictions, stats.restores, loads);
+	printf("  resident %.2f MB in %zu textures, peak %.2f MB, %.3f ms per frame\n",
+		stats.bytes / 1048576.0, stats.textures, stats.peakBytes / 1048576.0, seconds / frames * 1e3);
+
+	if (!ok || worstOver) {
+		fprintf(stderr, "texture-cache-bench: %s\n", ok ? "budget exceeded" : "deduplication fucked up");
+		return 1;
+	}
+	printf("  deduplication and budget ok\n");
+	return 0;
+}
+
+// A wavy grid of side x side vertices in the right-handed space both formats
+// use, in four bands of materials. Written as OBJ with quads (the second half
+// with negative indices) and as glTF with an external buffer, one triangle
+// primitive per band in the same order, so both imports must agree.
+static bool WriteTestModel(const std::string& base, int side, size_t& objBytes) {
+	const float colors[4][3] = { { 0.8f, 0.2f, 0.2f }, { 0.2f, 0.8f, 0.2f }, { 0.2f, 0.2f, 0.8f }, { 0.9f, 0.9f, 0.9f } };
+	size_t vertexCount = (size_t)side * side;
+	vector<float> positions(vertexCount * 3), normals(vertexCount * 3), uvs(vertexCount * 2);
+	for (int j = 0; j < side; j++) {
+		for (int i = 0; i < side; i++) {
+			size_t v = (size_t)j * side + i;
+			float x = i * 0.1f, z = j * 0.1f;
+			Float3 n = Normalize(Float3{ -0.3f * std::cos(x) * std::cos(z), 1.0f, 0.3f * std::sin(x) * std::sin(z) });
+			positions[v * 3] = x;
+			positions[v * 3 + 1] = 0.3f * std::sin(x) * std::cos(z);
+			positions[v * 3 + 2] = z;
+			normals[v * 3] = n.x;
+			normals[v * 3 + 1] = n.y;
+			normals[v * 3 + 2] = n.z;
+			uvs[v * 2] = (float)i / (side - 1);
+			uvs[v * 2 + 1] = (float)j / (side - 1);
+		}
+	}
+
+	// quads a d c b face up, counter-clockwise seen from above
+	vector<unsigned int> indices;
+	size_t bandFirst[5];
+	for (int band = 0; band < 4; band++) {
+		bandFirst[band] = indices.size();
+		for (int j = band * (side - 1) / 4; j < (band + 1) * (side - 1) / 4; j++) {
+			for (int i = 0; i + 1 < side; i++) {
+				unsigned int a = j * side + i, b = a + 1, c = b + side, d = a + side;
+				for (unsigned int index : { a, d, c, a, c, b })
+					indices.push_back(index);
+			}
+		}
+	}
+	bandFirst[4] = indices.size();
+
+	std::string name = base.substr(base.find_last_of("/\\") + 1);
+	FILE* f = fopen((base + ".mtl").c_str(), "wb");
+	if (!f)
+		return false;
+	for (int band = 0; band < 4; band++)
+		fprintf(f, "newmtl band%d\nKd %g %g %g\n\n", band, colors[band][0], colors[band][1], colors[band][2]);
+	fclose(f);
+
+	f = fopen((base + ".obj").c_str(), "wb");
+	if (!f)
+		return false;
+	fprintf(f, "# mesh-import-bench test model\nmtllib %s.mtl\n", name.c_str());
+	for (size_t v = 0; v < vertexCount; v++)
+		fprintf(f, "v %.6f %.6f %.6f\n", positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+	for (size_t v = 0; v < vertexCount; v++)
+		fprintf(f, "vt %.6f %.6f\n", uvs[v * 2], uvs[v * 2 + 1]);
+	for (size_t v = 0; v < vertexCount; v++)
+		fprintf(f, "vn %.6f %.6f %.6f\n", normals[v * 3], normals[v * 3 + 1], normals[v * 3 + 2]);
+	for (int band = 0; band < 4; band++) {
+		fprintf(f, "usemtl band%d\n", band);
+		for (size_t i = bandFirst[band]; i < bandFirst[band + 1]; i += 6) {
+			long long corner[4] = { indices[i] + 1, indices[i + 1] + 1, indices[i + 2] + 1, indices[i + 5] + 1 };
+			if (i >= indices.size() / 2)
+				for (long long& c : corner)
+					c -= (long long)vertexCount + 1;
+			fprintf(f, "f %lld/%lld/%lld %lld/%lld/%lld %lld/%lld/%lld %lld/%lld/%lld\n",
+				corner[0], corner[0], corner[0], corner[1], corner[1], corner[1], corner[2], corner[2], corner[2], corner[3], corner[3], corner[3]);
+		}
+	}
+	objBytes = (size_t)ftell(f);
+	fclose(f);
+
+	// glTF texture coordinates start at the top
+	for (size_t v = 0; v < vertexCount; v++)
+		uvs[v * 2 + 1] = 1.0f - uvs[v * 2 + 1];
+	f = fopen((base + ".bin").c_str(), "wb");
+	if (!f)
+		return false;
+	fwrite(positions.data(), sizeof(float), positions.size(), f);
+	fwrite(normals.data(), sizeof(float), normals.size(), f);
+	fwrite(uvs.data(), sizeof(float), uvs.size(), f);
+	fwrite(indices.data(), sizeof(unsigned int), indices.size(), f);
+	size_t binBytes = (size_t)ftell(f);
+	fclose(f);
+
+	f = fopen((base + ".gltf").c_str(), "wb");
+	if (!f)
+		return false;
+	size_t p = positions.size() * 4, n = normals.size() * 4, t = uvs.size() * 4;
+	fprintf(f, "{\n\"asset\": { \"version\": \"2.0\" },\n\"scene\": 0,\n\"scenes\": [ { \"nodes\": [ 0 ] } ],\n\"nodes\": [ { \"mesh\": 0 } ],\n");
+	fprintf(f, "\"buffers\": [ { \"uri\": \"%s.bin\", \"byteLength\": %zu } ],\n", name.c_str(), binBytes);
+	fprintf(f, "\"bufferViews\": [ { \"buffer\": 0, \"byteOffset\": 0, \"byteLength\": %zu }, { \"buffer\": 0, \"byteOffset\": %zu, \"byteLength\": %zu },\n"
+		"\t{ \"buffer\": 0, \"byteOffset\": %zu, \"byteLength\": %zu }, { \"buffer\": 0, \"byteOffset\": %zu, \"byteLength\": %zu } ],\n",
+		p, p, n, p + n, t, p + n + t, indices.size() * 4);
+	fprintf(f, "\"accessors\": [ { \"bufferView\": 0, \"componentType\": 5126, \"count\": %zu, \"type\": \"VEC3\" },\n"
+		"\t{ \"bufferView\": 1, \"componentType\": 5126, \"count\": %zu, \"type\": \"VEC3\" },\n"
+		"\t{ \"bufferView\": 2, \"componentType\": 5126, \"count\": %zu, \"type\": \"VEC2\" }", vertexCount, vertexCount, vertexCount);
+	for (int band = 0; band < 4; band++)
+		fprintf(f, ",\n\t{ \"bufferView\": 3, \"byteOffset\": %zu, \"componentType\": 5125, \"count\": %zu, \"type\": \"SCALAR\" }",
+			bandFirst[band] * 4, bandFirst[band + 1] - bandFirst[band]);
+	fprintf(f, " ],\n\"materials\": [");
+	for (int band = 0; band < 4; band++)
+		fprintf(f, "%s { \"name\": \"band%d\", \"pbrMetallicRoughness\": { \"baseColorFactor\": [ %g, %g, %g, 1 ] } }",
+			band ? "," : "", band, colors[band][0], colors[band][1], colors[band][2]);
+	fprintf(f, " ],\n\"meshes\": [ { \"primitives\": [");
+	for (int band = 0; band < 4; band++)
+		fprintf(f, "%s { \"attributes\": { \"POSITION\": 0, \"NORMAL\": 1, \"TEXCOORD_0\": 2 }, \"indices\": %d, \"material\": %d }",
+			band ? "," : "", 3 + band, band);
+	fprintf(f, " ] } ]\n}\n");
+	fclose(f);
+	return true;
+}
+
+// Triangles whose clockwise face normal points away from their vertex normals
+static size_t CountInvertedTriangles(const Vertex* vertices, const unsigned int* indices, size_t indexCount) {
+	size_t inverted = 0;
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		const Vertex& a = vertices[indices[i]];
+		const Vertex& b = vertices[indices[i + 1]];
+		const Vertex& c = vertices[indices[i + 2]];
+		Float3 face = Cross(Float3{ b.x - a.x, b.y - a.y, b.z - a.z }, Float3{ c.x - a.x, c.y - a.y, c.z - a.z });
+		if (Dot(face, Float3{ a.nx + b.nx + c.nx, a.ny + b.ny + c.ny, a.nz + b.nz + c.nz }) <= 0)
+			inverted++;
+	}
+	return inverted;
+}
+
+// Largest attribute difference between two imports, corner by corner; -1
+// when the triangle lists or submeshes do not line up at all.
+static float CompareImports(const MeshData& a, const MeshData& b) {
+	if (a.indices.size() != b.indices.size() || a.subMeshes.size() != b.subMeshes.size())
+		return -1;
+	for (size_t i = 0; i < a.subMeshes.size(); i++)
+		if (a.subMeshes[i].material != b.subMeshes[i].material || a.subMeshes[i].firstIndex != b.subMeshes[i].firstIndex
+			|| a.subMeshes[i].indexCount != b.subMeshes[i].indexCount)
+			return -1;
+
+	float maxError = 0;
+	for (size_t i = 0; i < a.indices.size(); i++) {
+		const float* va = &a.vertices[a.indices[i]].x;
+		const float* vb = &b.vertices[b.indices[i]].x;
+		for (int k = 0; k < 11; k++)
+			maxError = std::max(maxError, std::fabs(va[k] - vb[k]));
+	}
+	return maxError;
+}
+
+static size_t ReadWholeFile(const char* path, vector<uint8_t>& bytes) {
+	FILE* f = fopen(path, "rb");
+	if (!f)
+		return 0;
+	fseek(f, 0, SEEK_END);
+	bytes.resize((size_t)ftell(f));
+	fseek(f, 0, SEEK_SET);
+	size_t read = fread(bytes.data(), 1, bytes.size(), f);
+	fclose(f);
+	return read;
+}
+
+// Without --file, generates a model, checks the OBJ and glTF imports against
+// each other and removes it again. Times are with a warm page cache, so the
+// raw read is the floor every path is measured against.
+static int RunMeshImportBench(int argc, char** argv) {
+	const char* file = GetOption(argc, argv, "--file", nullptr);
+	int side = GetIntOption(argc, argv, "--side", 1000);
+	int threads = GetIntOption(argc, argv, "--threads", 0);
+	std::string base = std::string(GetOption(argc, argv, "--dir", ".")) + "/mesh_import_test";
+	std::string path = file ? file : base + ".obj";
+	bool ok = true;
+
+	if (!file) {
+		size_t objBytes;
+		if (!WriteTestModel(base, side, objBytes)) {
+			fprintf(stderr, "mesh-import-bench: cannot write %s\n", path.c_str());
+			return 1;
+		}
+	}
+
+	vector<uint8_t> bytes;
+	double readTime = 1e30;
+	for (int it = 0; it < 3; it++) {
+		Clock::time_point start = Clock::now();
+		if (!ReadWholeFile(path.c_str(), bytes)) {
+			fprintf(stderr, "mesh-import-bench: cannot read %s\n", path.c_str());
+			return 1;
+		}
+		readTime = std::min(readTime, SecondsSince(start));
+	}
+	double megabytes = bytes.size() / 1048576.0;
+	vector<uint8_t>().swap(bytes);
+
+	ThreadPool pool(threads);
+	ThreadPool single(1);
+	printf("mesh-import: %s, %.1f MB, %d threads\n", path.c_str(), megabytes, pool.GetThreadCount());
+	printf("  %-24s %9.2f ms  %8.1f MB/s\n", "read (fread)", readTime * 1e3, megabytes / readTime);
+
+	MeshData imported, singleImported;
+	for (ThreadPool* p : { &single, &pool }) {
+		MeshData& mesh = p == &single ? singleImported : imported;
+		Clock::time_point start = Clock::now();
+		if (!ImportMesh(path.c_str(), *p, mesh)) {
+			fprintf(stderr, "mesh-import-bench: %s does not import\n", path.c_str());
+			return 1;
+		}
+		double time = SecondsSince(start);
+		std::string label = "import, " + std::to_string(p->GetThreadCount()) + " thread" + (p->GetThreadCount() > 1 ? "s" : "");
+		printf("  %-24s %9.2f ms  %8.1f MB/s\n", label.c_str(), time * 1e3, megabytes / time);
+	}
+	printf("  %zu vertices, %zu triangles, %zu submeshes\n", imported.vertices.size(), imported.indices.size() / 3, imported.subMeshes.size());
+	ok = ok && CompareImports(singleImported, imported) == 0;
+	MeshData().vertices.swap(singleImported.vertices);
+
+	// the cache: stale, fresh, then stale again once the source is touched
+	std::string cachePath = path + ".mesh";
+	remove(cachePath.c_str());
+	ImportedMesh cached;
+	bool reimported = false;
+	Clock::time_point start = Clock::now();
+	ok = ok && cached.Open(path.c_str(), pool, &reimported) && reimported;
+	double coldTime = SecondsSince(start);
+
+	double warmTime = 1e30, touchTime = 1e30;
+	volatile float sum = 0;
+	for (int it = 0; it < 5 && ok; it++) {
+		start = Clock::now();
+		ok = cached.Open(path.c_str(), pool, &reimported) && !reimported;
+		warmTime = std::min(warmTime, SecondsSince(start));
+		// one read per page, as a first draw would upload it
+		const uint8_t* vertices = (const uint8_t*)cached.GetVertices();
+		size_t vertexBytes = cached.GetVertexCount() * sizeof(Vertex);
+		for (size_t offset = 0; offset < vertexBytes; offset += 4096)
+			sum += *(const float*)(vertices + offset - offset % sizeof(Vertex));
+		const uint8_t* indices = (const uint8_t*)cached.GetIndices();
+		for (size_t offset = 0; offset < cached.GetIndexCount() * sizeof(unsigned int); offset += 4096)
+			sum += (float)indices[offset];
+		touchTime = std::min(touchTime, SecondsSince(start));
+	}
+	ok = ok && cached.GetVertexCount() == imported.vertices.size() && cached.GetIndexCount() == imported.indices.size()
+		&& memcmp(cached.GetVertices(), imported.vertices.data(), imported.vertices.size() * sizeof(Vertex)) == 0
+		&& memcmp(cached.GetIndices(), imported.indices.data(), imported.indices.size() * sizeof(unsigned int)) == 0;
+	printf("  %-24s %9.2f ms\n", "cold: import + write", coldTime * 1e3);
+	printf("  %-24s %9.2f ms  (%.0fx faster than the import)\n", "warm: map cache", warmTime * 1e3, coldTime / warmTime);
+	printf("  %-24s %9.2f ms  %8.1f MB/s of cache\n", "warm: map + touch pages", touchTime * 1e3,
+		(cached.GetVertexCount() * sizeof(Vertex) + cached.GetIndexCount() * 4) / 1048576.0 / touchTime);
+	cached.Close();
+
+	std::error_code error;
+	std::filesystem::last_write_time(path, std::filesystem::last_write_time(path) + std::chrono::seconds(2), error);
+	bool invalidated = !error && cached.Open(path.c_str(), pool, &reimported) && reimported;
+	cached.Close();
+	ok = ok && invalidated;
+
+	if (!file) {
+		MeshData gltf;
+		start = Clock::now();
+		bool gltfOk = ImportMesh((base + ".gltf").c_str(), pool, gltf);
+		double gltfTime = SecondsSince(start);
+		float parity = gltfOk ? CompareImports(imported, gltf) : -1;
+		size_t inverted = CountInvertedTriangles(imported.vertices.data(), imported.indices.data(), imported.indices.size())
+			+ CountInvertedTriangles(gltf.vertices.data(), gltf.indices.data(), gltf.indices.size());
+		printf("  %-24s %9.2f ms, OBJ/glTF max difference %g, %zu inverted triangles\n", "glTF import", gltfTime * 1e3, parity, inverted);
+		ok = ok && parity >= 0 && parity < 1e-5f && inverted == 0 && imported.subMeshes.size() == 4;
+
+		for (const char* extension : { ".obj", ".obj.mesh", ".mtl", ".gltf", ".bin" })
+			remove((base + extension).c_str());
+	}
+
+	if (!ok) {
+		fprintf(stderr, "mesh-import-bench: import or cache fucked up\n");
+		return 1;
+	}
+	printf("  single/multithreaded parity, cache contents and invalidation ok\n");
+	return 0;
+}
+
+// Objects scattered over a square world much larger than the far plane, seen
+// by a camera circling it, so a few percent are visible per frame. Every BVH
+// width must return exactly the boxes the flat per-object test accepts.
+static int RunCullBench(int argc, char** argv) {
+	int objectCount = GetIntOption(argc, argv, "--objects", 100000);
+	int frames = GetIntOption(argc, argv, "--frames", 200);
+	float worldSize = (float)GetIntOption(argc, argv, "--world", 4000);
+
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> position(-worldSize / 2, worldSize / 2), height(0.0f, 20.0f), size(0.5f, 3.0f);
+	vector<Aabb> boxes(objectCount);
+	for (Aabb& box : boxes) {
+		Float3 center = { position(rng), height(rng), position(rng) };
+		Float3 extent = { size(rng), size(rng), size(rng) };
+		box = { center - extent, center + extent };
+	}
+
+	Bvh bvh;
+	Clock::time_point start = Clock::now();
+	bvh.Build(boxes.data(), boxes.size());
+	double buildTime = SecondsSince(start);
+	start = Clock::now();
+	bvh.Refit(boxes.data());
+	double refitTime = SecondsSince(start);
+
+	// same camera as the renderers, 16:9
+	vector<Frustum> frustums(frames);
+	Float4x4 projection = Float4x4::PerspectiveLH(1.0f, 9.0f / 16.0f, 0.5f, 500.0f);
+	for (int frame = 0; frame < frames; frame++) {
+		float angle = 6.2831853f * frame / frames;
+		Float3 eye = { std::cos(angle) * worldSize / 4, 10.0f, std::sin(angle) * worldSize / 4 };
+		Float3 forward = Normalize(Float3{ -std::sin(angle * 3), -0.05f, std::cos(angle * 3) });
+		frustums[frame] = ExtractFrustum(Float4x4::LookToLH(eye, forward, { 0, 1, 0 }) * projection);
+	}
+
+	printf("cull: %d objects, %zu BVH nodes, %d frames, build %.2f ms, refit %.2f ms\n",
+		objectCount, bvh.GetNodeCount(), frames, buildTime * 1e3, refitTime * 1e3);
+
+	vector<vector<uint32_t>> reference(frames);
+	size_t visibleTotal = 0;
+	start = Clock::now();
+	for (int frame = 0; frame < frames; frame++) {
+		for (uint32_t i = 0; i < (uint32_t)objectCount; i++)
+			if (IntersectsFrustum(frustums[frame], boxes[i]))
+				reference[frame].push_back(i);
+		visibleTotal += reference[frame].size();
+	}
+	double flatTime = SecondsSince(start) / frames;
+	printf("  %.2f%% visible on average\n", 100.0 * visibleTotal / ((double)objectCount * frames));
+	printf("  %-16s %8.3f ms/frame  %10.0f objects/ms\n", "flat, scalar", flatTime * 1e3, objectCount / (flatTime * 1e3));
+
+	bool ok = true;
+	vector<uint32_t> visible;
+	for (int lanes : { 1, 4, 8 }) {
+		if (lanes > Bvh::MaxLanes())
+			continue;
+
+		BvhCullStats stats;
+		double time = 0;
+		for (int frame = 0; frame < frames; frame++) {
+			visible.clear();
+			start = Clock::now();
+			bvh.Cull(frustums[frame], visible, lanes, &stats);
+			time += SecondsSince(start);
+			std::sort(visible.begin(), visible.end());
+			ok = ok && visible == reference[frame];
+		}
+		time /= frames;
+		std::string label = "BVH, " + std::to_string(lanes) + " lane" + (lanes > 1 ? "s" : "");
+		printf("  %-16s %8.3f ms/frame  %10.0f objects/ms  %6.0f nodes, %5.0f whole subtrees/frame  %.1fx flat\n",
+			label.c_str(), time * 1e3, objectCount / (time * 1e3), (double)stats.nodes / frames, (double)stats.inside / frames, flatTime / time);
+	}
+
+	if (!ok) {
+		fprintf(stderr, "cull-bench: BVH visible set fucked up\n");
+		return 1;
+	}
+	printf("  visible sets match the flat test\n");
+	return 0;
+}
+
+struct Command {
+	const char* name;
+	int (*run)(int argc, char** argv);
+	const char* help;
+};
+
+static const Command commands[] = {
+	{ "ltc-bench", RunLTCBench, "rect light LTC throughput and SIMD/scalar parity [--points N --lights N --iterations N --lut-dir DIR]" },
+	{ "polygon-light-bench", RunPolygonLightBench, "polygon light shading cost per point over 3-8 vertices against rect lights, with rect and triangle fan parity checks [--points N --lights N --max-vertices N --lut-dir DIR]" },
+	{ "round-light-bench", RunRoundLightBench, "disk and sphere light shading cost per point against rect and point lights, form factors against quadrature and a disk against a 256-gon [--points N --lights N --check-points N --lut-dir DIR]" },
+	{ "rect-lod-bench", RunRectLodBench, "rect light LOD: disk thresholds fit to an error bound, then cost saved and error on many lights over roughness, batched and rasterized [--max-error E --samples N --points N --lights N --iterations N --frames N --threads N --lut-dir DIR]" },
+	{ "ltc-fit", RunLTCFit, "fits the GGX LTC tables and writes ltc_mat.dds / ltc_amp.dds [--size N --samples N --iterations N --threads N --out-dir DIR --errors FILE.csv --lut-dir DIR]" },
+	{ "light-filter", RunLightFilter, "prefilters a light texture into the padded Gaussian mip chain of dataFiltered.dds [--in FILE.ppm|FILE.dds --out FILE.dds --size N --float 1 --threads N --check N]" },
+	{ "dds-load-bench", RunDDSLoadBench, "DDS load time and peak RSS, heap read vs memory-mapped [--file FILE.dds --iterations N]" },
+	{ "mip-stream-bench", RunMipStreamBench, "time to the first usable mip, streamed vs full DDS loads at 256-8192 px [--dir DIR --first-size N --iterations N]" },
+	{ "texture-cache-bench", RunTextureCacheBench, "texture cache hit/miss/eviction counters under a memory budget [--dir DIR --textures N --materials N --visible N --frames N --budget-mb N]" },
+	{ "cull-bench", RunCullBench, "BVH frustum culling throughput in objects/ms at 1/4/8 lanes against a flat test [--objects N --frames N --world N]" },
+	{ "cluster-bench", RunClusterBench, "clustered light grid build time and coverage check [--lights N --width N --height N --iterations N --threads N --samples N]" },
+	{ "light-list-bench", RunLightListBench, "per-object light list build time, lights per object against all lights and a brute force check [--lights N --objects N --radius R --iterations N --threads N]" },
+	{ "frame-graph-bench", RunFrameGraphBench, "CPU frame of many moving objects as frame graph jobs, ms per frame per thread count, per-job timings and a nested job check [--objects N --lights N --frames N --threads N]" },
+	{ "profile-check", RunProfileCheck, "profiler cost per zone enabled and disabled, zone nesting and per-zone totals over rasterized frames [--iterations N --frames N --threads N --out FILE.json --lut-dir DIR]" },
+	{ "instance-bench", RunInstanceBench, "object structured buffer build time, one draw per cube vs one instanced draw [--objects N --frames N --threads N]" },
+	{ "vertex-pack-bench", RunVertexPackBench, "Vertex to 24-byte PackedVertex conversion throughput, bytes per vertex and max errors [--vertices N --iterations N --threads N]" },
+	{ "mesh-check", RunMeshCheck, "asserts retained/ring-buffered mesh submission allocates no buffers per frame [--frames N]" },
+	{ "mesh-import-bench", RunMeshImportBench, "OBJ/glTF import time over threads, cold import vs mapped .mesh cache vs raw read [--file FILE --side N --threads N --dir DIR]" },
+	{ "upload-check", RunUploadCheck, "light uploads per edit, dirty ranges against a full rewrite per frame, and a buffer resize check [--points N --spots N --rects N --edits N --frames N]" },
+	{ "large-mesh-check", RunLargeMeshCheck, "registers and draws a mesh past 65536 vertices, checks its 16-bit chunks and the 32-bit fallback [--vertices N]" },
+	{ "reference-render", RunReferenceRender, "Monte Carlo reference of the raster-bench scene: light samples/s per core, error over sample counts, LTC and rasterizer error against it [--width N --height N --samples N --reference N --threads N --lights N --shadows 1 --out FILE.ppm --lut-dir DIR]" },
+	{ "scene-bench", RunSceneBench, "deterministic frame times of the wWinMain scene along the orbit or a recorded camera path at a fixed timestep, as JSON with min/mean/p50/p95/p99 [--frames N --warmup N --timestep S --path FILE --record FILE --width N --height N --threads N --lights N --out FILE.json --lut-dir DIR]" },
+	{ "input-replay", RunInputReplay, "replays an input log through Camera::Update and the software rasterizer unpaced, slowest frames; without --log, a scripted session must replay bit for bit [--log FILE --save FILE --frames N --spikes N --width N --height N --threads N --lut-dir DIR]" },
+	{ "permutation-bench", RunPermutationBench, "software tile kernel specialized per mix of point/spot/dir/rect lights against the generic one, ms per frame and an identical image check [--width N --height N --frames N --rounds N --threads N --lights N --lut-dir DIR]" },
+	{ "raster-bench", RunRasterBench, "software rasterizer fps over thread counts [--width N --height N --frames N --threads N --lights N --out FILE.ppm --lut-dir DIR]" },
+};
+
+int main(int argc, char** argv) {
+	if (argc >= 2) {
+		for (const Command& command : commands) {
+			if (strcmp(argv[1], command.name) == 0) {
+				const char* profile = GetOption(argc, argv, "--profile", nullptr);
+				if (profile) {
+					Profiler::SetThreadName("main");
+					Profiler::Clear();
+					Profiler::SetEnabled(true);
+				}
+				try {
+					int result = command.run(argc, argv);
+					if (profile && !Profiler::WriteChromeTrace(profile))
+						fprintf(stderr, "%s: could not write %s\n", command.name, profile);
+					return result;
+				}
+				catch (const exception& e) {
+					fprintf(stderr, "%s: %s\n", command.name, e.what());
+					return -1;
+				}
+			}
+		}
+	}
+
+	printf("usage: Headless <command> [options]\n");
+	for (const Command& command : commands)
+		printf("  %-20s %s\n", command.name, command.help);
+	return argc >= 2 ? -1 : 0;
+}